@@ -54,6 +54,15 @@ typedef void (*projectm_preset_switch_requested_event)(bool is_hard_cut, void* u
 typedef void (*projectm_preset_switch_failed_event)(const char* preset_filename,
                                                     const char* message, void* user_data);
 
+/**
+ * @brief Callback function that is executed if the quality governor changed the quality level.
+ *
+ * @param quality_level The new quality level. 0 is full quality, higher values mean reduced quality.
+ * @param user_data A user-defined data pointer that was provided when registering the callback,
+ *                  e.g. context information.
+ */
+typedef void (*projectm_quality_level_changed_event)(int quality_level, void* user_data);
+
 
 /**
  * @brief Sets a callback function that will be called when a preset change is requested.
@@ -83,6 +92,20 @@ PROJECTM_EXPORT void projectm_set_preset_switch_failed_event_callback(projectm_h
                                                                       projectm_preset_switch_failed_event callback,
                                                                       void* user_data);
 
+/**
+ * @brief Sets a callback function that will be called when the quality governor changed the quality level.
+ *
+ * Only one callback can be registered per projectM instance. To remove the callback, use NULL.
+ *
+ * @param instance The projectM instance handle.
+ * @param callback A pointer to the callback function.
+ * @param user_data A pointer to any data that will be sent back in the callback, e.g. context
+ *                  information.
+ */
+PROJECTM_EXPORT void projectm_set_quality_level_changed_event_callback(projectm_handle instance,
+                                                                       projectm_quality_level_changed_event callback,
+                                                                       void* user_data);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -37,6 +37,9 @@ extern "C" {
  * If this function returns NULL, in most cases the OpenGL context is not initialized, not made
  * current or insufficient to render projectM visuals.
  *
+ * Multiple instances can be used concurrently from different threads, as long as each instance
+ * is only ever used by one thread at a time and has its own OpenGL context made current on it.
+ *
  * @return A projectM handle for the newly created instance that must be used in subsequent API calls.
  *         NULL if the instance could not be created successfully.
  */
@@ -58,11 +61,25 @@ PROJECTM_EXPORT void projectm_destroy(projectm_handle instance);
  * "file://" URLs. Additionally, the special filename "idle://" can be used to load the default
  * idle preset, displaying the "M" logo.
  *
+ * Presets stored in a pack file can be loaded by appending the member name to the pack file name,
+ * e.g. "presets.milkpack/Geiss/Reaction Diffusion.milk". The pack is memory-mapped on first use
+ * and kept open for subsequent loads.
+ *
  * Other URL schemas aren't supported and will cause a loading error.
  *
+ * The preset is parsed and its shaders are submitted to the driver before this function returns,
+ * but the switch itself happens in a later projectm_opengl_render_frame() call, once the shaders
+ * are compiled. Until then, the current preset continues to be displayed. If there's no current
+ * preset, this function waits for the shaders and switches immediately.
+ *
  * If the preset can't be loaded, no switch takes place and the current preset will continue to
- * be displayed. Note that if there's a transition in progress when calling this function, the
- * transition will be finished immediately, even if the new preset can't be loaded.
+ * be displayed. Errors found while parsing the preset are reported via the preset switch failed
+ * event callback before this function returns. Shader compilation errors are only detected when
+ * the switch is about to happen, so the callback is then invoked from inside a later
+ * projectm_opengl_render_frame() call. Loading another preset before the switch took place
+ * discards the pending one without an event. Note that if there's a transition in progress when
+ * calling this function, the transition will be finished immediately, even if the new preset
+ * can't be loaded.
  *
  * @param instance The projectM instance handle.
  * @param filename The preset filename or URL to load.
@@ -76,9 +93,19 @@ PROJECTM_EXPORT void projectm_load_preset_file(projectm_handle instance, const c
  *
  * Currently, the preset data is assumed to be in Milkdrop format.
  *
+ * The preset is parsed and its shaders are submitted to the driver before this function returns,
+ * but the switch itself happens in a later projectm_opengl_render_frame() call, once the shaders
+ * are compiled. Until then, the current preset continues to be displayed. If there's no current
+ * preset, this function waits for the shaders and switches immediately.
+ *
  * If the preset can't be loaded, no switch takes place and the current preset will continue to
- * be displayed. Note that if there's a transition in progress when calling this function, the
- * transition will be finished immediately, even if the new preset can't be loaded.
+ * be displayed. Errors found while parsing the preset are reported via the preset switch failed
+ * event callback before this function returns. Shader compilation errors are only detected when
+ * the switch is about to happen, so the callback is then invoked from inside a later
+ * projectm_opengl_render_frame() call. Loading another preset before the switch took place
+ * discards the pending one without an event. Note that if there's a transition in progress when
+ * calling this function, the transition will be finished immediately, even if the new preset
+ * can't be loaded.
  *
  * @param instance The projectM instance handle.
  * @param data The preset contents to load.
@@ -87,6 +114,20 @@ PROJECTM_EXPORT void projectm_load_preset_file(projectm_handle instance, const c
 PROJECTM_EXPORT void projectm_load_preset_data(projectm_handle instance, const char* data,
                                                bool smooth_transition);
 
+/**
+ * @brief Switches to a loaded preset right away instead of in a later render call.
+ *
+ * Waits until the shaders of the preset loaded with projectm_load_preset_file() or
+ * projectm_load_preset_data() are compiled, then switches to it. Useful if each frame must show
+ * the requested preset, e.g. when rendering a video offline. Shader compilation errors are
+ * reported via the preset switch failed event callback before this function returns.
+ *
+ * Does nothing if no preset switch is pending.
+ *
+ * @param instance The projectM instance handle.
+ */
+PROJECTM_EXPORT void projectm_switch_to_pending_preset(projectm_handle instance);
+
 /**
  * @brief Reloads all textures.
  *
@@ -130,6 +171,22 @@ PROJECTM_EXPORT char* projectm_get_version_string();
  */
 PROJECTM_EXPORT char* projectm_get_vcs_version_string();
 
+/**
+ * @brief Returns the preset files stored in a preset pack.
+ *
+ * Pack files contain a whole preset library with its textures and can be built with the
+ * projectM-BuildPresetPack tool. The returned file names can be passed directly to
+ * @a projectm_load_preset_file(). If the pack contains both a preset and the bundle built from
+ * it, only the bundle is returned.
+ *
+ * Remember to call @a projectm_free_string_array() on the returned pointer if the data is no
+ * longer needed.
+ *
+ * @param pack_filename The pack file name.
+ * @return A null-terminated array of preset file names, or NULL if the file isn't a valid pack.
+ */
+PROJECTM_EXPORT char** projectm_get_pack_preset_files(const char* pack_filename);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -32,18 +32,14 @@ extern "C" {
 #endif
 
 /**
- * @brief Writes a .bmp main texture dump after rendering the next main texture, before shaders are applied.
+ * @brief Writes a .bmp dump of the next rendered frame.
  *
  * If no file name is given, the image is written to the current working directory
  * and will be named named "frame_texture_contents-YYYY-mm-dd-HH:MM:SS-frame.bmp".
  *
- * Note this is the main texture contents, not the final rendering result. If the active preset
- * uses a composite shader, the dumped image will not have it applied. The main texture is what is
- * passed over to the next frame, the composite shader is only applied to the display framebuffer
- * after updating the main texture.
- *
- * To capture the actual output, dump the contents of the main framebuffer after calling
- * @a projectm_render_frame() on the application side.
+ * The image contains the final rendering result, including composite shaders and transitions.
+ * It is read back asynchronously and written to disk at the end of a later render call, as soon
+ * as the GPU has finished the transfer.
  *
  * @param instance The projectM instance handle.
  * @param output_file The filename to write the dump to or NULL.
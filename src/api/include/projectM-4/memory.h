@@ -52,6 +52,15 @@ PROJECTM_EXPORT char* projectm_alloc_string(unsigned int length);
  */
 PROJECTM_EXPORT void projectm_free_string(const char* str);
 
+/**
+ * @brief Frees a null-terminated string array returned by a projectM API call.
+ *
+ * Frees all strings in the array and the array itself.
+ *
+ * @param array The array to free. Can be NULL.
+ */
+PROJECTM_EXPORT void projectm_free_string_array(char** array);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
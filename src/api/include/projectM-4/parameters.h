@@ -37,6 +37,9 @@ extern "C" {
  * Calling this method will clear and reload all textures, including the main rendering texture.
  * Can cause a small delay/lag in rendering. Only use if texture paths were changed.
  *
+ * Besides directories, the list can contain preset pack files. Textures stored in a pack are read
+ * directly from the memory-mapped file.
+ *
  * @param instance The projectM instance handle.
  * @param texture_search_paths A list of texture search paths.
  * @param count The number of paths in the list.
@@ -305,6 +308,142 @@ PROJECTM_EXPORT void projectm_set_window_size(projectm_handle instance, size_t w
  */
 PROJECTM_EXPORT void projectm_get_window_size(projectm_handle instance, size_t* width, size_t* height);
 
+/**
+ * @brief Sets the internal render resolution scale.
+ *
+ * Presets are rendered at the window size multiplied by this factor, then scaled to the window
+ * size when drawing the final image. Values below 1.0 reduce the GPU load on large outputs at the
+ * cost of sharpness. Aspect ratio calculations always use the window size, so presets look the same.
+ *
+ * @param instance The projectM instance handle.
+ * @param scale The new render scale. Will be clamped to [0.1, 2.0]. Default is 1.0.
+ */
+PROJECTM_EXPORT void projectm_set_render_scale(projectm_handle instance, float scale);
+
+/**
+ * @brief Returns the internal render resolution scale.
+ * @param instance The projectM instance handle.
+ * @return The current render scale.
+ */
+PROJECTM_EXPORT float projectm_get_render_scale(projectm_handle instance);
+
+/**
+ * @brief Sets the filter used to scale the internal render resolution to the window size.
+ *
+ * The filter is only used if the render scale is not 1.0.
+ *
+ * @param instance The projectM instance handle.
+ * @param filter The new upscale filter. Default is PROJECTM_UPSCALE_FILTER_BILINEAR.
+ */
+PROJECTM_EXPORT void projectm_set_upscale_filter(projectm_handle instance, projectm_upscale_filter filter);
+
+/**
+ * @brief Returns the filter used to scale the internal render resolution to the window size.
+ * @param instance The projectM instance handle.
+ * @return The current upscale filter.
+ */
+PROJECTM_EXPORT projectm_upscale_filter projectm_get_upscale_filter(projectm_handle instance);
+
+/**
+ * @brief Enables or disables the adaptive quality governor.
+ *
+ * If enabled, projectM measures the time between rendered frames. If the average frame time exceeds
+ * the budget given by the FPS value set via projectm_set_fps(), rendering quality is reduced in steps
+ * by lowering the per-pixel mesh size, the internal render scale, the rendered blur levels and the
+ * number of custom shape instances. Quality is restored step by step once there is enough headroom.
+ *
+ * Frame times are taken from the frame time set via projectm_set_frame_time() if used.
+ * Disabling the governor immediately restores full quality.
+ *
+ * @param instance The projectM instance handle.
+ * @param enabled True to enable the quality governor, false to disable it. Default is false.
+ */
+PROJECTM_EXPORT void projectm_set_quality_governor_enabled(projectm_handle instance, bool enabled);
+
+/**
+ * @brief Returns whether the adaptive quality governor is enabled.
+ * @param instance The projectM instance handle.
+ * @return True if the quality governor is enabled, false otherwise.
+ */
+PROJECTM_EXPORT bool projectm_get_quality_governor_enabled(projectm_handle instance);
+
+/**
+ * @brief Returns the quality level currently selected by the quality governor.
+ * @param instance The projectM instance handle.
+ * @return The current quality level. 0 is full quality, higher values mean reduced quality.
+ */
+PROJECTM_EXPORT int projectm_get_quality_level(projectm_handle instance);
+
+/**
+ * @brief Sets the frame pipelining depth.
+ *
+ * With a depth of 1 (the default), each projectm_opengl_render_frame() call evaluates the preset
+ * expressions and then issues the OpenGL commands for the frame. With a depth of 2, projectM starts
+ * evaluating the expressions of the next frame on a worker thread right after the current frame was
+ * submitted, so the CPU work overlaps with the application's buffer swap and other processing.
+ *
+ * A depth of 2 adds one frame of latency to the audio data used by presets. Expression code is then
+ * run on a thread other than the rendering thread, which is safe as projectM guards the shared
+ * expression memory with a mutex.
+ *
+ * @param instance The projectM instance handle.
+ * @param depth The pipeline depth. Will be clamped to 1 or 2.
+ */
+PROJECTM_EXPORT void projectm_set_pipeline_depth(projectm_handle instance, int depth);
+
+/**
+ * @brief Returns the frame pipelining depth.
+ * @param instance The projectM instance handle.
+ * @return The current pipeline depth.
+ */
+PROJECTM_EXPORT int projectm_get_pipeline_depth(projectm_handle instance);
+
+/**
+ * @brief Enables or disables compiling preset expression code to native machine code.
+ *
+ * If enabled, the per-frame, per-pixel and other expression code of presets loaded afterwards is
+ * translated to native machine code where possible, which runs considerably faster than the
+ * interpreter. Code using unsupported functions is still run by the interpreter.
+ *
+ * The expression JIT is only available if libprojectM was built with ENABLE_EXPRESSION_JIT on a
+ * supported platform, currently x86-64 Linux and macOS. Otherwise this setting has no effect.
+ * Disabled by default.
+ *
+ * @param instance The projectM instance handle.
+ * @param enabled True to enable the expression JIT, false to always use the interpreter.
+ */
+PROJECTM_EXPORT void projectm_set_expression_jit_enabled(projectm_handle instance, bool enabled);
+
+/**
+ * @brief Returns whether preset expression code is compiled to native machine code.
+ * @param instance The projectM instance handle.
+ * @return True if the expression JIT is enabled and available, false otherwise.
+ */
+PROJECTM_EXPORT bool projectm_get_expression_jit_enabled(projectm_handle instance);
+
+/**
+ * @brief Enables or disables the fast approximate blur.
+ *
+ * Presets can sample three increasingly blurred copies of the previous frame, blur1 to blur3.
+ * By default, these are rendered exactly like Milkdrop does, using two separable blur passes
+ * per level. The fast blur creates all three levels from a single downsample pyramid instead,
+ * which needs fewer passes and texture reads. The result is close to, but not identical with,
+ * the original blur, so some presets may look slightly different.
+ *
+ * Disabled by default.
+ *
+ * @param instance The projectM instance handle.
+ * @param enabled True to use the fast blur, false to use the exact Milkdrop blur.
+ */
+PROJECTM_EXPORT void projectm_set_fast_blur_enabled(projectm_handle instance, bool enabled);
+
+/**
+ * @brief Returns whether the fast approximate blur is enabled.
+ * @param instance The projectM instance handle.
+ * @return True if the fast blur is enabled, false otherwise.
+ */
+PROJECTM_EXPORT bool projectm_get_fast_blur_enabled(projectm_handle instance);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -46,6 +46,130 @@ PROJECTM_EXPORT void projectm_opengl_render_frame(projectm_handle instance);
  */
 PROJECTM_EXPORT void projectm_opengl_render_frame_fbo(projectm_handle instance, uint32_t framebuffer_object_id);
 
+/**
+ * @brief Renders a single frame and returns the texture holding the final image.
+ *
+ * The image is not drawn into any framebuffer. Hosts which composite projectM's output into their
+ * own scene can sample the texture directly, saving a full-screen copy per frame. If no preset
+ * transition is running and the internal render resolution equals the window size, no copy is made
+ * at all.
+ *
+ * The texture and fence are owned by projectM and remain valid until the next render call on this
+ * instance. They must not be modified or deleted. If the texture is used in a different, shared
+ * OpenGL context, call glWaitSync() on the fence before sampling it.
+ *
+ * @param instance The projectM instance handle.
+ * @param output Receives the texture information. The texture ID is 0 if no frame was rendered,
+ *               e.g. if the window size is zero.
+ */
+PROJECTM_EXPORT void projectm_opengl_render_frame_texture(projectm_handle instance, projectm_output_texture* output);
+
+/**
+ * @brief Sets whether the application's OpenGL state is saved and restored in each render call.
+ *
+ * projectM skips redundant OpenGL state changes while rendering. By default, it doesn't query
+ * any state and assumes the application uses OpenGL's default state. At the end of each render
+ * call, the shader program, vertex array, blending and the texture and sampler bindings of all
+ * texture units projectM used are reset to OpenGL's defaults, with texture unit 0 active. The
+ * target framebuffer and the viewport covering the window stay bound.
+ *
+ * If enabled, projectM instead reads the application's state at the start of each render call
+ * and restores all of the above, including framebuffer bindings and viewport, when done. This
+ * costs a few glGet calls per frame, which can stall some drivers.
+ *
+ * Disabled by default.
+ *
+ * @param instance The projectM instance handle.
+ * @param enabled True to restore the application's state, false to reset to OpenGL's defaults.
+ */
+PROJECTM_EXPORT void projectm_opengl_set_restore_state(projectm_handle instance, bool enabled);
+
+/**
+ * @brief Returns whether the application's OpenGL state is saved and restored in each render call.
+ * @param instance The projectM instance handle.
+ * @return True if the application's state is restored, false if OpenGL's defaults are set.
+ */
+PROJECTM_EXPORT bool projectm_opengl_get_restore_state(projectm_handle instance);
+
+/**
+ * @brief Callback function that receives a frame read back from the GPU.
+ *
+ * Images are always stored top row first. RGBA8 data is tightly packed with 4 bytes per pixel.
+ * YUV420 data contains the full-size Y plane, followed by the U and V planes, each with half the
+ * width and height, rounded up.
+ *
+ * The data pointer is only valid inside the callback. Make a copy if it needs to be retained.
+ *
+ * @param data Pointer to the image data.
+ * @param size Size of the image data in bytes.
+ * @param width The image width in pixels.
+ * @param height The image height in pixels.
+ * @param format The pixel format of the image data.
+ * @param frame_number The number of the frame the data was rendered in.
+ * @param user_data A user-defined data pointer that was provided when registering the callback,
+ *                  e.g. context information.
+ */
+typedef void (*projectm_frame_readback_event)(const uint8_t* data, size_t size,
+                                              uint32_t width, uint32_t height,
+                                              projectm_readback_format format,
+                                              uint32_t frame_number, void* user_data);
+
+/**
+ * @brief Enables or disables asynchronous readback of the rendered frames into system memory.
+ *
+ * If enabled, each rendered frame is converted into the given format and copied into a ring of
+ * pixel buffers without stalling the rendering pipeline. Completed frames are delivered a few frames
+ * later, either through the callback set with projectm_opengl_set_frame_readback_callback() at the end
+ * of the render call, or by calling projectm_opengl_poll_frame_readback().
+ *
+ * If all buffers are in use because completed frames weren't retrieved, the oldest frame is dropped.
+ *
+ * @param instance The projectM instance handle.
+ * @param enabled True to enable frame readback, false to disable it and discard pending frames.
+ * @param format The pixel format of the read back frames.
+ * @param ring_size Number of frames that can be in flight, between 1 and 16. Higher values increase
+ *                  the latency, but reduce the chance of waiting for the GPU. 3 is a good default.
+ */
+PROJECTM_EXPORT void projectm_opengl_set_frame_readback(projectm_handle instance, bool enabled,
+                                                        projectm_readback_format format, uint32_t ring_size);
+
+/**
+ * @brief Sets a callback function that receives completed frames at the end of each render call.
+ *
+ * Only one callback can be registered per projectM instance. To remove the callback, use NULL.
+ * If no callback is registered, frames need to be retrieved with projectm_opengl_poll_frame_readback().
+ *
+ * @param instance The projectM instance handle.
+ * @param callback A pointer to the callback function.
+ * @param user_data A pointer to any data that will be sent back in the callback, e.g. context
+ *                  information.
+ */
+PROJECTM_EXPORT void projectm_opengl_set_frame_readback_callback(projectm_handle instance,
+                                                                 projectm_frame_readback_event callback,
+                                                                 void* user_data);
+
+/**
+ * @brief Copies the oldest completed frame into the given buffer.
+ *
+ * This function does not block. If the GPU hasn't finished transferring the oldest frame yet,
+ * false is returned. Must be called with the OpenGL context used for rendering made current.
+ *
+ * If the buffer is too small, the frame is discarded. The required size is still returned in
+ * @a data_size. RGBA8 frames need width * height * 4 bytes.
+ *
+ * @param instance The projectM instance handle.
+ * @param buffer The buffer to copy the image data to.
+ * @param buffer_size The size of the buffer in bytes.
+ * @param data_size Receives the size of the image data in bytes. Can be NULL.
+ * @param width Receives the image width in pixels. Can be NULL.
+ * @param height Receives the image height in pixels. Can be NULL.
+ * @param frame_number Receives the number of the frame the data was rendered in. Can be NULL.
+ * @return True if a frame was copied into the buffer, false otherwise.
+ */
+PROJECTM_EXPORT bool projectm_opengl_poll_frame_readback(projectm_handle instance, uint8_t* buffer, size_t buffer_size,
+                                                         size_t* data_size, uint32_t* width, uint32_t* height,
+                                                         uint32_t* frame_number);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
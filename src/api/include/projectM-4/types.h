@@ -74,6 +74,36 @@ typedef enum
     PROJECTM_TOUCH_TYPE_DOUBLE_LINE      //!< Draws a double-line waveform.
 } projectm_touch_type;
 
+/**
+ * Filters used to scale the internal render resolution to the output size.
+ */
+typedef enum
+{
+    PROJECTM_UPSCALE_FILTER_BILINEAR, //!< Bilinear interpolation.
+    PROJECTM_UPSCALE_FILTER_BICUBIC   //!< Catmull-Rom bicubic interpolation. Sharper, but more expensive.
+} projectm_upscale_filter;
+
+/**
+ * Pixel formats for reading back rendered frames.
+ */
+typedef enum
+{
+    PROJECTM_READBACK_FORMAT_RGBA8, //!< 8 bits per channel RGBA, 4 bytes per pixel.
+    PROJECTM_READBACK_FORMAT_YUV420 //!< Planar 8-bit Y'CbCr 4:2:0 (I420), BT.601 limited range.
+} projectm_readback_format;
+
+/**
+ * Describes the final image of a frame rendered with projectm_opengl_render_frame_texture().
+ */
+typedef struct
+{
+    uint32_t texture_id; //!< OpenGL name of the GL_TEXTURE_2D texture holding the image, or 0 if no frame was rendered.
+    uint32_t width;      //!< Texture width in pixels.
+    uint32_t height;     //!< Texture height in pixels.
+    bool top_row_first;  //!< True if the first texture row is the top of the image, false for the usual OpenGL bottom-up order.
+    void* fence;         //!< GLsync fence object signalled when the GPU has finished rendering the image.
+} projectm_output_texture;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,220 @@
+#include "Lz4.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace libprojectM {
+namespace Lz4 {
+
+namespace {
+
+constexpr size_t MinMatchLength{4};   //!< Shortest match the format can encode.
+constexpr size_t LastLiterals{5};     //!< The last bytes of a block are always stored as literals.
+constexpr size_t MatchStartLimit{12}; //!< The last match must start at least this many bytes before the end.
+constexpr size_t MaxOffset{65535};    //!< Largest distance a match can reference.
+constexpr unsigned int HashBits{16};  //!< Size of the match finder hash table, in bits.
+
+auto Read32(const unsigned char* data) -> uint32_t
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+auto Hash(uint32_t sequence) -> uint32_t
+{
+    return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+/**
+ * @brief Appends a length which didn't fit into the token nibble.
+ * @param block The output block.
+ * @param length The remaining length after subtracting 15.
+ */
+void WriteLength(std::string& block, size_t length)
+{
+    while (length >= 255)
+    {
+        block.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    block.push_back(static_cast<char>(length));
+}
+
+/**
+ * @brief Appends a sequence of literals, optionally followed by a match.
+ * @param block The output block.
+ * @param literals The literal bytes.
+ * @param literalLength The number of literal bytes.
+ * @param offset The match offset, ignored if matchLength is 0.
+ * @param matchLength The match length, or 0 for the last sequence which only contains literals.
+ */
+void WriteSequence(std::string& block, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    size_t const matchCode = matchLength > 0 ? matchLength - MinMatchLength : 0;
+
+    block.push_back(static_cast<char>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+    if (literalLength >= 15)
+    {
+        WriteLength(block, literalLength - 15);
+    }
+
+    block.append(reinterpret_cast<const char*>(literals), literalLength);
+
+    if (matchLength == 0)
+    {
+        return;
+    }
+
+    block.push_back(static_cast<char>(offset & 0xFF));
+    block.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15)
+    {
+        WriteLength(block, matchCode - 15);
+    }
+}
+
+/**
+ * @brief Reads a length continuation from the block.
+ * @param source The current read position, advanced past the length bytes.
+ * @param sourceEnd The end of the block.
+ * @param length The length to add the continuation to.
+ * @return True if successful, false if the block ended prematurely.
+ */
+auto ReadLength(const unsigned char*& source, const unsigned char* sourceEnd, size_t& length) -> bool
+{
+    unsigned char byte;
+    do
+    {
+        if (source >= sourceEnd)
+        {
+            return false;
+        }
+        byte = *source++;
+        length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+} // namespace
+
+auto CompressBlock(const char* data, size_t size) -> std::string
+{
+    auto const* input = reinterpret_cast<const unsigned char*>(data);
+
+    std::string block;
+    block.reserve(size + size / 255 + 16);
+
+    size_t anchor{0};
+
+    if (size >= MatchStartLimit + 1)
+    {
+        // Stores the last position + 1 of each hashed 4-byte sequence, 0 if unused.
+        std::vector<uint32_t> hashTable(size_t(1) << HashBits);
+
+        size_t position{0};
+        while (position + MatchStartLimit < size)
+        {
+            auto const sequence = Read32(input + position);
+            auto& entry = hashTable[Hash(sequence)];
+            size_t const candidate = entry;
+            entry = static_cast<uint32_t>(position + 1);
+
+            if (candidate == 0 || position - (candidate - 1) > MaxOffset || Read32(input + candidate - 1) != sequence)
+            {
+                position++;
+                continue;
+            }
+
+            size_t const match = candidate - 1;
+            size_t matchLength{MinMatchLength};
+            while (position + matchLength < size - LastLiterals && input[match + matchLength] == input[position + matchLength])
+            {
+                matchLength++;
+            }
+
+            WriteSequence(block, input + anchor, position - anchor, position - match, matchLength);
+
+            position += matchLength;
+            anchor = position;
+        }
+    }
+
+    WriteSequence(block, input + anchor, size - anchor, 0, 0);
+
+    return block;
+}
+
+auto DecompressBlock(const char* source, size_t sourceSize, char* destination, size_t destinationSize) -> bool
+{
+    auto const* input = reinterpret_cast<const unsigned char*>(source);
+    auto const* inputEnd = input + sourceSize;
+    auto* output = reinterpret_cast<unsigned char*>(destination);
+    auto* outputEnd = output + destinationSize;
+
+    while (input < inputEnd)
+    {
+        auto const token = *input++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(input, inputEnd, literalLength))
+        {
+            return false;
+        }
+
+        if (literalLength > static_cast<size_t>(inputEnd - input) ||
+            literalLength > static_cast<size_t>(outputEnd - output))
+        {
+            return false;
+        }
+
+        memcpy(output, input, literalLength);
+        input += literalLength;
+        output += literalLength;
+
+        // The last sequence only contains literals.
+        if (input == inputEnd)
+        {
+            break;
+        }
+
+        if (inputEnd - input < 2)
+        {
+            return false;
+        }
+
+        size_t const offset = input[0] | (input[1] << 8);
+        input += 2;
+
+        if (offset == 0 || offset > static_cast<size_t>(output - reinterpret_cast<unsigned char*>(destination)))
+        {
+            return false;
+        }
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !ReadLength(input, inputEnd, matchLength))
+        {
+            return false;
+        }
+        matchLength += MinMatchLength;
+
+        if (matchLength > static_cast<size_t>(outputEnd - output))
+        {
+            return false;
+        }
+
+        // Matches may overlap the output, e.g. to repeat a short pattern, so copy byte by byte.
+        auto const* match = output - offset;
+        for (size_t byte = 0; byte < matchLength; byte++)
+        {
+            *output++ = *match++;
+        }
+    }
+
+    return output == outputEnd;
+}
+
+} // namespace Lz4
+} // namespace libprojectM
@@ -0,0 +1,37 @@
+/**
+ * @file Lz4.hpp
+ * @brief Minimal LZ4 block format encoder and decoder.
+ *
+ * Only the raw block format is implemented, without the frame format, dictionaries or checksums.
+ * The decoder accepts blocks written by any LZ4 implementation, the encoder uses a simple greedy
+ * match search, which is fast enough for packing presets but doesn't reach the ratio of the
+ * reference implementation.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace libprojectM {
+namespace Lz4 {
+
+/**
+ * @brief Compresses the given data into a single LZ4 block.
+ * @param data The data to compress.
+ * @param size The size of the data in bytes.
+ * @return The compressed block.
+ */
+auto CompressBlock(const char* data, size_t size) -> std::string;
+
+/**
+ * @brief Decompresses a single LZ4 block.
+ * @param source The compressed block.
+ * @param sourceSize The size of the compressed block in bytes.
+ * @param destination The output buffer. Must be at least destinationSize bytes large.
+ * @param destinationSize The exact size of the uncompressed data.
+ * @return True if the block was decompressed into exactly destinationSize bytes, false if the block is invalid.
+ */
+auto DecompressBlock(const char* source, size_t sourceSize, char* destination, size_t destinationSize) -> bool;
+
+} // namespace Lz4
+} // namespace libprojectM
@@ -0,0 +1,51 @@
+/**
+ * @file MemoryStream.hpp
+ * @brief Input stream reading directly from a memory buffer.
+ */
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+namespace libprojectM {
+
+/**
+ * @brief Stream buffer which reads from existing memory without copying it.
+ *
+ * Supports seeking, so the stream can be passed to all preset parsers.
+ */
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+    /**
+     * @brief Creates a stream buffer for the given memory area.
+     * @param data The data. Must stay valid as long as the buffer is used.
+     * @param size The size of the data in bytes.
+     */
+    MemoryStreamBuffer(const char* data, size_t size);
+
+protected:
+    auto seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode) -> pos_type override;
+
+    auto seekpos(pos_type position, std::ios_base::openmode mode) -> pos_type override;
+};
+
+/**
+ * @brief Input stream reading from a memory buffer.
+ */
+class MemoryStream : public std::istream
+{
+public:
+    /**
+     * @brief Creates a stream for the given memory area.
+     * @param data The data. Must stay valid as long as the stream is used.
+     * @param size The size of the data in bytes.
+     */
+    MemoryStream(const char* data, size_t size);
+
+private:
+    MemoryStreamBuffer m_buffer; //!< The stream buffer reading the data.
+};
+
+} // namespace libprojectM
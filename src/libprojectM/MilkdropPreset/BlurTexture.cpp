@@ -4,6 +4,9 @@
 
 #include "MilkdropStaticShaders.hpp"
 
+#include <Renderer/StateCache.hpp>
+
+#include <algorithm>
 #include <array>
 
 namespace libprojectM {
@@ -15,10 +18,10 @@ BlurTexture::BlurTexture()
     auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
 
     // Compile shader sources
-    m_blur1Shader.CompileProgram(staticShaders->GetBlurVertexShader(),
-                                 staticShaders->GetBlur1FragmentShader());
-    m_blur2Shader.CompileProgram(staticShaders->GetBlurVertexShader(),
-                                 staticShaders->GetBlur2FragmentShader());
+    m_blur1Shader.CompileProgramAsync(staticShaders->GetBlurVertexShader(),
+                                      staticShaders->GetBlur1FragmentShader());
+    m_blur2Shader.CompileProgramAsync(staticShaders->GetBlurVertexShader(),
+                                      staticShaders->GetBlur2FragmentShader());
 
     m_blurFramebuffer.CreateColorAttachment(0, 0);
 
@@ -32,7 +35,8 @@ BlurTexture::BlurTexture()
     glGenBuffers(1, &m_vboBlur);
     glGenVertexArrays(1, &m_vaoBlur);
 
-    glBindVertexArray(m_vaoBlur);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.BindVertexArray(m_vaoBlur);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboBlur);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * pointsBlur.size(), pointsBlur.data(), GL_STATIC_DRAW);
@@ -43,7 +47,7 @@ BlurTexture::BlurTexture()
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, nullptr);                                    // Position at index 0 and 1
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 4, reinterpret_cast<void*>(sizeof(float) * 2)); // Texture coord at index 2 and 3
 
-    glBindVertexArray(0);
+    stateCache.BindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Initialize with empty textures.
@@ -62,14 +66,36 @@ BlurTexture::BlurTexture()
 BlurTexture::~BlurTexture()
 {
     glDeleteBuffers(1, &m_vboBlur);
+    Renderer::StateCache::Current().VertexArrayDeleted(m_vaoBlur);
     glDeleteVertexArrays(1, &m_vaoBlur);
 }
 
+auto BlurTexture::IsCompilationComplete() const -> bool
+{
+    return m_blur1Shader.IsCompilationComplete() && m_blur2Shader.IsCompilationComplete() &&
+           (!m_fastBlurShader || m_fastBlurShader->IsCompilationComplete());
+}
+
+void BlurTexture::FinishCompilation()
+{
+    m_blur1Shader.FinishCompilation();
+    m_blur2Shader.FinishCompilation();
+    if (m_fastBlurShader)
+    {
+        m_fastBlurShader->FinishCompilation();
+    }
+}
+
 void BlurTexture::SetRequiredBlurLevel(BlurTexture::BlurLevel level)
 {
     m_blurLevel = std::max(level, m_blurLevel);
 }
 
+void BlurTexture::SetBlurLevelLimit(BlurTexture::BlurLevel level)
+{
+    m_blurLevelLimit = std::max(level, BlurLevel::Blur1);
+}
+
 auto BlurTexture::GetDescriptorsForBlurLevel(BlurTexture::BlurLevel blurLevel) const -> std::vector<Renderer::TextureSamplerDescriptor>
 {
     std::vector<Renderer::TextureSamplerDescriptor> descriptors;
@@ -108,7 +134,7 @@ void BlurTexture::Update(const Renderer::Texture& sourceTexture, const PerFrameC
 
     AllocateTextures(sourceTexture);
 
-    unsigned int const passes = static_cast<int>(m_blurLevel) * 2;
+    unsigned int const passes = static_cast<int>(std::min(m_blurLevel, m_blurLevelLimit)) * 2;
     auto const blur1EdgeDarken = static_cast<float>(*perFrameContext.blur1_edge_darken);
 
     const std::array<float, 8> weights = {4.0f, 3.8f, 3.5f, 2.9f, 1.9f, 1.2f, 0.7f, 0.3f}; //<- user can specify these
@@ -133,140 +159,235 @@ void BlurTexture::Update(const Renderer::Texture& sourceTexture, const PerFrameC
     scale[2] = 1.0f / (tempMax - tempMin);
     bias[2] = -tempMin * scale[2];
 
-    // Remember previously bound framebuffer
-    GLint origReadFramebuffer;
-    GLint origDrawFramebuffer;
-    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &origReadFramebuffer);
-    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &origDrawFramebuffer);
-
     m_blurFramebuffer.Bind(0);
 
-    glBlendFunc(GL_ONE, GL_ZERO);
-    glBindVertexArray(m_vaoBlur);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.SetBlend(false);
+    stateCache.BindVertexArray(m_vaoBlur);
 
-    for (unsigned int pass = 0; pass < passes; pass++)
+    // Keep using the exact blur until the fast blur shader is ready.
+    if (m_fastBlur && m_fastBlurShader->IsCompilationComplete())
+    {
+        RenderFastBlur(sourceTexture, passes / 2, scale, bias, blur1EdgeDarken);
+    }
+    else
     {
-        if (m_blurTextures[pass]->TextureID() == 0)
+        for (unsigned int pass = 0; pass < passes; pass++)
         {
-            continue;
-        }
+            if (m_blurTextures[pass]->TextureID() == 0)
+            {
+                continue;
+            }
 
-        // set pixel shader
-        Renderer::Shader* blurShader;
-        if ((pass % 2) == 0)
-        {
-            blurShader = &m_blur1Shader;
+            // set pixel shader
+            Renderer::Shader* blurShader;
+            if ((pass % 2) == 0)
+            {
+                blurShader = &m_blur1Shader;
+            }
+            else
+            {
+                blurShader = &m_blur2Shader;
+            }
+            blurShader->Bind();
+            blurShader->SetUniformInt("texture_sampler", 0);
+
+            stateCache.Viewport(0, 0, m_blurTextures[pass]->Width(), m_blurTextures[pass]->Height());
+
+            // hook up correct source texture - assume there is only one, at stage 0
+            if (pass == 0)
+            {
+                sourceTexture.Bind(0);
+            }
+            else
+            {
+                m_blurTextures[pass - 1]->Bind(0);
+            }
+            m_blurSampler->Bind(0);
+
+            float srcWidth = static_cast<float>((pass == 0) ? sourceTexture.Width() : m_blurTextures[pass - 1]->Width());
+            float srcHeight = static_cast<float>((pass == 0) ? sourceTexture.Height() : m_blurTextures[pass - 1]->Height());
+
+            float scaleNow = scale[pass / 2];
+            float biasNow = bias[pass / 2];
+
+            // set constants
+            if (pass % 2 == 0)
+            {
+                // pass 1 (long horizontal pass)
+                //-------------------------------------
+                const float w1 = weights[0] + weights[1];
+                const float w2 = weights[2] + weights[3];
+                const float w3 = weights[4] + weights[5];
+                const float w4 = weights[6] + weights[7];
+                const float d1 = 0 + 2 * weights[1] / w1;
+                const float d2 = 2 + 2 * weights[3] / w2;
+                const float d3 = 4 + 2 * weights[5] / w3;
+                const float d4 = 6 + 2 * weights[7] / w4;
+                const float w_div = 0.5f / (w1 + w2 + w3 + w4);
+                //-------------------------------------
+                //float4 _c0; // source texsize (.xy), and inverse (.zw)
+                //float4 _c1; // w1..w4
+                //float4 _c2; // d1..d4
+                //float4 _c3; // scale, bias, w_div, 0
+                //-------------------------------------
+                // The shader shifts the image by one source pixel up and left. The first pass used to
+                // read the preset framebuffer with a vertical flip, which also inverted the vertical
+                // shift. Keep it inverted for that pass, so the blurred image keeps its position.
+                float const shiftHeight = pass == 0 ? -srcHeight : srcHeight;
+                m_blur1Shader.SetUniformFloat4("_c0", {srcWidth, srcHeight, 1.0f / srcWidth, 1.0f / shiftHeight});
+                m_blur1Shader.SetUniformFloat4("_c1", {w1, w2, w3, w4});
+                m_blur1Shader.SetUniformFloat4("_c2", {d1, d2, d3, d4});
+                m_blur1Shader.SetUniformFloat4("_c3", {scaleNow, biasNow, w_div, 0.0});
+            }
+            else
+            {
+                // pass 2 (short vertical pass)
+                //-------------------------------------
+                const float w1 = weights[0] + weights[1] + weights[2] + weights[3];
+                const float w2 = weights[4] + weights[5] + weights[6] + weights[7];
+                const float d1 = 0 + 2 * ((weights[2] + weights[3]) / w1);
+                const float d2 = 2 + 2 * ((weights[6] + weights[7]) / w2);
+                const float w_div = 1.0f / ((w1 + w2) * 2);
+                //-------------------------------------
+                //float4 _c0; // source texsize (.xy), and inverse (.zw)
+                //float4 _c5; // w1,w2,d1,d2
+                //float4 _c6; // w_div, edge_darken_c1, edge_darken_c2, edge_darken_c3
+                //-------------------------------------
+                m_blur2Shader.SetUniformFloat4("_c0", {srcWidth, srcHeight, 1.0f / srcWidth, 1.0f / srcHeight});
+                m_blur2Shader.SetUniformFloat4("_c5", {w1, w2, d1, d2});
+                // note: only do this first time; if you do it many times,
+                // then the super-blurred levels will have big black lines along the top & left sides.
+                if (pass == 1)
+                {
+                    // Darken edges
+                    m_blur2Shader.SetUniformFloat4("_c6", {w_div, (1 - blur1EdgeDarken), blur1EdgeDarken, 5.0f});
+                }
+                else
+                {
+                    // Don't darken
+                    m_blur2Shader.SetUniformFloat4("_c6", {w_div, 1.0f, 0.0f, 5.0f});
+                }
+            }
+
+            // Draw fullscreen quad
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+            // Save to blur texture
+            m_blurTextures[pass]->Bind(0);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, m_blurTextures[pass]->Width(), m_blurTextures[pass]->Height());
+            m_blurTextures[pass]->Unbind(0);
         }
-        else
+    }
+
+    // Reset viewport size. The caller is responsible for binding its framebuffer again.
+    stateCache.Viewport(0, 0, sourceTexture.Width(), sourceTexture.Height());
+}
+
+void BlurTexture::SetFastBlur(bool enabled)
+{
+    m_fastBlur = enabled;
+
+    if (m_fastBlur && !m_fastBlurShader)
+    {
+        auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
+        m_fastBlurShader = std::make_unique<Renderer::Shader>();
+        m_fastBlurShader->CompileProgramAsync(staticShaders->GetBlurVertexShader(),
+                                              staticShaders->GetBlurFastFragmentShader());
+    }
+}
+
+void BlurTexture::RenderFastBlur(const Renderer::Texture& sourceTexture, unsigned int levels,
+                                 const Values& scale, const Values& bias, float blur1EdgeDarken)
+{
+    m_fastBlurShader->FinishCompilation();
+    m_fastBlurShader->Bind();
+    m_fastBlurShader->SetUniformInt("texture_sampler", 0);
+
+    // Each pass halves the resolution with a 5-tap dual filter downsample. The first pass only
+    // reduces the source to the size of the first intermediate texture, then each blur level
+    // is sampled down from the previous one, skipping the intermediate textures of the exact mode.
+    //
+    // pass 0: source -> blur0 (1/2)
+    // pass 1: blur0 -> blur1 (1/4)  <-  "blur1", with scale/bias 1 and edge darkening
+    // pass 2: blur1 -> blur3 (1/8)  <-  "blur2", with scale/bias 2
+    // pass 3: blur3 -> blur5 (1/16) <-  "blur3", with scale/bias 3
+    std::array<int, 4> const targets{0, 1, 3, 5};
+    const Renderer::Texture* input = &sourceTexture;
+
+    for (unsigned int pass = 0; pass <= levels; pass++)
+    {
+        auto const& target = m_blurTextures[targets[pass]];
+        if (target->TextureID() == 0)
         {
-            blurShader = &m_blur2Shader;
+            return;
         }
-        blurShader->Bind();
-        blurShader->SetUniformInt("texture_sampler", 0);
 
-        glViewport(0, 0, m_blurTextures[pass]->Width(), m_blurTextures[pass]->Height());
+        Renderer::StateCache::Current().Viewport(0, 0, target->Width(), target->Height());
+
+        input->Bind(0);
+        m_blurSampler->Bind(0);
+
+        auto const srcWidth = static_cast<float>(input->Width());
+        auto const srcHeight = static_cast<float>(input->Height());
 
-        // hook up correct source texture - assume there is only one, at stage 0
+        //-------------------------------------
+        //float4 _c0; // source texsize (.xy), and inverse (.zw)
+        //float4 _c1; // scale, bias, edge_darken_c1, edge_darken_c2
+        //float4 _c2; // sample offset (.xy)
+        //-------------------------------------
+        m_fastBlurShader->SetUniformFloat4("_c0", {srcWidth, srcHeight, 1.0f / srcWidth, 1.0f / srcHeight});
+
+        // The exact blur moves each level up and left by one pixel of its source texture, with the
+        // vertical shift of the first pass inverted. Do the same on the passes reading the same sources.
         if (pass == 0)
         {
-            sourceTexture.Bind(0);
-            blurShader->SetUniformInt("flipVertical", 1);
+            m_fastBlurShader->SetUniformFloat4("_c2", {1.0f / srcWidth, -1.0f / srcHeight, 0.0f, 0.0f});
+        }
+        else if (pass == 1)
+        {
+            m_fastBlurShader->SetUniformFloat4("_c2", {0.0f, 0.0f, 0.0f, 0.0f});
         }
         else
         {
-            m_blurTextures[pass - 1]->Bind(0);
-            blurShader->SetUniformInt("flipVertical", 0);
+            m_fastBlurShader->SetUniformFloat4("_c2", {1.0f / srcWidth, 1.0f / srcHeight, 0.0f, 0.0f});
         }
-        m_blurSampler->Bind(0);
-
-        float srcWidth = static_cast<float>((pass == 0) ? sourceTexture.Width() : m_blurTextures[pass - 1]->Width());
-        float srcHeight = static_cast<float>((pass == 0) ? sourceTexture.Height() : m_blurTextures[pass - 1]->Height());
 
-        float scaleNow = scale[pass / 2];
-        float biasNow = bias[pass / 2];
-
-        // set constants
-        if (pass % 2 == 0)
+        if (pass == 0)
         {
-            // pass 1 (long horizontal pass)
-            //-------------------------------------
-            const float w1 = weights[0] + weights[1];
-            const float w2 = weights[2] + weights[3];
-            const float w3 = weights[4] + weights[5];
-            const float w4 = weights[6] + weights[7];
-            const float d1 = 0 + 2 * weights[1] / w1;
-            const float d2 = 2 + 2 * weights[3] / w2;
-            const float d3 = 4 + 2 * weights[5] / w3;
-            const float d4 = 6 + 2 * weights[7] / w4;
-            const float w_div = 0.5f / (w1 + w2 + w3 + w4);
-            //-------------------------------------
-            //float4 _c0; // source texsize (.xy), and inverse (.zw)
-            //float4 _c1; // w1..w4
-            //float4 _c2; // d1..d4
-            //float4 _c3; // scale, bias, w_div, 0
-            //-------------------------------------
-            m_blur1Shader.SetUniformFloat4("_c0", {srcWidth, srcHeight, 1.0f / srcWidth, 1.0f / srcHeight});
-            m_blur1Shader.SetUniformFloat4("_c1", {w1, w2, w3, w4});
-            m_blur1Shader.SetUniformFloat4("_c2", {d1, d2, d3, d4});
-            m_blur1Shader.SetUniformFloat4("_c3", {scaleNow, biasNow, w_div, 0.0});
+            m_fastBlurShader->SetUniformFloat4("_c1", {1.0f, 0.0f, 1.0f, 0.0f});
+        }
+        else if (pass == 1)
+        {
+            m_fastBlurShader->SetUniformFloat4("_c1", {scale[0], bias[0], 1.0f - blur1EdgeDarken, blur1EdgeDarken});
         }
         else
         {
-            // pass 2 (short vertical pass)
-            //-------------------------------------
-            const float w1 = weights[0] + weights[1] + weights[2] + weights[3];
-            const float w2 = weights[4] + weights[5] + weights[6] + weights[7];
-            const float d1 = 0 + 2 * ((weights[2] + weights[3]) / w1);
-            const float d2 = 2 + 2 * ((weights[6] + weights[7]) / w2);
-            const float w_div = 1.0f / ((w1 + w2) * 2);
-            //-------------------------------------
-            //float4 _c0; // source texsize (.xy), and inverse (.zw)
-            //float4 _c5; // w1,w2,d1,d2
-            //float4 _c6; // w_div, edge_darken_c1, edge_darken_c2, edge_darken_c3
-            //-------------------------------------
-            m_blur2Shader.SetUniformFloat4("_c0", {srcWidth, srcHeight, 1.0f / srcWidth, 1.0f / srcHeight});
-            m_blur2Shader.SetUniformFloat4("_c5", {w1, w2, d1, d2});
-            // note: only do this first time; if you do it many times,
-            // then the super-blurred levels will have big black lines along the top & left sides.
-            if (pass == 1)
-            {
-                // Darken edges
-                m_blur2Shader.SetUniformFloat4("_c6", {w_div, (1 - blur1EdgeDarken), blur1EdgeDarken, 5.0f});
-            }
-            else
-            {
-                // Don't darken
-                m_blur2Shader.SetUniformFloat4("_c6", {w_div, 1.0f, 0.0f, 5.0f});
-            }
+            m_fastBlurShader->SetUniformFloat4("_c1", {scale[pass - 1], bias[pass - 1], 1.0f, 0.0f});
         }
 
         // Draw fullscreen quad
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
         // Save to blur texture
-        m_blurTextures[pass]->Bind(0);
-        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, m_blurTextures[pass]->Width(), m_blurTextures[pass]->Height());
-        m_blurTextures[pass]->Unbind(0);
-    }
+        target->Bind(0);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, target->Width(), target->Height());
+        target->Unbind(0);
 
-    glBindVertexArray(0);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Bind previous framebuffer and reset viewport size
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, origReadFramebuffer);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, origDrawFramebuffer);
-    glViewport(0, 0, sourceTexture.Width(), sourceTexture.Height());
-
-    Renderer::Shader::Unbind();
+        input = target.get();
+    }
 }
 
 void BlurTexture::Bind(GLint& unit, Renderer::Shader& shader) const
 {
+    auto const lastRenderedTexture = static_cast<size_t>(std::min(m_blurLevel, m_blurLevelLimit)) * 2 - 1;
+
     for (size_t i = 0; i < static_cast<size_t>(m_blurLevel) * 2; i++)
     {
         if (i % 2 == 1)
         {
-            m_blurTextures[i]->Bind(unit, m_blurSampler);
+            // Levels above the limit weren't rendered, use the highest rendered level instead.
+            m_blurTextures[std::min(i, lastRenderedTexture)]->Bind(unit, m_blurSampler);
             shader.SetUniformInt(std::string("sampler_blur" + std::to_string(i / 2 + 1)).c_str(), unit);
             unit++;
         }
@@ -49,6 +49,18 @@ public:
      */
     ~BlurTexture();
 
+    /**
+     * @brief Returns whether the shaders compiled in the constructor are ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the shaders compiled in the constructor.
+     * @throws Renderer::ShaderException Thrown if a shader failed to compile.
+     */
+    void FinishCompilation();
+
     /**
      * @brief Sets the minimum required blur level.
      * If the current level isn't high enough, it'll be increased.
@@ -56,6 +68,26 @@ public:
      */
     void SetRequiredBlurLevel(BlurLevel level);
 
+    /**
+     * @brief Sets the highest blur level actually rendered.
+     * If a preset requires higher blur levels, the highest rendered level is bound in their place.
+     * Used to reduce the GPU load. The limit can't be lower than BlurLevel::Blur1.
+     * @param level The maximum blur level to render.
+     */
+    void SetBlurLevelLimit(BlurLevel level);
+
+    /**
+     * @brief Enables or disables the fast approximate blur.
+     *
+     * The fast blur creates all blur levels from a single downsample pyramid, using a 5-tap
+     * dual filter on each level instead of two separable Gaussian passes. It needs fewer passes
+     * and texture fetches, but the result is only an approximation of Milkdrop's blur.
+     * The min/max scale and bias values and the blur1 edge darkening are still applied.
+     * Its shader is compiled asynchronously when first enabled, the exact blur is used until it's ready.
+     * @param enabled True to use the fast blur, false for the exact Milkdrop blur.
+     */
+    void SetFastBlur(bool enabled);
+
     /**
      * @brief Returns a list of descriptors for the given blur level.
      * The blur textures don't need to be present and can be empty placeholders.
@@ -65,6 +97,9 @@ public:
 
     /**
      * @brief Renders the required blur passes on the given texture.
+     *
+     * Leaves the blur framebuffer bound, the caller needs to bind its render target again.
+     *
      * @param sourceTexture The texture to create the blur levels from.
      * @param perFrameContext The per-frame variables.
      */
@@ -98,11 +133,24 @@ private:
      */
     void AllocateTextures(const Renderer::Texture& sourceTexture);
 
+    /**
+     * @brief Renders the blur levels with the fast dual filter pyramid.
+     * The blur framebuffer and vertex array must already be bound.
+     * @param sourceTexture The texture to create the blur levels from.
+     * @param levels The number of blur levels to render, 1 to 3.
+     * @param scale The scale value for each blur level.
+     * @param bias The bias value for each blur level.
+     * @param blur1EdgeDarken The edge darkening factor applied to the first blur level.
+     */
+    void RenderFastBlur(const Renderer::Texture& sourceTexture, unsigned int levels,
+                        const Values& scale, const Values& bias, float blur1EdgeDarken);
+
     GLuint m_vboBlur; //!< Vertex buffer object for the fullscreen blur quad.
     GLuint m_vaoBlur; //!< Vertex array object for the fullscreen blur quad.
 
     Renderer::Shader m_blur1Shader; //!< The shader used on the first blur pass.
     Renderer::Shader m_blur2Shader; //!< The shader used for subsequent blur passes after the initial pass.
+    std::unique_ptr<Renderer::Shader> m_fastBlurShader; //!< The fast blur downsample shader. Compiled when the fast blur is first enabled.
 
     int m_sourceTextureWidth{};  //!< Width of the source texture used to create the blur textures.
     int m_sourceTextureHeight{}; //!< Height of the source texture used to create the blur textures.
@@ -111,6 +159,8 @@ private:
     std::shared_ptr<Renderer::Sampler> m_blurSampler;                               //!< The blur sampler.
     std::array<std::shared_ptr<Renderer::Texture>, NumBlurTextures> m_blurTextures; //!< The blur textures for each pass.
     BlurLevel m_blurLevel{BlurLevel::None};                                         //!< Current blur level.
+    BlurLevel m_blurLevelLimit{BlurLevel::Blur3};                                   //!< Highest blur level to render.
+    bool m_fastBlur{false};                                                         //!< If true, the fast approximate blur is used.
 };
 
 } // namespace MilkdropPreset
@@ -1,5 +1,7 @@
 #include "Border.hpp"
 
+#include <Renderer/StateCache.hpp>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -26,15 +28,16 @@ void Border::Draw(const PerFrameContext& presetPerFrameContext)
     float const outerBorderSize = static_cast<float>(*presetPerFrameContext.ob_size);
     float const innerBorderSize = static_cast<float>(*presetPerFrameContext.ib_size);
 
-    glBindVertexArray(m_vaoID);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.BindVertexArray(m_vaoID);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
     // No additive drawing for borders
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    stateCache.SetBlend(true);
+    stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     m_presetState.untexturedShader.Bind();
-    m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+    m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
 
     std::array<Point, 4> vertices{};
     for (int border = 0; border < 2; border++)
@@ -79,11 +82,7 @@ void Border::Draw(const PerFrameContext& presetPerFrameContext)
         }
     }
 
-    Renderer::Shader::Unbind();
-
-    glDisable(GL_BLEND);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
 }
 
 } // namespace MilkdropPreset
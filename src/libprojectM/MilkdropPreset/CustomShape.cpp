@@ -1,10 +1,15 @@
 #include "CustomShape.hpp"
 
+#include "PerPixelCodeAnalysis.hpp"
 #include "PresetFileParser.hpp"
 
-#include <Renderer/TextureManager.hpp>
 #include <Renderer/RenderItem.hpp>
+#include <Renderer/StateCache.hpp>
+#include <Renderer/TextureManager.hpp>
 
+#include <algorithm>
+#include <array>
+#include <utility>
 #include <vector>
 
 namespace libprojectM {
@@ -12,7 +17,7 @@ namespace MilkdropPreset {
 
 CustomShape::CustomShape(PresetState& presetState)
     : m_presetState(presetState)
-    , m_perFrameContext(presetState.globalMemory, &presetState.globalRegisters)
+    , m_perFrameContext(presetState.expressionEngine, *presetState.globalMemory, &presetState.globalRegisters)
 {
     std::vector<TexturedPoint> vertexData;
     vertexData.resize(102);
@@ -23,7 +28,8 @@ CustomShape::CustomShape(PresetState& presetState)
     glGenVertexArrays(1, &m_vaoIdUntextured);
     glGenBuffers(1, &m_vboIdUntextured);
 
-    glBindVertexArray(m_vaoIdTextured);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.BindVertexArray(m_vaoIdTextured);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboIdTextured);
 
     glEnableVertexAttribArray(0);
@@ -36,7 +42,7 @@ CustomShape::CustomShape(PresetState& presetState)
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedPoint) * vertexData.size(), vertexData.data(), GL_STREAM_DRAW);
 
-    glBindVertexArray(m_vaoIdUntextured);
+    stateCache.BindVertexArray(m_vaoIdUntextured);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboIdUntextured);
 
     glEnableVertexAttribArray(0);
@@ -49,15 +55,19 @@ CustomShape::CustomShape(PresetState& presetState)
 
     RenderItem::Init();
 
-    m_perFrameContext.RegisterBuiltinVariables();
+    m_perFrameContext.RegisterBuiltinVariables(m_presetState.frameVariables);
 }
 
 CustomShape::~CustomShape()
 {
+    auto& stateCache = Renderer::StateCache::Current();
+
     glDeleteBuffers(1, &m_vboIdTextured);
+    stateCache.VertexArrayDeleted(m_vaoIdTextured);
     glDeleteVertexArrays(1, &m_vaoIdTextured);
 
     glDeleteBuffers(1, &m_vboIdUntextured);
+    stateCache.VertexArrayDeleted(m_vaoIdUntextured);
     glDeleteVertexArrays(1, &m_vaoIdUntextured);
 }
 
@@ -108,7 +118,8 @@ void CustomShape::Initialize(PresetFileParser& parsedFile, int index)
 
 void CustomShape::CompileCodeAndRunInitExpressions()
 {
-    m_perFrameContext.LoadStateVariables(m_presetState, *this, 0);
+    m_perFrameContext.LoadSharedVariables();
+    m_perFrameContext.LoadStateVariables(*this, 0);
     m_perFrameContext.EvaluateInitCode(m_presetState.customShapeInitCode[m_index], *this);
 
     for (int t = 0; t < TVarCount; t++)
@@ -117,22 +128,51 @@ void CustomShape::CompileCodeAndRunInitExpressions()
     }
 
     m_perFrameContext.CompilePerFrameCode(m_presetState.customShapePerFrameCode[m_index], *this);
+
+    m_usesSharedState = PerPixelCodeAnalysis::UsesSharedState(m_presetState.customShapePerFrameCode[m_index]);
+
+    // The texture manager may only be used on the OpenGL thread, while Evaluate() may run on a worker.
+    if (!m_image.empty())
+    {
+        m_imageTexture = m_presetState.renderContext.textureManager->GetTexture(m_image);
+        m_imageTextureFound = !m_imageTexture.Empty();
+    }
 }
 
-void CustomShape::Draw()
+auto CustomShape::Enabled() const -> bool
+{
+    return m_enabled;
+}
+
+auto CustomShape::UsesSharedState() const -> bool
+{
+    return m_usesSharedState;
+}
+
+void CustomShape::Evaluate()
 {
     static constexpr float pi = 3.141592653589793f;
 
+    m_preparedFrame.instances.clear();
+    m_preparedFrame.vertices.clear();
+    m_preparedFrame.outlineVertices.clear();
+
     if (!m_enabled)
     {
         return;
     }
 
-    glEnable(GL_BLEND);
+    int const instances = std::min(m_instances, m_presetState.renderContext.maxShapeInstances);
+
+    // Need to use +/- 1.0 here instead of 2.0 used in Milkdrop to achieve the same rendering result.
+    const auto incrementX = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
+    const auto incrementY = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
 
-    for (int instance = 0; instance < m_instances; instance++)
+    m_perFrameContext.LoadSharedVariables();
+
+    for (int instance = 0; instance < instances; instance++)
     {
-        m_perFrameContext.LoadStateVariables(m_presetState, *this, instance);
+        m_perFrameContext.LoadStateVariables(*this, instance);
         m_perFrameContext.ExecutePerFrameCode();
 
         int sides = static_cast<int>(*m_perFrameContext.sides);
@@ -145,10 +185,19 @@ void CustomShape::Draw()
             sides = 100;
         }
 
-        // Additive Drawing or Overwrite
-        glBlendFunc(GL_SRC_ALPHA, static_cast<int>(*m_perFrameContext.additive) != 0 ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+        ShapeInstance instanceData;
+        instanceData.firstVertex = m_preparedFrame.vertices.size();
+        instanceData.firstOutlineVertex = m_preparedFrame.outlineVertices.size();
+        instanceData.sides = sides;
+        instanceData.additive = static_cast<int>(*m_perFrameContext.additive) != 0;
+        instanceData.textured = static_cast<int>(*m_perFrameContext.textured) != 0;
+        instanceData.borderR = static_cast<float>(*m_perFrameContext.border_r);
+        instanceData.borderG = static_cast<float>(*m_perFrameContext.border_g);
+        instanceData.borderB = static_cast<float>(*m_perFrameContext.border_b);
+        instanceData.borderA = static_cast<float>(*m_perFrameContext.border_a);
 
-        std::vector<TexturedPoint> vertexData(sides + 2);
+        m_preparedFrame.vertices.resize(instanceData.firstVertex + sides + 2);
+        auto* vertexData = &m_preparedFrame.vertices[instanceData.firstVertex];
 
         vertexData[0].x = static_cast<float>(*m_perFrameContext.x * 2.0 - 1.0);
         vertexData[0].y = static_cast<float>(*m_perFrameContext.y * -2.0 + 1.0);
@@ -187,61 +236,111 @@ void CustomShape::Draw()
             vertexData[i].a = vertexData[1].a;
         }
 
+        if (instanceData.textured)
+        {
+            // Textures from the "image" key keep their own aspect ratio, the main texture uses the viewport's.
+            auto const textureAspectY = m_imageTextureFound ? 1.0f : m_presetState.renderContext.aspectY;
+            auto const texAngle = static_cast<float>(*m_perFrameContext.tex_ang);
+            auto const texZoom = static_cast<float>(*m_perFrameContext.tex_zoom);
+
+            for (int i = 1; i < sides + 1; i++)
+            {
+                const float cornerProgress = static_cast<float>(i - 1) / static_cast<float>(sides);
+                const float angle = cornerProgress * pi * 2.0f + texAngle + pi * 0.25f;
+
+                vertexData[i].u = 0.5f + 0.5f * cosf(angle) / texZoom * textureAspectY;
+                vertexData[i].v = 1.0f - (0.5f - 0.5f * sinf(angle) / texZoom); // Vertical flip required!
+            }
+        }
+
         // Duplicate last vertex.
         vertexData[sides + 1] = vertexData[1];
 
-        if (static_cast<int>(*m_perFrameContext.textured) != 0)
+        if (instanceData.borderA > 0.0001f)
+        {
+            // If thick outline is used, draw the shape four times with slight offsets
+            // (top left, top right, bottom right, bottom left).
+            static const std::array<std::array<float, 2>, 4> passOffsets{{{0.0f, 0.0f},
+                                                                          {1.0f, 0.0f},
+                                                                          {1.0f, 1.0f},
+                                                                          {0.0f, 1.0f}}};
+
+            instanceData.outlinePasses = m_thickOutline ? 4 : 1;
+            m_preparedFrame.outlineVertices.resize(instanceData.firstOutlineVertex + instanceData.outlinePasses * sides);
+            auto* outlineVertex = &m_preparedFrame.outlineVertices[instanceData.firstOutlineVertex];
+
+            for (int pass = 0; pass < instanceData.outlinePasses; pass++)
+            {
+                for (int i = 0; i < sides; i++)
+                {
+                    outlineVertex->x = vertexData[i + 1].x + passOffsets[pass][0] * incrementX;
+                    outlineVertex->y = vertexData[i + 1].y + passOffsets[pass][1] * incrementY;
+                    outlineVertex++;
+                }
+            }
+        }
+
+        m_preparedFrame.instances.push_back(instanceData);
+    }
+}
+
+void CustomShape::SwapPreparedFrame()
+{
+    std::swap(m_preparedFrame, m_drawnFrame);
+}
+
+void CustomShape::Draw()
+{
+    if (m_drawnFrame.instances.empty())
+    {
+        return;
+    }
+
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.SetBlend(true);
+
+    for (auto const& instanceData : m_drawnFrame.instances)
+    {
+        int const sides = instanceData.sides;
+        auto const* vertexData = &m_drawnFrame.vertices[instanceData.firstVertex];
+
+        // Additive Drawing or Overwrite
+        stateCache.BlendFunc(GL_SRC_ALPHA, instanceData.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+
+        if (instanceData.textured)
         {
             m_presetState.texturedShader.Bind();
-            m_presetState.texturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+            m_presetState.texturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
             m_presetState.texturedShader.SetUniformInt("texture_sampler", 0);
 
             // Textured shape, either main texture or texture from "image" key
-            auto textureAspectY = m_presetState.renderContext.aspectY;
-            if (m_image.empty())
+            if (m_imageTextureFound && m_imageTexture.Empty())
             {
-                assert(!m_presetState.mainTexture.expired());
-                m_presetState.mainTexture.lock()->Bind(0);
+                m_imageTexture.TryUpdate(*m_presetState.drawnFrame.renderContext.textureManager);
+            }
+
+            if (m_imageTextureFound && !m_imageTexture.Empty())
+            {
+                m_imageTexture.Bind(0, m_presetState.texturedShader);
             }
             else
             {
-                auto desc = m_presetState.renderContext.textureManager->GetTexture(m_image);
-                if (!desc.Empty())
-                {
-                    desc.Bind(0, m_presetState.texturedShader);
-                    textureAspectY = 1.0f;
-                }
-                else
-                {
-                    // No texture found, fall back to main texture.
-                    assert(!m_presetState.mainTexture.expired());
-                    m_presetState.mainTexture.lock()->Bind(0);
-                }
+                // No texture found, fall back to main texture.
+                assert(!m_presetState.mainTexture.expired());
+                m_presetState.mainTexture.lock()->Bind(0);
             }
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-            for (int i = 1; i < sides + 1; i++)
-            {
-                const float cornerProgress = static_cast<float>(i - 1) / static_cast<float>(sides);
-                const float angle = cornerProgress * pi * 2.0f + static_cast<float>(*m_perFrameContext.tex_ang) + pi * 0.25f;
-
-                vertexData[i].u = 0.5f + 0.5f * cosf(angle) / static_cast<float>(*m_perFrameContext.tex_zoom) * textureAspectY;
-                vertexData[i].v = 1.0f - (0.5f - 0.5f * sinf(angle) / static_cast<float>(*m_perFrameContext.tex_zoom)); // Vertical flip required!
-            }
-
-            vertexData[sides + 1] = vertexData[1];
-
             glBindBuffer(GL_ARRAY_BUFFER, m_vboIdTextured);
 
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexturedPoint) * (sides + 2), vertexData.data());
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexturedPoint) * (sides + 2), vertexData);
 
-            glBindVertexArray(m_vaoIdTextured);
+            stateCache.BindVertexArray(m_vaoIdTextured);
             glDrawArrays(GL_TRIANGLE_FAN, 0, sides + 2);
-            glBindVertexArray(0);
 
-            glBindTexture(GL_TEXTURE_2D, 0);
+            stateCache.BindTexture(0, GL_TEXTURE_2D, 0);
             Renderer::Sampler::Unbind(0);
         }
         else
@@ -249,94 +348,45 @@ void CustomShape::Draw()
             // Untextured (creates a color gradient: center=r/g/b/a to border=r2/b2/g2/a2)
             glBindBuffer(GL_ARRAY_BUFFER, m_vboIdUntextured);
 
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexturedPoint) * (sides + 2), vertexData.data());
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexturedPoint) * (sides + 2), vertexData);
 
             m_presetState.untexturedShader.Bind();
-            m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+            m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
 
-            glBindVertexArray(m_vaoIdUntextured);
+            stateCache.BindVertexArray(m_vaoIdUntextured);
             glDrawArrays(GL_TRIANGLE_FAN, 0, sides + 2);
-            glBindVertexArray(0);
         }
 
-        if (*m_perFrameContext.border_a > 0.0001f)
+        if (instanceData.outlinePasses > 0)
         {
-            std::vector<ShapeVertex> points(sides);
-
-            for (int i = 0; i < sides; i++)
-            {
-                points[i].x = vertexData[i + 1].x;
-                points[i].y = vertexData[i + 1].y;
-            }
-
             m_presetState.untexturedShader.Bind();
-            m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+            m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
 
-            glVertexAttrib4f(1,
-                             static_cast<float>(*m_perFrameContext.border_r),
-                             static_cast<float>(*m_perFrameContext.border_g),
-                             static_cast<float>(*m_perFrameContext.border_b),
-                             static_cast<float>(*m_perFrameContext.border_a));
+            glVertexAttrib4f(1, instanceData.borderR, instanceData.borderG, instanceData.borderB, instanceData.borderA);
             glLineWidth(1);
 #ifndef USE_GLES
             glEnable(GL_LINE_SMOOTH);
 #endif
 
-            glBindVertexArray(m_vaoID);
+            stateCache.BindVertexArray(m_vaoID);
             glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
-            const auto iterations = m_thickOutline ? 4 : 1;
+            // Orphans the buffer of the previous outline, so the driver doesn't need to wait until it was drawn.
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(ShapeVertex) * sides * instanceData.outlinePasses),
+                         &m_drawnFrame.outlineVertices[instanceData.firstOutlineVertex], GL_STREAM_DRAW);
 
-            // Need to use +/- 1.0 here instead of 2.0 used in Milkdrop to achieve the same rendering result.
-            const auto incrementX = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
-            const auto incrementY = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
-
-            // If thick outline is used, draw the shape four times with slight offsets
-            // (top left, top right, bottom right, bottom left).
-            for (auto iteration = 0; iteration < iterations; iteration++)
+            for (int pass = 0; pass < instanceData.outlinePasses; pass++)
             {
-                switch (iteration)
-                {
-                    case 0:
-                        break;
-
-                    case 1:
-                        for (auto j = 0; j < sides; j++)
-                        {
-                            points[j].x += incrementX;
-                        }
-                        break;
-
-                    case 2:
-                        for (auto j = 0; j < sides; j++)
-                        {
-                            points[j].y += incrementY;
-                        }
-                        break;
-
-                    case 3:
-                        for (auto j = 0; j < sides; j++)
-                        {
-                            points[j].x -= incrementX;
-                        }
-                        break;
-                }
-
-                glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizei>(sizeof(Point) * sides), points.data());
-                glDrawArrays(GL_LINE_LOOP, 0, sides);
+                glDrawArrays(GL_LINE_LOOP, pass * sides, sides);
             }
         }
     }
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
 
 #ifndef USE_GLES
     glDisable(GL_LINE_SMOOTH);
 #endif
-    glDisable(GL_BLEND);
-
-    Renderer::Shader::Unbind();
 }
 
 } // namespace MilkdropPreset
@@ -8,6 +8,8 @@
 
 #include <projectm-eval.h>
 
+#include <vector>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -36,13 +38,41 @@ public:
     void Initialize(PresetFileParser& parsedFile, int index);
 
     /**
-     * @brief Compiles all code blocks and runs the init expression.
+     * @brief Compiles all code blocks, runs the init expression and looks up the shape texture.
      * @throws MilkdropCompileException Thrown if one of the code blocks couldn't be compiled.
      */
     void CompileCodeAndRunInitExpressions();
 
     /**
-     * @brief Renders the shape.
+     * @brief Returns whether the shape is enabled in the preset.
+     * @return true if the shape is drawn.
+     */
+    auto Enabled() const -> bool;
+
+    /**
+     * @brief Returns whether the shape code accesses state shared with other code contexts.
+     *
+     * If false, Evaluate() can run concurrently with the evaluation of other shapes and waves.
+     *
+     * @return true if the per-frame code uses global registers, gmegabuf or rand().
+     */
+    auto UsesSharedState() const -> bool;
+
+    /**
+     * @brief Runs the per-frame code for all instances and calculates the vertices.
+     *
+     * Doesn't make any OpenGL calls, so it can run on a worker thread.
+     */
+    void Evaluate();
+
+    /**
+     * @brief Hands the instances calculated in the last Evaluate() call over to Draw().
+     * Evaluate() can then calculate the next frame while the current one is drawn.
+     */
+    void SwapPreparedFrame();
+
+    /**
+     * @brief Renders the shape instances handed over in the last SwapPreparedFrame() call.
      */
     void Draw();
 
@@ -52,7 +82,34 @@ private:
         float y{.0f}; //!< The vertex Y coordinate.
     };
 
-    std::string m_image; //!< Texture filename to be rendered on this shape
+    /**
+     * @brief Draw parameters of a single shape instance, calculated by Evaluate().
+     */
+    struct ShapeInstance {
+        size_t firstVertex{};        //!< Index of the instance's first vertex in FrameData::vertices.
+        size_t firstOutlineVertex{}; //!< Index of the instance's first outline vertex in FrameData::outlineVertices.
+        int sides{3};                //!< Number of sides.
+        int outlinePasses{};         //!< Number of outline passes, 0 if the instance has no border.
+        bool additive{};             //!< If true, the instance is drawn with additive blending.
+        bool textured{};             //!< If true, the instance is drawn with a texture.
+        float borderR{};             //!< Border red color value.
+        float borderG{};             //!< Border green color value.
+        float borderB{};             //!< Border blue color value.
+        float borderA{};             //!< Border alpha value.
+    };
+
+    /**
+     * @brief All instances of a frame, calculated by Evaluate() and drawn by Draw().
+     */
+    struct FrameData {
+        std::vector<ShapeInstance> instances;     //!< The instances to draw.
+        std::vector<TexturedPoint> vertices;      //!< Vertices of all instances, sides + 2 per instance.
+        std::vector<ShapeVertex> outlineVertices; //!< Border vertices of all instances, sides per outline pass.
+    };
+
+    std::string m_image;                               //!< Texture filename to be rendered on this shape
+    Renderer::TextureSamplerDescriptor m_imageTexture; //!< The texture loaded from m_image.
+    bool m_imageTextureFound{false};                   //!< True if m_image was found, which changes the texture aspect ratio.
 
     int m_index{0};        //!< The custom shape index in the preset.
     bool m_enabled{false};      //!< If false, the shape isn't drawn.
@@ -93,6 +150,10 @@ private:
     PresetState& m_presetState; //!< The global preset state.
     ShapePerFrameContext m_perFrameContext;
 
+    bool m_usesSharedState{true}; //!< True if the code accesses global registers, gmegabuf or rand().
+    FrameData m_preparedFrame;    //!< Instances calculated by the last Evaluate() call.
+    FrameData m_drawnFrame;       //!< Instances drawn by Draw().
+
     GLuint m_vboIdTextured{0}; //!< Vertex buffer object ID for a textured shape.
     GLuint m_vaoIdTextured{0}; //!< Vertex array object ID for a textured shape.
 
@@ -1,7 +1,9 @@
 #include "CustomWaveform.hpp"
 
 #include "PerFrameContext.hpp"
+#include "PerPixelCodeAnalysis.hpp"
 #include "PresetFileParser.hpp"
+#include "WaveformBatch.hpp"
 
 #include <algorithm>
 #include <cmath>
@@ -12,30 +14,14 @@ namespace MilkdropPreset {
 static constexpr int CustomWaveformMaxSamples = std::max(libprojectM::Audio::WaveformSamples, libprojectM::Audio::SpectrumSamples);
 
 CustomWaveform::CustomWaveform(PresetState& presetState)
-    : RenderItem()
-    , m_presetState(presetState)
-    , m_perFrameContext(presetState.globalMemory, &presetState.globalRegisters)
-    , m_perPointContext(presetState.globalMemory, &presetState.globalRegisters)
+    : m_presetState(presetState)
+    , m_perFrameContext(presetState.expressionEngine, *presetState.globalMemory, &presetState.globalRegisters)
+    , m_perPointContext(presetState.expressionEngine, *presetState.globalMemory, &presetState.globalRegisters)
 {
-    RenderItem::Init();
-
-    m_perFrameContext.RegisterBuiltinVariables();
+    m_perFrameContext.RegisterBuiltinVariables(presetState.frameVariables);
     m_perPointContext.RegisterBuiltinVariables();
 }
 
-void CustomWaveform::InitVertexAttrib()
-{
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ColoredPoint), nullptr);                                    // points
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ColoredPoint), reinterpret_cast<void*>(sizeof(float) * 2)); // colors
-
-    std::vector<ColoredPoint> vertexData;
-    vertexData.resize(std::max(libprojectM::Audio::SpectrumSamples, libprojectM::Audio::WaveformSamples) * 2 + 2);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ColoredPoint) * vertexData.size(), vertexData.data(), GL_STREAM_DRAW);
-}
-
 void CustomWaveform::Initialize(PresetFileParser& parsedFile, int index)
 {
     std::string const wavecodePrefix = "wavecode_" + std::to_string(index) + "_";
@@ -58,9 +44,9 @@ void CustomWaveform::Initialize(PresetFileParser& parsedFile, int index)
 
 }
 
-void CustomWaveform::CompileCodeAndRunInitExpressions(const PerFrameContext& presetPerFrameContext)
+void CustomWaveform::CompileCodeAndRunInitExpressions()
 {
-    m_perFrameContext.LoadStateVariables(m_presetState, presetPerFrameContext, *this);
+    m_perFrameContext.LoadStateVariables(*this);
     m_perFrameContext.EvaluateInitCode(m_presetState.customWaveInitCode[m_index], *this);
 
     for (int t = 0; t < TVarCount; t++)
@@ -70,13 +56,28 @@ void CustomWaveform::CompileCodeAndRunInitExpressions(const PerFrameContext& pre
 
     m_perFrameContext.CompilePerFrameCode(m_presetState.customWavePerFrameCode[m_index], *this);
     m_perPointContext.CompilePerPointCode(m_presetState.customWavePerPointCode[m_index], *this);
+
+    m_usesSharedState = PerPixelCodeAnalysis::UsesSharedState(m_presetState.customWavePerFrameCode[m_index]) ||
+                        PerPixelCodeAnalysis::UsesSharedState(m_presetState.customWavePerPointCode[m_index]);
 }
 
-void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
+auto CustomWaveform::Enabled() const -> bool
+{
+    return m_enabled != 0;
+}
+
+auto CustomWaveform::UsesSharedState() const -> bool
+{
+    return m_usesSharedState;
+}
+
+void CustomWaveform::Evaluate(const PerFrameContext& presetPerFrameContext)
 {
     static_assert(libprojectM::Audio::WaveformSamples <= WaveformMaxPoints, "WaveformMaxPoints is larger than WaveformSamples");
     static_assert(libprojectM::Audio::SpectrumSamples <= WaveformMaxPoints, "WaveformMaxPoints is larger than SpectrumSamples");
 
+    m_vertexCount = 0;
+
     if (!m_enabled)
     {
         return;
@@ -163,86 +164,28 @@ void CustomWaveform::Draw(const PerFrameContext& presetPerFrameContext)
         pointsTransformed[sample].a = Renderer::color_modulo(*m_perPointContext.a);
     }
 
-    std::vector<ColoredPoint> pointsSmoothed(sampleCount * 2);
-    auto smoothedVertexCount = SmoothWave(pointsTransformed.data(), sampleCount, pointsSmoothed.data());
-
-#ifndef USE_GLES
-    glDisable(GL_LINE_SMOOTH);
-#endif
-    glLineWidth(1);
+    m_points.resize(sampleCount * 2);
+    m_vertexCount = SmoothWave(pointsTransformed.data(), sampleCount, m_points.data());
+}
 
-    // Additive wave drawing (vice overwrite)
-    glEnable(GL_BLEND);
-    if (m_additive)
-    {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    }
-    else
+void CustomWaveform::AddToBatch(WaveformBatch& batch)
+{
+    if (m_vertexCount == 0)
     {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        return;
     }
 
-    m_presetState.untexturedShader.Bind();
-    m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-
-    auto iterations = (m_drawThick && !m_useDots) ? 4 : 1;
-
     // Need to use +/- 1.0 here instead of 2.0 used in Milkdrop to achieve the same rendering result.
     auto incrementX = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
     auto incrementY = 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
 
-    GLuint drawType = m_useDots ? GL_POINTS : GL_LINE_STRIP;
-
-    glBindVertexArray(m_vaoID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-    // If thick outline is used, draw the shape four times with slight offsets
-    // (top left, top right, bottom right, bottom left).
-    for (auto iteration = 0; iteration < iterations; iteration++)
-    {
-        switch (iteration)
-        {
-            case 0:
-            default:
-                break;
-
-            case 1:
-                for (auto j = 0; j < smoothedVertexCount; j++)
-                {
-                    pointsSmoothed[j].x += incrementX;
-                }
-                break;
-
-            case 2:
-                for (auto j = 0; j < smoothedVertexCount; j++)
-                {
-                    pointsSmoothed[j].y += incrementY;
-                }
-                break;
-
-            case 3:
-                for (auto j = 0; j < smoothedVertexCount; j++)
-                {
-                    pointsSmoothed[j].x -= incrementX;
-                }
-                break;
-        }
-
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(ColoredPoint) * smoothedVertexCount, pointsSmoothed.data());
-        glDrawArrays(drawType, 0, smoothedVertexCount);
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    Renderer::Shader::Unbind();
-
-    glDisable(GL_BLEND);
+    batch.Add(m_points.data(), m_vertexCount, m_useDots ? GL_POINTS : GL_LINE_STRIP, m_additive,
+              m_drawThick && !m_useDots, incrementX, incrementY);
 }
 
 void CustomWaveform::LoadPerFrameEvaluationVariables(const PerFrameContext& presetPerFrameContext)
 {
-    m_perFrameContext.LoadStateVariables(m_presetState, presetPerFrameContext, *this);
+    m_perFrameContext.LoadStateVariables(*this);
     m_perPointContext.LoadReadOnlyStateVariables(presetPerFrameContext);
 }
 
@@ -11,10 +11,12 @@ namespace libprojectM {
 namespace MilkdropPreset {
 
 class PresetFileParser;
+class WaveformBatch;
 
-class CustomWaveform : public Renderer::RenderItem
+class CustomWaveform
 {
 public:
+    using ColoredPoint = Renderer::RenderItem::ColoredPoint;
 
     /**
      * @brief Creates a new waveform with the given number of samples.
@@ -22,11 +24,6 @@ public:
      */
     explicit CustomWaveform(PresetState& presetState);
 
-    /**
-     * @brief Initializes the waveform's vertex buffer and attribute data.
-     */
-    void InitVertexAttrib() override;
-
     /**
      * @brief Loads the initial values and code from the preset file.
      * @param parsedFile The file parser with the preset data.
@@ -37,15 +34,38 @@ public:
     /**
      * @brief Compiles all code blocks and runs the init expression.
      * @throws MilkdropCompileException Thrown if one of the code blocks couldn't be compiled.
-     * @param presetPerFrameContext The per-frame context to retrieve the init Q vars from.
      */
-    void CompileCodeAndRunInitExpressions(const PerFrameContext& presetPerFrameContext);
+    void CompileCodeAndRunInitExpressions();
 
     /**
-     * @brief Renders the waveform.
+     * @brief Returns whether the waveform is enabled in the preset.
+     * @return true if the waveform is drawn.
+     */
+    auto Enabled() const -> bool;
+
+    /**
+     * @brief Returns whether the waveform code accesses state shared with other code contexts.
+     *
+     * If false, Evaluate() can run concurrently with the evaluation of other shapes and waves.
+     *
+     * @return true if the per-frame or per-point code uses global registers, gmegabuf or rand().
+     */
+    auto UsesSharedState() const -> bool;
+
+    /**
+     * @brief Runs the per-frame and per-point code and calculates the waveform vertices.
+     *
+     * Doesn't make any OpenGL calls, so it can run on a worker thread.
+     *
      * @param presetPerFrameContext The per-frame context to retrieve the init Q vars from.
      */
-    void Draw(const PerFrameContext& presetPerFrameContext);
+    void Evaluate(const PerFrameContext& presetPerFrameContext);
+
+    /**
+     * @brief Adds the waveform calculated in the last Evaluate() call to the batch.
+     * @param batch The batch which draws all waveforms of the frame.
+     */
+    void AddToBatch(WaveformBatch& batch);
 
 private:
     /**
@@ -102,7 +122,9 @@ private:
     WaveformPerFrameContext m_perFrameContext; //!< Holds the code execution context for per-frame expressions
     WaveformPerPointContext m_perPointContext; //!< Holds the code execution context for per-point expressions
 
+    bool m_usesSharedState{true};       //!< True if the code accesses global registers, gmegabuf or rand().
     std::vector<ColoredPoint> m_points; //!< Points in this waveform.
+    int m_vertexCount{};                //!< Number of points to draw, calculated by the last Evaluate() call.
 
     friend class WaveformPerFrameContext;
     friend class WaveformPerPointContext;
@@ -1,5 +1,7 @@
 #include "DarkenCenter.hpp"
 
+#include <Renderer/StateCache.hpp>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -21,11 +23,12 @@ void DarkenCenter::InitVertexAttrib()
 
 void DarkenCenter::Draw()
 {
-    glBindVertexArray(m_vaoID);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.BindVertexArray(m_vaoID);
 
-    if (m_presetState.renderContext.aspectY != m_aspectY)
+    if (m_presetState.drawnFrame.renderContext.aspectY != m_aspectY)
     {
-        m_aspectY = m_presetState.renderContext.aspectY;
+        m_aspectY = m_presetState.drawnFrame.renderContext.aspectY;
 
         // Update mesh with new aspect ratio if needed
         float const halfSize = 0.05f;
@@ -41,17 +44,13 @@ void DarkenCenter::Draw()
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    stateCache.SetBlend(true);
+    stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     m_presetState.untexturedShader.Bind();
-    m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+    m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
 
     glDrawArrays(GL_TRIANGLE_FAN, 0, 6);
-
-    glDisable(GL_BLEND);
-    glBindVertexArray(0);
-    Renderer::Shader::Unbind();
 }
 
 } // namespace MilkdropPreset
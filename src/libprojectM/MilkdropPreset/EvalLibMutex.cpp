@@ -1,4 +1,34 @@
 #include <projectm-eval.h>
 
-void projectm_eval_memory_host_lock_mutex() {}
-void projectm_eval_memory_host_unlock_mutex() {}
+#include <mutex>
+
+/*
+ * projectm-eval calls these functions around each megabuf and gmegabuf block lookup, which also
+ * allocates missing blocks. The callbacks don't get the buffer being accessed, so a lock per
+ * buffer or instance isn't possible and one process-wide mutex guards all of them.
+ *
+ * The lock is only held for the block lookup, never while other expression code runs. Each
+ * preset owns its own gmegabuf and evaluation contexts, so instances rendering on separate
+ * threads only contend if they access memory buffers at the same moment, and then only for the
+ * duration of one lookup. The EvalThreading.DISABLED_ThroughputScaling test measures the cost.
+ */
+
+namespace {
+
+std::mutex& EvalMemoryMutex()
+{
+    static std::mutex evalMemoryMutex;
+    return evalMemoryMutex;
+}
+
+} // namespace
+
+void projectm_eval_memory_host_lock_mutex()
+{
+    EvalMemoryMutex().lock();
+}
+
+void projectm_eval_memory_host_unlock_mutex()
+{
+    EvalMemoryMutex().unlock();
+}
@@ -0,0 +1,140 @@
+#include "ExpressionCache.hpp"
+
+#include <cctype>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+constexpr size_t ExpressionCache::DefaultCapacity;
+
+auto ExpressionCache::Instance() -> ExpressionCache&
+{
+    static ExpressionCache cache;
+    return cache;
+}
+
+auto ExpressionCache::NormalizeCode(const std::string& code) -> std::string
+{
+    std::string normalized;
+    normalized.reserve(code.size());
+
+    bool pendingSpace{false};
+    size_t position{};
+    while (position < code.size())
+    {
+        if (code.compare(position, 2, "//") == 0)
+        {
+            auto const lineEnd = code.find('\n', position);
+            position = lineEnd == std::string::npos ? code.size() : lineEnd;
+            pendingSpace = true;
+            continue;
+        }
+
+        if (code.compare(position, 2, "/*") == 0)
+        {
+            auto const commentEnd = code.find("*/", position + 2);
+            position = commentEnd == std::string::npos ? code.size() : commentEnd + 2;
+            pendingSpace = true;
+            continue;
+        }
+
+        auto const character = static_cast<unsigned char>(code[position++]);
+        if (std::isspace(character))
+        {
+            pendingSpace = true;
+            continue;
+        }
+
+        if (pendingSpace && !normalized.empty())
+        {
+            normalized.push_back(' ');
+        }
+        pendingSpace = false;
+
+        normalized.push_back(static_cast<char>(std::tolower(character)));
+    }
+
+    return normalized;
+}
+
+auto ExpressionCache::Find(const std::string& key, Entry& entry) -> bool
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto const indexEntry = m_entryIndex.find(key);
+    if (indexEntry == m_entryIndex.end())
+    {
+        m_misses++;
+        return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, indexEntry->second);
+    entry = indexEntry->second->second;
+    m_hits++;
+    return true;
+}
+
+void ExpressionCache::Insert(const std::string& key, Entry entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_capacity == 0)
+    {
+        return;
+    }
+
+    auto const indexEntry = m_entryIndex.find(key);
+    if (indexEntry != m_entryIndex.end())
+    {
+        indexEntry->second->second = std::move(entry);
+        m_entries.splice(m_entries.begin(), m_entries, indexEntry->second);
+        return;
+    }
+
+    m_entries.emplace_front(key, std::move(entry));
+    m_entryIndex.emplace(key, m_entries.begin());
+
+    EvictToCapacity();
+}
+
+void ExpressionCache::SetCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_capacity = capacity;
+    EvictToCapacity();
+}
+
+void ExpressionCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_entries.clear();
+    m_entryIndex.clear();
+}
+
+auto ExpressionCache::GetStatistics() const -> Statistics
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Statistics statistics;
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+    statistics.evictions = m_evictions;
+    statistics.entries = m_entries.size();
+    statistics.capacity = m_capacity;
+    return statistics;
+}
+
+void ExpressionCache::EvictToCapacity()
+{
+    while (m_entries.size() > m_capacity)
+    {
+        m_entryIndex.erase(m_entries.back().first);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Process-wide cache of compile results of expression code.
+ *
+ * Loading a preset compiles the same init, per-frame, per-pixel, shape and waveform code each
+ * time, e.g. when a playlist cycles through the same presets or a preset is reloaded for a
+ * transition. The cache maps normalized code text to the result of compiling it:
+ *
+ * - Code with syntax errors is stored with its error message, so it fails without being
+ *   parsed again. Broken code in preset collections is otherwise recompiled on every load.
+ * - Code compiled independently of a context is stored as SharedCode, which is bound to the
+ *   variables of a new context by name. The native-jit engine stores its templates this way.
+ *   projectm-eval code is bound to the context it was compiled for and isn't cached.
+ *
+ * The number of entries is bounded, and the least recently used entry is removed first.
+ * All functions are thread-safe.
+ */
+class ExpressionCache
+{
+public:
+    /**
+     * @brief Compiled code which isn't bound to any context, like a JIT template.
+     */
+    class SharedCode
+    {
+    public:
+        virtual ~SharedCode() = default;
+    };
+
+    using SharedCodePtr = std::shared_ptr<const SharedCode>;
+
+    /**
+     * @brief The cached result of compiling one piece of code.
+     *
+     * Only the engine creating the shared code inserts entries for valid code, so an entry
+     * without an error and without shared code means that engine doesn't support the code.
+     */
+    struct Entry
+    {
+        std::string error;        //!< The compile error message. Empty if the code is valid.
+        int errorLine{};          //!< Line of the compile error.
+        int errorColumn{};        //!< Column of the compile error.
+        uint64_t codeHash{};      //!< FNV-1a hash of the exact code the error location refers to.
+        SharedCodePtr sharedCode; //!< Code usable by any context. Empty if the code has errors or isn't supported.
+    };
+
+    /**
+     * @brief Cache usage counters.
+     */
+    struct Statistics
+    {
+        uint64_t hits{};      //!< Number of lookups which found an entry.
+        uint64_t misses{};    //!< Number of lookups which didn't find an entry.
+        uint64_t evictions{}; //!< Number of entries removed to stay within the capacity.
+        size_t entries{};     //!< Current number of entries.
+        size_t capacity{};    //!< Maximum number of entries.
+    };
+
+    static constexpr size_t DefaultCapacity{1024}; //!< Default maximum number of entries.
+
+    /**
+     * @brief Returns the process-wide cache instance.
+     * @return The cache.
+     */
+    static auto Instance() -> ExpressionCache&;
+
+    /**
+     * @brief Returns the cache key for the given code.
+     *
+     * Comments are removed, whitespace runs are replaced by a single space and everything is
+     * converted to lower case, as expression code is case-insensitive.
+     *
+     * @param code The expression code.
+     * @return The normalized code.
+     */
+    static auto NormalizeCode(const std::string& code) -> std::string;
+
+    /**
+     * @brief Looks up the compile result for the given key.
+     * @param key The normalized code.
+     * @param[out] entry The cached compile result.
+     * @return True if the key was found, false if the code has to be compiled.
+     */
+    auto Find(const std::string& key, Entry& entry) -> bool;
+
+    /**
+     * @brief Adds a compile result to the cache, replacing any existing entry.
+     * @param key The normalized code.
+     * @param entry The compile result.
+     */
+    void Insert(const std::string& key, Entry entry);
+
+    /**
+     * @brief Sets the maximum number of entries, evicting entries if needed.
+     * @param capacity The new capacity. 0 disables the cache.
+     */
+    void SetCapacity(size_t capacity);
+
+    /**
+     * @brief Removes all entries. The counters are kept.
+     */
+    void Clear();
+
+    /**
+     * @brief Returns the current cache counters.
+     * @return A snapshot of the counters.
+     */
+    auto GetStatistics() const -> Statistics;
+
+private:
+    using EntryList = std::list<std::pair<std::string, Entry>>;
+
+    void EvictToCapacity();
+
+    mutable std::mutex m_mutex;                                        //!< Guards all members.
+    EntryList m_entries;                                               //!< Entries, most recently used first.
+    std::unordered_map<std::string, EntryList::iterator> m_entryIndex; //!< Entry lookup by key.
+    size_t m_capacity{DefaultCapacity};                                //!< Maximum number of entries.
+    uint64_t m_hits{};                                                 //!< Number of cache hits.
+    uint64_t m_misses{};                                               //!< Number of cache misses.
+    uint64_t m_evictions{};                                            //!< Number of evicted entries.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
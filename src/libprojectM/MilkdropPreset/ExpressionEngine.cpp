@@ -0,0 +1,63 @@
+#include "ExpressionEngine.hpp"
+
+#include "ProjectMEvalEngine.hpp"
+
+#ifdef PROJECTM_EXPRESSION_JIT
+#include "JitExpressionEngine.hpp"
+#endif
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+void ExpressionEngine::Program::ExecuteBatch(size_t count, const std::vector<BatchInput>& inputs, const std::vector<BatchOutput>& outputs)
+{
+    for (size_t index = 0; index < count; index++)
+    {
+        for (const auto& input : inputs)
+        {
+            *input.variable = *reinterpret_cast<const PRJM_EVAL_F*>(reinterpret_cast<const char*>(input.values) + index * input.stride);
+        }
+
+        Execute();
+
+        for (const auto& output : outputs)
+        {
+            *reinterpret_cast<float*>(reinterpret_cast<char*>(output.values) + index * output.stride) = static_cast<float>(*output.variable);
+        }
+    }
+}
+
+auto ExpressionEngine::Default() -> ExpressionEngine&
+{
+    return *Available().front();
+}
+
+auto ExpressionEngine::Available() -> const std::vector<ExpressionEngine*>&
+{
+    // Additional engines are added here, the first entry is used as the default.
+    static ProjectMEvalEngine projectMEvalEngine;
+#ifdef PROJECTM_EXPRESSION_JIT
+    static JitExpressionEngine jitExpressionEngine;
+    static const std::vector<ExpressionEngine*> engines{&projectMEvalEngine, &jitExpressionEngine};
+#else
+    static const std::vector<ExpressionEngine*> engines{&projectMEvalEngine};
+#endif
+
+    return engines;
+}
+
+auto ExpressionEngine::Find(const std::string& name) -> ExpressionEngine*
+{
+    for (auto* engine : Available())
+    {
+        if (engine->Name() == name)
+        {
+            return engine;
+        }
+    }
+
+    return nullptr;
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <projectm-eval.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Interface for the expression evaluator running Milkdrop preset code.
+ *
+ * All Milkdrop code contexts only use this interface to compile and run preset code, so
+ * different evaluator implementations can be used without changing the context classes.
+ * The default implementation uses the projectm-eval library.
+ *
+ * Variable values are always stored as PRJM_EVAL_F. Pointers returned by RegisterVariable()
+ * stay valid until the variables of the context are reset or the context is destroyed, so
+ * callers can read and write variables directly without going through the interface.
+ */
+class ExpressionEngine
+{
+public:
+    using GlobalRegisters = PRJM_EVAL_F[100]; //!< The reg00-reg99 variables shared by all contexts of a preset.
+
+    /**
+     * @brief Loads a variable from a strided array before each iteration of a batch execution.
+     */
+    struct BatchInput
+    {
+        PRJM_EVAL_F* variable{};     //!< The context variable to set.
+        const PRJM_EVAL_F* values{}; //!< The value of the first iteration.
+        size_t stride{};             //!< Distance between the values of two iterations in bytes. 0 uses the same value for all iterations.
+    };
+
+    /**
+     * @brief Stores a variable into a strided array after each iteration of a batch execution.
+     */
+    struct BatchOutput
+    {
+        const PRJM_EVAL_F* variable{}; //!< The context variable to read.
+        float* values{};               //!< The value of the first iteration.
+        size_t stride{};               //!< Distance between the values of two iterations in bytes.
+    };
+
+    /**
+     * @brief A memory buffer shared between contexts, used for gmegabuf.
+     */
+    class MemoryBuffer
+    {
+    public:
+        virtual ~MemoryBuffer() = default;
+    };
+
+    /**
+     * @brief A compiled program.
+     */
+    class Program
+    {
+    public:
+        virtual ~Program() = default;
+
+        /**
+         * @brief Executes the program once.
+         */
+        virtual void Execute() = 0;
+
+        /**
+         * @brief Executes the program several times in a row.
+         *
+         * Used for code running once per vertex or point. The inputs are loaded before each
+         * iteration, the outputs are stored after it. Implementations may use this to avoid
+         * per-call overhead, but must run the iterations in order.
+         *
+         * @param count The number of iterations.
+         * @param inputs The variables to load before each iteration.
+         * @param outputs The variables to store after each iteration.
+         */
+        virtual void ExecuteBatch(size_t count, const std::vector<BatchInput>& inputs, const std::vector<BatchOutput>& outputs);
+    };
+
+    /**
+     * @brief A code context, holding the variables and local memory used by the compiled programs.
+     */
+    class Context
+    {
+    public:
+        virtual ~Context() = default;
+
+        /**
+         * @brief Registers a variable or returns the existing one.
+         * @param name The variable name.
+         * @return A pointer to the variable value.
+         */
+        virtual auto RegisterVariable(const std::string& name) -> PRJM_EVAL_F* = 0;
+
+        /**
+         * @brief Resets all variables to zero and removes them from the context.
+         * Invalidates all pointers returned by RegisterVariable().
+         */
+        virtual void ResetVariables() = 0;
+
+        /**
+         * @brief Compiles the given code.
+         * @param code The code to compile.
+         * @return The compiled program, or nullptr if the code couldn't be compiled.
+         */
+        virtual auto Compile(const std::string& code) -> std::unique_ptr<Program> = 0;
+
+        /**
+         * @brief Returns the error message of the last failed compilation.
+         * @param[out] line The line of the error location.
+         * @param[out] column The column of the error location.
+         * @return The error message, or an empty string if no error occurred.
+         */
+        virtual auto LastError(int& line, int& column) const -> std::string = 0;
+    };
+
+    virtual ~ExpressionEngine() = default;
+
+    /**
+     * @brief Returns the name of the engine implementation.
+     * @return A short, human-readable name.
+     */
+    virtual auto Name() const -> std::string = 0;
+
+    /**
+     * @brief Creates a new memory buffer.
+     * @return The new memory buffer.
+     */
+    virtual auto CreateMemoryBuffer() -> std::unique_ptr<MemoryBuffer> = 0;
+
+    /**
+     * @brief Creates a new code context.
+     * @param globalMemory The global memory buffer used for gmegabuf. Must be created by this engine.
+     * @param globalRegisters The global reg00-reg99 variables.
+     * @return The new context.
+     */
+    virtual auto CreateContext(MemoryBuffer& globalMemory, GlobalRegisters* globalRegisters) -> std::unique_ptr<Context> = 0;
+
+    /**
+     * @brief Returns the engine used for new presets.
+     * @return The default engine.
+     */
+    static auto Default() -> ExpressionEngine&;
+
+    /**
+     * @brief Returns all engines compiled into the library, the default engine first.
+     * @return A list of all available engines.
+     */
+    static auto Available() -> const std::vector<ExpressionEngine*>&;
+
+    /**
+     * @brief Returns the available engine with the given name.
+     * @param name The engine name, as returned by Name().
+     * @return The engine, or nullptr if no engine with this name was compiled into the library.
+     */
+    static auto Find(const std::string& name) -> ExpressionEngine*;
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,900 @@
+#include "ExpressionJit.hpp"
+
+#include "ExpressionParser.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define PROJECTM_EXPRESSION_JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+constexpr PRJM_EVAL_F closeFactor{0.00001}; //!< Tolerance used for equality and boolean tests.
+
+/*
+ * Runtime helpers called from the generated code. They follow the projectm-eval semantics.
+ */
+
+auto Truth(double value) -> double
+{
+    return std::fabs(value) > closeFactor ? 1.0 : 0.0;
+}
+
+auto Not(double value) -> double
+{
+    return std::fabs(value) > closeFactor ? 0.0 : 1.0;
+}
+
+auto Divide(double dividend, double divisor) -> double
+{
+    if (divisor == 0.0)
+    {
+        return 0.0;
+    }
+    return dividend / divisor;
+}
+
+auto Equal(double first, double second) -> double
+{
+    return std::fabs(first - second) < closeFactor ? 1.0 : 0.0;
+}
+
+auto NotEqual(double first, double second) -> double
+{
+    return std::fabs(first - second) < closeFactor ? 0.0 : 1.0;
+}
+
+auto Below(double first, double second) -> double
+{
+    return first < second ? 1.0 : 0.0;
+}
+
+auto Above(double first, double second) -> double
+{
+    return first > second ? 1.0 : 0.0;
+}
+
+auto BelowEqual(double first, double second) -> double
+{
+    return first <= second ? 1.0 : 0.0;
+}
+
+auto AboveEqual(double first, double second) -> double
+{
+    return first >= second ? 1.0 : 0.0;
+}
+
+auto Min(double first, double second) -> double
+{
+    return first < second ? first : second;
+}
+
+auto Max(double first, double second) -> double
+{
+    return first > second ? first : second;
+}
+
+auto Sqr(double value) -> double
+{
+    return value * value;
+}
+
+auto Sqrt(double value) -> double
+{
+    return std::sqrt(std::fabs(value));
+}
+
+auto Sign(double value) -> double
+{
+    if (value > 0.0)
+    {
+        return 1.0;
+    }
+    if (value < 0.0)
+    {
+        return -1.0;
+    }
+    return 0.0;
+}
+
+auto Sin(double value) -> double
+{
+    return std::sin(value);
+}
+
+auto Cos(double value) -> double
+{
+    return std::cos(value);
+}
+
+auto Tan(double value) -> double
+{
+    return std::tan(value);
+}
+
+auto Atan(double value) -> double
+{
+    return std::atan(value);
+}
+
+auto Atan2(double first, double second) -> double
+{
+    return std::atan2(first, second);
+}
+
+auto Exp(double value) -> double
+{
+    return std::exp(value);
+}
+
+auto Floor(double value) -> double
+{
+    return std::floor(value);
+}
+
+auto Ceil(double value) -> double
+{
+    return std::ceil(value);
+}
+
+auto Abs(double value) -> double
+{
+    return std::fabs(value);
+}
+
+auto Pow(double base, double exponent) -> double
+{
+    return std::pow(base, exponent);
+}
+
+using UnaryHelper = double (*)(double);
+using BinaryHelper = double (*)(double, double);
+
+/**
+ * @brief Expression tree node built from the ExpressionParser syntax tree.
+ */
+struct Node
+{
+    enum class Type
+    {
+        Constant,
+        Variable,
+        Assign,
+        Add,
+        Subtract,
+        Multiply,
+        Negate,
+        CallUnary,
+        CallBinary,
+        LogicalAnd,
+        LogicalOr,
+        Condition,
+        Sequence
+    };
+
+    explicit Node(Type nodeType)
+        : type(nodeType)
+    {
+    }
+
+    Type type;
+    PRJM_EVAL_F value{};                           //!< Constant value.
+    size_t variable{};                             //!< Variable index for Variable and Assign nodes.
+    char assignOperator{'='};                      //!< One of =, +, -, * and / for Assign nodes.
+    UnaryHelper unaryHelper{nullptr};              //!< Function for CallUnary nodes.
+    BinaryHelper binaryHelper{nullptr};            //!< Function for CallBinary nodes.
+    std::vector<std::unique_ptr<Node>> arguments; //!< Operands, in evaluation order.
+};
+
+using NodePtr = std::unique_ptr<Node>;
+
+auto MakeNode(Node::Type type) -> NodePtr
+{
+    return std::make_unique<Node>(type);
+}
+
+auto MakeNode(Node::Type type, NodePtr first, NodePtr second = {}, NodePtr third = {}) -> NodePtr
+{
+    auto node = std::make_unique<Node>(type);
+    for (auto* argument : {&first, &second, &third})
+    {
+        if (*argument)
+        {
+            node->arguments.push_back(std::move(*argument));
+        }
+    }
+    return node;
+}
+
+/**
+ * @brief Converts the syntax tree into the JIT's expression tree.
+ *
+ * Resolves functions and operators to the runtime helpers and assigns an index to each variable.
+ * Any construct outside of the supported subset makes the conversion fail, which is signalled
+ * by returning nullptr from Convert().
+ */
+class TreeBuilder
+{
+public:
+    using SyntaxNode = ExpressionParser::Node;
+
+    auto Convert(const SyntaxNode& node) -> NodePtr
+    {
+        switch (node.type)
+        {
+            case SyntaxNode::Type::Constant: {
+                auto constant = MakeNode(Node::Type::Constant);
+                constant->value = node.value;
+                return constant;
+            }
+
+            case SyntaxNode::Type::Variable: {
+                if (node.name.find('.') != std::string::npos)
+                {
+                    // Dotted names like "a.b" are namespace-aware in projectm-eval.
+                    return {};
+                }
+                auto variable = MakeNode(Node::Type::Variable);
+                variable->variable = VariableIndex(node.name);
+                return variable;
+            }
+
+            case SyntaxNode::Type::Assign:
+                return ConvertAssignment(node);
+
+            case SyntaxNode::Type::Unary:
+                return ConvertUnary(node);
+
+            case SyntaxNode::Type::Binary:
+                return ConvertBinary(node);
+
+            case SyntaxNode::Type::Condition: {
+                auto arguments = ConvertArguments(node, 3);
+                if (arguments.empty())
+                {
+                    return {};
+                }
+                return MakeNode(Node::Type::Condition, std::move(arguments[0]), std::move(arguments[1]), std::move(arguments[2]));
+            }
+
+            case SyntaxNode::Type::Call:
+                return ConvertCall(node);
+
+            case SyntaxNode::Type::Sequence: {
+                auto sequence = MakeNode(Node::Type::Sequence);
+                for (auto const& statement : node.arguments)
+                {
+                    auto converted = Convert(*statement);
+                    if (!converted)
+                    {
+                        return {};
+                    }
+                    sequence->arguments.push_back(std::move(converted));
+                }
+                return sequence;
+            }
+
+            case SyntaxNode::Type::Index:
+                // Memory access is left to the interpreter.
+                return {};
+        }
+
+        return {};
+    }
+
+    /**
+     * Returns the lower-case names of all variables used in the code, in the order of their indices.
+     */
+    auto Variables() const -> const std::vector<std::string>&
+    {
+        return m_variables;
+    }
+
+private:
+    auto VariableIndex(const std::string& name) -> size_t
+    {
+        auto const existing = std::find(m_variables.begin(), m_variables.end(), name);
+        if (existing != m_variables.end())
+        {
+            return static_cast<size_t>(existing - m_variables.begin());
+        }
+
+        m_variables.push_back(name);
+        return m_variables.size() - 1;
+    }
+
+    auto ConvertArguments(const SyntaxNode& node, size_t count) -> std::vector<NodePtr>
+    {
+        if (node.arguments.size() != count)
+        {
+            return {};
+        }
+
+        std::vector<NodePtr> arguments;
+        for (auto const& argument : node.arguments)
+        {
+            auto converted = Convert(*argument);
+            if (!converted)
+            {
+                return {};
+            }
+            arguments.push_back(std::move(converted));
+        }
+
+        return arguments;
+    }
+
+    auto ConvertAssignment(const SyntaxNode& node) -> NodePtr
+    {
+        auto const& target = *node.arguments[0];
+        if (target.type != SyntaxNode::Type::Variable || target.name.find('.') != std::string::npos ||
+            node.operation.size() > 2 || std::string("=+-*/").find(node.operation[0]) == std::string::npos)
+        {
+            return {};
+        }
+
+        auto const variable = VariableIndex(target.name);
+        auto value = Convert(*node.arguments[1]);
+        if (!value)
+        {
+            return {};
+        }
+
+        auto assignment = MakeNode(Node::Type::Assign, std::move(value));
+        assignment->variable = variable;
+        assignment->assignOperator = node.operation[0];
+        return assignment;
+    }
+
+    auto ConvertUnary(const SyntaxNode& node) -> NodePtr
+    {
+        auto operand = Convert(*node.arguments[0]);
+        if (!operand)
+        {
+            return {};
+        }
+
+        if (node.operation == "-")
+        {
+            return MakeNode(Node::Type::Negate, std::move(operand));
+        }
+        if (node.operation == "!")
+        {
+            auto result = MakeNode(Node::Type::CallUnary, std::move(operand));
+            result->unaryHelper = &Not;
+            return result;
+        }
+        return operand;
+    }
+
+    auto ConvertBinary(const SyntaxNode& node) -> NodePtr
+    {
+        static const std::vector<std::pair<const char*, Node::Type>> operators{
+            {"+", Node::Type::Add}, {"-", Node::Type::Subtract}, {"*", Node::Type::Multiply}, {"&&", Node::Type::LogicalAnd}, {"||", Node::Type::LogicalOr}};
+
+        static const std::vector<std::pair<const char*, BinaryHelper>> helperOperators{
+            {"/", &Divide}, {"==", &Equal}, {"!=", &NotEqual}, {"<", &Below}, {">", &Above}, {"<=", &BelowEqual}, {">=", &AboveEqual}};
+
+        auto arguments = ConvertArguments(node, 2);
+        if (arguments.empty())
+        {
+            return {};
+        }
+
+        for (auto const& entry : operators)
+        {
+            if (node.operation == entry.first)
+            {
+                return MakeNode(entry.second, std::move(arguments[0]), std::move(arguments[1]));
+            }
+        }
+
+        for (auto const& entry : helperOperators)
+        {
+            if (node.operation == entry.first)
+            {
+                auto call = MakeNode(Node::Type::CallBinary, std::move(arguments[0]), std::move(arguments[1]));
+                call->binaryHelper = entry.second;
+                return call;
+            }
+        }
+
+        // Modulo, power and bitwise operators are left to the interpreter.
+        return {};
+    }
+
+    auto ConvertCall(const SyntaxNode& node) -> NodePtr
+    {
+        static const std::vector<std::pair<const char*, UnaryHelper>> unaryFunctions{
+            {"sin", &Sin}, {"cos", &Cos}, {"tan", &Tan}, {"atan", &Atan}, {"exp", &Exp}, {"floor", &Floor}, {"ceil", &Ceil}, {"abs", &Abs}, {"sqr", &Sqr}, {"sqrt", &Sqrt}, {"sign", &Sign}, {"bnot", &Not}};
+
+        static const std::vector<std::pair<const char*, BinaryHelper>> binaryFunctions{
+            {"atan2", &Atan2}, {"min", &Min}, {"max", &Max}, {"pow", &Pow}, {"above", &Above}, {"below", &Below}, {"equal", &Equal}};
+
+        auto const& name = node.name;
+
+        for (auto const& function : unaryFunctions)
+        {
+            if (name == function.first)
+            {
+                auto arguments = ConvertArguments(node, 1);
+                if (arguments.empty())
+                {
+                    return {};
+                }
+                auto call = MakeNode(Node::Type::CallUnary, std::move(arguments[0]));
+                call->unaryHelper = function.second;
+                return call;
+            }
+        }
+
+        for (auto const& function : binaryFunctions)
+        {
+            if (name == function.first)
+            {
+                auto arguments = ConvertArguments(node, 2);
+                if (arguments.empty())
+                {
+                    return {};
+                }
+                auto call = MakeNode(Node::Type::CallBinary, std::move(arguments[0]), std::move(arguments[1]));
+                call->binaryHelper = function.second;
+                return call;
+            }
+        }
+
+        if (name == "band" || name == "bor")
+        {
+            auto arguments = ConvertArguments(node, 2);
+            if (arguments.empty())
+            {
+                return {};
+            }
+            return MakeNode(name == "band" ? Node::Type::LogicalAnd : Node::Type::LogicalOr,
+                            std::move(arguments[0]), std::move(arguments[1]));
+        }
+
+        if (name == "if")
+        {
+            auto arguments = ConvertArguments(node, 3);
+            if (arguments.empty())
+            {
+                return {};
+            }
+            return MakeNode(Node::Type::Condition, std::move(arguments[0]), std::move(arguments[1]), std::move(arguments[2]));
+        }
+
+        if (name == "exec2" || name == "exec3")
+        {
+            auto arguments = ConvertArguments(node, name == "exec2" ? 2 : 3);
+            if (arguments.empty())
+            {
+                return {};
+            }
+            auto sequence = MakeNode(Node::Type::Sequence);
+            sequence->arguments = std::move(arguments);
+            return sequence;
+        }
+
+        // Memory access, loops, random numbers and everything else is left to the interpreter.
+        return {};
+    }
+
+    std::vector<std::string> m_variables; //!< Names of the variables used in the code.
+};
+
+#ifdef PROJECTM_EXPRESSION_JIT_X86_64
+
+/**
+ * @brief Emits x86-64 SSE2 code for an expression tree.
+ *
+ * The generated function takes no arguments and returns the result in xmm0. Intermediate values
+ * are kept on the machine stack, helpers are called with the System V calling convention.
+ * Variable addresses are left as zero and recorded as relocations, to be patched when the
+ * code is instantiated for a context.
+ */
+class CodeGenerator
+{
+public:
+    explicit CodeGenerator(std::vector<ExpressionJit::Relocation>& relocations)
+        : m_relocations(relocations)
+    {
+    }
+
+    auto Generate(const Node& program) -> std::vector<uint8_t>
+    {
+        Emit({0x55});             // push rbp
+        Emit({0x48, 0x89, 0xE5}); // mov rbp, rsp
+
+        GenerateNode(program);
+
+        Emit({0x48, 0x89, 0xEC}); // mov rsp, rbp
+        Emit({0x5D});             // pop rbp
+        Emit({0xC3});             // ret
+
+        return std::move(m_code);
+    }
+
+private:
+    void Emit(std::initializer_list<uint8_t> bytes)
+    {
+        m_code.insert(m_code.end(), bytes);
+    }
+
+    void EmitImmediate64(uint64_t value)
+    {
+        for (int byte = 0; byte < 8; byte++)
+        {
+            m_code.push_back(static_cast<uint8_t>(value >> (byte * 8)));
+        }
+    }
+
+    void LoadAddress(const void* address)
+    {
+        Emit({0x48, 0xB8}); // mov rax, imm64
+        EmitImmediate64(reinterpret_cast<uintptr_t>(address));
+    }
+
+    void LoadVariableAddress(size_t variable)
+    {
+        Emit({0x48, 0xB8}); // mov rax, imm64
+        m_relocations.push_back({m_code.size(), variable});
+        EmitImmediate64(0);
+    }
+
+    void LoadConstant(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Emit({0x48, 0xB8}); // mov rax, imm64
+        EmitImmediate64(bits);
+        Emit({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+    }
+
+    void Push()
+    {
+        Emit({0x66, 0x48, 0x0F, 0x7E, 0xC0}); // movq rax, xmm0
+        Emit({0x50});                         // push rax
+        m_stackDepth++;
+    }
+
+    /**
+     * Moves xmm0 to xmm1 and pops the previously pushed value into xmm0.
+     */
+    void PopFirstOperand()
+    {
+        Emit({0x66, 0x0F, 0x28, 0xC8});       // movapd xmm1, xmm0
+        Emit({0x58});                         // pop rax
+        Emit({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+        m_stackDepth--;
+    }
+
+    void Call(const void* function)
+    {
+        bool const realign = (m_stackDepth % 2) != 0;
+        if (realign)
+        {
+            Emit({0x48, 0x83, 0xEC, 0x08}); // sub rsp, 8
+        }
+
+        LoadAddress(function);
+        Emit({0xFF, 0xD0}); // call rax
+
+        if (realign)
+        {
+            Emit({0x48, 0x83, 0xC4, 0x08}); // add rsp, 8
+        }
+    }
+
+    /**
+     * Emits a conditional jump, taken if xmm0 holds 0.0, and returns the offset to patch.
+     */
+    auto JumpIfZero() -> size_t
+    {
+        Emit({0x66, 0x0F, 0x57, 0xC9}); // xorpd xmm1, xmm1
+        Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+        Emit({0x0F, 0x84});             // je rel32
+        return EmitJumpTarget();
+    }
+
+    auto JumpIfNotZero() -> size_t
+    {
+        Emit({0x66, 0x0F, 0x57, 0xC9}); // xorpd xmm1, xmm1
+        Emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+        Emit({0x0F, 0x85});             // jne rel32
+        return EmitJumpTarget();
+    }
+
+    auto Jump() -> size_t
+    {
+        Emit({0xE9}); // jmp rel32
+        return EmitJumpTarget();
+    }
+
+    auto EmitJumpTarget() -> size_t
+    {
+        auto const offset = m_code.size();
+        Emit({0, 0, 0, 0});
+        return offset;
+    }
+
+    void PatchJump(size_t offset)
+    {
+        auto const relative = static_cast<int32_t>(m_code.size() - (offset + 4));
+        std::memcpy(&m_code[offset], &relative, sizeof(relative));
+    }
+
+    void GenerateArithmetic(char operation)
+    {
+        switch (operation)
+        {
+            case '+':
+                Emit({0xF2, 0x0F, 0x58, 0xC1}); // addsd xmm0, xmm1
+                break;
+
+            case '-':
+                Emit({0xF2, 0x0F, 0x5C, 0xC1}); // subsd xmm0, xmm1
+                break;
+
+            case '*':
+                Emit({0xF2, 0x0F, 0x59, 0xC1}); // mulsd xmm0, xmm1
+                break;
+
+            default:
+                Call(reinterpret_cast<const void*>(&Divide));
+                break;
+        }
+    }
+
+    void GenerateNode(const Node& node)
+    {
+        switch (node.type)
+        {
+            case Node::Type::Constant:
+                LoadConstant(node.value);
+                break;
+
+            case Node::Type::Variable:
+                LoadVariableAddress(node.variable);
+                Emit({0xF2, 0x0F, 0x10, 0x00}); // movsd xmm0, [rax]
+                break;
+
+            case Node::Type::Assign:
+                GenerateNode(*node.arguments[0]);
+                if (node.assignOperator != '=')
+                {
+                    Emit({0x66, 0x0F, 0x28, 0xC8}); // movapd xmm1, xmm0
+                    LoadVariableAddress(node.variable);
+                    Emit({0xF2, 0x0F, 0x10, 0x00}); // movsd xmm0, [rax]
+                    GenerateArithmetic(node.assignOperator);
+                }
+                LoadVariableAddress(node.variable);
+                Emit({0xF2, 0x0F, 0x11, 0x00}); // movsd [rax], xmm0
+                break;
+
+            case Node::Type::Add:
+            case Node::Type::Subtract:
+            case Node::Type::Multiply:
+                GenerateNode(*node.arguments[0]);
+                Push();
+                GenerateNode(*node.arguments[1]);
+                PopFirstOperand();
+                GenerateArithmetic(node.type == Node::Type::Add        ? '+'
+                                   : node.type == Node::Type::Subtract ? '-'
+                                                                       : '*');
+                break;
+
+            case Node::Type::Negate:
+                GenerateNode(*node.arguments[0]);
+                Emit({0x48, 0xB8}); // mov rax, imm64
+                EmitImmediate64(0x8000000000000000ULL);
+                Emit({0x66, 0x48, 0x0F, 0x6E, 0xC8}); // movq xmm1, rax
+                Emit({0x66, 0x0F, 0x57, 0xC1});       // xorpd xmm0, xmm1
+                break;
+
+            case Node::Type::CallUnary:
+                GenerateNode(*node.arguments[0]);
+                Call(reinterpret_cast<const void*>(node.unaryHelper));
+                break;
+
+            case Node::Type::CallBinary:
+                GenerateNode(*node.arguments[0]);
+                Push();
+                GenerateNode(*node.arguments[1]);
+                PopFirstOperand();
+                Call(reinterpret_cast<const void*>(node.binaryHelper));
+                break;
+
+            case Node::Type::LogicalAnd:
+            {
+                GenerateNode(*node.arguments[0]);
+                Call(reinterpret_cast<const void*>(&Truth));
+                auto const skipSecond = JumpIfZero();
+                GenerateNode(*node.arguments[1]);
+                Call(reinterpret_cast<const void*>(&Truth));
+                PatchJump(skipSecond);
+                break;
+            }
+
+            case Node::Type::LogicalOr:
+            {
+                GenerateNode(*node.arguments[0]);
+                Call(reinterpret_cast<const void*>(&Truth));
+                auto const skipSecond = JumpIfNotZero();
+                GenerateNode(*node.arguments[1]);
+                Call(reinterpret_cast<const void*>(&Truth));
+                PatchJump(skipSecond);
+                break;
+            }
+
+            case Node::Type::Condition:
+            {
+                GenerateNode(*node.arguments[0]);
+                Call(reinterpret_cast<const void*>(&Truth));
+                auto const falseBranch = JumpIfZero();
+                GenerateNode(*node.arguments[1]);
+                auto const end = Jump();
+                PatchJump(falseBranch);
+                GenerateNode(*node.arguments[2]);
+                PatchJump(end);
+                break;
+            }
+
+            case Node::Type::Sequence:
+                if (node.arguments.empty())
+                {
+                    Emit({0x66, 0x0F, 0x57, 0xC0}); // xorpd xmm0, xmm0
+                }
+                for (auto const& statement : node.arguments)
+                {
+                    GenerateNode(*statement);
+                }
+                break;
+        }
+    }
+
+    std::vector<uint8_t> m_code;                            //!< The generated machine code.
+    std::vector<ExpressionJit::Relocation>& m_relocations; //!< Variable address locations in the code.
+    int m_stackDepth{};                                     //!< Number of values currently pushed onto the stack.
+};
+
+#endif
+
+} // namespace
+
+ExpressionJit::NativeCode::NativeCode(void* memory, size_t size)
+    : m_memory(memory)
+    , m_size(size)
+{
+}
+
+ExpressionJit::NativeCode::~NativeCode()
+{
+#ifdef PROJECTM_EXPRESSION_JIT_X86_64
+    munmap(m_memory, m_size);
+#endif
+}
+
+auto ExpressionJit::NativeCode::Execute() const -> PRJM_EVAL_F
+{
+    return reinterpret_cast<double (*)()>(m_memory)();
+}
+
+auto ExpressionJit::Supported() -> bool
+{
+#ifdef PROJECTM_EXPRESSION_JIT_X86_64
+    return std::is_same<PRJM_EVAL_F, double>::value;
+#else
+    return false;
+#endif
+}
+
+ExpressionJit::Template::Template(std::vector<uint8_t> machineCode,
+                                 std::vector<std::string> variables,
+                                 std::vector<Relocation> relocations)
+    : m_machineCode(std::move(machineCode))
+    , m_variables(std::move(variables))
+    , m_relocations(std::move(relocations))
+{
+}
+
+auto ExpressionJit::Template::Variables() const -> const std::vector<std::string>&
+{
+    return m_variables;
+}
+
+auto ExpressionJit::Template::Instantiate(const VariableResolver& resolveVariable) const -> std::unique_ptr<NativeCode>
+{
+#ifdef PROJECTM_EXPRESSION_JIT_X86_64
+    std::vector<PRJM_EVAL_F*> storage;
+    storage.reserve(m_variables.size());
+    for (auto const& name : m_variables)
+    {
+        auto* variable = resolveVariable(name);
+        if (variable == nullptr)
+        {
+            return {};
+        }
+        storage.push_back(variable);
+    }
+
+    void* memory = mmap(nullptr, m_machineCode.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        return {};
+    }
+
+    auto* bytes = static_cast<uint8_t*>(memory);
+    std::memcpy(bytes, m_machineCode.data(), m_machineCode.size());
+    for (auto const& relocation : m_relocations)
+    {
+        auto const address = reinterpret_cast<uintptr_t>(storage[relocation.variable]);
+        std::memcpy(bytes + relocation.offset, &address, sizeof(address));
+    }
+
+    if (mprotect(memory, m_machineCode.size(), PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, m_machineCode.size());
+        return {};
+    }
+
+    return std::make_unique<NativeCode>(memory, m_machineCode.size());
+#else
+    (void) resolveVariable;
+    return {};
+#endif
+}
+
+auto ExpressionJit::CompileTemplate(const std::string& code) -> std::unique_ptr<Template>
+{
+    if (!Supported())
+    {
+        return {};
+    }
+
+    auto const syntaxTree = ExpressionParser::Parse(code);
+    if (!syntaxTree)
+    {
+        return {};
+    }
+
+    TreeBuilder treeBuilder;
+    auto program = treeBuilder.Convert(*syntaxTree);
+    if (!program)
+    {
+        return {};
+    }
+
+#ifdef PROJECTM_EXPRESSION_JIT_X86_64
+    std::vector<Relocation> relocations;
+    auto machineCode = CodeGenerator(relocations).Generate(*program);
+
+    return std::make_unique<Template>(std::move(machineCode), treeBuilder.Variables(), std::move(relocations));
+#else
+    return {};
+#endif
+}
+
+auto ExpressionJit::Compile(const std::string& code, const VariableResolver& resolveVariable) -> std::unique_ptr<NativeCode>
+{
+    auto compiledTemplate = CompileTemplate(code);
+    if (!compiledTemplate)
+    {
+        return {};
+    }
+
+    return compiledTemplate->Instantiate(resolveVariable);
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "ExpressionCache.hpp"
+
+#include <projectm-eval.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Compiles Milkdrop expression code into native machine code.
+ *
+ * Only a subset of the expression language is supported: numbers and the $pi, $e and $phi
+ * constants, variables, assignments with =, +=, -=, *= and /=, the arithmetic, comparison and
+ * boolean operators, the ternary operator, and the most common math and logic functions.
+ * The semantics follow projectm-eval, e.g. division by zero returns 0 and equality and boolean
+ * tests use the same 0.00001 tolerance.
+ *
+ * If the code uses anything else, like memory buffers, loops or random numbers, or if the
+ * current platform isn't supported, compilation fails and the caller is expected to fall back
+ * to the interpreter. Code generation is currently implemented for x86-64 with the System V ABI.
+ */
+class ExpressionJit
+{
+public:
+    /**
+     * @brief Returns a pointer to the storage of the given, lower-case variable name.
+     */
+    using VariableResolver = std::function<PRJM_EVAL_F*(const std::string& name)>;
+
+    /**
+     * @brief A block of executable machine code.
+     */
+    class NativeCode
+    {
+    public:
+        NativeCode(void* memory, size_t size);
+
+        ~NativeCode();
+
+        NativeCode(const NativeCode&) = delete;
+        auto operator=(const NativeCode&) -> NativeCode& = delete;
+
+        /**
+         * @brief Runs the code.
+         * @return The value of the last expression.
+         */
+        auto Execute() const -> PRJM_EVAL_F;
+
+    private:
+        void* m_memory{nullptr}; //!< The executable memory block.
+        size_t m_size{};         //!< Size of the memory block in bytes.
+    };
+
+    /**
+     * @brief Location of a variable address in the generated machine code.
+     */
+    struct Relocation
+    {
+        size_t offset{};   //!< Byte offset of the 64-bit address in the machine code.
+        size_t variable{}; //!< Index of the variable in the template's variable list.
+    };
+
+    /**
+     * @brief Machine code compiled from a piece of code, not yet bound to any variable storage.
+     *
+     * The template only depends on the code text and can be instantiated any number of times
+     * for different contexts, which only copies the code and patches in the variable addresses.
+     * Templates are shared between contexts through the ExpressionCache.
+     */
+    class Template : public ExpressionCache::SharedCode
+    {
+    public:
+        Template(std::vector<uint8_t> machineCode, std::vector<std::string> variables, std::vector<Relocation> relocations);
+
+        /**
+         * @brief Returns the lower-case names of the variables used in the code.
+         * @return The variable names, in relocation index order.
+         */
+        auto Variables() const -> const std::vector<std::string>&;
+
+        /**
+         * @brief Creates executable code using the given variable storage.
+         * @param resolveVariable Returns the storage of variables used in the code.
+         * @return The executable code, or nullptr if a variable couldn't be resolved.
+         */
+        auto Instantiate(const VariableResolver& resolveVariable) const -> std::unique_ptr<NativeCode>;
+
+    private:
+        std::vector<uint8_t> m_machineCode;    //!< Machine code with zeroed variable addresses.
+        std::vector<std::string> m_variables;  //!< Names of the variables used in the code.
+        std::vector<Relocation> m_relocations; //!< Locations of the variable addresses.
+    };
+
+    /**
+     * @brief Returns whether native code can be generated on this platform.
+     * @return True if the JIT is supported, false if Compile() will always fail.
+     */
+    static auto Supported() -> bool;
+
+    /**
+     * @brief Compiles the given code.
+     * @param code The expression code.
+     * @param resolveVariable Returns the storage of variables used in the code.
+     * @return The compiled code, or nullptr if the code or platform isn't supported.
+     */
+    static auto Compile(const std::string& code, const VariableResolver& resolveVariable) -> std::unique_ptr<NativeCode>;
+
+    /**
+     * @brief Compiles the given code into a template which can be instantiated for any context.
+     * @param code The expression code.
+     * @return The compiled template, or nullptr if the code or platform isn't supported.
+     */
+    static auto CompileTemplate(const std::string& code) -> std::unique_ptr<Template>;
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,643 @@
+#include "ExpressionParser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <initializer_list>
+#include <locale>
+#include <sstream>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+using Node = ExpressionParser::Node;
+using NodePtr = ExpressionParser::NodePtr;
+
+constexpr int maxNestingDepth{200}; //!< Maximum expression nesting before giving up.
+
+auto MakeNode(Node::Type type, const std::string& operation = {}) -> NodePtr
+{
+    auto node = std::make_unique<Node>(type);
+    node->operation = operation;
+    return node;
+}
+
+auto MakeNode(Node::Type type, const std::string& operation, NodePtr first, NodePtr second = {}) -> NodePtr
+{
+    auto node = MakeNode(type, operation);
+    node->arguments.push_back(std::move(first));
+    if (second)
+    {
+        node->arguments.push_back(std::move(second));
+    }
+    return node;
+}
+
+/**
+ * @brief Recursive-descent parser, one method per precedence level.
+ *
+ * All methods return nullptr on errors, which is passed up to Parse().
+ */
+class Parser
+{
+public:
+    explicit Parser(const std::string& code)
+        : m_code(code)
+    {
+    }
+
+    auto Parse() -> NodePtr
+    {
+        auto program = ParseSequence();
+        SkipWhitespace();
+        if (!program || m_invalid || m_position != m_code.size())
+        {
+            return {};
+        }
+        return program;
+    }
+
+private:
+    void SkipWhitespace()
+    {
+        while (m_position < m_code.size())
+        {
+            if (std::isspace(static_cast<unsigned char>(m_code[m_position])))
+            {
+                m_position++;
+            }
+            else if (m_code.compare(m_position, 2, "//") == 0)
+            {
+                auto const lineEnd = m_code.find('\n', m_position);
+                m_position = lineEnd == std::string::npos ? m_code.size() : lineEnd;
+            }
+            else if (m_code.compare(m_position, 2, "/*") == 0)
+            {
+                auto const commentEnd = m_code.find("*/", m_position + 2);
+                if (commentEnd == std::string::npos)
+                {
+                    m_invalid = true;
+                    m_position = m_code.size();
+                    break;
+                }
+                m_position = commentEnd + 2;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    auto Peek(const char* token) -> bool
+    {
+        SkipWhitespace();
+        return m_code.compare(m_position, std::strlen(token), token) == 0;
+    }
+
+    auto Accept(const char* token) -> bool
+    {
+        if (!Peek(token))
+        {
+            return false;
+        }
+        m_position += std::strlen(token);
+        return true;
+    }
+
+    /**
+     * Accepts a single-character operator which isn't the start of any of the given longer tokens.
+     */
+    auto AcceptOperator(const char* token, std::initializer_list<const char*> longerTokens) -> bool
+    {
+        for (auto const* longerToken : longerTokens)
+        {
+            if (Peek(longerToken))
+            {
+                return false;
+            }
+        }
+        return Accept(token);
+    }
+
+    auto AtSequenceEnd() -> bool
+    {
+        SkipWhitespace();
+        return m_position >= m_code.size() || Peek(";") || Peek(")") || Peek("]") || Peek(",");
+    }
+
+    auto ParseSequence() -> NodePtr
+    {
+        if (++m_depth > maxNestingDepth)
+        {
+            return {};
+        }
+
+        auto sequence = MakeNode(Node::Type::Sequence);
+        auto begin = m_position;
+        while (true)
+        {
+            if (!AtSequenceEnd())
+            {
+                auto statement = ParseAssignment();
+                if (!statement)
+                {
+                    return {};
+                }
+
+                SkipWhitespace();
+                statement->begin = begin;
+                statement->end = m_position;
+                sequence->arguments.push_back(std::move(statement));
+            }
+
+            if (!Accept(";"))
+            {
+                break;
+            }
+            begin = m_position;
+        }
+
+        m_depth--;
+        return sequence;
+    }
+
+    auto ParseAssignment() -> NodePtr
+    {
+        if (++m_depth > maxNestingDepth)
+        {
+            return {};
+        }
+
+        auto target = ParseConditional();
+        if (!target)
+        {
+            return {};
+        }
+
+        std::string operation;
+        for (auto const* candidate : {"+=", "-=", "*=", "/=", "%=", "^=", "|=", "&="})
+        {
+            if (Accept(candidate))
+            {
+                operation = candidate;
+                break;
+            }
+        }
+        if (operation.empty() && !Peek("==") && Accept("="))
+        {
+            operation = "=";
+        }
+
+        if (operation.empty())
+        {
+            m_depth--;
+            return target;
+        }
+
+        if (target->type != Node::Type::Variable && target->type != Node::Type::Call && target->type != Node::Type::Index)
+        {
+            return {};
+        }
+
+        auto value = ParseAssignment();
+        if (!value)
+        {
+            return {};
+        }
+
+        m_depth--;
+        return MakeNode(Node::Type::Assign, operation, std::move(target), std::move(value));
+    }
+
+    auto ParseConditional() -> NodePtr
+    {
+        auto condition = ParseLogicalOr();
+        if (!condition || !Accept("?"))
+        {
+            return condition;
+        }
+
+        auto trueBranch = ParseAssignment();
+        if (!trueBranch)
+        {
+            return {};
+        }
+
+        auto node = MakeNode(Node::Type::Condition, {}, std::move(condition), std::move(trueBranch));
+        if (Accept(":"))
+        {
+            auto falseBranch = ParseAssignment();
+            if (!falseBranch)
+            {
+                return {};
+            }
+            node->arguments.push_back(std::move(falseBranch));
+        }
+
+        return node;
+    }
+
+    auto ParseLogicalOr() -> NodePtr
+    {
+        auto left = ParseLogicalAnd();
+        while (left && Accept("||"))
+        {
+            auto right = ParseLogicalAnd();
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(Node::Type::Binary, "||", std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    auto ParseLogicalAnd() -> NodePtr
+    {
+        auto left = ParseComparison();
+        while (left && Accept("&&"))
+        {
+            auto right = ParseComparison();
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(Node::Type::Binary, "&&", std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    auto ParseComparison() -> NodePtr
+    {
+        auto left = ParseBitwise();
+        if (!left)
+        {
+            return {};
+        }
+
+        std::string operation;
+        for (auto const* candidate : {"==", "!=", "<=", ">="})
+        {
+            if (Accept(candidate))
+            {
+                operation = candidate;
+                break;
+            }
+        }
+        if (operation.empty() && !Peek("<<") && Accept("<"))
+        {
+            operation = "<";
+        }
+        if (operation.empty() && !Peek(">>") && Accept(">"))
+        {
+            operation = ">";
+        }
+        if (operation.empty())
+        {
+            return left;
+        }
+
+        auto right = ParseBitwise();
+        if (!right || Peek("<") || Peek(">") || Peek("==") || Peek("!="))
+        {
+            // Chained comparisons are left to the interpreter.
+            return {};
+        }
+
+        return MakeNode(Node::Type::Binary, operation, std::move(left), std::move(right));
+    }
+
+    auto ParseBitwise() -> NodePtr
+    {
+        auto left = ParseAdditive();
+        while (left)
+        {
+            std::string operation;
+            if (AcceptOperator("|", {"||", "|="}))
+            {
+                operation = "|";
+            }
+            else if (AcceptOperator("&", {"&&", "&="}))
+            {
+                operation = "&";
+            }
+            else
+            {
+                break;
+            }
+
+            auto right = ParseAdditive();
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(Node::Type::Binary, operation, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    auto ParseAdditive() -> NodePtr
+    {
+        auto left = ParseMultiplicative();
+        while (left)
+        {
+            std::string operation;
+            if (AcceptOperator("+", {"+="}))
+            {
+                operation = "+";
+            }
+            else if (AcceptOperator("-", {"-="}))
+            {
+                operation = "-";
+            }
+            else
+            {
+                break;
+            }
+
+            auto right = ParseMultiplicative();
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(Node::Type::Binary, operation, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    auto ParseMultiplicative() -> NodePtr
+    {
+        auto left = ParsePower();
+        while (left)
+        {
+            std::string operation;
+            if (AcceptOperator("*", {"*="}))
+            {
+                operation = "*";
+            }
+            else if (AcceptOperator("/", {"/="}))
+            {
+                operation = "/";
+            }
+            else if (AcceptOperator("%", {"%="}))
+            {
+                operation = "%";
+            }
+            else
+            {
+                break;
+            }
+
+            auto right = ParsePower();
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(Node::Type::Binary, operation, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    auto ParsePower() -> NodePtr
+    {
+        auto left = ParseUnary();
+        while (left && AcceptOperator("^", {"^="}))
+        {
+            auto right = ParseUnary();
+            if (!right)
+            {
+                return {};
+            }
+            left = MakeNode(Node::Type::Binary, "^", std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    auto ParseUnary() -> NodePtr
+    {
+        if (++m_depth > maxNestingDepth)
+        {
+            return {};
+        }
+
+        NodePtr result;
+        std::string operation;
+        if (AcceptOperator("-", {"-="}))
+        {
+            operation = "-";
+        }
+        else if (AcceptOperator("+", {"+="}))
+        {
+            operation = "+";
+        }
+        else if (AcceptOperator("!", {"!="}))
+        {
+            operation = "!";
+        }
+
+        if (operation.empty())
+        {
+            result = ParsePostfix();
+        }
+        else
+        {
+            auto operand = ParseUnary();
+            if (operand)
+            {
+                result = MakeNode(Node::Type::Unary, operation, std::move(operand));
+            }
+        }
+
+        m_depth--;
+        return result;
+    }
+
+    auto ParsePostfix() -> NodePtr
+    {
+        auto base = ParsePrimary();
+        while (base && Accept("["))
+        {
+            auto offset = ParseSequence();
+            if (!offset || !Accept("]"))
+            {
+                return {};
+            }
+            base = MakeNode(Node::Type::Index, {}, std::move(base), std::move(offset));
+        }
+        return base;
+    }
+
+    auto ParsePrimary() -> NodePtr
+    {
+        SkipWhitespace();
+        if (m_position >= m_code.size())
+        {
+            return {};
+        }
+
+        if (Accept("("))
+        {
+            auto inner = ParseSequence();
+            if (!inner || !Accept(")"))
+            {
+                return {};
+            }
+            return inner;
+        }
+
+        auto const character = m_code[m_position];
+        if (std::isdigit(static_cast<unsigned char>(character)) || character == '.')
+        {
+            return ParseNumber();
+        }
+
+        if (character == '$')
+        {
+            m_position++;
+            auto const name = ReadIdentifier();
+            auto constant = MakeNode(Node::Type::Constant);
+            if (name == "pi")
+            {
+                constant->value = 3.141592653589793;
+            }
+            else if (name == "e")
+            {
+                constant->value = 2.718281828459045;
+            }
+            else if (name == "phi")
+            {
+                constant->value = 1.618033988749895;
+            }
+            else
+            {
+                return {};
+            }
+            return constant;
+        }
+
+        if (std::isalpha(static_cast<unsigned char>(character)) || character == '_')
+        {
+            auto const name = ReadIdentifier();
+            if (Accept("("))
+            {
+                return ParseCall(name);
+            }
+
+            auto variable = MakeNode(Node::Type::Variable);
+            variable->name = name;
+            return variable;
+        }
+
+        return {};
+    }
+
+    auto ParseNumber() -> NodePtr
+    {
+        auto const start = m_position;
+        while (m_position < m_code.size() &&
+               (std::isdigit(static_cast<unsigned char>(m_code[m_position])) || m_code[m_position] == '.'))
+        {
+            m_position++;
+        }
+
+        if (m_position < m_code.size() &&
+            (std::isalpha(static_cast<unsigned char>(m_code[m_position])) || m_code[m_position] == '_'))
+        {
+            // Exponents, hex numbers and other suffixes.
+            return {};
+        }
+
+        auto literal = m_code.substr(start, m_position - start);
+        if (literal == "." || std::count(literal.begin(), literal.end(), '.') > 1)
+        {
+            return {};
+        }
+        if (literal.back() == '.')
+        {
+            literal += '0';
+        }
+        if (literal.front() == '.')
+        {
+            literal.insert(literal.begin(), '0');
+        }
+
+        std::istringstream stream(literal);
+        stream.imbue(std::locale::classic());
+
+        auto constant = MakeNode(Node::Type::Constant);
+        stream >> constant->value;
+        if (stream.fail() || !stream.eof())
+        {
+            return {};
+        }
+        return constant;
+    }
+
+    /**
+     * Reads a lower-case identifier. Dots are part of the name, e.g. in namespaced variables.
+     */
+    auto ReadIdentifier() -> std::string
+    {
+        std::string name;
+        while (m_position < m_code.size() &&
+               (std::isalnum(static_cast<unsigned char>(m_code[m_position])) || m_code[m_position] == '_' || m_code[m_position] == '.'))
+        {
+            name += static_cast<char>(std::tolower(static_cast<unsigned char>(m_code[m_position])));
+            m_position++;
+        }
+        return name;
+    }
+
+    auto ParseCall(const std::string& name) -> NodePtr
+    {
+        auto call = MakeNode(Node::Type::Call);
+        call->name = name;
+
+        if (Accept(")"))
+        {
+            return call;
+        }
+
+        do
+        {
+            auto argument = ParseSequence();
+            if (!argument)
+            {
+                return {};
+            }
+            call->arguments.push_back(std::move(argument));
+        } while (Accept(","));
+
+        if (!Accept(")"))
+        {
+            return {};
+        }
+
+        return call;
+    }
+
+    const std::string& m_code; //!< The code being parsed.
+    size_t m_position{};       //!< Current parse position.
+    int m_depth{};             //!< Current nesting depth.
+    bool m_invalid{false};     //!< Set if an error was found while skipping whitespace.
+};
+
+} // namespace
+
+auto ExpressionParser::Parse(const std::string& code) -> NodePtr
+{
+    Parser parser(code);
+    return parser.Parse();
+}
+
+auto ExpressionParser::IsGlobalRegister(const std::string& name) -> bool
+{
+    return name.size() == 5 && name.compare(0, 3, "reg") == 0 &&
+           std::isdigit(static_cast<unsigned char>(name[3])) && std::isdigit(static_cast<unsigned char>(name[4]));
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
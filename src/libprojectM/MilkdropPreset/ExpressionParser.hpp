@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Parses Milkdrop expression code into a syntax tree.
+ *
+ * Used by everything inspecting preset code besides the evaluator itself: the per-pixel code
+ * analysis, the per-pixel GLSL translator and the expression JIT. Each of them walks the same
+ * tree and rejects the node types or functions it doesn't support.
+ *
+ * The parser accepts numbers, the $pi, $e and $phi constants, variables, function calls with
+ * any number of arguments, memory access with brackets, statement sequences, all assignment
+ * operators, the ternary operator and the arithmetic, bitwise, comparison and boolean operators.
+ * Operator precedence follows ns-eel2. Constructs with unclear semantics, like chained
+ * comparisons, exponent or hexadecimal number notation and unterminated comments, make
+ * parsing fail, so callers always fall back to the projectm-eval interpreter for them.
+ */
+class ExpressionParser
+{
+public:
+    /**
+     * @brief A node of the syntax tree.
+     */
+    struct Node
+    {
+        enum class Type
+        {
+            Constant,  //!< A number or named constant, stored in value.
+            Variable,  //!< A variable, name is the lower-case variable name.
+            Assign,    //!< An assignment, e.g. "=" or "+=". The arguments are the target and the value.
+            Unary,     //!< A "-", "+" or "!" operator applied to the only argument.
+            Binary,    //!< A binary operator like "+", "==" or "&&" applied to both arguments.
+            Condition, //!< The ternary operator. The arguments are the condition and one or two branches.
+            Call,      //!< A function call, name is the lower-case function name.
+            Index,     //!< Memory access with brackets, "base[offset]". The arguments are base and offset.
+            Sequence   //!< Statements separated by semicolons, evaluating to the last statement's value.
+        };
+
+        explicit Node(Type nodeType)
+            : type(nodeType)
+        {
+        }
+
+        Type type;
+        double value{};                               //!< Value of Constant nodes.
+        std::string name;                             //!< Name of Variable and Call nodes.
+        std::string operation;                        //!< Operator of Assign, Unary and Binary nodes.
+        std::vector<std::unique_ptr<Node>> arguments; //!< Operands, in evaluation order.
+        size_t begin{};                               //!< For statements in a sequence: source offset after the preceding semicolon.
+        size_t end{};                                 //!< For statements in a sequence: source offset of the following semicolon.
+    };
+
+    using NodePtr = std::unique_ptr<Node>;
+
+    /**
+     * @brief Parses the given code.
+     * @param code The expression code.
+     * @return A Sequence node with the top-level statements, or nullptr if the code can't be parsed.
+     */
+    static auto Parse(const std::string& code) -> NodePtr;
+
+    /**
+     * @brief Checks if the given variable name is one of the global registers reg00 to reg99.
+     * @param name The lower-case variable name.
+     * @return True if the name is a global register.
+     */
+    static auto IsGlobalRegister(const std::string& name) -> bool;
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -1,11 +1,19 @@
 #include "Factory.hpp"
 
+#include "ExpressionEngine.hpp"
 #include "IdlePreset.hpp"
 #include "MilkdropPreset.hpp"
+#include "MilkdropPresetExceptions.hpp"
+
+#include <MemoryStream.hpp>
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
+namespace {
+constexpr auto jitExpressionEngineName{"native-jit"};
+} // namespace
+
 std::unique_ptr<::libprojectM::Preset> Factory::LoadPresetFromFile(const std::string& filename)
 {
     std::string path;
@@ -16,7 +24,14 @@ std::unique_ptr<::libprojectM::Preset> Factory::LoadPresetFromFile(const std::st
     }
     else if (protocol == "" || protocol == "file")
     {
-        return std::make_unique<MilkdropPreset>(path);
+        std::string packFile;
+        std::string memberName;
+        if (PackArchive::SplitPath(path, packFile, memberName))
+        {
+            return LoadPresetFromPack(packFile, memberName);
+        }
+
+        return std::make_unique<MilkdropPreset>(path, SelectedExpressionEngine());
     }
     else
     {
@@ -27,7 +42,65 @@ std::unique_ptr<::libprojectM::Preset> Factory::LoadPresetFromFile(const std::st
 
 std::unique_ptr<Preset> Factory::LoadPresetFromStream(std::istream& data)
 {
-    return std::make_unique<MilkdropPreset>(data);
+    return std::make_unique<MilkdropPreset>(data, SelectedExpressionEngine());
+}
+
+void Factory::SetExpressionJitEnabled(bool enabled)
+{
+    m_expressionJitEnabled = enabled;
+}
+
+auto Factory::ExpressionJitEnabled() const -> bool
+{
+    return m_expressionJitEnabled && ExpressionEngine::Find(jitExpressionEngineName) != nullptr;
+}
+
+auto Factory::SelectedExpressionEngine() const -> ExpressionEngine&
+{
+    if (m_expressionJitEnabled)
+    {
+        auto* jitEngine = ExpressionEngine::Find(jitExpressionEngineName);
+        if (jitEngine != nullptr)
+        {
+            return *jitEngine;
+        }
+    }
+
+    return ExpressionEngine::Default();
+}
+
+auto Factory::LoadPresetFromPack(const std::string& packFile, const std::string& memberName) -> std::unique_ptr<Preset>
+{
+    auto& pack = m_packs[packFile];
+    if (!pack)
+    {
+        pack = std::make_unique<PackArchive>();
+        if (!pack->Open(packFile))
+        {
+            pack.reset();
+            throw MilkdropPresetLoadException("Could not open preset pack \"" + packFile + "\"");
+        }
+    }
+
+    auto const memberIndex = pack->Find(memberName);
+    if (memberIndex == PackArchive::InvalidIndex)
+    {
+        throw MilkdropPresetLoadException("Preset \"" + memberName + "\" not found in pack \"" + packFile + "\"");
+    }
+
+    std::vector<char> buffer;
+    auto const memberData = pack->Read(memberIndex, buffer);
+    if (memberData.data == nullptr)
+    {
+        throw MilkdropPresetLoadException("Could not read preset \"" + memberName + "\" from pack \"" + packFile + "\"");
+    }
+
+    // The preset is parsed directly from the mapped file.
+    MemoryStream presetStream(memberData.data, memberData.size);
+    auto preset = std::make_unique<MilkdropPreset>(presetStream, SelectedExpressionEngine());
+    preset->SetFilename(memberName.substr(memberName.find_last_of("/\\") + 1));
+
+    return preset;
 }
 
 } // namespace MilkdropPreset
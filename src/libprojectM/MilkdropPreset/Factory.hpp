@@ -12,13 +12,17 @@
 
 #pragma once
 
+#include <PackArchive.hpp>
 #include <PresetFactory.hpp>
 
+#include <map>
 #include <memory>
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
+class ExpressionEngine;
+
 class Factory : public PresetFactory
 {
 
@@ -29,9 +33,46 @@ public:
 
     std::string supportedExtensions() const override
     {
-        return ".milk .prjm";
+        return ".milk .prjm .milkb";
     }
 
+    /**
+     * @brief Sets whether newly loaded presets compile their code to native machine code.
+     *
+     * Has no effect if the library was built without the expression JIT.
+     *
+     * @param enabled True to use the expression JIT, false to always use the interpreter.
+     */
+    void SetExpressionJitEnabled(bool enabled);
+
+    /**
+     * @brief Returns whether newly loaded presets use the expression JIT.
+     * @return True if the JIT is enabled and was built into the library, false otherwise.
+     */
+    auto ExpressionJitEnabled() const -> bool;
+
+private:
+    /**
+     * @brief Returns the expression engine for new presets.
+     * @return The JIT engine if enabled and available, the default engine otherwise.
+     */
+    auto SelectedExpressionEngine() const -> ExpressionEngine&;
+
+    /**
+     * @brief Loads a preset stored in a pack file.
+     *
+     * Opened packs are kept mapped, so switching between presets of the same pack doesn't touch
+     * the file system.
+     *
+     * @param packFile The pack file name.
+     * @param memberName The name of the preset inside the pack.
+     * @return The loaded preset.
+     * @throws MilkdropPresetLoadException If the pack can't be opened or has no such preset.
+     */
+    auto LoadPresetFromPack(const std::string& packFile, const std::string& memberName) -> std::unique_ptr<Preset>;
+
+    bool m_expressionJitEnabled{false};                          //!< If true, new presets use the JIT expression engine.
+    std::map<std::string, std::unique_ptr<PackArchive>> m_packs; //!< Opened preset packs, indexed by file name.
 };
 
 } // namespace MilkdropPreset
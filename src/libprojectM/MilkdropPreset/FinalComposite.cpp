@@ -2,6 +2,8 @@
 
 #include "PresetState.hpp"
 
+#include <Renderer/StateCache.hpp>
+
 #include <cstddef>
 
 #ifdef MILKDROP_PRESET_DEBUG
@@ -47,7 +49,7 @@ void FinalComposite::LoadCompositeShader(const PresetState& presetState)
         {
             try
             {
-                m_compositeShader->LoadCode(presetState.compositeShader);
+                m_compositeShader->LoadCode(presetState.compositeShader, presetState.compositeShaderSamplers);
 #ifdef MILKDROP_PRESET_DEBUG
                 std::cerr << "[Composite Shader] Loaded composite shader code." << std::endl;
 #endif
@@ -75,43 +77,56 @@ void FinalComposite::LoadCompositeShader(const PresetState& presetState)
     }
     else
     {
-        // Video echo OR gamma adjustment with random hue.
+        // Video echo OR gamma adjustment with random hue, plus the classic filters.
         m_videoEcho = std::make_unique<VideoEcho>(presetState);
-        if (presetState.brighten ||
-            presetState.darken ||
-            presetState.solarize ||
-            presetState.invert)
+    }
+}
+
+void FinalComposite::CompileCompositeShader(PresetState& presetState)
+{
+    if (m_compositeShader)
+    {
+        try
+        {
+            m_compositeShader->LoadTexturesAndCompileAsync(presetState);
+        }
+        catch (Renderer::ShaderException& ex)
         {
-            m_filters = std::make_unique<Filters>(presetState);
+            UseDefaultCompositeShader(presetState, ex);
         }
     }
 }
 
-void FinalComposite::CompileCompositeShader(PresetState& presetState)
+auto FinalComposite::IsCompilationComplete() const -> bool
+{
+    if (m_compositeShader)
+    {
+        return m_compositeShader->IsCompilationComplete();
+    }
+
+    return !m_videoEcho || m_videoEcho->IsCompilationComplete();
+}
+
+void FinalComposite::FinishCompilation(PresetState& presetState)
 {
     if (m_compositeShader)
     {
         try
         {
-            m_compositeShader->LoadTexturesAndCompile(presetState);
+            m_compositeShader->FinishCompilation(presetState);
 #ifdef MILKDROP_PRESET_DEBUG
             std::cerr << "[Composite Shader] Successfully compiled composite shader code." << std::endl;
 #endif
         }
         catch (Renderer::ShaderException& ex)
         {
-#ifdef MILKDROP_PRESET_DEBUG
-            std::cerr << "[Composite Shader] Error compiling composite warp shader code:" << ex.message() << std::endl;
-            std::cerr << "[Composite Shader] Using fallback shader." << std::endl;
-#else
-                (void)ex; // silence unused parameter warning
-#endif
-            // Fall back to default shader
-            m_compositeShader = std::make_unique<MilkdropShader>(MilkdropShader::ShaderType::CompositeShader);
-            m_compositeShader->LoadCode(defaultCompositeShader);
-            m_compositeShader->LoadTexturesAndCompile(presetState);
+            UseDefaultCompositeShader(presetState, ex);
         }
     }
+    else if (m_videoEcho)
+    {
+        m_videoEcho->FinishCompilation();
+    }
 }
 
 void FinalComposite::Draw(const PresetState& presetState, const PerFrameContext& perFrameContext)
@@ -119,16 +134,14 @@ void FinalComposite::Draw(const PresetState& presetState, const PerFrameContext&
     if (m_compositeShader)
     {
         InitializeMesh(presetState);
-        ApplyHueShaderColors(presetState);
 
         // Render the grid
-        glDisable(GL_BLEND);
-        glBindVertexArray(m_vaoID);
-        glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(MeshVertex) * vertexCount, m_vertices.data());
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        auto& stateCache = Renderer::StateCache::Current();
+        stateCache.SetBlend(false);
+        stateCache.BindVertexArray(m_vaoID);
 
         m_compositeShader->LoadVariables(presetState, perFrameContext);
+        ApplyHueShaderColors(presetState);
 
         glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
     }
@@ -136,14 +149,7 @@ void FinalComposite::Draw(const PresetState& presetState, const PerFrameContext&
     {
         // Apply old-school filters
         m_videoEcho->Draw();
-        if (m_filters)
-        {
-            m_filters->Draw();
-        }
     }
-
-    glBindVertexArray(0);
-    Renderer::Shader::Unbind();
 }
 
 auto FinalComposite::HasCompositeShader() const -> bool
@@ -151,16 +157,32 @@ auto FinalComposite::HasCompositeShader() const -> bool
     return m_compositeShader != nullptr;
 }
 
+void FinalComposite::UseDefaultCompositeShader(PresetState& presetState, const Renderer::ShaderException& ex)
+{
+#ifdef MILKDROP_PRESET_DEBUG
+    std::cerr << "[Composite Shader] Error compiling composite warp shader code:" << ex.message() << std::endl;
+    std::cerr << "[Composite Shader] Using fallback shader." << std::endl;
+#else
+    (void)ex; // silence unused parameter warning
+#endif
+    m_compositeShader = std::make_unique<MilkdropShader>(MilkdropShader::ShaderType::CompositeShader);
+    m_compositeShader->LoadCode(defaultCompositeShader);
+    m_compositeShader->LoadTexturesAndCompile(presetState);
+}
+
 void FinalComposite::InitializeMesh(const PresetState& presetState)
 {
-    if (m_viewportWidth == presetState.renderContext.viewportSizeX &&
-        m_viewportHeight == presetState.renderContext.viewportSizeY)
+    if (m_viewportWidth == presetState.drawnFrame.renderContext.viewportSizeX &&
+        m_viewportHeight == presetState.drawnFrame.renderContext.viewportSizeY)
     {
         return;
     }
 
-    float const halfTexelWidth = 0.5f / static_cast<float>(presetState.renderContext.viewportSizeX);
-    float const halfTexelHeight = 0.5f / static_cast<float>(presetState.renderContext.viewportSizeY);
+    m_viewportWidth = presetState.drawnFrame.renderContext.viewportSizeX;
+    m_viewportHeight = presetState.drawnFrame.renderContext.viewportSizeY;
+
+    float const halfTexelWidth = 0.5f / static_cast<float>(presetState.drawnFrame.renderContext.viewportSizeX);
+    float const halfTexelHeight = 0.5f / static_cast<float>(presetState.drawnFrame.renderContext.viewportSizeY);
 
     float const dividedByX = 1.0f / static_cast<float>(compositeGridWidth - 2);
     float const dividedByY = 1.0f / static_cast<float>(compositeGridHeight - 2);
@@ -186,8 +208,8 @@ void FinalComposite::InitializeMesh(const PresetState& presetState)
 
             float rad;
             float ang;
-            UvToMathSpace(presetState.renderContext.aspectX,
-                          presetState.renderContext.aspectY,
+            UvToMathSpace(presetState.drawnFrame.renderContext.aspectX,
+                          presetState.drawnFrame.renderContext.aspectY,
                           u, v, rad, ang);
 
             // fix-ups:
@@ -304,11 +326,13 @@ void FinalComposite::InitializeMesh(const PresetState& presetState)
         }
     }
 
-    // Store indices.
+    // Store vertices and indices. The hue colors are calculated in the vertex shader.
     // ToDo: Probably don't need to store m_indices
-    glBindVertexArray(m_vaoID);
+    Renderer::StateCache::Current().BindVertexArray(m_vaoID);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(MeshVertex) * vertexCount, m_vertices.data());
     glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(int) * m_indices.size(), m_indices.data());
-    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 float FinalComposite::SquishToCenter(float x, float exponent)
@@ -344,51 +368,14 @@ void FinalComposite::UvToMathSpace(float aspectX, float aspectY,
 
 void FinalComposite::ApplyHueShaderColors(const PresetState& presetState)
 {
-    std::array<std::array<float, 3>, 4> shade = {{{1.0f, 1.0f, 1.0f},
-                                                  {1.0f, 1.0f, 1.0f},
-                                                  {1.0f, 1.0f, 1.0f},
-                                                  {1.0f, 1.0f, 1.0f}}};
-
-    for (int i = 0; i < 4; i++)
-    {
-        auto const indexFloat = static_cast<float>(i);
-        shade[i][0] = 0.6f + 0.3f * sinf(presetState.renderContext.time * 30.0f * 0.0143f + 3 + indexFloat * 21 + presetState.hueRandomOffsets[3]);
-        shade[i][1] = 0.6f + 0.3f * sinf(presetState.renderContext.time * 30.0f * 0.0107f + 1 + indexFloat * 13 + presetState.hueRandomOffsets[1]);
-        shade[i][2] = 0.6f + 0.3f * sinf(presetState.renderContext.time * 30.0f * 0.0129f + 6 + indexFloat * 9 + presetState.hueRandomOffsets[2]);
-
-        float const max = std::max(shade[i][0], std::max(shade[i][1], shade[i][2]));
-
-        for (int k = 0; k < 3; k++)
-        {
-            shade[i][k] /= max;
-            shade[i][k] = 0.5f + 0.5f * shade[i][k];
-        }
-    }
-
-    // Interpolate and apply to all grid vertices.
-    for (int gridY = 0; gridY < compositeGridHeight; gridY++)
-    {
-        for (int gridX = 0; gridX < compositeGridWidth; gridX++)
-        {
-            auto& vertex = m_vertices[gridX + gridY * compositeGridWidth];
-            float x = vertex.x * 0.5f + 0.5f;
-            float y = vertex.y * 0.5f + 0.5f;
-
-            std::array<float, 3> color{{1.0f, 1.0f, 1.0f}};
-            for (int col = 0; col < 3; col++)
-            {
-                color[col] = shade[0][col] * (x) * (y) +
-                             shade[1][col] * (1 - x) * (y) +
-                             shade[2][col] * (x) * (1 - y) +
-                             shade[3][col] * (1 - x) * (1 - y);
-            }
-
-            vertex.r = color[0];
-            vertex.g = color[1];
-            vertex.b = color[2];
-            vertex.a = 1.0f;
-        }
-    }
+    auto const shade = VideoEcho::HueShadeColors(presetState);
+    auto& shader = m_compositeShader->Shader();
+
+    // Interpolated over the grid vertices in the vertex shader.
+    shader.SetUniformFloat3("hue_shade_0", shade[0]);
+    shader.SetUniformFloat3("hue_shade_1", shade[1]);
+    shader.SetUniformFloat3("hue_shade_2", shade[2]);
+    shader.SetUniformFloat3("hue_shade_3", shade[3]);
 }
 
 } // namespace MilkdropPreset
@@ -1,6 +1,5 @@
 #pragma once
 
-#include "Filters.hpp"
 #include "MilkdropShader.hpp"
 #include "VideoEcho.hpp"
 
@@ -29,11 +28,24 @@ public:
     void LoadCompositeShader(const PresetState& presetState);
 
     /**
-     * @brief Loads the required textures and compiles the composite shader.
+     * @brief Loads the required textures and starts compiling the composite shader.
+     * The result is checked in FinishCompilation(), which must be called before drawing.
      * @param presetState The preset state to retrieve the configuration values from.
      */
     void CompileCompositeShader(PresetState& presetState);
 
+    /**
+     * @brief Returns whether the composite or video echo shader is ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the composite shader, falling back to the default shader if it failed to compile.
+     * @param presetState The preset state to retrieve the configuration values from.
+     */
+    void FinishCompilation(PresetState& presetState);
+
     /**
      * @brief Renders the composite quad with the appropriate effects or shaders.
      * @param presetState The preset state to retrieve the configuration values from.
@@ -74,13 +86,20 @@ private:
      */
     void InitializeMesh(const PresetState& presetState);
 
+    /**
+     * @brief Replaces a composite shader which failed to compile with the default shader.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param ex The compilation error.
+     */
+    void UseDefaultCompositeShader(PresetState& presetState, const Renderer::ShaderException& ex);
+
     static float SquishToCenter(float x, float exponent);
 
     static void UvToMathSpace(float aspectX, float aspectY,
                               float u, float v, float& rad, float& ang);
 
     /**
-     * @brief Calculates the randomized, slowly changing diffuse colors.
+     * @brief Passes the randomized, slowly changing diffuse corner colors to the composite shader.
      * @param presetState The preset state to retrieve the configuration values from.
      */
     void ApplyHueShaderColors(const PresetState& presetState);
@@ -98,8 +117,7 @@ private:
     int m_viewportHeight{}; //!< Last known viewport height.
 
     std::unique_ptr<MilkdropShader> m_compositeShader; //!< The composite shader. Either preset-defined or empty.
-    std::unique_ptr<VideoEcho> m_videoEcho; //!< Video echo effect. Used if no composite shader is loaded and video echo is enabled.
-    std::unique_ptr<Filters> m_filters; //!< Color post-processing filters. Used if no composite shader is loaded.
+    std::unique_ptr<VideoEcho> m_videoEcho; //!< Video echo, gamma and filter effects. Used if no composite shader is loaded.
 };
 
 } // namespace MilkdropPreset
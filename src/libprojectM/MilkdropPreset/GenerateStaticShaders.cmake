@@ -15,12 +15,12 @@ foreach(shader_file IN LISTS SHADER_FILES)
     string(REGEX REPLACE "Glsl([0-9]+)" "" _accessor_name ${_shader_name})
 
     string(APPEND STATIC_SHADER_CONTENTS "static std::string k${_shader_name} = R\"(\n${_shader_contents})\";\n\n")
-    string(APPEND STATIC_SHADER_ACCESSOR_DECLARATIONS "    std::string Get${_accessor_name}();\n")
-
     if(_shader_type STREQUAL ".inc")
-        # Includes don't get the header prepended.
+        # Includes don't get the header prepended, so they don't depend on the GL context and can be static.
+        string(APPEND STATIC_SHADER_ACCESSOR_DECLARATIONS "    static std::string Get${_accessor_name}();\n")
         string(APPEND STATIC_SHADER_ACCESSOR_DEFINITIONS "DECLARE_SHADER_ACCESSOR_NO_HEADER(${_accessor_name});\n")
     else()
+        string(APPEND STATIC_SHADER_ACCESSOR_DECLARATIONS "    std::string Get${_accessor_name}();\n")
         string(APPEND STATIC_SHADER_ACCESSOR_DEFINITIONS "DECLARE_SHADER_ACCESSOR(${_accessor_name});\n")
     endif()
 endforeach()
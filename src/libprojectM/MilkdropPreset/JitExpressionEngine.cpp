@@ -0,0 +1,203 @@
+#include "JitExpressionEngine.hpp"
+
+#include "ExpressionCache.hpp"
+#include "ExpressionJit.hpp"
+
+#include "Utils.hpp"
+
+#include <cctype>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+class NativeProgram : public ExpressionEngine::Program
+{
+public:
+    explicit NativeProgram(std::unique_ptr<ExpressionJit::NativeCode> code)
+        : m_code(std::move(code))
+    {
+    }
+
+    void Execute() override
+    {
+        m_code->Execute();
+    }
+
+private:
+    std::unique_ptr<ExpressionJit::NativeCode> m_code;
+};
+
+class JitContext : public ExpressionEngine::Context
+{
+public:
+    JitContext(std::unique_ptr<ExpressionEngine::Context> fallbackContext,
+               ExpressionEngine::GlobalRegisters* globalRegisters,
+               std::atomic<uint32_t>& nativePrograms,
+               std::atomic<uint32_t>& fallbackPrograms)
+        : m_fallbackContext(std::move(fallbackContext))
+        , m_globalRegisters(globalRegisters)
+        , m_nativePrograms(nativePrograms)
+        , m_fallbackPrograms(fallbackPrograms)
+    {
+    }
+
+    auto RegisterVariable(const std::string& name) -> PRJM_EVAL_F* override
+    {
+        return m_fallbackContext->RegisterVariable(name);
+    }
+
+    void ResetVariables() override
+    {
+        m_fallbackContext->ResetVariables();
+    }
+
+    auto Compile(const std::string& code) -> std::unique_ptr<ExpressionEngine::Program> override
+    {
+        m_cachedError = {};
+
+        auto& cache = ExpressionCache::Instance();
+        auto const key = ExpressionCache::NormalizeCode(code);
+        auto const codeHash = Utils::Fnv1aHash(code.data(), code.size());
+
+        ExpressionCache::Entry entry;
+        bool const cached = cache.Find(key, entry);
+
+        // Templates are only cached after projectm-eval accepted the code, and instantiating one
+        // registers the same variables, so neither projectm-eval nor the JIT parser have to run.
+        if (cached && entry.sharedCode)
+        {
+            // Only this engine stores shared code in the cache.
+            auto nativeProgram = Instantiate(static_cast<const ExpressionJit::Template&>(*entry.sharedCode));
+            if (nativeProgram)
+            {
+                return nativeProgram;
+            }
+        }
+
+        // The key ignores whitespace and comments, so the error location is only reused for the same text.
+        if (cached && !entry.error.empty() && entry.codeHash == codeHash)
+        {
+            m_cachedError = std::move(entry);
+            return {};
+        }
+
+        auto fallbackProgram = m_fallbackContext->Compile(code);
+        if (!fallbackProgram)
+        {
+            entry = {};
+            entry.error = m_fallbackContext->LastError(entry.errorLine, entry.errorColumn);
+            entry.codeHash = codeHash;
+            if (!entry.error.empty())
+            {
+                cache.Insert(key, std::move(entry));
+            }
+            return {};
+        }
+
+        if (!cached)
+        {
+            entry.sharedCode = ExpressionJit::CompileTemplate(code);
+            cache.Insert(key, entry);
+
+            if (entry.sharedCode)
+            {
+                auto nativeProgram = Instantiate(static_cast<const ExpressionJit::Template&>(*entry.sharedCode));
+                if (nativeProgram)
+                {
+                    return nativeProgram;
+                }
+            }
+        }
+
+        m_fallbackPrograms++;
+        return fallbackProgram;
+    }
+
+    auto LastError(int& line, int& column) const -> std::string override
+    {
+        if (!m_cachedError.error.empty())
+        {
+            line = m_cachedError.errorLine;
+            column = m_cachedError.errorColumn;
+            return m_cachedError.error;
+        }
+
+        return m_fallbackContext->LastError(line, column);
+    }
+
+private:
+    /**
+     * Binds the template to this context's variables and counts the native program.
+     */
+    auto Instantiate(const ExpressionJit::Template& compiledTemplate) -> std::unique_ptr<ExpressionEngine::Program>
+    {
+        auto nativeCode = compiledTemplate.Instantiate([this](const std::string& name) {
+            return ResolveVariable(name);
+        });
+
+        if (!nativeCode)
+        {
+            return {};
+        }
+
+        m_nativePrograms++;
+        return std::make_unique<NativeProgram>(std::move(nativeCode));
+    }
+
+    /**
+     * Maps reg00 to reg99 to the global registers, and everything else to context variables.
+     */
+    auto ResolveVariable(const std::string& name) -> PRJM_EVAL_F*
+    {
+        if (name.size() == 5 && name.compare(0, 3, "reg") == 0 &&
+            std::isdigit(static_cast<unsigned char>(name[3])) && std::isdigit(static_cast<unsigned char>(name[4])))
+        {
+            if (m_globalRegisters == nullptr)
+            {
+                return nullptr;
+            }
+            return &(*m_globalRegisters)[(name[3] - '0') * 10 + (name[4] - '0')];
+        }
+
+        return m_fallbackContext->RegisterVariable(name);
+    }
+
+    std::unique_ptr<ExpressionEngine::Context> m_fallbackContext; //!< projectm-eval context owning the variables.
+    ExpressionEngine::GlobalRegisters* m_globalRegisters{nullptr}; //!< The reg00 to reg99 storage.
+    std::atomic<uint32_t>& m_nativePrograms;                      //!< Engine-wide native program counter.
+    std::atomic<uint32_t>& m_fallbackPrograms;                    //!< Engine-wide fallback program counter.
+    ExpressionCache::Entry m_cachedError;                          //!< The cached error of the last compilation, if it failed due to a cache hit.
+};
+
+} // namespace
+
+auto JitExpressionEngine::Name() const -> std::string
+{
+    return "native-jit";
+}
+
+auto JitExpressionEngine::CreateMemoryBuffer() -> std::unique_ptr<MemoryBuffer>
+{
+    return m_fallbackEngine.CreateMemoryBuffer();
+}
+
+auto JitExpressionEngine::CreateContext(MemoryBuffer& globalMemory, GlobalRegisters* globalRegisters) -> std::unique_ptr<Context>
+{
+    return std::make_unique<JitContext>(m_fallbackEngine.CreateContext(globalMemory, globalRegisters),
+                                        globalRegisters, m_nativePrograms, m_fallbackPrograms);
+}
+
+auto JitExpressionEngine::NativePrograms() const -> uint32_t
+{
+    return m_nativePrograms;
+}
+
+auto JitExpressionEngine::FallbackPrograms() const -> uint32_t
+{
+    return m_fallbackPrograms;
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
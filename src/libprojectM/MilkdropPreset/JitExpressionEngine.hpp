@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ExpressionEngine.hpp"
+#include "ProjectMEvalEngine.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Expression engine compiling preset code to native machine code.
+ *
+ * New code is always compiled by projectm-eval first, so syntax errors and variable registration
+ * behave exactly like the default engine. If the code only uses constructs the JIT supports,
+ * the interpreted program is then replaced by native code. Otherwise, or if the platform isn't
+ * supported, the projectm-eval program is used as a fallback.
+ *
+ * Compile results are kept in the process-wide ExpressionCache. If the same code is compiled
+ * again, e.g. when a preset is loaded a second time, the cached native code is bound to the new
+ * context without running projectm-eval or the JIT parser. Templates are only cached after
+ * projectm-eval accepted the code, so this doesn't skip any error checks. Code with errors fails
+ * with the cached error if it is exactly the same text, so the error location matches.
+ */
+class JitExpressionEngine : public ExpressionEngine
+{
+public:
+    auto Name() const -> std::string override;
+
+    auto CreateMemoryBuffer() -> std::unique_ptr<MemoryBuffer> override;
+
+    auto CreateContext(MemoryBuffer& globalMemory, GlobalRegisters* globalRegisters) -> std::unique_ptr<Context> override;
+
+    /**
+     * @brief Returns the number of programs compiled to native code so far.
+     * @return The number of native programs.
+     */
+    auto NativePrograms() const -> uint32_t;
+
+    /**
+     * @brief Returns the number of programs which fell back to the interpreter so far.
+     * @return The number of interpreted programs.
+     */
+    auto FallbackPrograms() const -> uint32_t;
+
+private:
+    ProjectMEvalEngine m_fallbackEngine; //!< Interpreter used for parsing, variable storage and fallback.
+
+    std::atomic<uint32_t> m_nativePrograms{};   //!< Number of programs compiled to native code.
+    std::atomic<uint32_t> m_fallbackPrograms{}; //!< Number of programs using the interpreter.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -23,7 +23,11 @@
 
 #include "Factory.hpp"
 #include "MilkdropPresetExceptions.hpp"
+#include "PresetBundle.hpp"
 #include "PresetFileParser.hpp"
+#include "ThreadPool.hpp"
+
+#include <Renderer/StateCache.hpp>
 
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
@@ -32,10 +36,12 @@
 namespace libprojectM {
 namespace MilkdropPreset {
 
-MilkdropPreset::MilkdropPreset(const std::string& absoluteFilePath)
+MilkdropPreset::MilkdropPreset(const std::string& absoluteFilePath, ExpressionEngine& expressionEngine)
     : m_absoluteFilePath(absoluteFilePath)
-    , m_perFrameContext(m_state.globalMemory, &m_state.globalRegisters)
-    , m_perPixelContext(m_state.globalMemory, &m_state.globalRegisters)
+    , m_state(expressionEngine)
+    , m_perFrameContext(m_state.expressionEngine, *m_state.globalMemory, &m_state.globalRegisters)
+    , m_drawnPerFrameContext(m_state.expressionEngine, *m_state.globalMemory, &m_state.globalRegisters)
+    , m_perPixelContext(m_state.expressionEngine, *m_state.globalMemory, &m_state.globalRegisters)
     , m_motionVectors(m_state)
     , m_waveform(m_state)
     , m_darkenCenter(m_state)
@@ -44,9 +50,11 @@ MilkdropPreset::MilkdropPreset(const std::string& absoluteFilePath)
     Load(absoluteFilePath);
 }
 
-MilkdropPreset::MilkdropPreset(std::istream& presetData)
-    : m_perFrameContext(m_state.globalMemory, &m_state.globalRegisters)
-    , m_perPixelContext(m_state.globalMemory, &m_state.globalRegisters)
+MilkdropPreset::MilkdropPreset(std::istream& presetData, ExpressionEngine& expressionEngine)
+    : m_state(expressionEngine)
+    , m_perFrameContext(m_state.expressionEngine, *m_state.globalMemory, &m_state.globalRegisters)
+    , m_drawnPerFrameContext(m_state.expressionEngine, *m_state.globalMemory, &m_state.globalRegisters)
+    , m_perPixelContext(m_state.expressionEngine, *m_state.globalMemory, &m_state.globalRegisters)
     , m_motionVectors(m_state)
     , m_waveform(m_state)
     , m_darkenCenter(m_state)
@@ -59,6 +67,7 @@ void MilkdropPreset::Initialize(const Renderer::RenderContext& renderContext)
 {
     assert(renderContext.textureManager);
     m_state.renderContext = renderContext;
+    m_state.drawnFrame.renderContext = renderContext;
 
     // Initialize variables and code now we have a proper render state.
     CompileCodeAndRunInitExpressions();
@@ -71,15 +80,109 @@ void MilkdropPreset::Initialize(const Renderer::RenderContext& renderContext)
         m_state.mainTexture = m_framebuffer.GetColorAttachmentTexture(1, 0);
     }
 
-    m_perPixelMesh.CompileWarpShader(m_state);
+    // Start compiling the fast blur shader with the others if it's already enabled.
+    m_state.blurTexture.SetFastBlur(renderContext.fastBlur);
+
+    m_perPixelMesh.CompileWarpShader(m_state, m_perPixelContext);
     m_finalComposite.CompileCompositeShader(m_state);
+    m_shadersCompiled = false;
 }
 
-void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audioData, const Renderer::RenderContext& renderContext)
+auto MilkdropPreset::IsCompilationComplete() const -> bool
+{
+    return m_shadersCompiled ||
+           (m_state.IsCompilationComplete() &&
+            m_perPixelMesh.IsCompilationComplete() &&
+            m_motionVectors.IsCompilationComplete() &&
+            m_waveformBatch.IsCompilationComplete() &&
+            m_finalComposite.IsCompilationComplete());
+}
+
+void MilkdropPreset::FinishCompilation()
+{
+    if (m_shadersCompiled)
+    {
+        return;
+    }
+
+    m_state.FinishCompilation();
+    m_perPixelMesh.FinishCompilation(m_state);
+    m_motionVectors.FinishCompilation();
+    m_waveformBatch.FinishCompilation();
+    m_finalComposite.FinishCompilation(m_state);
+
+    m_shadersCompiled = true;
+}
+
+void MilkdropPreset::UpdateRenderContext(const Renderer::RenderContext& renderContext)
+{
+    m_state.renderContext = renderContext;
+    m_state.drawnFrame.renderContext = renderContext;
+}
+
+void MilkdropPreset::PrepareFrame(const libprojectM::Audio::FrameAudioData& audioData, const Renderer::RenderContext& renderContext)
 {
     m_state.audioData = audioData;
     m_state.renderContext = renderContext;
 
+    // First evaluate per-frame code
+    PerFrameUpdate();
+
+    // Then run the per-pixel code and calculate the warp mesh.
+    m_perPixelMesh.Prepare(m_state, m_perFrameContext, m_perPixelContext);
+
+    // Calculate the vertices of all shapes and waves.
+    EvaluateCustomShapesAndWaves();
+    for (auto& wave : m_customWaveforms)
+    {
+        wave->AddToBatch(m_waveformBatch);
+    }
+    m_waveform.AddToBatch(m_perFrameContext, m_waveformBatch);
+
+    m_framePrepared = true;
+}
+
+void MilkdropPreset::BeginFrame(const libprojectM::Audio::FrameAudioData& audioData, const Renderer::RenderContext& renderContext)
+{
+    // No-op if the caller already waited for the shaders.
+    FinishCompilation();
+
+    if (!m_framePrepared)
+    {
+        PrepareFrame(audioData, renderContext);
+    }
+    m_framePrepared = false;
+
+    // The frame may have been prepared in advance with a predicted context. Its results are
+    // drawn as-is, only the viewport and timing values of the actual context are used.
+    m_state.drawnFrame.audioData = m_state.audioData;
+    m_state.drawnFrame.renderContext = renderContext;
+    m_state.drawnFrame.frameQVariables = m_state.frameQVariables;
+    m_drawnPerFrameContext.CopyVariables(m_perFrameContext);
+
+    m_perPixelMesh.SwapPreparedFrame();
+    for (auto& shape : m_customShapes)
+    {
+        shape->SwapPreparedFrame();
+    }
+    m_waveformBatch.SwapPreparedFrame();
+
+    m_frameBegun = true;
+}
+
+void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audioData, const Renderer::RenderContext& renderContext)
+{
+    if (!m_frameBegun)
+    {
+        BeginFrame(audioData, renderContext);
+    }
+    m_frameBegun = false;
+
+    // Only the drawn frame's data is used from here on, PrepareFrame() may run concurrently.
+
+    m_state.blurTexture.SetBlurLevelLimit(static_cast<BlurTexture::BlurLevel>(renderContext.maxBlurLevel));
+    m_state.blurTexture.SetFastBlur(renderContext.fastBlur);
+
     // Update framebuffer and u/v texture size if needed
     if (m_framebuffer.SetSize(renderContext.viewportSizeX, renderContext.viewportSizeY))
     {
@@ -87,25 +190,20 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
         m_isFirstFrame = true;
     }
 
+    // All drawing into the preset framebuffer uses a flipped projection, so the previous frame
+    // can be sampled as "main" directly without copying it into the expected orientation first.
     m_state.mainTexture = m_framebuffer.GetColorAttachmentTexture(m_previousFrameBuffer, 0);
 
-    // First evaluate per-frame code
-    PerFrameUpdate();
-
-    glViewport(0, 0, renderContext.viewportSizeX, renderContext.viewportSizeY);
+    Renderer::StateCache::Current().Viewport(0, 0, renderContext.viewportSizeX, renderContext.viewportSizeY);
 
     m_framebuffer.Bind(m_previousFrameBuffer);
     // Motion vector field. Drawn to the previous frame texture before warping it.
     // Only do it after drawing one frame after init or resize.
     if (!m_isFirstFrame)
     {
-        m_motionVectors.Draw(m_perFrameContext, m_motionVectorUVMap->Texture());
+        m_motionVectors.Draw(m_drawnPerFrameContext, m_motionVectorUVMap->Texture());
     }
 
-    // y-flip the previous frame and assign the flipped texture as "main"
-    m_flipTexture.Draw(m_framebuffer.GetColorAttachmentTexture(m_previousFrameBuffer, 0), nullptr, true, false);
-    m_state.mainTexture = m_flipTexture.Texture();
-
     // We now draw to the current framebuffer.
     m_framebuffer.Bind(m_currentFrameBuffer);
 
@@ -113,7 +211,7 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
     m_framebuffer.SetAttachment(m_currentFrameBuffer, 1, m_motionVectorUVMap);
 
     // Draw previous frame image warped via per-pixel mesh and warp shader
-    m_perPixelMesh.Draw(m_state, m_perFrameContext, m_perPixelContext);
+    m_perPixelMesh.Draw(m_state, m_drawnPerFrameContext);
 
     // Remove the u/v texture from the framebuffer.
     m_framebuffer.RemoveColorAttachment(m_currentFrameBuffer, 1);
@@ -122,7 +220,8 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
     {
         const auto warpedImage = m_framebuffer.GetColorAttachmentTexture(m_currentFrameBuffer, 0);
         assert(warpedImage.get());
-        m_state.blurTexture.Update(*warpedImage, m_perFrameContext);
+        m_state.blurTexture.Update(*warpedImage, m_drawnPerFrameContext);
+        m_framebuffer.Bind(m_currentFrameBuffer);
     }
 
     // Draw audio-data-related stuff
@@ -130,39 +229,28 @@ void MilkdropPreset::RenderFrame(const libprojectM::Audio::FrameAudioData& audio
     {
         shape->Draw();
     }
-    for (auto& wave : m_customWaveforms)
-    {
-        wave->Draw(m_perFrameContext);
-    }
-    m_waveform.Draw(m_perFrameContext);
+    m_waveformBatch.Draw();
 
     // Done in DrawSprites() in Milkdrop
-    if (*m_perFrameContext.darken_center > 0)
+    if (*m_drawnPerFrameContext.darken_center > 0)
     {
         m_darkenCenter.Draw();
     }
-    m_border.Draw(m_perFrameContext);
+    m_border.Draw(m_drawnPerFrameContext);
 
     // Todo: Song title anim would go here
 
-    // y-flip the image for final compositing again
-    m_flipTexture.Draw(m_framebuffer.GetColorAttachmentTexture(m_currentFrameBuffer, 0), nullptr, true, false);
-    m_state.mainTexture = m_flipTexture.Texture();
+    // The composite draws the final image upright, reading the current frame as "main".
+    m_state.mainTexture = m_framebuffer.GetColorAttachmentTexture(m_currentFrameBuffer, 0);
 
     // We no longer need the previous frame image, use it to render the final composite.
     m_framebuffer.BindRead(m_currentFrameBuffer);
     m_framebuffer.BindDraw(m_previousFrameBuffer);
 
-    m_finalComposite.Draw(m_state, m_perFrameContext);
+    m_finalComposite.Draw(m_state, m_drawnPerFrameContext);
 
     // ToDo: Draw user sprites (can have evaluated code)
 
-    if (!m_finalComposite.HasCompositeShader())
-    {
-        // Flip texture again in "previous" framebuffer as old-school effects are still upside down.
-        m_flipTexture.Draw(m_framebuffer.GetColorAttachmentTexture(m_previousFrameBuffer, 0), m_framebuffer, m_previousFrameBuffer, true, false);
-    }
-
     // Swap framebuffer IDs for the next frame.
     std::swap(m_currentFrameBuffer, m_previousFrameBuffer);
 
@@ -180,23 +268,92 @@ void MilkdropPreset::DrawInitialImage(const std::shared_ptr<Renderer::Texture>&
     m_framebuffer.SetSize(renderContext.viewportSizeX, renderContext.viewportSizeY);
 
     // Render to previous framebuffer, as this is the image used to draw the next frame on.
-    m_flipTexture.Draw(image, m_framebuffer, m_previousFrameBuffer);
+    // The preset framebuffer stores images upside down, so flip the upright output image.
+    m_flipTexture.Draw(image, m_framebuffer, m_previousFrameBuffer, true, false);
 }
 
 void MilkdropPreset::PerFrameUpdate()
 {
     m_perFrameContext.LoadStateVariables(m_state);
-    m_perPixelContext.LoadStateReadOnlyVariables(m_state, m_perFrameContext);
-
     m_perFrameContext.ExecutePerFrameCode();
 
-    m_perPixelContext.LoadPerFrameQVariables(m_state, m_perFrameContext);
+    // Share the frame inputs and resulting Q variables with the per-pixel, shape and waveform code.
+    m_perFrameContext.UpdateSharedVariables(m_state);
+    m_perPixelContext.LoadStateReadOnlyVariables(m_state);
 
     // Clamp gamma and echo zoom values
     *m_perFrameContext.gamma = std::max(0.0, std::min(8.0, *m_perFrameContext.gamma));
     *m_perFrameContext.echo_zoom = std::max(0.001, std::min(1000.0, *m_perFrameContext.echo_zoom));
 }
 
+void MilkdropPreset::EvaluateCustomShapesAndWaves()
+{
+    constexpr size_t itemCount{CustomShapeCount + CustomWaveformCount};
+
+    auto evaluate = [this](size_t item) {
+        if (item < CustomShapeCount)
+        {
+            m_customShapes[item]->Evaluate();
+        }
+        else
+        {
+            m_customWaveforms[item - CustomShapeCount]->Evaluate(m_perFrameContext);
+        }
+    };
+
+    auto enabled = [this](size_t item) {
+        return item < CustomShapeCount
+                   ? m_customShapes[item]->Enabled()
+                   : m_customWaveforms[item - CustomShapeCount]->Enabled();
+    };
+
+    auto usesSharedState = [this](size_t item) {
+        return item < CustomShapeCount
+                   ? m_customShapes[item]->UsesSharedState()
+                   : m_customWaveforms[item - CustomShapeCount]->UsesSharedState();
+    };
+
+    // Items not touching global registers, gmegabuf or rand() only depend on their own context
+    // and can be evaluated in any order. All others run in a single task, keeping Milkdrop's order.
+    std::array<size_t, itemCount> independentItems{};
+    size_t independentItemCount{};
+    bool hasDependentItems{false};
+    for (size_t item = 0; item < itemCount; item++)
+    {
+        if (!enabled(item))
+        {
+            evaluate(item);
+        }
+        else if (usesSharedState(item))
+        {
+            hasDependentItems = true;
+        }
+        else
+        {
+            independentItems[independentItemCount++] = item;
+        }
+    }
+
+    // Task 0 runs the dependent items, the others one independent item each.
+    size_t const firstTask = hasDependentItems ? 0 : 1;
+    ThreadPool::Shared().Run(independentItemCount + 1 - firstTask, [&](size_t task) {
+        task += firstTask;
+        if (task > 0)
+        {
+            evaluate(independentItems[task - 1]);
+            return;
+        }
+
+        for (size_t item = 0; item < itemCount; item++)
+        {
+            if (enabled(item) && usesSharedState(item))
+            {
+                evaluate(item);
+            }
+        }
+    });
+}
+
 void MilkdropPreset::Load(const std::string& pathname)
 {
 #ifdef MILKDROP_PRESET_DEBUG
@@ -205,6 +362,12 @@ void MilkdropPreset::Load(const std::string& pathname)
 
     SetFilename(ParseFilename(pathname));
 
+    if (PresetBundle::IsBundleFileName(pathname))
+    {
+        LoadBundle(pathname);
+        return;
+    }
+
     PresetFileParser parser;
 
     if (!parser.Read(pathname))
@@ -224,6 +387,21 @@ void MilkdropPreset::Load(std::istream& stream)
     std::cerr << "[Preset] Loading preset from stream." << std::endl;
 #endif
 
+    if (PresetBundle::IsBundle(stream))
+    {
+        PresetBundle bundle;
+        if (!bundle.Read(stream))
+        {
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Preset] Could not read preset bundle data." << std::endl;
+#endif
+            throw MilkdropPresetLoadException("Could not read preset bundle data.");
+        }
+
+        InitializePreset(bundle);
+        return;
+    }
+
     PresetFileParser parser;
 
     if (!parser.Read(stream))
@@ -237,6 +415,46 @@ void MilkdropPreset::Load(std::istream& stream)
     InitializePreset(parser);
 }
 
+void MilkdropPreset::LoadBundle(const std::string& pathname)
+{
+    PresetBundle bundle;
+
+    if (!bundle.Read(pathname))
+    {
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Preset] Could not read preset bundle." << std::endl;
+#endif
+        throw MilkdropPresetLoadException("Could not read preset bundle \"" + pathname + "\"");
+    }
+
+    // If the preset was edited after building the bundle, load the source file instead.
+    auto const sourceFile = PresetBundle::SourceFileName(pathname);
+    if (!bundle.IsUpToDate(sourceFile))
+    {
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Preset] Preset bundle is outdated, loading \"" << sourceFile << "\" instead." << std::endl;
+#endif
+        Load(sourceFile);
+        return;
+    }
+
+    InitializePreset(bundle);
+}
+
+void MilkdropPreset::InitializePreset(const PresetBundle& bundle)
+{
+    PresetFileParser parser;
+    bundle.Apply(parser);
+
+    // The shaders are translated when compiled in Initialize(), which uses the bundled code if possible.
+    // The bundled sampler lists save searching the shader code for sampler references.
+    m_state.precompiledShaders = bundle.Shaders();
+    m_state.warpShaderSamplers = bundle.WarpShaderSamplers();
+    m_state.compositeShaderSamplers = bundle.CompositeShaderSamplers();
+
+    InitializePreset(parser);
+}
+
 void MilkdropPreset::InitializePreset(PresetFileParser& parsedFile)
 {
     // Create the offscreen rendering surfaces.
@@ -251,7 +469,8 @@ void MilkdropPreset::InitializePreset(PresetFileParser& parsedFile)
 
     // Register code context variables
     m_perFrameContext.RegisterBuiltinVariables();
-    m_perPixelContext.RegisterBuiltinVariables();
+    m_drawnPerFrameContext.RegisterBuiltinVariables();
+    m_perPixelContext.RegisterBuiltinVariables(m_state.frameVariables);
 
     // Custom waveforms:
     for (int i = 0; i < CustomWaveformCount; i++)
@@ -278,6 +497,7 @@ void MilkdropPreset::CompileCodeAndRunInitExpressions()
     // Per-frame init and code
     m_perFrameContext.LoadStateVariables(m_state);
     m_perFrameContext.EvaluateInitCode(m_state);
+    m_perFrameContext.UpdateSharedVariables(m_state);
     m_perFrameContext.CompilePerFrameCode(m_state.perFrameCode);
 
     // Per-vertex code
@@ -286,7 +506,7 @@ void MilkdropPreset::CompileCodeAndRunInitExpressions()
     for (int i = 0; i < CustomWaveformCount; i++)
     {
         auto& wave = m_customWaveforms[i];
-        wave->CompileCodeAndRunInitExpressions(m_perFrameContext);
+        wave->CompileCodeAndRunInitExpressions();
     }
 
     for (int i = 0; i < CustomShapeCount; i++)
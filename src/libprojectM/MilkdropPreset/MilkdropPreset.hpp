@@ -27,7 +27,6 @@
 #include "CustomShape.hpp"
 #include "CustomWaveform.hpp"
 #include "DarkenCenter.hpp"
-#include "Filters.hpp"
 #include "FinalComposite.hpp"
 #include "MotionVectors.hpp"
 #include "PerFrameContext.hpp"
@@ -35,6 +34,7 @@
 #include "PerPixelMesh.hpp"
 #include "Preset.hpp"
 #include "Waveform.hpp"
+#include "WaveformBatch.hpp"
 
 #include <Renderer/CopyTexture.hpp>
 #include <Renderer/Framebuffer.hpp>
@@ -48,6 +48,7 @@ namespace libprojectM {
 namespace MilkdropPreset {
 
 class Factory;
+class PresetBundle;
 class PresetFileParser;
 
 class MilkdropPreset : public ::libprojectM::Preset
@@ -58,15 +59,19 @@ public:
      * @brief LoadCode a MilkdropPreset by filename with input and output buffers specified.
      * @param factory The factory class that created this preset instance.
      * @param absoluteFilePath the absolute file path of a MilkdropPreset to load from the file system
+     * @param expressionEngine The engine used to compile and run the preset code.
      */
-    MilkdropPreset(const std::string& absoluteFilePath);
+    MilkdropPreset(const std::string& absoluteFilePath,
+                   ExpressionEngine& expressionEngine = ExpressionEngine::Default());
 
     /**
      * @brief LoadCode a MilkdropPreset from an input stream with input and output buffers specified.
      * @param presetData an already initialized input stream to read the MilkdropPreset file from
      * @param presetOutputs initialized and filled with data parsed from a MilkdropPreset
+     * @param expressionEngine The engine used to compile and run the preset code.
      */
-    MilkdropPreset(std::istream& presetData);
+    MilkdropPreset(std::istream& presetData,
+                   ExpressionEngine& expressionEngine = ExpressionEngine::Default());
 
     /**
      * @brief Initializes the preset with rendering-related data.
@@ -74,8 +79,32 @@ public:
      */
     void Initialize(const Renderer::RenderContext& renderContext) override;
 
+    auto IsCompilationComplete() const -> bool override;
+
+    void FinishCompilation() override;
+
+    void UpdateRenderContext(const Renderer::RenderContext& renderContext) override;
+
+    /**
+     * @brief Evaluates all preset code and calculates the warp mesh, shape and waveform vertices.
+     * @param audioData The frame audio data.
+     * @param renderContext The rendering context/information of the prepared frame.
+     */
+    void PrepareFrame(const libprojectM::Audio::FrameAudioData& audioData,
+                      const Renderer::RenderContext& renderContext) override;
+
+    /**
+     * @brief Hands the prepared per-frame values, mesh, shapes and waveforms over to RenderFrame().
+     * Calls PrepareFrame() first if the frame wasn't prepared yet.
+     * @param audioData The frame audio data.
+     * @param renderContext The current rendering context/information.
+     */
+    void BeginFrame(const libprojectM::Audio::FrameAudioData& audioData,
+                    const Renderer::RenderContext& renderContext) override;
+
     /**
      * @brief Renders the preset.
+     * Calls BeginFrame() first if it wasn't called for this frame.
      * @param audioData The frame audio data.
      * @param renderContext The current rendering context/information.
      */
@@ -89,10 +118,26 @@ public:
 private:
     void PerFrameUpdate();
 
+    /**
+     * @brief Runs the code of all custom shapes and waves and calculates their vertices.
+     *
+     * Shapes and waves not sharing state with other code are evaluated in parallel on the
+     * shared thread pool. The OpenGL draw calls are made in RenderFrame(), in the original order.
+     */
+    void EvaluateCustomShapesAndWaves();
+
     void Load(const std::string& pathname);
 
     void Load(std::istream& stream);
 
+    /**
+     * @brief Loads a precompiled preset bundle, or its source file if the bundle is outdated.
+     * @param pathname The bundle file name.
+     */
+    void LoadBundle(const std::string& pathname);
+
+    void InitializePreset(const PresetBundle& bundle);
+
     void InitializePreset(PresetFileParser& parsedFile);
 
     void CompileCodeAndRunInitExpressions();
@@ -112,15 +157,17 @@ private:
     int m_previousFrameBuffer{1};                                     //!< Framebuffer ID of the previous frame.
     std::shared_ptr<Renderer::TextureAttachment> m_motionVectorUVMap; //!< The UV map of the previous frame's warp mesh, used for motion vector reverse propagation.
 
-    PresetState m_state;               //!< Preset state container.
-    PerFrameContext m_perFrameContext; //!< Preset per-frame evaluation code context.
-    PerPixelContext m_perPixelContext; //!< Preset per-pixel/per-vertex evaluation code context.
+    PresetState m_state;                    //!< Preset state container.
+    PerFrameContext m_perFrameContext;      //!< Preset per-frame evaluation code context.
+    PerFrameContext m_drawnPerFrameContext; //!< Copy of the per-frame values of the frame being drawn.
+    PerPixelContext m_perPixelContext;      //!< Preset per-pixel/per-vertex evaluation code context.
 
     PerPixelMesh m_perPixelMesh; //!< The per-pixel/per-vertex mesh, responsible for most of the movement/warp effects in Milkdrop presets.
 
     MotionVectors m_motionVectors;                                                      //!< Motion vector grid.
     Waveform m_waveform;                                                                //!< Preset default waveform.
     std::array<std::unique_ptr<CustomWaveform>, CustomWaveformCount> m_customWaveforms; //!< Custom waveforms in this preset.
+    WaveformBatch m_waveformBatch;                                                      //!< Draws the default and custom waveforms with a single vertex upload.
     std::array<std::unique_ptr<CustomShape>, CustomShapeCount> m_customShapes;          //!< Custom shapes in this preset.
     DarkenCenter m_darkenCenter;                                                        //!< Center darkening effect.
     Border m_border;                                                                    //!< Inner/outer borders.
@@ -128,7 +175,10 @@ private:
 
     FinalComposite m_finalComposite; //!< Final composite shader or filters.
 
-    bool m_isFirstFrame{true}; //!< Controls drawing the motion vectors starting with the second frame.
+    bool m_isFirstFrame{true};     //!< Controls drawing the motion vectors starting with the second frame.
+    bool m_framePrepared{false};   //!< True if PrepareFrame() was called for the next frame to render.
+    bool m_frameBegun{false};      //!< True if BeginFrame() was called for the next frame to render.
+    bool m_shadersCompiled{false}; //!< True after FinishCompilation() checked all shaders.
 };
 
 } // namespace MilkdropPreset
@@ -13,9 +13,14 @@
 #include <glm/mat4x4.hpp>
 
 #include <algorithm>
-#include <regex>
+#include <cctype>
 #include <set>
 
+#ifdef MILKDROP_PRESET_DEBUG
+#include <chrono>
+#include <iostream>
+#endif
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -23,6 +28,144 @@ using libprojectM::MilkdropPreset::MilkdropStaticShaders;
 
 static auto floatRand = []() { return static_cast<float>(rand() % 7381) / 7380.0f; };
 
+#ifdef MILKDROP_PRESET_DEBUG
+/**
+ * @brief Prints the time a shader translation stage took.
+ * @param type The shader type.
+ * @param stage The stage name.
+ * @param startTime The time the stage started.
+ */
+static void LogStageTime(MilkdropShader::ShaderType type, const char* stage, std::chrono::steady_clock::time_point startTime)
+{
+    auto const duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
+    std::cerr << (type == MilkdropShader::ShaderType::WarpShader ? "[Warp Shader] " : "[Composite Shader] ")
+              << stage << " took " << duration.count() << " us." << std::endl;
+}
+#endif
+
+static auto IsWhitespace(char character) -> bool
+{
+    return character == ' ' || character == '\t' || character == '\n' || character == '\r' || character == '\f' || character == '\v';
+}
+
+/**
+ * @brief Returns the end of a sampler or texsize declaration starting at the given position.
+ *
+ * Matches "sampler", "sampler2D" or "sampler3D" followed by whitespace or a parenthesis, and
+ * "float4" followed by whitespace and "texsize_". Declarations end at the next line break.
+ *
+ * @param source The shader source.
+ * @param pos The position to check.
+ * @return The end of the declaration, or pos if there's no declaration at pos.
+ */
+static auto FindDeclarationEnd(const std::string& source, size_t pos) -> size_t
+{
+    size_t end = pos;
+    if (source.compare(pos, 7, "sampler") == 0)
+    {
+        end += 7;
+        if ((source.compare(end, 2, "2D") == 0 || source.compare(end, 2, "3D") == 0) &&
+            end + 2 < source.length() && (IsWhitespace(source.at(end + 2)) || source.at(end + 2) == '('))
+        {
+            end += 2;
+        }
+
+        if (end < source.length() && source.at(end) == '(')
+        {
+            end++;
+        }
+        else if (end < source.length() && IsWhitespace(source.at(end)))
+        {
+            while (end < source.length() && IsWhitespace(source.at(end)))
+            {
+                end++;
+            }
+        }
+        else
+        {
+            return pos;
+        }
+    }
+    else if (source.compare(pos, 6, "float4") == 0 && pos + 6 < source.length() && IsWhitespace(source.at(pos + 6)))
+    {
+        end += 6;
+        while (end < source.length() && IsWhitespace(source.at(end)))
+        {
+            end++;
+        }
+
+        if (source.compare(end, 8, "texsize_") != 0)
+        {
+            return pos;
+        }
+    }
+    else
+    {
+        return pos;
+    }
+
+    auto const lineEnd = source.find_first_of("\r\n", end);
+    return lineEnd != std::string::npos ? lineEnd : source.length();
+}
+
+/**
+ * @brief Appends the source without any sampler and texsize declarations to the output.
+ *
+ * The declarations are added again by the caller, depending on the textures actually used.
+ *
+ * @param source The shader source after running the HLSL preprocessor.
+ * @param output The string to append the remaining code to.
+ */
+static void RemoveSamplerAndTexSizeDeclarations(const std::string& source, std::string& output)
+{
+    size_t pos{0};
+    while (pos < source.length())
+    {
+        auto const next = source.find_first_of("sf", pos);
+        if (next == std::string::npos)
+        {
+            output.append(source, pos, std::string::npos);
+            break;
+        }
+        output.append(source, pos, next - pos);
+
+        auto const declarationEnd = FindDeclarationEnd(source, next);
+        if (declarationEnd != next)
+        {
+            pos = declarationEnd;
+        }
+        else
+        {
+            output.push_back(source.at(next));
+            pos = next + 1;
+        }
+    }
+}
+
+/**
+ * @brief Negates vertical screen-space derivatives in a generated warp shader.
+ *
+ * The warp mesh is rendered bottom-up into the preset framebuffer, so dFdy() has the opposite
+ * sign of the DirectX ddy() the preset shader was written for. GLSL follows the C preprocessor
+ * rules, so the macro doesn't expand recursively.
+ * @param glslSource The generated GLSL source, starting with the #version line.
+ */
+static void FlipVerticalDerivatives(std::string& glslSource)
+{
+    if (glslSource.find("dFdy") == std::string::npos)
+    {
+        return;
+    }
+
+    auto const versionLineEnd = glslSource.find('\n');
+    if (versionLineEnd == std::string::npos)
+    {
+        return;
+    }
+
+    glslSource.insert(versionLineEnd + 1, "#define dFdy(x) (-dFdy(x))\n");
+}
+
 MilkdropShader::MilkdropShader(ShaderType type)
     : m_type(type)
     , m_randValues({floatRand(), floatRand(), floatRand(), floatRand()})
@@ -48,79 +191,70 @@ MilkdropShader::MilkdropShader(ShaderType type)
     } while (index < sizeof(m_randTranslation) / sizeof(m_randTranslation[0]));
 }
 
-void MilkdropShader::LoadCode(const std::string& presetShaderCode)
+void MilkdropShader::LoadCode(const std::string& presetShaderCode, const std::set<std::string>& samplerNames)
 {
     m_fragmentShaderCode = presetShaderCode;
-    m_preprocessedCode = m_fragmentShaderCode;
 
-    GetReferencedSamplers(m_preprocessedCode);
-    PreprocessPresetShader(m_preprocessedCode);
+    if (samplerNames.empty())
+    {
+        GetReferencedSamplers(m_fragmentShaderCode, m_samplerNames, m_maxBlurLevelRequired);
+    }
+    else
+    {
+        // The blur samplers are part of the list, LoadTexturesAndCompileAsync() sets the blur level from them.
+        m_samplerNames = samplerNames;
+        m_maxBlurLevelRequired = BlurTexture::BlurLevel::None;
+    }
+
+#ifdef MILKDROP_PRESET_DEBUG
+    auto const startTime = std::chrono::steady_clock::now();
+#endif
+
+    m_preprocessedCode = PreprocessPresetShader(m_fragmentShaderCode, m_type);
+
+#ifdef MILKDROP_PRESET_DEBUG
+    LogStageTime(m_type, "Preprocessing", startTime);
+#endif
 }
 
 void MilkdropShader::LoadTexturesAndCompile(PresetState& presetState)
 {
-    std::locale loc;
+    LoadTexturesAndCompileAsync(presetState);
+    FinishCompilation(presetState);
+}
 
+void MilkdropShader::LoadTexturesAndCompileAsync(PresetState& presetState)
+{
     // Now request the textures and descriptors from the texture manager.
     for (const auto& name : m_samplerNames)
     {
-        std::string baseName = name;
-        if (name.length() > 3 && name.at(2) == '_')
-        {
-            baseName = name.substr(3);
-        }
-
-        std::string lowerCaseName = Utils::ToLower(baseName);
-
-        // The "main" and "blurX" textures are preset-specific and are not managed by TextureManager.
-        if (lowerCaseName == "main")
-        {
-            Renderer::TextureSamplerDescriptor desc(presetState.mainTexture.lock(),
-                                                    presetState.renderContext.textureManager->GetSampler(name),
-                                                    name,
-                                                    "main");
-            m_mainTextureDescriptors.push_back(std::move(desc));
-            continue;
-        }
-
-        // A few presets directly use the (undocumented) sampler name.
-        if (lowerCaseName == "blur1")
+        std::string unqualifiedName;
+        switch (GetSamplerType(name, unqualifiedName))
         {
-            UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur1);
-            continue;
-        }
-        if (lowerCaseName == "blur2")
-        {
-            UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur2);
-            continue;
-        }
-        if (lowerCaseName == "blur3")
-        {
-            UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur3);
-            continue;
-        }
-
-        // Random textures need special treatment.
-        if (lowerCaseName.length() >= 6 &&
-            lowerCaseName.substr(0, 4) == "rand" && std::isdigit(lowerCaseName.at(4), loc) && std::isdigit(lowerCaseName.at(5), loc))
-        {
-            // First look up the random texture index in the preset state so the texture matches between warp and composite shaders
-            int randomSlot = -1;
-            try
-            {
-                randomSlot = std::stoi(lowerCaseName.substr(4, 2));
-            }
-            catch (...) // Ignore any conversion errors.
-            {
+            // The "main" and "blurX" textures are preset-specific and are not managed by TextureManager.
+            case SamplerType::Main: {
+                Renderer::TextureSamplerDescriptor desc(presetState.mainTexture.lock(),
+                                                        presetState.renderContext.textureManager->GetSampler(name),
+                                                        name,
+                                                        "main");
+                m_mainTextureDescriptors.push_back(std::move(desc));
+                break;
             }
 
-            if (randomSlot >= 0 && randomSlot <= 15)
-            {
+            // A few presets directly use the (undocumented) sampler name.
+            case SamplerType::Blur:
+                UpdateMaxBlurLevel(static_cast<BlurTexture::BlurLevel>(unqualifiedName.back() - '0'), m_samplerNames, m_maxBlurLevelRequired);
+                break;
+
+            // Random textures need special treatment.
+            case SamplerType::Random: {
+                // First look up the random texture index in the preset state so the texture matches between warp and composite shaders
+                int const randomSlot = std::stoi(unqualifiedName.substr(4, 2));
                 if (presetState.randomTextureDescriptors.find(randomSlot) != presetState.randomTextureDescriptors.end())
                 {
                     // Use existing texture descriptor.
                     m_textureSamplerDescriptors.push_back(presetState.randomTextureDescriptors.at(randomSlot));
-                    continue;
+                    break;
                 }
 
                 // Slot empty, request a new random texture.
@@ -130,18 +264,43 @@ void MilkdropShader::LoadTexturesAndCompile(PresetState& presetState)
                 presetState.randomTextureDescriptors.insert({randomSlot, desc});
 
                 m_textureSamplerDescriptors.push_back(std::move(desc));
-                continue;
+                break;
             }
 
-            // Fall through if slot number is out of range and treat as normal texture.
+            case SamplerType::Texture:
+                m_textureSamplerDescriptors.push_back(presetState.renderContext.textureManager->GetTexture(name));
+                break;
         }
-
-        auto desc = presetState.renderContext.textureManager->GetTexture(name);
-        m_textureSamplerDescriptors.push_back(std::move(desc));
     }
 
     // Now that we have the textures, transpile the code.
     TranspileHLSLShader(presetState, m_preprocessedCode);
+}
+
+auto MilkdropShader::IsCompilationComplete() const -> bool
+{
+    return m_shader.IsCompilationComplete();
+}
+
+void MilkdropShader::FinishCompilation(PresetState& presetState)
+{
+    try
+    {
+        m_shader.FinishCompilation();
+    }
+    catch (Renderer::ShaderException&)
+    {
+        if (m_type != ShaderType::WarpShader || m_warpVertexShader.empty())
+        {
+            throw;
+        }
+
+        // Retry with the stock vertex shader.
+        m_warpVertexShader.clear();
+        m_shader.CompileProgram(MilkdropStaticShaders::Get()->GetPresetWarpVertexShader(), m_glslSource);
+    }
+
+    m_glslSource.clear();
 
     // Update blur texture level if shader was compiled successfully.
     presetState.blurTexture.SetRequiredBlurLevel(m_maxBlurLevelRequired);
@@ -150,11 +309,13 @@ void MilkdropShader::LoadTexturesAndCompile(PresetState& presetState)
 void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFrameContext& perFrameContext)
 {
     // These are the inputs: http://www.geisswerks.com/milkdrop/milkdrop_preset_authoring.html#3f6
+    auto const& renderContext = presetState.drawnFrame.renderContext;
+    auto const& audioData = presetState.drawnFrame.audioData;
 
-    auto floatTime = static_cast<float>(presetState.renderContext.time);
+    auto floatTime = static_cast<float>(renderContext.time);
     auto timeSincePresetStartWrapped = floatTime - static_cast<int>(floatTime / 10000.0) * 10000;
-    auto mipX = logf(static_cast<float>(presetState.renderContext.viewportSizeX)) / logf(2.0f);
-    auto mipY = logf(static_cast<float>(presetState.renderContext.viewportSizeY)) / logf(2.0f);
+    auto mipX = logf(static_cast<float>(renderContext.viewportSizeX)) / logf(2.0f);
+    auto mipY = logf(static_cast<float>(renderContext.viewportSizeY)) / logf(2.0f);
     auto mipAvg = 0.5f * (mipX + mipY);
 
     BlurTexture::Values blurMin;
@@ -163,7 +324,7 @@ void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFram
 
     m_shader.Bind();
 
-    m_shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
+    m_shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
 
     m_shader.SetUniformFloat4("rand_frame", {floatRand(),
                                              floatRand(),
@@ -174,26 +335,26 @@ void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFram
                                               m_randValues[2],
                                               m_randValues[3]});
 
-    m_shader.SetUniformFloat4("_c0", {presetState.renderContext.aspectX,
-                                      presetState.renderContext.aspectY,
-                                      1.0f / presetState.renderContext.aspectX,
-                                      1.0f / presetState.renderContext.aspectY});
+    m_shader.SetUniformFloat4("_c0", {renderContext.aspectX,
+                                      renderContext.aspectY,
+                                      1.0f / renderContext.aspectX,
+                                      1.0f / renderContext.aspectY});
     m_shader.SetUniformFloat4("_c1", {0.0,
                                       0.0,
                                       0.0,
                                       0.0});
     m_shader.SetUniformFloat4("_c2", {timeSincePresetStartWrapped,
-                                      presetState.renderContext.fps,
-                                      presetState.renderContext.frame,
-                                      presetState.renderContext.progress});
-    m_shader.SetUniformFloat4("_c3", {presetState.audioData.bass / 100,
-                                      presetState.audioData.mid / 100,
-                                      presetState.audioData.treb / 100,
-                                      presetState.audioData.vol / 100});
-    m_shader.SetUniformFloat4("_c4", {presetState.audioData.bassAtt / 100,
-                                      presetState.audioData.midAtt / 100,
-                                      presetState.audioData.trebAtt / 100,
-                                      presetState.audioData.volAtt / 100});
+                                      renderContext.fps,
+                                      renderContext.frame,
+                                      renderContext.progress});
+    m_shader.SetUniformFloat4("_c3", {audioData.bass / 100,
+                                      audioData.mid / 100,
+                                      audioData.treb / 100,
+                                      audioData.vol / 100});
+    m_shader.SetUniformFloat4("_c4", {audioData.bassAtt / 100,
+                                      audioData.midAtt / 100,
+                                      audioData.trebAtt / 100,
+                                      audioData.volAtt / 100});
     m_shader.SetUniformFloat4("_c5", {blurMax[0] - blurMin[0],
                                       blurMin[0],
                                       blurMax[1] - blurMin[1],
@@ -202,10 +363,10 @@ void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFram
                                       blurMin[2],
                                       blurMin[0],
                                       blurMax[0]});
-    m_shader.SetUniformFloat4("_c7", {presetState.renderContext.viewportSizeX,
-                                      presetState.renderContext.viewportSizeY,
-                                      1.0f / static_cast<float>(presetState.renderContext.viewportSizeX),
-                                      1.0f / static_cast<float>(presetState.renderContext.viewportSizeY)});
+    m_shader.SetUniformFloat4("_c7", {renderContext.viewportSizeX,
+                                      renderContext.viewportSizeY,
+                                      1.0f / static_cast<float>(renderContext.viewportSizeX),
+                                      1.0f / static_cast<float>(renderContext.viewportSizeY)});
 
     m_shader.SetUniformFloat4("_c8", {0.5f + 0.5f * cosf(floatTime * 0.329f + 1.2f),
                                       0.5f + 0.5f * cosf(floatTime * 1.293f + 3.9f),
@@ -297,10 +458,10 @@ void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFram
     {
         std::string varName = "_q";
         varName.push_back(static_cast<char>('a' + i / 4));
-        m_shader.SetUniformFloat4(varName.c_str(), {presetState.frameQVariables[i],
-                                                    presetState.frameQVariables[i + 1],
-                                                    presetState.frameQVariables[i + 2],
-                                                    presetState.frameQVariables[i + 3]});
+        m_shader.SetUniformFloat4(varName.c_str(), {presetState.drawnFrame.frameQVariables[i],
+                                                    presetState.drawnFrame.frameQVariables[i + 1],
+                                                    presetState.drawnFrame.frameQVariables[i + 2],
+                                                    presetState.drawnFrame.frameQVariables[i + 3]});
     }
 
     // Bind all texture and sampler descriptors. This includes the main and blur textures.
@@ -317,169 +478,181 @@ void MilkdropShader::LoadVariables(const PresetState& presetState, const PerFram
     {
         if (desc.Empty())
         {
-            desc.TryUpdate(*presetState.renderContext.textureManager);
+            desc.TryUpdate(*renderContext.textureManager);
         }
         desc.Bind(textureUnit, m_shader);
         textureUnit++;
     }
 }
 
+void MilkdropShader::SetWarpVertexShader(const std::string& vertexShaderSource)
+{
+    m_warpVertexShader = vertexShaderSource;
+}
+
+auto MilkdropShader::UsesWarpVertexShader() const -> bool
+{
+    return !m_warpVertexShader.empty();
+}
+
 auto MilkdropShader::Shader() -> Renderer::Shader&
 {
     return m_shader;
 }
 
-void MilkdropShader::PreprocessPresetShader(std::string& program)
+auto MilkdropShader::PreprocessPresetShader(const std::string& program, ShaderType type) -> std::string
 {
+    static const std::string samplerState{"sampler_state"};
+    static const std::string shaderBody{"shader_body"};
 
-    if (program.length() <= 0)
+    if (program.empty())
     {
         throw Renderer::ShaderException("Preset shader is declared, but empty.");
     }
 
-    size_t found;
+    std::string result;
+    auto const header = MilkdropStaticShaders::GetPresetShaderHeader();
+    result.reserve(header.size() + program.size() + 512);
 
-    // Find "sampler_state" overrides and remove them first, as they're not supported by GLSL.
-    // The logic isn't totally fool-proof, but should work in general.
-    found = program.find("sampler_state");
-    while (found != std::string::npos)
+    // First copy the generic "header" into the shader. Includes uniforms and some defines
+    // to unwrap the packed 4-element uniforms into single values.
+    result.append(header);
+
+    const char* entryPoint;
+    const char* bodyStart;
+    if (type == ShaderType::WarpShader)
+    {
+        result.append("#define rad _rad_ang.x\n"
+                      "#define ang _rad_ang.y\n"
+                      "#define uv _uv.xy\n"
+                      "#define uv_orig _uv.zw\n");
+        entryPoint = "void PS(float4 _vDiffuse : COLOR, float4 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR0, out float4 _mv_tex_coords : COLOR1)\n";
+        bodyStart = "{\nfloat3 ret = 0;\n_mv_tex_coords.xy = _uv.xy;\n";
+    }
+    else
     {
-        // Now go backwards and find the assignment
-        found = program.rfind('=', found);
-        auto startPos = found;
+        result.append("#define rad _rad_ang.x\n"
+                      "#define ang _rad_ang.y\n"
+                      "#define uv _uv.xy\n"
+                      "#define uv_orig _uv.xy\n"
+                      "#define hue_shader _vDiffuse.xyz\n");
+        entryPoint = "void PS(float4 _vDiffuse : COLOR, float2 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR)\n";
+        bodyStart = "{\nfloat3 ret = 0;\n";
+    }
+
+    size_t const codeStart = result.size();
+    bool removeSamplerStates{true};
+    bool entryPointFound{false};
+    bool openingBraceFound{false};
 
-        // Find closing brace and semicolon
-        found = program.find('}', found);
-        found = program.find(';', found);
+    // Positions of the next keywords. Only searched again once passed, so the code is scanned once.
+    size_t nextSamplerState{program.find(samplerState)};
+    size_t nextShaderBody{program.find(shaderBody)};
 
-        if (found != std::string::npos)
+    size_t pos{0};
+    while (pos < program.length())
+    {
+        if (nextSamplerState < pos)
         {
-            program.replace(startPos, found - startPos, "");
+            nextSamplerState = program.find(samplerState, pos);
         }
-        else
+        if (nextShaderBody < pos)
         {
-            // No closing brace and semicolon.
-            break;
+            nextShaderBody = program.find(shaderBody, pos);
         }
 
-        found = program.find("sampler_state");
-    }
-
-    // replace shader_body with entry point function
-    found = program.find("shader_body");
-    if (found != std::string::npos)
-    {
-        if (m_type == ShaderType::WarpShader)
+        // Copy everything up to the next text to rewrite.
+        auto next = std::string::npos;
+        if (removeSamplerStates)
         {
-            program.replace(int(found), 11, "void PS(float4 _vDiffuse : COLOR, float4 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR0, out float4 _mv_tex_coords : COLOR1)\n");
+            next = nextSamplerState;
         }
-        else
+        if (!entryPointFound)
         {
-            program.replace(int(found), 11, "void PS(float4 _vDiffuse : COLOR, float2 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR)\n");
+            next = std::min(next, nextShaderBody);
         }
-    }
-    else
-    {
-        throw Renderer::ShaderException("Preset shader is missing \"shader_body\" entry point.");
-    }
-
-    // replace the "{" immediately following shader_body with some variable declarations
-    found = program.find('{', found);
-    if (found != std::string::npos)
-    {
-        std::string progMain = "{\nfloat3 ret = 0;\n";
-        if (m_type == ShaderType::WarpShader)
+        else if (!openingBraceFound)
         {
-            progMain.append("_mv_tex_coords.xy = _uv.xy;\n");
+            next = std::min(next, program.find('{', pos));
         }
-        program.replace(int(found), 1, progMain);
-    }
-    else
-    {
-        throw Renderer::ShaderException("Preset shader has no opening braces.");
-    }
 
-    // replace "}" with return statement (this can probably be optimized for the GLSL conversion...)
-    found = program.rfind('}');
-    if (found != std::string::npos)
-    {
-        program.replace(int(found), 1, "_return_value = float4(ret.xyz, 1.0);\n"
-                                       "}\n");
-    }
-    else
-    {
-        throw Renderer::ShaderException("Preset shader has no closing brace.");
-    }
+        if (next == std::string::npos)
+        {
+            result.append(program, pos, std::string::npos);
+            break;
+        }
+        result.append(program, pos, next - pos);
+        pos = next;
 
-    // Find matching closing brace and cut off excess text after shader's main function
-    int bracesOpen = 1;
-    size_t pos = found + 1;
-    for (; pos < program.length() && bracesOpen > 0; ++pos)
-    {
-        switch (program.at(pos))
+        // Remove "sampler_state" overrides, as they're not supported by GLSL. Everything from
+        // the assignment up to the semicolon after the closing brace is cut.
+        // The logic isn't totally fool-proof, but should work in general.
+        if (removeSamplerStates && pos == nextSamplerState)
         {
-            case '/':
-                // Skip comments until EoL to prevent false counting
-                if (pos < program.length() - 1 && program.at(pos + 1) == '/')
-                {
-                    for (; pos < program.length(); ++pos)
-                    {
-                        if (program.at(pos) == '\n')
-                        {
-                            break;
-                        }
-                    }
-                }
-                continue;
+            auto const assignment = result.rfind('=');
+            auto const closingBrace = program.find('}', pos);
+            auto const semicolon = closingBrace != std::string::npos ? program.find(';', closingBrace) : std::string::npos;
 
-            case '{':
-                bracesOpen++;
+            if (assignment != std::string::npos && assignment >= codeStart && semicolon != std::string::npos)
+            {
+                result.resize(assignment);
+                pos = semicolon;
                 continue;
+            }
 
-            case '}':
-                bracesOpen--;
+            // No closing brace and semicolon, leave this and all following overrides alone.
+            removeSamplerStates = false;
+            continue;
         }
+
+        // Replace shader_body with the entry point function.
+        if (!entryPointFound && pos == nextShaderBody)
+        {
+            result.append(entryPoint);
+            pos += shaderBody.length();
+            entryPointFound = true;
+            continue;
+        }
+
+        // Replace the "{" immediately following shader_body with some variable declarations.
+        result.append(bodyStart);
+        pos++;
+        openingBraceFound = true;
     }
 
-    if (pos < program.length() - 1)
+    if (!entryPointFound)
     {
-        program.resize(pos);
+        throw Renderer::ShaderException("Preset shader is missing \"shader_body\" entry point.");
     }
 
-    std::string fullSource; //!< Full shader source before translation, includes all uniforms etc.
-
-    // First copy the generic "header" into the shader. Includes uniforms and some defines
-    // to unwrap the packed 4-element uniforms into single values.
-    fullSource.append(MilkdropStaticShaders::Get()->GetPresetShaderHeader());
-
-    if (m_type == ShaderType::WarpShader)
+    if (!openingBraceFound)
     {
-        fullSource.append("#define rad _rad_ang.x\n"
-                          "#define ang _rad_ang.y\n"
-                          "#define uv _uv.xy\n"
-                          "#define uv_orig _uv.zw\n");
+        throw Renderer::ShaderException("Preset shader has no opening braces.");
     }
-    else
+
+    // Replace the last "}" with the return statement and cut off excess text after the main function.
+    auto const closingBrace = result.rfind('}');
+    if (closingBrace == std::string::npos || closingBrace < codeStart)
     {
-        fullSource.append("#define rad _rad_ang.x\n"
-                          "#define ang _rad_ang.y\n"
-                          "#define uv _uv.xy\n"
-                          "#define uv_orig _uv.xy\n"
-                          "#define hue_shader _vDiffuse.xyz\n");
+        throw Renderer::ShaderException("Preset shader has no closing brace.");
     }
 
-    fullSource.append(program);
+    result.resize(closingBrace);
+    result.append("_return_value = float4(ret.xyz, 1.0);\n"
+                  "}\n");
 
-    program = fullSource;
+    return result;
 }
 
-void MilkdropShader::GetReferencedSamplers(const std::string& program)
+void MilkdropShader::GetReferencedSamplers(const std::string& program,
+                                           std::set<std::string>& samplerNames,
+                                           BlurTexture::BlurLevel& maxBlurLevel)
 {
     // Look up samplers referenced in the shader program
-    m_samplerNames.clear();
+    samplerNames.clear();
 
     // "main" should always be present.
-    m_samplerNames.insert("main");
+    samplerNames.insert("main");
 
     // Search for sampler usage
     auto found = program.find("sampler_", 0);
@@ -494,7 +667,7 @@ void MilkdropShader::GetReferencedSamplers(const std::string& program)
             // Skip "sampler_state", as it's a reserved word and not a sampler.
             if (sampler != "state")
             {
-                m_samplerNames.insert(sampler);
+                samplerNames.insert(sampler);
             }
         }
 
@@ -511,7 +684,7 @@ void MilkdropShader::GetReferencedSamplers(const std::string& program)
         if (end != std::string::npos)
         {
             std::string const sampler = program.substr(static_cast<int>(found), static_cast<int>(end - found));
-            m_samplerNames.insert(sampler);
+            samplerNames.insert(sampler);
         }
 
         found = program.find("texsize_", found);
@@ -519,139 +692,345 @@ void MilkdropShader::GetReferencedSamplers(const std::string& program)
 
     if (program.find("GetBlur3") != std::string::npos)
     {
-        UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur3);
+        UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur3, samplerNames, maxBlurLevel);
     }
     else if (program.find("GetBlur2") != std::string::npos)
     {
-        UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur2);
+        UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur2, samplerNames, maxBlurLevel);
     }
     else if (program.find("GetBlur1") != std::string::npos)
     {
-        UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur1);
+        UpdateMaxBlurLevel(BlurTexture::BlurLevel::Blur1, samplerNames, maxBlurLevel);
     }
     else
     {
-        m_maxBlurLevelRequired = BlurTexture::BlurLevel::None;
+        maxBlurLevel = BlurTexture::BlurLevel::None;
     }
 }
 
 void MilkdropShader::TranspileHLSLShader(const PresetState& presetState, std::string& program)
 {
-    std::string shaderTypeString = "composite";
+    // Collect unique samplers and texsize uniforms
+    std::set<std::string> samplerDeclarations;
+    std::set<std::string> texSizeDeclarations;
+    for (const auto& desc : m_mainTextureDescriptors)
+    {
+        samplerDeclarations.insert(desc.SamplerDeclaration());
+        texSizeDeclarations.insert(desc.TexSizeDeclaration());
+    }
+    for (const auto& desc : presetState.blurTexture.GetDescriptorsForBlurLevel(m_maxBlurLevelRequired))
+    {
+        samplerDeclarations.insert(desc.SamplerDeclaration());
+        // No texsize_blur1 etc.
+    }
+    for (const auto& desc : m_textureSamplerDescriptors)
+    {
+        samplerDeclarations.insert(desc.SamplerDeclaration());
+        texSizeDeclarations.insert(desc.TexSizeDeclaration());
+    }
+
+    auto const version = MilkdropStaticShaders::Get()->GetGlslGeneratorVersion();
+
+    // Presets loaded from a bundle contain the translated code, which can be used as long as
+    // the preset uses the same textures as when the bundle was built.
+    auto const precompiledShader = presetState.precompiledShaders.find(TranslationKey(program, samplerDeclarations, texSizeDeclarations, version));
+    if (precompiledShader != presetState.precompiledShaders.end())
+    {
+        m_glslSource = precompiledShader->second;
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << (m_type == ShaderType::WarpShader ? "[Warp Shader] " : "[Composite Shader] ")
+                  << "Using precompiled GLSL code." << std::endl;
+#endif
+    }
+    else
+    {
+        m_glslSource = TranslateShader(program, m_type, samplerDeclarations, texSizeDeclarations, version);
+    }
+
+    // Now we have GLSL source for the preset shader program (hopefully it's valid!)
+    // Compile the preset shader fragment shader with the standard vertex shader and cross our fingers.
+    // The result is checked in FinishCompilation(), so the driver can compile it in the background.
     if (m_type == ShaderType::WarpShader)
+    {
+        m_shader.CompileProgramAsync(m_warpVertexShader.empty() ? MilkdropStaticShaders::Get()->GetPresetWarpVertexShader() : m_warpVertexShader,
+                                     m_glslSource);
+    }
+    else
+    {
+        m_shader.CompileProgramAsync(MilkdropStaticShaders::Get()->GetPresetCompVertexShader(), m_glslSource);
+    }
+}
+
+auto MilkdropShader::TranslationKey(const std::string& preprocessedCode,
+                                    const std::set<std::string>& samplerDeclarations,
+                                    const std::set<std::string>& texSizeDeclarations,
+                                    M4::GLSLGenerator::Version version) -> uint64_t
+{
+    // Each string is hashed including its terminating null character, so they can't run into each other.
+    auto const versionNumber = static_cast<uint32_t>(version);
+    auto key = Utils::Fnv1aHash(&versionNumber, sizeof(versionNumber));
+    key = Utils::Fnv1aHash(preprocessedCode.c_str(), preprocessedCode.size() + 1, key);
+    for (const auto& declaration : samplerDeclarations)
+    {
+        key = Utils::Fnv1aHash(declaration.c_str(), declaration.size() + 1, key);
+    }
+    key = Utils::Fnv1aHash("", 1, key);
+    for (const auto& declaration : texSizeDeclarations)
+    {
+        key = Utils::Fnv1aHash(declaration.c_str(), declaration.size() + 1, key);
+    }
+
+    return key;
+}
+
+auto MilkdropShader::TranslateShader(const std::string& preprocessedCode, ShaderType type,
+                                     const std::set<std::string>& samplerDeclarations,
+                                     const std::set<std::string>& texSizeDeclarations,
+                                     M4::GLSLGenerator::Version version) -> std::string
+{
+    std::string shaderTypeString = "composite";
+    if (type == ShaderType::WarpShader)
     {
         shaderTypeString = "warp";
     }
 
-    M4::GLSLGenerator generator;
-    M4::Allocator allocator;
+    // The parse tree and its strings are allocated from an arena which is reused for all shaders
+    // translated on this thread. It must be reset before creating the tree.
+    thread_local M4::Allocator allocator;
+    allocator.Reset();
 
+    M4::GLSLGenerator generator;
     M4::HLSLTree tree(&allocator);
     M4::HLSLParser parser(&allocator, &tree);
 
+#ifdef MILKDROP_PRESET_DEBUG
+    auto startTime = std::chrono::steady_clock::now();
+#endif
+
     // Preprocess define macros
     std::string sourcePreprocessed;
-    if (!parser.ApplyPreprocessor("", program.c_str(), program.size(), sourcePreprocessed))
+    if (!parser.ApplyPreprocessor("", preprocessedCode.c_str(), preprocessedCode.size(), sourcePreprocessed))
     {
-        throw Renderer::ShaderException("Error translating HLSL " + shaderTypeString + " shader: Preprocessing failed.\nSource:\n" + program);
+        throw Renderer::ShaderException("Error translating HLSL " + shaderTypeString + " shader: Preprocessing failed.\nSource:\n" + preprocessedCode);
     }
 
-    // Remove previous shader declarations
+    // Insert the sampler and texsize declarations on top, in the same order as the original prepend
+    // loop, followed by the code without the previous shader and texsize declarations.
     // ToDo: Quite some presets declare a sampler_state{} struct to change the wrap mode.
-    //       The below code causes invalid syntax as it leaves part of the expression.
+    //       Removing the declaration causes invalid syntax as it leaves part of the expression.
     //       Leaving it in causes HLSLParser to add "sampler_XYZ = sampler2D( <unknown expression> );"
     //       in the main() function, which is also bad...
-    std::smatch matches;
-    while (std::regex_search(sourcePreprocessed, matches, std::regex("sampler(2D|3D|)(\\s+|\\().*")))
+    std::string source;
+    source.reserve(sourcePreprocessed.size() + (samplerDeclarations.size() + texSizeDeclarations.size()) * 64);
+    for (auto samplerDeclaration = samplerDeclarations.rbegin(); samplerDeclaration != samplerDeclarations.rend(); ++samplerDeclaration)
+    {
+        source.append(*samplerDeclaration);
+    }
+    for (auto texSizeDeclaration = texSizeDeclarations.rbegin(); texSizeDeclaration != texSizeDeclarations.rend(); ++texSizeDeclaration)
     {
-        sourcePreprocessed.replace(matches.position(), matches.length(), "");
+        source.append(*texSizeDeclaration);
     }
+    RemoveSamplerAndTexSizeDeclarations(sourcePreprocessed, source);
+
+#ifdef MILKDROP_PRESET_DEBUG
+    LogStageTime(type, "HLSL preprocessing", startTime);
+    startTime = std::chrono::steady_clock::now();
+#endif
 
-    // Remove previous texsize declarations
-    while (std::regex_search(sourcePreprocessed, matches, std::regex("float4\\s+texsize_.*")))
+    // Transpile from HLSL (aka preset shader aka DirectX shader) to GLSL (aka OpenGL shader lang)
+    // First, parse HLSL into a tree
+    if (!parser.Parse("", source.c_str(), source.size()))
     {
-        sourcePreprocessed.replace(matches.position(), matches.length(), "");
+        throw Renderer::ShaderException("Error translating HLSL " + shaderTypeString + " shader: HLSL parsing failed.\nSource:\n" + source);
     }
 
-    // Collect unique samplers and texsize uniforms
-    std::set<std::string> samplerDeclarations;
-    std::set<std::string> texSizeDeclarations;
-    for (const auto& desc : m_mainTextureDescriptors)
+#ifdef MILKDROP_PRESET_DEBUG
+    LogStageTime(type, "HLSL parsing", startTime);
+    M4::HLSLTreeStatistics statisticsBefore;
+    M4::GetTreeStatistics(&tree, statisticsBefore);
+    startTime = std::chrono::steady_clock::now();
+#endif
+
+    // The shader header declares all helper functions, uniforms and samplers, but most presets only
+    // use a few of them. Hide everything not reachable from the entry point, so the generator skips it,
+    // then fold constant expressions like "1.0/3" and remove identity operations in the remaining code.
+    M4::PruneTree(&tree, "PS");
+#ifndef MILKDROP_PRESET_DEBUG
+    M4::FoldConstants(&tree);
+#else
+    int const foldedExpressions = M4::FoldConstants(&tree);
+
+    LogStageTime(type, "HLSL optimization", startTime);
+    M4::HLSLTreeStatistics statisticsAfter;
+    M4::GetTreeStatistics(&tree, statisticsAfter);
+    std::cerr << "[Shader Translation] Functions: " << statisticsBefore.functions << " -> " << statisticsAfter.functions
+              << ", uniforms: " << statisticsBefore.uniforms << " -> " << statisticsAfter.uniforms
+              << ", samplers: " << statisticsBefore.samplers << " -> " << statisticsAfter.samplers
+              << ", expressions: " << statisticsBefore.expressions << " -> " << statisticsAfter.expressions
+              << " (" << foldedExpressions << " folded)." << std::endl;
+    startTime = std::chrono::steady_clock::now();
+#endif
+
+    // Then generate GLSL from the resulting parser tree.
+    // On GLES, the only 3D textures are the 8-bit noise volumes, and the render targets store at most
+    // 16-bit floats, so mediump is sufficient for both and can be much faster on mobile GPUs.
+    unsigned int generatorFlags = M4::GLSLGenerator::Flag_AlternateNanPropagation;
+    if (version == M4::GLSLGenerator::Version_300_ES)
     {
-        samplerDeclarations.insert(desc.SamplerDeclaration());
-        texSizeDeclarations.insert(desc.TexSizeDeclaration());
+        generatorFlags |= M4::GLSLGenerator::Flag_MediumPrecisionOutputs;
     }
-    for (const auto& desc : presetState.blurTexture.GetDescriptorsForBlurLevel(m_maxBlurLevelRequired))
+
+    if (!generator.Generate(&tree, M4::GLSLGenerator::Target_FragmentShader, version,
+                            "PS", M4::GLSLGenerator::Options(generatorFlags)))
     {
-        samplerDeclarations.insert(desc.SamplerDeclaration());
-        // No texsize_blur1 etc.
+        throw Renderer::ShaderException("Error translating HLSL " + shaderTypeString + " shader: GLSL generating failed.\nSource:\n" + source);
     }
-    for (const auto& desc : m_textureSamplerDescriptors)
+
+#ifdef MILKDROP_PRESET_DEBUG
+    LogStageTime(type, "GLSL generation", startTime);
+    std::cerr << "[Shader Translation] Arena usage: " << allocator.GetUsedSize() << " bytes." << std::endl;
+#endif
+
+    std::string glslSource = generator.GetResult();
+    if (type == ShaderType::WarpShader)
     {
-        samplerDeclarations.insert(desc.SamplerDeclaration());
-        texSizeDeclarations.insert(desc.TexSizeDeclaration());
+        FlipVerticalDerivatives(glslSource);
     }
 
-    // Now insert them on top.
-    for (const auto& texSizeDeclaration : texSizeDeclarations)
+    return glslSource;
+}
+
+auto MilkdropShader::PrecompileShader(const std::string& presetShaderCode, ShaderType type,
+                                      M4::GLSLGenerator::Version version, uint64_t& key) -> std::string
+{
+    std::set<std::string> samplerNames;
+    BlurTexture::BlurLevel maxBlurLevel{BlurTexture::BlurLevel::None};
+    GetReferencedSamplers(presetShaderCode, samplerNames, maxBlurLevel);
+
+    // Predict the declarations LoadTexturesAndCompileAsync() and TranspileHLSLShader() will add,
+    // assuming all textures are found.
+    std::set<std::string> samplerDeclarations;
+    std::set<std::string> texSizeDeclarations;
+    std::set<std::string> const samplerNamesCopy(samplerNames);
+    for (const auto& name : samplerNamesCopy)
     {
-        sourcePreprocessed.insert(0, texSizeDeclaration);
+        std::string unqualifiedName;
+        switch (GetSamplerType(name, unqualifiedName))
+        {
+            case SamplerType::Main:
+                samplerDeclarations.insert(Renderer::TextureSamplerDescriptor::SamplerDeclaration(name, false));
+                texSizeDeclarations.insert(Renderer::TextureSamplerDescriptor::TexSizeDeclaration("main"));
+                break;
+
+            case SamplerType::Blur:
+                UpdateMaxBlurLevel(static_cast<BlurTexture::BlurLevel>(unqualifiedName.back() - '0'), samplerNames, maxBlurLevel);
+                break;
+
+            case SamplerType::Random:
+                // Random textures are selected on load.
+                return {};
+
+            case SamplerType::Texture:
+                // Only the noise volumes are 3D textures, all others are 2D textures or the 2D placeholder.
+                samplerDeclarations.insert(Renderer::TextureSamplerDescriptor::SamplerDeclaration(
+                    name, unqualifiedName == "noisevol_lq" || unqualifiedName == "noisevol_hq"));
+                texSizeDeclarations.insert(Renderer::TextureSamplerDescriptor::TexSizeDeclaration(unqualifiedName));
+                break;
+        }
     }
-    for (const auto& samplerDeclaration : samplerDeclarations)
+
+    // The blur textures are named like their samplers and have no texsize uniform.
+    for (int level = 1; level <= static_cast<int>(maxBlurLevel); level++)
     {
-        sourcePreprocessed.insert(0, samplerDeclaration);
+        samplerDeclarations.insert(Renderer::TextureSamplerDescriptor::SamplerDeclaration("blur" + std::to_string(level), false));
     }
 
-    // Transpile from HLSL (aka preset shader aka DirectX shader) to GLSL (aka OpenGL shader lang)
-    // First, parse HLSL into a tree
-    if (!parser.Parse("", sourcePreprocessed.c_str(), sourcePreprocessed.size()))
+    auto const preprocessedCode = PreprocessPresetShader(presetShaderCode, type);
+    key = TranslationKey(preprocessedCode, samplerDeclarations, texSizeDeclarations, version);
+
+    return TranslateShader(preprocessedCode, type, samplerDeclarations, texSizeDeclarations, version);
+}
+
+auto MilkdropShader::ReferencedSamplerNames(const std::string& presetShaderCode) -> std::set<std::string>
+{
+    std::set<std::string> samplerNames;
+    BlurTexture::BlurLevel maxBlurLevel{BlurTexture::BlurLevel::None};
+    GetReferencedSamplers(presetShaderCode, samplerNames, maxBlurLevel);
+
+    return samplerNames;
+}
+
+auto MilkdropShader::TextureNames(const std::set<std::string>& samplerNames) -> std::set<std::string>
+{
+    std::set<std::string> textureNames;
+    for (const auto& name : samplerNames)
     {
-        throw Renderer::ShaderException("Error translating HLSL " + shaderTypeString + " shader: HLSL parsing failed.\nSource:\n" + sourcePreprocessed);
+        std::string unqualifiedName;
+        if (GetSamplerType(name, unqualifiedName) == SamplerType::Texture)
+        {
+            textureNames.insert(unqualifiedName);
+        }
     }
 
-    // Then generate GLSL from the resulting parser tree
-    if (!generator.Generate(&tree, M4::GLSLGenerator::Target_FragmentShader,
-                            MilkdropStaticShaders::Get()->GetGlslGeneratorVersion(),
-                            "PS", M4::GLSLGenerator::Options(M4::GLSLGenerator::Flag_AlternateNanPropagation)))
+    return textureNames;
+}
+
+auto MilkdropShader::GetSamplerType(const std::string& samplerName, std::string& unqualifiedName) -> SamplerType
+{
+    unqualifiedName = samplerName;
+    if (samplerName.length() > 3 && samplerName.at(2) == '_')
     {
-        throw Renderer::ShaderException("Error translating HLSL " + shaderTypeString + " shader: GLSL generating failed.\nSource:\n" + sourcePreprocessed);
+        unqualifiedName = samplerName.substr(3);
     }
 
-    // Now we have GLSL source for the preset shader program (hopefully it's valid!)
-    // Compile the preset shader fragment shader with the standard vertex shader and cross our fingers.
-    if (m_type == ShaderType::WarpShader)
+    std::string const lowerCaseName = Utils::ToLower(unqualifiedName);
+
+    if (lowerCaseName == "main")
     {
-        m_shader.CompileProgram(MilkdropStaticShaders::Get()->GetPresetWarpVertexShader(), generator.GetResult());
+        return SamplerType::Main;
     }
-    else
+
+    if (lowerCaseName == "blur1" || lowerCaseName == "blur2" || lowerCaseName == "blur3")
     {
-        m_shader.CompileProgram(MilkdropStaticShaders::Get()->GetPresetCompVertexShader(), generator.GetResult());
+        return SamplerType::Blur;
     }
+
+    // Random texture slots range from rand00 to rand15. Others are treated as normal textures.
+    if (lowerCaseName.length() >= 6 && lowerCaseName.compare(0, 4, "rand") == 0 &&
+        std::isdigit(static_cast<unsigned char>(lowerCaseName.at(4))) && std::isdigit(static_cast<unsigned char>(lowerCaseName.at(5))) &&
+        std::stoi(lowerCaseName.substr(4, 2)) <= 15)
+    {
+        return SamplerType::Random;
+    }
+
+    return SamplerType::Texture;
 }
 
-void MilkdropShader::UpdateMaxBlurLevel(BlurTexture::BlurLevel requestedLevel)
+void MilkdropShader::UpdateMaxBlurLevel(BlurTexture::BlurLevel requestedLevel,
+                                        std::set<std::string>& samplerNames,
+                                        BlurTexture::BlurLevel& maxBlurLevel)
 {
-    if (m_maxBlurLevelRequired >= requestedLevel)
+    if (maxBlurLevel >= requestedLevel)
     {
         return;
     }
 
-    m_maxBlurLevelRequired = requestedLevel;
+    maxBlurLevel = requestedLevel;
 
-    if (m_maxBlurLevelRequired == BlurTexture::BlurLevel::Blur3)
+    if (maxBlurLevel == BlurTexture::BlurLevel::Blur3)
     {
-        m_samplerNames.insert("blur1");
-        m_samplerNames.insert("blur2");
-        m_samplerNames.insert("blur3");
+        samplerNames.insert("blur1");
+        samplerNames.insert("blur2");
+        samplerNames.insert("blur3");
     }
-    else if (m_maxBlurLevelRequired == BlurTexture::BlurLevel::Blur2)
+    else if (maxBlurLevel == BlurTexture::BlurLevel::Blur2)
     {
-        m_samplerNames.insert("blur1");
-        m_samplerNames.insert("blur2");
+        samplerNames.insert("blur1");
+        samplerNames.insert("blur2");
     }
     else
     {
-        m_samplerNames.insert("blur1");
+        samplerNames.insert("blur1");
     }
 }
 
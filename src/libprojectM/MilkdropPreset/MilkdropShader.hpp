@@ -12,7 +12,10 @@
 #include <Renderer/Shader.hpp>
 #include <Renderer/TextureManager.hpp>
 
+#include <GLSLGenerator.h>
+
 #include <array>
+#include <cstdint>
 #include <set>
 
 namespace libprojectM {
@@ -43,8 +46,10 @@ public:
     /**
      * @brief Translates and compiles the shader code.
      * @param presetShaderCode The preset shader code.
+     * @param samplerNames The samplers referenced in the code as returned by ReferencedSamplerNames(),
+     *                     e.g. from a preset bundle. If empty, the code is searched for sampler references.
      */
-    void LoadCode(const std::string& presetShaderCode);
+    void LoadCode(const std::string& presetShaderCode, const std::set<std::string>& samplerNames = {});
 
     /**
      * @brief Loads the required texture references into the shader.
@@ -53,6 +58,46 @@ public:
      */
     void LoadTexturesAndCompile(PresetState& presetState);
 
+    /**
+     * @brief Loads the required texture references and starts compiling the shader in the background.
+     * FinishCompilation() must be called before the shader is used.
+     * @param presetState The preset state to pull the values and textures from.
+     */
+    void LoadTexturesAndCompileAsync(PresetState& presetState);
+
+    /**
+     * @brief Returns whether the program can be finished without waiting for the driver.
+     * @return true if the background compilation is done.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the compilation started by LoadTexturesAndCompileAsync().
+     *
+     * If a warp shader fails to compile with the custom vertex shader, it's compiled again with
+     * the stock vertex shader.
+     *
+     * @throws Renderer::ShaderException Thrown if the shader failed to compile.
+     * @param presetState The preset state to update the required blur level in.
+     */
+    void FinishCompilation(PresetState& presetState);
+
+    /**
+     * @brief Sets a custom vertex shader to use with a warp shader instead of the stock one.
+     *
+     * Must be called before LoadTexturesAndCompile(). If the program fails to compile with the
+     * custom vertex shader, the stock warp vertex shader is used instead.
+     *
+     * @param vertexShaderSource The vertex shader source, or an empty string to use the stock shader.
+     */
+    void SetWarpVertexShader(const std::string& vertexShaderSource);
+
+    /**
+     * @brief Returns whether the compiled program uses the custom warp vertex shader.
+     * @return true if the shader was compiled with the vertex shader passed to SetWarpVertexShader().
+     */
+    auto UsesWarpVertexShader() const -> bool;
+
     /**
      * @brief Loads all required shader variables into the uniforms.
      * Binds the underlying shader program.
@@ -67,22 +112,121 @@ public:
      */
     auto Shader() -> Renderer::Shader&;
 
-private:
     /**
      * @brief Prepares the shader code to be translated into GLSL.
-     * @param program The program code to work on.
+     *
+     * Removes sampler_state overrides, turns shader_body into the PS() entry point, cuts off any
+     * text after the main function and prepends the uniform header. The code is rewritten in a
+     * single pass into one buffer.
+     *
+     * @throws Renderer::ShaderException Thrown if the code has no shader_body or braces.
+     * @param program The preset shader code.
+     * @param type The shader type, selects the entry point signature.
+     * @return The code ready to be passed to the HLSL parser.
+     */
+    static auto PreprocessPresetShader(const std::string& program, ShaderType type) -> std::string;
+
+    /**
+     * @brief Returns the key of a translated shader in PresetState::precompiledShaders.
+     *
+     * The GLSL code only depends on the preprocessed shader code, the sampler and texsize
+     * declarations added for the textures used by the preset and the GLSL version, so a
+     * translation can be reused if all of them match.
+     *
+     * @param preprocessedCode The code returned by PreprocessPresetShader().
+     * @param samplerDeclarations The sampler uniform declarations.
+     * @param texSizeDeclarations The texsize uniform declarations.
+     * @param version The GLSL version the code is generated for.
+     * @return The translation key.
+     */
+    static auto TranslationKey(const std::string& preprocessedCode,
+                               const std::set<std::string>& samplerDeclarations,
+                               const std::set<std::string>& texSizeDeclarations,
+                               M4::GLSLGenerator::Version version) -> uint64_t;
+
+    /**
+     * @brief Translates the preprocessed shader code into a GLSL fragment shader.
+     * @throws Renderer::ShaderException Thrown if the code couldn't be translated.
+     * @param preprocessedCode The code returned by PreprocessPresetShader().
+     * @param type The shader type.
+     * @param samplerDeclarations The sampler uniform declarations to add to the code.
+     * @param texSizeDeclarations The texsize uniform declarations to add to the code.
+     * @param version The GLSL version to generate.
+     * @return The GLSL fragment shader source.
+     */
+    static auto TranslateShader(const std::string& preprocessedCode, ShaderType type,
+                                const std::set<std::string>& samplerDeclarations,
+                                const std::set<std::string>& texSizeDeclarations,
+                                M4::GLSLGenerator::Version version) -> std::string;
+
+    /**
+     * @brief Translates a preset shader without an OpenGL context, e.g. to store it in a preset bundle.
+     *
+     * The sampler and texsize declarations are predicted from the referenced sampler names,
+     * assuming that each texture is either built in or loaded from a file. If the prediction
+     * doesn't match the textures found on load, the key differs and the shader is translated
+     * again. Shaders using random textures can't be precompiled, as the texture is selected on load.
+     *
+     * @throws Renderer::ShaderException Thrown if the code couldn't be translated.
+     * @param presetShaderCode The preset shader code.
+     * @param type The shader type.
+     * @param version The GLSL version to generate.
+     * @param[out] key The translation key of the returned code.
+     * @return The GLSL fragment shader source, or an empty string if the shader can't be precompiled.
+     */
+    static auto PrecompileShader(const std::string& presetShaderCode, ShaderType type,
+                                 M4::GLSLGenerator::Version version, uint64_t& key) -> std::string;
+
+    /**
+     * @brief Returns the samplers referenced in a preset shader, including the main and blur samplers.
+     * @param presetShaderCode The preset shader code.
+     * @return The sampler names, without the "sampler_" prefix.
+     */
+    static auto ReferencedSamplerNames(const std::string& presetShaderCode) -> std::set<std::string>;
+
+    /**
+     * @brief Returns the textures requested from the texture manager by name for the given samplers.
+     * @param samplerNames The sampler names returned by ReferencedSamplerNames().
+     * @return The unqualified names of all referenced textures, except the main, blur and random textures.
+     */
+    static auto TextureNames(const std::set<std::string>& samplerNames) -> std::set<std::string>;
+
+private:
+    /**
+     * @brief Types of textures a preset shader sampler can be bound to.
+     */
+    enum class SamplerType
+    {
+        Main,   //!< The main texture, i.e. the previous frame.
+        Blur,   //!< One of the blur textures.
+        Random, //!< A random texture, selected when the shader is loaded.
+        Texture //!< A built-in texture or a texture loaded from a file.
+    };
+
+    /**
+     * @brief Determines which texture a sampler referenced in a preset shader is bound to.
+     * @param samplerName The sampler name without the "sampler_" prefix, e.g. "fw_noise_lq".
+     * @param[out] unqualifiedName The name without the wrap and filter mode prefix, e.g. "noise_lq".
+     * @return The type of the texture.
      */
-    void PreprocessPresetShader(std::string& program);
+    static auto GetSamplerType(const std::string& samplerName, std::string& unqualifiedName) -> SamplerType;
 
     /**
-     * @brief Searches for sampler references in the program and stores them in m_samplerNames.
+     * @brief Searches for sampler references in the program.
      * @param program The program code to work on.
+     * @param samplerNames Receives the referenced sampler names.
+     * @param maxBlurLevel Receives the blur level required by the GetBlurX() functions.
      */
-    void GetReferencedSamplers(const std::string& program);
+    static void GetReferencedSamplers(const std::string& program,
+                                      std::set<std::string>& samplerNames,
+                                      BlurTexture::BlurLevel& maxBlurLevel);
 
     /**
-     * @brief Translates the HLSL shader into GLSL.
-     * @param presetState The preset state to pull the blur textures from.
+     * @brief Translates the HLSL shader into GLSL and starts compiling it.
+     *
+     * Uses the matching translation from PresetState::precompiledShaders if there is one.
+     *
+     * @param presetState The preset state to pull the blur textures and precompiled shaders from.
      * @param program The shader to transpile.
      */
     void TranspileHLSLShader(const PresetState& presetState, std::string& program);
@@ -91,12 +235,18 @@ private:
      * @brief Updates the requested blur level if higher than before.
      * Also adds the required samplers.
      * @param requestedLevel The requested blur level.
+     * @param samplerNames The sampler names to add the blur samplers to.
+     * @param maxBlurLevel The blur level to update.
      */
-    void UpdateMaxBlurLevel(BlurTexture::BlurLevel requestedLevel);
+    static void UpdateMaxBlurLevel(BlurTexture::BlurLevel requestedLevel,
+                                   std::set<std::string>& samplerNames,
+                                   BlurTexture::BlurLevel& maxBlurLevel);
 
     ShaderType m_type{ShaderType::WarpShader}; //!< Type of this shader.
     std::string m_fragmentShaderCode;          //!< The original preset fragment shader code.
     std::string m_preprocessedCode;            //!< The preprocessed preset shader code.
+    std::string m_warpVertexShader;            //!< Custom warp vertex shader source, empty to use the stock shader.
+    std::string m_glslSource;                  //!< Translated GLSL fragment shader, kept until the program is compiled.
 
     std::set<std::string> m_samplerNames;                                        //!< All sampler names referenced in the shader code.
     std::vector<Renderer::TextureSamplerDescriptor> m_mainTextureDescriptors;              //!< Descriptors for all main texture references.
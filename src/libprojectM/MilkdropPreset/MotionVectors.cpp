@@ -2,6 +2,7 @@
 
 #include "MilkdropStaticShaders.hpp"
 
+#include <Renderer/StateCache.hpp>
 #include <Renderer/TextureManager.hpp>
 
 namespace libprojectM {
@@ -12,19 +13,27 @@ MotionVectors::MotionVectors(PresetState& presetState)
     , m_presetState(presetState)
 {
     auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
-    m_motionVectorShader.CompileProgram(staticShaders->GetPresetMotionVectorsVertexShader(),
-                                        staticShaders->GetUntexturedDrawFragmentShader());
+    m_motionVectorShader.CompileProgramAsync(staticShaders->GetPresetMotionVectorsVertexShader(),
+                                             staticShaders->GetUntexturedDrawFragmentShader());
     RenderItem::Init();
 }
 
 void MotionVectors::InitVertexAttrib()
 {
-    glEnableVertexAttribArray(0);
+    // All line end points are calculated in the vertex shader from the vertex and instance IDs.
+    glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
+    glDisableVertexAttribArray(2);
+}
+
+auto MotionVectors::IsCompilationComplete() const -> bool
+{
+    return m_motionVectorShader.IsCompilationComplete();
+}
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(MotionVectorVertex), reinterpret_cast<void*>(offsetof(MotionVectorVertex, x)));
-    glVertexAttribIPointer(2, 1, GL_INT, sizeof(MotionVectorVertex), reinterpret_cast<void*>(offsetof(MotionVectorVertex, index)));
+void MotionVectors::FinishCompilation()
+{
+    m_motionVectorShader.FinishCompilation();
 }
 
 void MotionVectors::Draw(const PerFrameContext& presetPerFrameContext, std::shared_ptr<Renderer::Texture> motionTexture)
@@ -80,19 +89,19 @@ void MotionVectors::Draw(const PerFrameContext& presetPerFrameContext, std::shar
 
     // Tweaked this a bit to ensure lines are always at least a bit more than 1px long.
     // Line smoothing makes some of them disappear otherwise.
-    float const inverseWidth = 1.25f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
-    float const inverseHeight = 1.25f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
+    float const inverseWidth = 1.25f / static_cast<float>(m_presetState.drawnFrame.renderContext.viewportSizeX);
+    float const inverseHeight = 1.25f / static_cast<float>(m_presetState.drawnFrame.renderContext.viewportSizeY);
     float const minimumLength = sqrtf(inverseWidth * inverseWidth + inverseHeight * inverseHeight);
 
-    std::vector<MotionVectorVertex> lineVertices(static_cast<std::size_t>(countX + 1) * 2); // countX + 1 lines for each grid row, 2 vertices each.
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.SetBlend(true);
+    stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     m_motionVectorShader.Bind();
-    m_motionVectorShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-    m_motionVectorShader.SetUniformFloat("length_multiplier", static_cast<float>(*presetPerFrameContext.mv_l));
-    m_motionVectorShader.SetUniformFloat("minimum_length", minimumLength);
+    m_motionVectorShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
+    m_motionVectorShader.SetUniformInt2("grid_size", {countX, countY});
+    m_motionVectorShader.SetUniformFloat4("grid_offset", {divertX, divertY, divertX2, divertY2});
+    m_motionVectorShader.SetUniformFloat2("trail_length", {static_cast<float>(*presetPerFrameContext.mv_l), minimumLength});
 
     m_motionVectorShader.SetUniformInt("warp_coordinates", 0);
 
@@ -104,62 +113,19 @@ void MotionVectors::Draw(const PerFrameContext& presetPerFrameContext, std::shar
                      static_cast<float>(*presetPerFrameContext.mv_b),
                      static_cast<float>(*presetPerFrameContext.mv_a));
 
-    glBindVertexArray(m_vaoID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+    stateCache.BindVertexArray(m_vaoID);
 
     glLineWidth(1);
 #ifndef USE_GLES
     glEnable(GL_LINE_SMOOTH);
 #endif
 
-    for (int y = 0; y < countY; y++)
-    {
-        float const posY = (static_cast<float>(y) + 0.25f) / (static_cast<float>(countY) + divertY + 0.25f - 1.0f) - divertY2;
-
-        if (posY > 0.0001f && posY < 0.9999f)
-        {
-            int vertex = 0;
-            for (int x = 0; x < countX; x++)
-            {
-                float const posX = (static_cast<float>(x) + 0.25f) / (static_cast<float>(countX) + divertX + 0.25f - 1.0f) + divertX2;
-
-                if (posX > 0.0001f && posX < 0.9999f)
-                {
-                    lineVertices[vertex].x = posX;
-                    lineVertices[vertex].y = posY;
-                    lineVertices[vertex].index = vertex;
-
-                    lineVertices[vertex + 1] = lineVertices[vertex];
-                    lineVertices[vertex + 1].index++;
-
-                    vertex += 2;
-                }
-            }
-
-            // Draw a row of lines.
-            if (m_lastVertexCount >= vertex)
-            {
-                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(MotionVectorVertex) * vertex, lineVertices.data());
-            }
-            else
-            {
-                glBufferData(GL_ARRAY_BUFFER, sizeof(MotionVectorVertex) * vertex, lineVertices.data(), GL_STREAM_DRAW);
-                m_lastVertexCount = vertex;
-            }
-            glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(vertex));
-        }
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // One line per grid cell, drawn row by row in the same order as Milkdrop.
+    glDrawArraysInstanced(GL_LINES, 0, 2, countX * countY);
 
 #ifndef USE_GLES
     glDisable(GL_LINE_SMOOTH);
 #endif
-
-    Renderer::Shader::Unbind();
-
-    glDisable(GL_BLEND);
 }
 
 } // namespace MilkdropPreset
@@ -28,6 +28,18 @@ public:
 
     void InitVertexAttrib();
 
+    /**
+     * @brief Returns whether the shaders compiled in the constructor are ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the shaders compiled in the constructor.
+     * @throws Renderer::ShaderException Thrown if a shader failed to compile.
+     */
+    void FinishCompilation();
+
     /**
      * Renders the motion vectors.
      * @param presetPerFrameContext The per-frame context variables.
@@ -36,19 +48,10 @@ public:
     void Draw(const PerFrameContext& presetPerFrameContext, std::shared_ptr<Renderer::Texture> motionTexture);
 
 private:
-    struct MotionVectorVertex
-    {
-        float x{};
-        float y{};
-        int32_t index{};
-    };
-
     PresetState& m_presetState; //!< The global preset state.
 
-    Renderer::Shader m_motionVectorShader; //!< The motion vector shader, calculates the trace positions in the GPU.
+    Renderer::Shader m_motionVectorShader; //!< The motion vector shader, calculates the grid and trace positions in the GPU.
     std::shared_ptr<Renderer::Sampler> m_sampler{std::make_shared<Renderer::Sampler>(GL_CLAMP_TO_EDGE, GL_LINEAR)}; //!< The texture sampler.
-
-    int m_lastVertexCount{}; //!< Number of vertices drawn in the previous draw call.
 };
 
 } // namespace MilkdropPreset
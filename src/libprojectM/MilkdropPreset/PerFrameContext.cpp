@@ -2,37 +2,28 @@
 
 #include "MilkdropPresetExceptions.hpp"
 
+#include <cassert>
+
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
 #endif
 
 #define REG_VAR(var) \
-    var = projectm_eval_context_register_variable(perFrameCodeContext, #var);
+    var = perFrameCodeContext->RegisterVariable(#var); \
+    builtinVariables.push_back(var);
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
-PerFrameContext::PerFrameContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
-    : perFrameCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
-{
-}
-
-PerFrameContext::~PerFrameContext()
+PerFrameContext::PerFrameContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters)
+    : perFrameCodeContext(engine.CreateContext(gmegabuf, globalRegisters))
 {
-    if (perFrameCodeHandle != nullptr)
-    {
-        projectm_eval_code_destroy(perFrameCodeHandle);
-    }
-
-    if (perFrameCodeContext != nullptr)
-    {
-        projectm_eval_context_destroy(perFrameCodeContext);
-    }
 }
 
 void PerFrameContext::RegisterBuiltinVariables()
 {
-    projectm_eval_context_reset_variables(perFrameCodeContext);
+    perFrameCodeContext->ResetVariables();
+    builtinVariables.clear();
 
     REG_VAR(zoom);
     REG_VAR(zoomexp);
@@ -65,7 +56,8 @@ void PerFrameContext::RegisterBuiltinVariables()
     for (int q = 0; q < QVarCount; q++)
     {
         std::string qvar = "q" + std::to_string(q + 1);
-        q_vars[q] = projectm_eval_context_register_variable(perFrameCodeContext, qvar.c_str());
+        q_vars[q] = perFrameCodeContext->RegisterVariable(qvar);
+        builtinVariables.push_back(q_vars[q]);
     }
     REG_VAR(progress);
     REG_VAR(ob_size);
@@ -116,6 +108,16 @@ void PerFrameContext::RegisterBuiltinVariables()
     REG_VAR(blur1_edge_darken);
 }
 
+void PerFrameContext::CopyVariables(const PerFrameContext& other)
+{
+    assert(builtinVariables.size() == other.builtinVariables.size());
+
+    for (size_t index = 0; index < builtinVariables.size(); index++)
+    {
+        *builtinVariables[index] = *other.builtinVariables[index];
+    }
+}
+
 void PerFrameContext::EvaluateInitCode(PresetState& state)
 {
     if (state.perFrameInitCode.empty())
@@ -123,14 +125,14 @@ void PerFrameContext::EvaluateInitCode(PresetState& state)
         return;
     }
 
-    auto* initCode = projectm_eval_code_compile(perFrameCodeContext, state.perFrameInitCode.c_str());
+    auto initCode = perFrameCodeContext->Compile(state.perFrameInitCode);
     if (initCode == nullptr)
     {
 #ifdef MILKDROP_PRESET_DEBUG
         int line;
         int col;
-        auto* errmsg = projectm_eval_get_error(perFrameCodeContext, &line, &col);
-        if (errmsg)
+        auto const errmsg = perFrameCodeContext->LastError(line, col);
+        if (!errmsg.empty())
         {
             std::cerr << "[Preset] Could not compile per-frame INIT code: " << errmsg << "(L" << line << " C" << col << ")" << std::endl;
         }
@@ -138,8 +140,7 @@ void PerFrameContext::EvaluateInitCode(PresetState& state)
         throw MilkdropCompileException("Could not compile per-frame init code");
     }
 
-    projectm_eval_code_execute(initCode);
-    projectm_eval_code_destroy(initCode);
+    initCode->Execute();
 
     for (int q = 0; q < QVarCount; q++)
     {
@@ -238,14 +239,14 @@ void PerFrameContext::CompilePerFrameCode(const std::string& perFrameCode)
         return;
     }
 
-    perFrameCodeHandle = projectm_eval_code_compile(perFrameCodeContext, perFrameCode.c_str());
+    perFrameCodeHandle = perFrameCodeContext->Compile(perFrameCode);
     if (perFrameCodeHandle == nullptr)
     {
 #ifdef MILKDROP_PRESET_DEBUG
         int line;
         int col;
-        auto* errmsg = projectm_eval_get_error(perFrameCodeContext, &line, &col);
-        if (errmsg)
+        auto const errmsg = perFrameCodeContext->LastError(line, col);
+        if (!errmsg.empty())
         {
             std::cerr << "[Preset] Could not compile per-frame code: " << errmsg << "(L" << line << " C" << col << ")" << std::endl;
         }
@@ -258,8 +259,18 @@ void PerFrameContext::ExecutePerFrameCode()
 {
     if (perFrameCodeHandle != nullptr)
     {
-        projectm_eval_code_execute(perFrameCodeHandle);
+        perFrameCodeHandle->Execute();
+    }
+}
+
+void PerFrameContext::UpdateSharedVariables(PresetState& state)
+{
+    for (int q = 0; q < QVarCount; q++)
+    {
+        state.frameQVariables[q] = *q_vars[q];
     }
+
+    state.frameVariables.Update(state);
 }
 
 } // namespace MilkdropPreset
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "ExpressionEngine.hpp"
 #include "PresetState.hpp"
 
-#include <projectm-eval.h>
+#include <memory>
+#include <vector>
 
 namespace libprojectM {
 namespace MilkdropPreset {
@@ -23,20 +25,23 @@ class PerFrameContext
 public:
     /**
      * @brief Constructor. Creates a new per-frame state object.
+     * @param engine The expression engine used to compile and run the code.
      * @param gmegabuf The global memory buffer to use in the code context.
      * @param globalRegisters The global variables to use in the code context.
      */
-    PerFrameContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100]);
+    PerFrameContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters);
 
     /**
-     * @brief Destructor.
+     * @brief Registers the state variables in the expression evaluator context.
      */
-    ~PerFrameContext();
+    void RegisterBuiltinVariables();
 
     /**
-     * @brief Registers the state variables in the expression evaluator context.
+     * @brief Copies the values of all built-in variables from another context.
+     * Both contexts must have registered their built-in variables.
+     * @param other The context to copy the values from.
      */
-    void RegisterBuiltinVariables();
+    void CopyVariables(const PerFrameContext& other);
 
     /**
      * @brief Loads the current state values into the expression evaluator variables.
@@ -63,8 +68,16 @@ public:
      */
     void ExecutePerFrameCode();
 
-    projectm_eval_context* perFrameCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
-    projectm_eval_code* perFrameCodeHandle{nullptr}; //!< The compiled per-frame code handle.
+    /**
+     * @brief Stores the Q variables in the preset state and updates the shared frame variables.
+     * Must be called after the per-frame code has been executed.
+     * @param state The preset state container.
+     */
+    void UpdateSharedVariables(PresetState& state);
+
+    std::unique_ptr<ExpressionEngine::Context> perFrameCodeContext; //!< The code runtime context, holds memory buffers and variables.
+    std::unique_ptr<ExpressionEngine::Program> perFrameCodeHandle;  //!< The compiled per-frame code handle.
+    std::vector<PRJM_EVAL_F*> builtinVariables;                     //!< All registered built-in variables, in registration order.
 
     PRJM_EVAL_F* zoom{};
     PRJM_EVAL_F* zoomexp{};
@@ -0,0 +1,321 @@
+#include "PerPixelCodeAnalysis.hpp"
+
+#include "ExpressionParser.hpp"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+using VariableSet = std::set<std::string>;
+
+/**
+ * Variables set to a different value for each vertex.
+ */
+const VariableSet perVertexInputs{"x", "y", "rad", "ang"};
+
+/**
+ * Variables reset to the per-frame value before each vertex is calculated.
+ */
+const VariableSet perVertexOutputs{"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+/**
+ * Functions without side effects, which always return the same value for the same arguments.
+ */
+const VariableSet pureFunctions{
+    "abs", "above", "acos", "asin", "atan", "atan2", "band", "below", "bnot", "bor", "ceil", "cos", "equal",
+    "exec2", "exec3", "exp", "floor", "if", "int", "invsqrt", "log", "log10", "max", "min", "pow", "sigmoid",
+    "sign", "sin", "sqr", "sqrt", "tan"};
+
+/**
+ * Functions and buffers accessing state shared with the code of other shapes and waves. rand()
+ * is included as the random number sequence depends on the execution order.
+ */
+const VariableSet sharedStateNames{"gmegabuf", "gmem", "rand"};
+
+struct Statement
+{
+    size_t begin{};             //!< Start offset of the statement in the code.
+    size_t end{};               //!< End offset of the statement, excluding the semicolon.
+    VariableSet reads;          //!< Variables read by the statement.
+    VariableSet writes;         //!< Variables assigned by the statement.
+    bool impure{false};         //!< True if the statement calls a function with side effects.
+    bool indirectWrites{false}; //!< True if the statement uses assign(), which writes to a variable passed as argument.
+    bool sharedState{false};    //!< True if the statement uses global registers, gmegabuf or rand().
+};
+
+auto Intersects(const VariableSet& first, const VariableSet& second) -> bool
+{
+    return std::any_of(first.begin(), first.end(), [&second](const std::string& name) {
+        return second.find(name) != second.end();
+    });
+}
+
+/**
+ * Collects the variables, function calls and memory accesses of a statement's syntax tree.
+ * The target of a plain assignment is only written, not read.
+ */
+void CollectUsage(const ExpressionParser::Node& node, Statement& statement, bool plainAssignmentTarget = false)
+{
+    using Type = ExpressionParser::Node::Type;
+
+    if (sharedStateNames.find(node.name) != sharedStateNames.end())
+    {
+        statement.sharedState = true;
+    }
+
+    switch (node.type)
+    {
+        case Type::Variable:
+            if (ExpressionParser::IsGlobalRegister(node.name))
+            {
+                // Global registers are shared with other code and could be used as a per-vertex counter.
+                statement.impure = true;
+                statement.sharedState = true;
+            }
+            if (!plainAssignmentTarget)
+            {
+                statement.reads.insert(node.name);
+            }
+            return;
+
+        case Type::Assign: {
+            auto const& target = *node.arguments[0];
+            CollectUsage(target, statement, node.operation == "=");
+            if (target.type == Type::Variable)
+            {
+                statement.writes.insert(target.name);
+            }
+            break;
+        }
+
+        case Type::Call:
+            if (pureFunctions.find(node.name) == pureFunctions.end())
+            {
+                statement.impure = true;
+            }
+            if (node.name == "assign")
+            {
+                statement.indirectWrites = true;
+            }
+            break;
+
+        case Type::Index:
+            // Memory access, like megabuf().
+            statement.impure = true;
+            break;
+
+        default:
+            break;
+    }
+
+    for (size_t index = (node.type == Type::Assign ? 1 : 0); index < node.arguments.size(); index++)
+    {
+        CollectUsage(*node.arguments[index], statement);
+    }
+}
+
+/**
+ * Splits the code into top-level statements and collects the variables each statement uses.
+ */
+auto ParseStatements(const std::string& code, std::vector<Statement>& statements) -> bool
+{
+    auto const program = ExpressionParser::Parse(code);
+    if (!program)
+    {
+        return false;
+    }
+
+    for (auto const& node : program->arguments)
+    {
+        Statement statement;
+        statement.begin = node->begin;
+        statement.end = node->end;
+        CollectUsage(*node, statement);
+        statements.push_back(std::move(statement));
+    }
+
+    return true;
+}
+
+} // namespace
+
+auto PerPixelCodeAnalysis::Analyze(const std::string& perPixelCode) -> PerPixelCodeAnalysis
+{
+    PerPixelCodeAnalysis result;
+    result.perVertexCode = perPixelCode;
+
+    std::vector<Statement> statements;
+    if (!ParseStatements(perPixelCode, statements))
+    {
+        return result;
+    }
+
+    result.analyzed = true;
+    result.statementCount = statements.size();
+
+    // Can't tell which variables are changed by assign(), so keep everything per-vertex.
+    if (std::any_of(statements.begin(), statements.end(), [](const Statement& statement) { return statement.indirectWrites; }))
+    {
+        return result;
+    }
+
+    // Variables which can have a different value for each vertex.
+    VariableSet varying = perVertexInputs;
+
+    // Variables read before they're first assigned carry their value over from the previous vertex.
+    std::map<std::string, size_t> firstWrite;
+    for (size_t index = statements.size(); index > 0; index--)
+    {
+        for (auto const& name : statements[index - 1].writes)
+        {
+            firstWrite[name] = index - 1;
+        }
+    }
+
+    for (size_t index = 0; index < statements.size(); index++)
+    {
+        for (auto const& name : statements[index].reads)
+        {
+            auto const write = firstWrite.find(name);
+            if (write != firstWrite.end() && write->second >= index &&
+                perVertexOutputs.find(name) == perVertexOutputs.end())
+            {
+                varying.insert(name);
+            }
+        }
+    }
+
+    // Propagate until no more statements become position-dependent.
+    std::vector<bool> positionDependent(statements.size());
+    bool changed{true};
+    while (changed)
+    {
+        changed = false;
+        for (size_t index = 0; index < statements.size(); index++)
+        {
+            auto const& statement = statements[index];
+            if (!positionDependent[index] &&
+                (statement.impure || Intersects(statement.reads, varying) || Intersects(statement.writes, varying)))
+            {
+                positionDependent[index] = true;
+                changed = true;
+            }
+
+            if (positionDependent[index])
+            {
+                for (auto const& name : statement.writes)
+                {
+                    changed |= varying.insert(name).second;
+                }
+            }
+        }
+    }
+
+    // Only hoist statements if moving them in front of the per-vertex statements keeps the results intact.
+    std::vector<bool> hoisted(statements.size());
+    for (size_t index = 0; index < statements.size(); index++)
+    {
+        hoisted[index] = !positionDependent[index];
+    }
+
+    changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        VariableSet perVertexWrites;
+        for (size_t index = 0; index < statements.size(); index++)
+        {
+            if (!hoisted[index])
+            {
+                perVertexWrites.insert(statements[index].writes.begin(), statements[index].writes.end());
+            }
+        }
+
+        VariableSet earlierPerVertexReads;
+        for (size_t index = 0; index < statements.size(); index++)
+        {
+            auto const& statement = statements[index];
+            if (!hoisted[index])
+            {
+                earlierPerVertexReads.insert(statement.reads.begin(), statement.reads.end());
+                continue;
+            }
+
+            if (Intersects(statement.writes, perVertexWrites) ||
+                Intersects(statement.writes, earlierPerVertexReads) ||
+                Intersects(statement.reads, perVertexWrites))
+            {
+                hoisted[index] = false;
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    std::string perFrameCode;
+    std::string perVertexCode;
+    for (size_t index = 0; index < statements.size(); index++)
+    {
+        auto& target = hoisted[index] ? perFrameCode : perVertexCode;
+
+        // Statements may end with a line comment, so the separator goes on the next line.
+        target.append(perPixelCode, statements[index].begin, statements[index].end - statements[index].begin);
+        target.append("\n;\n");
+
+        if (hoisted[index])
+        {
+            result.hoistedStatementCount++;
+        }
+    }
+
+    if (result.hoistedStatementCount > 0)
+    {
+        result.perFrameCode = std::move(perFrameCode);
+        result.perVertexCode = std::move(perVertexCode);
+    }
+
+    return result;
+}
+
+auto PerPixelCodeAnalysis::AssignedVariables(const std::string& code, std::set<std::string>& variables) -> bool
+{
+    std::vector<Statement> statements;
+    if (!ParseStatements(code, statements))
+    {
+        return false;
+    }
+
+    for (auto const& statement : statements)
+    {
+        if (statement.indirectWrites)
+        {
+            return false;
+        }
+        variables.insert(statement.writes.begin(), statement.writes.end());
+    }
+
+    return true;
+}
+
+auto PerPixelCodeAnalysis::UsesSharedState(const std::string& code) -> bool
+{
+    std::vector<Statement> statements;
+    if (!ParseStatements(code, statements))
+    {
+        return true;
+    }
+
+    return std::any_of(statements.begin(), statements.end(), [](const Statement& statement) {
+        return statement.sharedState;
+    });
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <string>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Splits per-pixel code into a position-independent and a per-vertex part.
+ *
+ * Many presets compute values in their per-pixel code which don't depend on the vertex position,
+ * e.g. "zoom = zoom + 0.1 * bass". Running these statements for each mesh vertex gives the
+ * same result every time, so they can be run once per frame instead.
+ *
+ * The analysis works on the top-level statements of the code. A statement is position-independent
+ * if it doesn't read or write any variable that differs between vertices (x, y, rad, ang and
+ * everything derived from them or carried over from the previous vertex), and doesn't call any
+ * function with side effects, like rand() or memory buffer access. Such a statement is hoisted
+ * only if moving it in front of all per-vertex statements doesn't change the result.
+ */
+class PerPixelCodeAnalysis
+{
+public:
+    /**
+     * @brief Analyzes the given per-pixel code.
+     * @param perPixelCode The per-pixel code.
+     * @return The analysis result.
+     */
+    static auto Analyze(const std::string& perPixelCode) -> PerPixelCodeAnalysis;
+
+    /**
+     * @brief Collects all variables the given code assigns a value to.
+     *
+     * Works for any preset code, not only per-pixel code. Used to find out which variables
+     * need to be reset before the code is run again.
+     *
+     * @param code The code to scan.
+     * @param[out] variables Receives the lower-case names of all assigned variables.
+     * @return false if the code couldn't be analyzed, or may also change variables indirectly.
+     */
+    static auto AssignedVariables(const std::string& code, std::set<std::string>& variables) -> bool;
+
+    /**
+     * @brief Checks if the given code accesses state shared with other code contexts of the preset.
+     *
+     * Shared state are the reg00 to reg99 global registers, the gmegabuf global memory and
+     * the random number generator. Code not using any of these only depends on its own context
+     * and the read-only frame values, and can run concurrently with other such code.
+     *
+     * @param code The code to scan.
+     * @return true if the code uses shared state or couldn't be analyzed.
+     */
+    static auto UsesSharedState(const std::string& code) -> bool;
+
+    std::string perFrameCode;  //!< Position-independent statements, to be run once per frame before the per-vertex code. Empty if nothing can be hoisted.
+    std::string perVertexCode; //!< Statements which must be run for each vertex. Contains the original code if nothing can be hoisted.
+
+    bool analyzed{false};           //!< False if the code couldn't be analyzed, e.g. due to syntax errors.
+    size_t statementCount{};        //!< Number of top-level statements in the code.
+    size_t hoistedStatementCount{}; //!< Number of statements moved to the per-frame part.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
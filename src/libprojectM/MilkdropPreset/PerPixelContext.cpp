@@ -7,32 +7,35 @@
 #endif
 
 #define REG_VAR(var) \
-    var = projectm_eval_context_register_variable(perPixelCodeContext, #var);
+    var = perPixelCodeContext->RegisterVariable(#var);
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
-PerPixelContext::PerPixelContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
-    : perPixelCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
+PerPixelContext::PerPixelContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters)
+    : perPixelCodeContext(engine.CreateContext(gmegabuf, globalRegisters))
 {
 }
 
-PerPixelContext::~PerPixelContext()
+void PerPixelContext::RegisterBuiltinVariables(const SharedVariableBlock& sharedVariableBlock)
 {
-    if (perPixelCodeHandle != nullptr)
-    {
-        projectm_eval_code_destroy(perPixelCodeHandle);
-    }
+    perPixelCodeContext->ResetVariables();
 
-    if (perPixelCodeContext != nullptr)
+    sharedVariables.Register(*perPixelCodeContext, sharedVariableBlock);
+    time = sharedVariables.Variable(SharedVariableBlock::Time);
+    fps = sharedVariables.Variable(SharedVariableBlock::Fps);
+    frame = sharedVariables.Variable(SharedVariableBlock::Frame);
+    progress = sharedVariables.Variable(SharedVariableBlock::Progress);
+    bass = sharedVariables.Variable(SharedVariableBlock::Bass);
+    mid = sharedVariables.Variable(SharedVariableBlock::Mid);
+    treb = sharedVariables.Variable(SharedVariableBlock::Treb);
+    bass_att = sharedVariables.Variable(SharedVariableBlock::BassAtt);
+    mid_att = sharedVariables.Variable(SharedVariableBlock::MidAtt);
+    treb_att = sharedVariables.Variable(SharedVariableBlock::TrebAtt);
+    for (int q = 0; q < QVarCount; q++)
     {
-        projectm_eval_context_destroy(perPixelCodeContext);
+        q_vars[q] = sharedVariables.Variable(SharedVariableBlock::Q1 + q);
     }
-}
-
-void PerPixelContext::RegisterBuiltinVariables()
-{
-    projectm_eval_context_reset_variables(perPixelCodeContext);
 
     REG_VAR(zoom);
     REG_VAR(zoomexp);
@@ -44,25 +47,10 @@ void PerPixelContext::RegisterBuiltinVariables()
     REG_VAR(dy);
     REG_VAR(sx);
     REG_VAR(sy);
-    REG_VAR(time);
-    REG_VAR(fps);
-    REG_VAR(bass);
-    REG_VAR(mid);
-    REG_VAR(treb);
-    REG_VAR(bass_att);
-    REG_VAR(mid_att);
-    REG_VAR(treb_att);
-    REG_VAR(frame);
     REG_VAR(x);
     REG_VAR(y);
     REG_VAR(rad);
     REG_VAR(ang);
-    for (int q = 0; q < QVarCount; q++)
-    {
-        std::string qvar = "q" + std::to_string(q + 1);
-        q_vars[q] = projectm_eval_context_register_variable(perPixelCodeContext, qvar.c_str());
-    }
-    REG_VAR(progress);
     REG_VAR(meshx);
     REG_VAR(meshy);
     REG_VAR(pixelsx);
@@ -71,18 +59,10 @@ void PerPixelContext::RegisterBuiltinVariables()
     REG_VAR(aspecty);
 }
 
-void PerPixelContext::LoadStateReadOnlyVariables(PresetState& state, PerFrameContext& perFrameState)
+void PerPixelContext::LoadStateReadOnlyVariables(const PresetState& state)
 {
-    *time = static_cast<PRJM_EVAL_F>(*perFrameState.time);
-    *fps = static_cast<PRJM_EVAL_F>(*perFrameState.fps);
-    *frame = static_cast<PRJM_EVAL_F>(*perFrameState.frame);
-    *progress = static_cast<PRJM_EVAL_F>(*perFrameState.progress);
-    *bass = static_cast<PRJM_EVAL_F>(*perFrameState.bass);
-    *mid = static_cast<PRJM_EVAL_F>(*perFrameState.mid);
-    *treb = static_cast<PRJM_EVAL_F>(*perFrameState.treb);
-    *bass_att = static_cast<PRJM_EVAL_F>(*perFrameState.bass_att);
-    *mid_att = static_cast<PRJM_EVAL_F>(*perFrameState.mid_att);
-    *treb_att = static_cast<PRJM_EVAL_F>(*perFrameState.treb_att);
+    sharedVariables.Load();
+
     *meshx = static_cast<PRJM_EVAL_F>(state.renderContext.perPixelMeshX);
     *meshy = static_cast<PRJM_EVAL_F>(state.renderContext.perPixelMeshY);
     *pixelsx = static_cast<PRJM_EVAL_F>(state.renderContext.viewportSizeX);
@@ -91,40 +71,100 @@ void PerPixelContext::LoadStateReadOnlyVariables(PresetState& state, PerFrameCon
     *aspecty = static_cast<PRJM_EVAL_F>(state.renderContext.aspectY);
 }
 
-void PerPixelContext::LoadPerFrameQVariables(PresetState& state, PerFrameContext& perFrameState)
-{
-    for (int q = 0; q < QVarCount; q++)
-    {
-        state.frameQVariables[q] = *perFrameState.q_vars[q];
-        *q_vars[q] = *perFrameState.q_vars[q];
-    }
-}
-
 void PerPixelContext::CompilePerPixelCode(const std::string& perPixelCode)
 {
+    perPixelInvariantCodeHandle.reset();
+    codeAnalysis = PerPixelCodeAnalysis();
+    glslTranslator = PerPixelGlslTranslator();
+    glslUniformVariables.clear();
+
     if (perPixelCode.empty())
     {
         return;
     }
 
-    perPixelCodeHandle = projectm_eval_code_compile(perPixelCodeContext, perPixelCode.c_str());
+    perPixelCodeHandle = perPixelCodeContext->Compile(perPixelCode);
     if (perPixelCodeHandle == nullptr)
     {
 #ifdef MILKDROP_PRESET_DEBUG
         int line;
         int col;
-        auto* errmsg = projectm_eval_get_error(perPixelCodeContext, &line, &col);
+        auto const errmsg = perPixelCodeContext->LastError(line, col);
         std::cerr << "[Preset] Could not compile per-pixel code: " << errmsg << "(L" << line << " C" << col << ")" << std::endl;
 #endif
         throw MilkdropCompileException("Could not compile per-pixel code");
     }
+
+    // Split off the statements which give the same result for every vertex.
+    codeAnalysis = PerPixelCodeAnalysis::Analyze(perPixelCode);
+    if (codeAnalysis.hoistedStatementCount > 0)
+    {
+        auto invariantCode = perPixelCodeContext->Compile(codeAnalysis.perFrameCode);
+        std::unique_ptr<ExpressionEngine::Program> perVertexCode;
+        if (!codeAnalysis.perVertexCode.empty())
+        {
+            perVertexCode = perPixelCodeContext->Compile(codeAnalysis.perVertexCode);
+        }
+
+        if (invariantCode && (codeAnalysis.perVertexCode.empty() || perVertexCode))
+        {
+            perPixelInvariantCodeHandle = std::move(invariantCode);
+            perPixelCodeHandle = std::move(perVertexCode);
+
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Preset] Per-pixel code: " << codeAnalysis.hoistedStatementCount << " of " << codeAnalysis.statementCount
+                      << " statements are position-independent and run once per frame." << std::endl;
+#endif
+        }
+        else
+        {
+            // Keep running the full code for each vertex.
+            codeAnalysis.hoistedStatementCount = 0;
+        }
+    }
+
+    if (perPixelCodeHandle == nullptr)
+    {
+        return;
+    }
+
+    // Try to move the remaining per-vertex code into the warp vertex shader.
+    if (glslTranslator.Translate(codeAnalysis.hoistedStatementCount > 0 ? codeAnalysis.perVertexCode : perPixelCode))
+    {
+        for (auto const& name : glslTranslator.UniformVariables())
+        {
+            glslUniformVariables.push_back(perPixelCodeContext->RegisterVariable(name));
+        }
+
+#ifdef MILKDROP_PRESET_DEBUG
+        std::cerr << "[Preset] Per-pixel code can be evaluated in the warp shader." << std::endl;
+#endif
+    }
 }
 
 void PerPixelContext::ExecutePerPixelCode()
 {
     if (perPixelCodeHandle != nullptr)
     {
-        projectm_eval_code_execute(perPixelCodeHandle);
+        perPixelCodeHandle->Execute();
+    }
+}
+
+void PerPixelContext::ExecutePerPixelInvariantCode()
+{
+    if (perPixelInvariantCodeHandle != nullptr)
+    {
+        perPixelInvariantCodeHandle->Execute();
+    }
+}
+
+void PerPixelContext::ExecutePerPixelCodeBatch(size_t vertexCount,
+                                               const std::vector<ExpressionEngine::BatchInput>& inputs,
+                                               const std::vector<ExpressionEngine::BatchOutput>& outputs)
+{
+    if (perPixelCodeHandle != nullptr)
+    {
+        perPixelCodeHandle->ExecuteBatch(vertexCount, inputs, outputs);
     }
 }
 
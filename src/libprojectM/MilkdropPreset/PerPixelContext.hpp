@@ -1,9 +1,13 @@
 #pragma once
 
 #include "PerFrameContext.hpp"
+#include "ExpressionEngine.hpp"
+#include "PerPixelCodeAnalysis.hpp"
+#include "PerPixelGlslTranslator.hpp"
 #include "PresetState.hpp"
 
-#include <projectm-eval.h>
+#include <memory>
+#include <vector>
 
 namespace libprojectM {
 namespace MilkdropPreset {
@@ -13,20 +17,17 @@ class PerPixelContext
 public:
     /**
      * @brief Constructor. Creates a new per-frame state object.
+     * @param engine The expression engine used to compile and run the code.
      * @param gmegabuf The global memory buffer to use in the code context.
      * @param globalRegisters The global variables to use in the code context.
      */
-    PerPixelContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100]);
-
-    /**
-     * @brief Destructor.
-     */
-    ~PerPixelContext();
+    PerPixelContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters);
 
     /**
      * @brief Registers the state variables in the expression evaluator context.
+     * @param sharedVariables The preset's shared frame variables.
      */
-    void RegisterBuiltinVariables();
+    void RegisterBuiltinVariables(const SharedVariableBlock& sharedVariables);
 
     /**
      * @brief Loads the current state read-only values into the expression evaluator variables.
@@ -35,19 +36,20 @@ public:
      * preset authors may use this fact to change these values from vertex to vertex. Even if this
      * is an undocumented feature, we should do the same as some presets may depend on it.
      *
+     * Time, audio and Q values are taken from the shared variable block, which must be updated
+     * with the per-frame code results first.
+     *
      * @param state The preset state container.
      */
-    void LoadStateReadOnlyVariables(PresetState& state, PerFrameContext& perFrameState);
-
-    /**
-     * @brief Copies the current per-frame Q variable values into the per-pixel state.
-     * @param state The preset state container.
-     * @param perFrameState The per-frame execution context.
-     */
-    void LoadPerFrameQVariables(PresetState& state, PerFrameContext& perFrameState);
+    void LoadStateReadOnlyVariables(const PresetState& state);
 
     /**
      * @brief Compiles the per-pixel code and stores the code handle in the class.
+     *
+     * Statements which don't depend on the vertex position are compiled separately into
+     * perPixelInvariantCodeHandle, the remaining code into perPixelCodeHandle. If the remaining
+     * code is free of side effects, it is also translated to GLSL so it can run in the warp shader.
+     *
      * @throws MilkdropCompileException Thrown if the per-pixel code couldn't be compiled.
      * @param perPixelCode The code to compile.
      */
@@ -58,8 +60,30 @@ public:
      */
     void ExecutePerPixelCode();
 
-    projectm_eval_context* perPixelCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
-    projectm_eval_code* perPixelCodeHandle{nullptr};     //!< The compiled per-pixel code handle.
+    /**
+     * @brief Executes the position-independent part of the per-pixel code.
+     *
+     * Must be called once per frame, before the per-vertex code is run.
+     */
+    void ExecutePerPixelInvariantCode();
+
+    /**
+     * @brief Executes the per-pixel code once for each vertex.
+     * @param vertexCount The number of vertices.
+     * @param inputs The variables loaded before each vertex.
+     * @param outputs The variables stored after each vertex.
+     */
+    void ExecutePerPixelCodeBatch(size_t vertexCount,
+                                  const std::vector<ExpressionEngine::BatchInput>& inputs,
+                                  const std::vector<ExpressionEngine::BatchOutput>& outputs);
+
+    std::unique_ptr<ExpressionEngine::Context> perPixelCodeContext;         //!< The code runtime context, holds memory buffers and variables.
+    SharedVariableBinding sharedVariables;                                  //!< Binding of the time, audio and Q variables to the shared block.
+    std::unique_ptr<ExpressionEngine::Program> perPixelCodeHandle;          //!< The compiled per-pixel code handle.
+    std::unique_ptr<ExpressionEngine::Program> perPixelInvariantCodeHandle; //!< Position-independent part of the per-pixel code, run once per frame.
+    PerPixelCodeAnalysis codeAnalysis;                                      //!< Result of the per-pixel code dependency analysis.
+    PerPixelGlslTranslator glslTranslator;                                  //!< GLSL translation of the per-vertex code. Source is empty if it can't run on the GPU.
+    std::vector<PRJM_EVAL_F*> glslUniformVariables;                         //!< Context variables passed as uniforms to the GLSL code, in the translator's order.
 
     PRJM_EVAL_F* zoom{};
     PRJM_EVAL_F* zoomexp{};
@@ -0,0 +1,585 @@
+#include "PerPixelGlslTranslator.hpp"
+
+#include "ExpressionParser.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <locale>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+/**
+ * Per-vertex inputs, passed as function arguments.
+ */
+const std::vector<std::string> inputVariables{"x", "y", "rad", "ang"};
+
+/**
+ * Per-vertex outputs in the order of the function's output arguments.
+ */
+const std::vector<std::string> outputVariables{"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+/**
+ * Helper functions implementing the expression semantics, e.g. division by zero returning 0.
+ * GLSL leaves pow() undefined for negative bases and atan() undefined if both arguments are 0,
+ * so the C library results are reproduced.
+ */
+constexpr auto helperFunctions = R"(
+#define PER_PIXEL_EQUATIONS
+
+bool per_pixel_truth(float value) { return abs(value) > 0.00001; }
+float per_pixel_div(float a, float b) { return b == 0.0 ? 0.0 : a / b; }
+float per_pixel_equal(float a, float b) { return abs(a - b) < 0.00001 ? 1.0 : 0.0; }
+float per_pixel_sqr(float a) { return a * a; }
+float per_pixel_atan2(float y, float x) { return y == 0.0 && x == 0.0 ? 0.0 : atan(y, x); }
+float per_pixel_pow(float a, float b)
+{
+    if (a >= 0.0)
+    {
+        return pow(a, b);
+    }
+    if (b != floor(b))
+    {
+        return intBitsToFloat(0x7FC00000);
+    }
+    float result = pow(-a, b);
+    return mod(b, 2.0) == 0.0 ? result : -result;
+}
+)";
+
+/**
+ * Translates the syntax tree into one GLSL expression per statement.
+ *
+ * All values are floats. Boolean results are 1.0 or 0.0, like in the expression evaluator.
+ * Sequences become GLSL expressions using the comma operator, so assignments inside
+ * expressions keep their evaluation order.
+ */
+class Translator
+{
+public:
+    using Node = ExpressionParser::Node;
+
+    auto Translate(const Node& program, std::string& source, std::vector<std::string>& uniformVariables) -> bool
+    {
+        std::vector<std::string> statements;
+        for (auto const& statement : program.arguments)
+        {
+            auto expression = Emit(*statement);
+            if (expression.empty())
+            {
+                return false;
+            }
+            statements.push_back(std::move(expression));
+        }
+
+        // Values read before being assigned come from outside. If the code also writes them, they
+        // would carry over to the next vertex on the CPU, which can't be done in a shader.
+        for (auto const& name : m_readBeforeAssignment)
+        {
+            if (m_written.find(name) != m_written.end() && !IsInputOrOutput(name))
+            {
+                return false;
+            }
+        }
+
+        std::ostringstream glsl;
+        glsl << helperFunctions << "\n";
+
+        uniformVariables.clear();
+        for (auto const& name : outputVariables)
+        {
+            uniformVariables.push_back(name);
+        }
+        for (auto const& name : m_readBeforeAssignment)
+        {
+            if (!IsInputOrOutput(name))
+            {
+                uniformVariables.push_back(name);
+            }
+        }
+
+        for (size_t index = 0; index < uniformVariables.size(); index++)
+        {
+            glsl << "uniform float " << PerPixelGlslTranslator::UniformName(index) << ";\n";
+        }
+
+        glsl << "\nvoid PerPixelEquations(float x, float y, float rad, float ang,\n"
+             << "                       out vec4 transforms, out vec2 warp_center,\n"
+             << "                       out vec2 warp_distance, out vec2 stretch)\n"
+             << "{\n";
+
+        for (auto const& variable : m_variables)
+        {
+            glsl << "    float " << LocalName(variable.first) << " = ";
+
+            auto const input = std::find(inputVariables.begin(), inputVariables.end(), variable.first);
+            auto const uniform = std::find(uniformVariables.begin(), uniformVariables.end(), variable.first);
+            if (input != inputVariables.end())
+            {
+                glsl << *input;
+            }
+            else if (uniform != uniformVariables.end())
+            {
+                glsl << PerPixelGlslTranslator::UniformName(uniform - uniformVariables.begin());
+            }
+            else
+            {
+                glsl << "0.0";
+            }
+            glsl << ";\n";
+        }
+
+        for (auto const& statement : statements)
+        {
+            glsl << "    " << statement << ";\n";
+        }
+
+        glsl << "    transforms = vec4(" << Output(0) << ", " << Output(1) << ", " << Output(2) << ", " << Output(3) << ");\n"
+             << "    warp_center = vec2(" << Output(4) << ", " << Output(5) << ");\n"
+             << "    warp_distance = vec2(" << Output(6) << ", " << Output(7) << ");\n"
+             << "    stretch = vec2(" << Output(8) << ", " << Output(9) << ");\n"
+             << "}\n";
+
+        source = glsl.str();
+        return true;
+    }
+
+private:
+    static auto IsInputOrOutput(const std::string& name) -> bool
+    {
+        return std::find(inputVariables.begin(), inputVariables.end(), name) != inputVariables.end() ||
+               std::find(outputVariables.begin(), outputVariables.end(), name) != outputVariables.end();
+    }
+
+    auto LocalName(const std::string& name) -> std::string
+    {
+        auto const variable = m_variables.find(name);
+        if (variable != m_variables.end())
+        {
+            return "per_pixel_var" + std::to_string(variable->second);
+        }
+
+        auto const index = m_variables.size();
+        m_variables.insert({name, index});
+        return "per_pixel_var" + std::to_string(index);
+    }
+
+    /**
+     * Returns the final value of the given output variable.
+     */
+    auto Output(size_t index) -> std::string
+    {
+        auto const& name = outputVariables.at(index);
+        if (m_variables.find(name) == m_variables.end())
+        {
+            // Not used by the code, so the per-frame value is simply passed through.
+            return PerPixelGlslTranslator::UniformName(index);
+        }
+        return LocalName(name);
+    }
+
+    static auto Truth(const std::string& expression) -> std::string
+    {
+        return "per_pixel_truth(" + expression + ")";
+    }
+
+    static auto Boolean(const std::string& condition) -> std::string
+    {
+        return "(" + condition + " ? 1.0 : 0.0)";
+    }
+
+    /**
+     * Formats a constant with the fewest digits giving back the same single-precision value.
+     */
+    static auto Number(double value) -> std::string
+    {
+        auto const floatValue = static_cast<float>(value);
+
+        std::string number;
+        for (int precision = std::numeric_limits<float>::digits10; precision <= std::numeric_limits<float>::max_digits10; precision++)
+        {
+            std::ostringstream output;
+            output.imbue(std::locale::classic());
+            output << std::setprecision(precision) << floatValue;
+            number = output.str();
+
+            std::istringstream input(number);
+            input.imbue(std::locale::classic());
+            float parsedValue{};
+            input >> parsedValue;
+            if (parsedValue == floatValue)
+            {
+                break;
+            }
+        }
+
+        if (number.find_first_of(".e") == std::string::npos)
+        {
+            number += ".0";
+        }
+        return number;
+    }
+
+    /**
+     * Global registers are shared between all code and can't be modified in a shader. Namespaced
+     * variables are resolved by the evaluator.
+     */
+    static auto IsShaderVariable(const std::string& name) -> bool
+    {
+        return !ExpressionParser::IsGlobalRegister(name) && name.find('.') == std::string::npos;
+    }
+
+    /**
+     * Returns the GLSL expression for a variable, or an empty string if it can't be used in a shader.
+     */
+    auto ReadVariable(const std::string& name) -> std::string
+    {
+        if (!IsShaderVariable(name))
+        {
+            return {};
+        }
+
+        if (!IsInputOrOutput(name) && m_assigned.find(name) == m_assigned.end())
+        {
+            m_readBeforeAssignment.insert(name);
+        }
+        return LocalName(name);
+    }
+
+    /**
+     * Translates a node evaluated only if a condition is met.
+     */
+    auto EmitConditional(const Node& node) -> std::string
+    {
+        m_conditionalDepth++;
+        auto result = Emit(node);
+        m_conditionalDepth--;
+        return result;
+    }
+
+    auto Emit(const Node& node) -> std::string
+    {
+        switch (node.type)
+        {
+            case Node::Type::Constant:
+                if (!std::isfinite(static_cast<float>(node.value)))
+                {
+                    return {};
+                }
+                return Number(node.value);
+
+            case Node::Type::Variable:
+                return ReadVariable(node.name);
+
+            case Node::Type::Assign:
+                return EmitAssignment(node);
+
+            case Node::Type::Unary: {
+                auto operand = Emit(*node.arguments[0]);
+                if (operand.empty())
+                {
+                    return {};
+                }
+                if (node.operation == "-")
+                {
+                    return "(-" + operand + ")";
+                }
+                if (node.operation == "!")
+                {
+                    return "(" + Truth(operand) + " ? 0.0 : 1.0)";
+                }
+                return operand;
+            }
+
+            case Node::Type::Binary:
+                return EmitBinary(node);
+
+            case Node::Type::Condition: {
+                if (node.arguments.size() != 3)
+                {
+                    return {};
+                }
+                auto condition = Emit(*node.arguments[0]);
+                auto trueBranch = EmitConditional(*node.arguments[1]);
+                auto falseBranch = EmitConditional(*node.arguments[2]);
+                if (condition.empty() || trueBranch.empty() || falseBranch.empty())
+                {
+                    return {};
+                }
+                return "(" + Truth(condition) + " ? " + trueBranch + " : " + falseBranch + ")";
+            }
+
+            case Node::Type::Call:
+                return EmitCall(node);
+
+            case Node::Type::Sequence: {
+                std::string sequence;
+                for (auto const& statement : node.arguments)
+                {
+                    auto expression = Emit(*statement);
+                    if (expression.empty())
+                    {
+                        return {};
+                    }
+                    sequence += sequence.empty() ? expression : ", " + expression;
+                }
+                return sequence.empty() ? "0.0" : "(" + sequence + ")";
+            }
+
+            case Node::Type::Index:
+                // Memory buffers have to be accessed on the CPU.
+                return {};
+        }
+
+        return {};
+    }
+
+    auto EmitAssignment(const Node& node) -> std::string
+    {
+        static const std::set<std::string> supportedOperations{"=", "+=", "-=", "*=", "/="};
+
+        auto const& target = *node.arguments[0];
+        if (target.type != Node::Type::Variable || !IsShaderVariable(target.name) ||
+            supportedOperations.find(node.operation) == supportedOperations.end())
+        {
+            return {};
+        }
+
+        // A plain assignment doesn't read the target variable.
+        if (node.operation != "=")
+        {
+            ReadVariable(target.name);
+        }
+
+        auto value = Emit(*node.arguments[1]);
+        if (value.empty())
+        {
+            return {};
+        }
+
+        auto const name = LocalName(target.name);
+        m_written.insert(target.name);
+        if (m_conditionalDepth == 0)
+        {
+            m_assigned.insert(target.name);
+        }
+
+        if (node.operation == "=")
+        {
+            return "(" + name + " = " + value + ")";
+        }
+        if (node.operation == "/=")
+        {
+            return "(" + name + " = per_pixel_div(" + name + ", " + value + "))";
+        }
+        return "(" + name + " = " + name + " " + node.operation[0] + " " + value + ")";
+    }
+
+    auto EmitBinary(const Node& node) -> std::string
+    {
+        auto const& operation = node.operation;
+        bool const shortCircuit = operation == "&&" || operation == "||";
+
+        auto left = Emit(*node.arguments[0]);
+        auto right = shortCircuit ? EmitConditional(*node.arguments[1]) : Emit(*node.arguments[1]);
+        if (left.empty() || right.empty())
+        {
+            return {};
+        }
+
+        if (operation == "+" || operation == "-" || operation == "*")
+        {
+            return "(" + left + " " + operation + " " + right + ")";
+        }
+        if (operation == "/")
+        {
+            return "per_pixel_div(" + left + ", " + right + ")";
+        }
+        if (operation == "==")
+        {
+            return "per_pixel_equal(" + left + ", " + right + ")";
+        }
+        if (operation == "!=")
+        {
+            return "(1.0 - per_pixel_equal(" + left + ", " + right + "))";
+        }
+        if (operation == "<" || operation == ">" || operation == "<=" || operation == ">=")
+        {
+            return Boolean("(" + left + " " + operation + " " + right + ")");
+        }
+        if (shortCircuit)
+        {
+            return Boolean("(" + Truth(left) + " " + operation + " " + Truth(right) + ")");
+        }
+
+        // Modulo, power and bitwise operators aren't supported.
+        return {};
+    }
+
+    auto EmitArguments(const Node& node, size_t count, bool conditional, std::vector<std::string>& arguments) -> bool
+    {
+        if (node.arguments.size() != count)
+        {
+            return false;
+        }
+
+        for (size_t index = 0; index < count; index++)
+        {
+            auto argument = conditional && index > 0 ? EmitConditional(*node.arguments[index]) : Emit(*node.arguments[index]);
+            if (argument.empty())
+            {
+                return false;
+            }
+            arguments.push_back(std::move(argument));
+        }
+
+        return true;
+    }
+
+    auto EmitCall(const Node& node) -> std::string
+    {
+        static const std::map<std::string, std::string> unaryFunctions{
+            {"sin", "sin"}, {"cos", "cos"}, {"tan", "tan"}, {"atan", "atan"}, {"exp", "exp"}, {"floor", "floor"}, {"ceil", "ceil"}, {"abs", "abs"}, {"sqr", "per_pixel_sqr"}, {"sign", "sign"}};
+
+        static const std::map<std::string, std::string> binaryFunctions{
+            {"atan2", "per_pixel_atan2"}, {"min", "min"}, {"max", "max"}, {"pow", "per_pixel_pow"}, {"equal", "per_pixel_equal"}};
+
+        auto const& name = node.name;
+        std::vector<std::string> arguments;
+
+        auto const unaryFunction = unaryFunctions.find(name);
+        if (unaryFunction != unaryFunctions.end())
+        {
+            if (!EmitArguments(node, 1, false, arguments))
+            {
+                return {};
+            }
+            return unaryFunction->second + "(" + arguments[0] + ")";
+        }
+
+        auto const binaryFunction = binaryFunctions.find(name);
+        if (binaryFunction != binaryFunctions.end())
+        {
+            if (!EmitArguments(node, 2, false, arguments))
+            {
+                return {};
+            }
+            return binaryFunction->second + "(" + arguments[0] + ", " + arguments[1] + ")";
+        }
+
+        if (name == "sqrt")
+        {
+            if (!EmitArguments(node, 1, false, arguments))
+            {
+                return {};
+            }
+            return "sqrt(abs(" + arguments[0] + "))";
+        }
+
+        if (name == "bnot")
+        {
+            if (!EmitArguments(node, 1, false, arguments))
+            {
+                return {};
+            }
+            return "(" + Truth(arguments[0]) + " ? 0.0 : 1.0)";
+        }
+
+        if (name == "above" || name == "below")
+        {
+            if (!EmitArguments(node, 2, false, arguments))
+            {
+                return {};
+            }
+            return Boolean("(" + arguments[0] + (name == "above" ? " > " : " < ") + arguments[1] + ")");
+        }
+
+        if (name == "band" || name == "bor")
+        {
+            if (!EmitArguments(node, 2, true, arguments))
+            {
+                return {};
+            }
+            return Boolean("(" + Truth(arguments[0]) + (name == "band" ? " && " : " || ") + Truth(arguments[1]) + ")");
+        }
+
+        if (name == "if")
+        {
+            if (!EmitArguments(node, 3, true, arguments))
+            {
+                return {};
+            }
+            return "(" + Truth(arguments[0]) + " ? " + arguments[1] + " : " + arguments[2] + ")";
+        }
+
+        if (name == "exec2" || name == "exec3")
+        {
+            if (!EmitArguments(node, name == "exec2" ? 2 : 3, false, arguments))
+            {
+                return {};
+            }
+
+            std::string sequence = arguments[0];
+            for (size_t index = 1; index < arguments.size(); index++)
+            {
+                sequence += ", " + arguments[index];
+            }
+            return "(" + sequence + ")";
+        }
+
+        // Memory buffers, loops, random numbers and everything else has to run on the CPU.
+        return {};
+    }
+
+    int m_conditionalDepth{}; //!< Number of enclosing conditionally evaluated expressions.
+
+    std::map<std::string, size_t> m_variables;    //!< All variables used in the code and their local variable index.
+    std::set<std::string> m_assigned;             //!< Variables unconditionally assigned so far.
+    std::set<std::string> m_written;              //!< All variables assigned anywhere in the code.
+    std::set<std::string> m_readBeforeAssignment; //!< Variables read before their first assignment.
+};
+
+} // namespace
+
+auto PerPixelGlslTranslator::Translate(const std::string& perPixelCode) -> bool
+{
+    m_source.clear();
+    m_uniformVariables.clear();
+
+    auto const program = ExpressionParser::Parse(perPixelCode);
+
+    Translator translator;
+    if (!program || !translator.Translate(*program, m_source, m_uniformVariables))
+    {
+        m_source.clear();
+        m_uniformVariables.clear();
+        return false;
+    }
+
+    return true;
+}
+
+auto PerPixelGlslTranslator::Source() const -> const std::string&
+{
+    return m_source;
+}
+
+auto PerPixelGlslTranslator::UniformVariables() const -> const std::vector<std::string>&
+{
+    return m_uniformVariables;
+}
+
+auto PerPixelGlslTranslator::UniformName(size_t index) -> std::string
+{
+    return "per_pixel_uniform" + std::to_string(index);
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
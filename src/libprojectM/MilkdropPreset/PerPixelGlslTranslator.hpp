@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Translates per-pixel expression code into a GLSL function.
+ *
+ * Only side-effect-free code can be translated: arithmetic, comparisons, boolean logic, if()
+ * and the common math functions operating on x, y, rad, ang, the per-frame values and
+ * q variables. Code using memory buffers, global registers, loops, random numbers or values
+ * carried over from the previous vertex can't run independently for each vertex and is
+ * rejected, so the caller can fall back to evaluating the code on the CPU.
+ *
+ * The generated source defines PER_PIXEL_EQUATIONS and the following function:
+ *
+ *     void PerPixelEquations(float x, float y, float rad, float ang,
+ *                            out vec4 transforms, out vec2 warp_center,
+ *                            out vec2 warp_distance, out vec2 stretch);
+ *
+ * The outputs match the vertex attributes of the warp vertex shader. All other values used
+ * by the code are passed as float uniforms, which must be set before drawing. This includes
+ * the initial values of zoom, zoomexp, rot, warp, cx, cy, dx, dy, sx and sy.
+ */
+class PerPixelGlslTranslator
+{
+public:
+    /**
+     * @brief Translates the given per-pixel code.
+     * @param perPixelCode The per-pixel code.
+     * @return True if the code was translated, false if it contains unsupported constructs.
+     */
+    auto Translate(const std::string& perPixelCode) -> bool;
+
+    /**
+     * @brief Returns the generated GLSL declarations, to be inserted in front of the warp vertex shader.
+     * @return The GLSL source, or an empty string if the last translation failed.
+     */
+    auto Source() const -> const std::string&;
+
+    /**
+     * @brief Returns the lower-case names of the expression variables passed as uniforms.
+     * @return A list of variable names. The index is used to build the uniform name.
+     */
+    auto UniformVariables() const -> const std::vector<std::string>&;
+
+    /**
+     * @brief Returns the GLSL uniform name for the given variable index.
+     * @param index The index in the UniformVariables() list.
+     * @return The uniform name.
+     */
+    static auto UniformName(size_t index) -> std::string;
+
+private:
+    std::string m_source;                        //!< The generated GLSL code.
+    std::vector<std::string> m_uniformVariables; //!< Variables passed in as uniforms.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -6,8 +6,11 @@
 #include "PerPixelContext.hpp"
 #include "PresetState.hpp"
 
+#include <Renderer/StateCache.hpp>
+
 #include <algorithm>
 #include <cmath>
+#include <utility>
 
 #ifdef MILKDROP_PRESET_DEBUG
 #include <iostream>
@@ -16,26 +19,22 @@
 namespace libprojectM {
 namespace MilkdropPreset {
 
-static constexpr uint32_t VerticesPerDrawCall = 1024 * 3;
-
 PerPixelMesh::PerPixelMesh()
     : RenderItem()
 {
     RenderItem::Init();
 
     auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
-    m_perPixelMeshShader.CompileProgram(staticShaders->GetPresetWarpVertexShader(),
-                                        staticShaders->GetPresetWarpFragmentShader());
+    m_perPixelMeshShader.CompileProgramAsync(staticShaders->GetPresetWarpVertexShader(),
+                                             staticShaders->GetPresetWarpFragmentShader());
 }
 
 void PerPixelMesh::InitVertexAttrib()
 {
-    m_drawVertices.resize(VerticesPerDrawCall); // Fixed size, may scale it later depending on GPU caps.
-
     glGenVertexArrays(1, &m_vaoID);
     glGenBuffers(1, &m_vboID);
 
-    glBindVertexArray(m_vaoID);
+    Renderer::StateCache::Current().BindVertexArray(m_vaoID);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
     glEnableVertexAttribArray(0);
@@ -53,10 +52,7 @@ void PerPixelMesh::InitVertexAttrib()
     glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), reinterpret_cast<void*>(offsetof(MeshVertex, distanceX))); // Distance
     glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), reinterpret_cast<void*>(offsetof(MeshVertex, stretchX)));  // Stretch
 
-    // Pre-allocate vertex buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(MeshVertex) * m_drawVertices.size(), m_drawVertices.data(), GL_STREAM_DRAW);
-
-    glBindVertexArray(0);
+    Renderer::StateCache::Current().BindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -70,7 +66,7 @@ void PerPixelMesh::LoadWarpShader(const PresetState& presetState)
             try
             {
                 m_warpShader = std::make_unique<MilkdropShader>(MilkdropShader::ShaderType::WarpShader);
-                m_warpShader->LoadCode(presetState.warpShader);
+                m_warpShader->LoadCode(presetState.warpShader, presetState.warpShaderSamplers);
 #ifdef MILKDROP_PRESET_DEBUG
                 std::cerr << "[Warp Shader] Loaded preset warp shader code." << std::endl;
 #endif
@@ -88,13 +84,62 @@ void PerPixelMesh::LoadWarpShader(const PresetState& presetState)
     }
 }
 
-void PerPixelMesh::CompileWarpShader(PresetState& presetState)
+void PerPixelMesh::CompileWarpShader(PresetState& presetState, const PerPixelContext& perPixelContext)
 {
+    m_perPixelEquationsOnGpu = false;
+    m_perPixelEquationsVertexShader = PerPixelEquationsVertexShader(perPixelContext);
+    m_perPixelEquationsUniformCount = perPixelContext.glslUniformVariables.size();
+    m_warpShaderPending = true;
+
     if (m_warpShader)
     {
         try
         {
-            m_warpShader->LoadTexturesAndCompile(presetState);
+            m_warpShader->SetWarpVertexShader(m_perPixelEquationsVertexShader);
+            m_warpShader->LoadTexturesAndCompileAsync(presetState);
+        }
+        catch (Renderer::ShaderException& ex)
+        {
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Warp Shader] Error translating warp shader code:" << ex.message() << std::endl;
+#else
+            (void)ex; // silence unused parameter warning
+#endif
+            m_warpShader.reset();
+        }
+    }
+
+    if (!m_warpShader && !m_perPixelEquationsVertexShader.empty())
+    {
+        auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
+        m_perPixelEquationsShader.CompileProgramAsync(m_perPixelEquationsVertexShader,
+                                                      staticShaders->GetPresetWarpFragmentShader());
+    }
+}
+
+auto PerPixelMesh::IsCompilationComplete() const -> bool
+{
+    return m_perPixelMeshShader.IsCompilationComplete() &&
+           m_perPixelEquationsShader.IsCompilationComplete() &&
+           (!m_warpShader || m_warpShader->IsCompilationComplete());
+}
+
+void PerPixelMesh::FinishCompilation(PresetState& presetState)
+{
+    m_perPixelMeshShader.FinishCompilation();
+
+    if (!m_warpShaderPending)
+    {
+        return;
+    }
+    m_warpShaderPending = false;
+
+    if (m_warpShader)
+    {
+        try
+        {
+            m_warpShader->FinishCompilation(presetState);
+            m_perPixelEquationsOnGpu = m_warpShader->UsesWarpVertexShader();
 #ifdef MILKDROP_PRESET_DEBUG
             std::cerr << "[Warp Shader] Successfully compiled warp shader code." << std::endl;
 #endif
@@ -107,14 +152,43 @@ void PerPixelMesh::CompileWarpShader(PresetState& presetState)
             (void)ex; // silence unused parameter warning
 #endif
             m_warpShader.reset();
+
+            if (!m_perPixelEquationsVertexShader.empty())
+            {
+                auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
+                m_perPixelEquationsShader.CompileProgramAsync(m_perPixelEquationsVertexShader,
+                                                              staticShaders->GetPresetWarpFragmentShader());
+            }
+        }
+    }
+
+    if (!m_warpShader && !m_perPixelEquationsVertexShader.empty())
+    {
+        try
+        {
+            m_perPixelEquationsShader.FinishCompilation();
+            m_perPixelEquationsOnGpu = true;
+        }
+        catch (Renderer::ShaderException& ex)
+        {
+#ifdef MILKDROP_PRESET_DEBUG
+            std::cerr << "[Warp Shader] Error compiling per-pixel equations shader, using CPU evaluation:" << ex.message() << std::endl;
+#else
+            (void)ex; // silence unused parameter warning
+#endif
         }
     }
+
+    m_perPixelEquationsVertexShader.clear();
 }
 
-void PerPixelMesh::Draw(const PresetState& presetState,
-                        const PerFrameContext& perFrameContext,
-                        PerPixelContext& perPixelContext)
+void PerPixelMesh::Prepare(const PresetState& presetState,
+                           const PerFrameContext& perFrameContext,
+                           PerPixelContext& perPixelContext)
 {
+    m_preparedFrame.triangleVertices.clear();
+    m_preparedFrame.perPixelEquationsUniforms.clear();
+
     if (presetState.renderContext.viewportSizeX == 0 ||
         presetState.renderContext.viewportSizeY == 0 ||
         presetState.renderContext.perPixelMeshX == 0 ||
@@ -127,9 +201,33 @@ void PerPixelMesh::Draw(const PresetState& presetState,
     InitializeMesh(presetState);
 
     // Calculate the dynamic movement values
-    CalculateMesh(presetState, perFrameContext, perPixelContext);
+    CalculateMesh(perFrameContext, perPixelContext);
+
+    // Expand the grid into the triangle list, so Draw() only needs to upload it.
+    auto& triangleVertices = m_preparedFrame.triangleVertices;
+    triangleVertices.resize(m_listIndices.size());
+    for (size_t index = 0; index < m_listIndices.size(); index++)
+    {
+        triangleVertices[index] = m_vertices[m_listIndices[index]];
+    }
+}
+
+void PerPixelMesh::SwapPreparedFrame()
+{
+    std::swap(m_preparedFrame, m_drawnFrame);
+}
+
+void PerPixelMesh::Draw(const PresetState& presetState,
+                        const PerFrameContext& perFrameContext)
+{
+    if (presetState.drawnFrame.renderContext.viewportSizeX == 0 ||
+        presetState.drawnFrame.renderContext.viewportSizeY == 0 ||
+        m_drawnFrame.triangleVertices.empty())
+    {
+        return;
+    }
 
-    // Render the resulting mesh.
+    // Render the mesh calculated in Prepare().
     WarpedBlit(presetState, perFrameContext);
 }
 
@@ -143,6 +241,7 @@ void PerPixelMesh::InitializeMesh(const PresetState& presetState)
 
         // Grid size has changed, reallocate vertex buffers
         m_vertices.resize((m_gridSizeX + 1) * (m_gridSizeY + 1));
+        m_vertexInputs.resize(m_vertices.size());
         m_listIndices.resize(m_gridSizeX * m_gridSizeY * 6);
     }
     else if (m_viewportWidth == presetState.renderContext.viewportSizeX &&
@@ -177,6 +276,12 @@ void PerPixelMesh::InitializeMesh(const PresetState& presetState)
                 vertex.angle = atan2f(vertex.y * aspectY, vertex.x * aspectX);
             }
 
+            auto& inputs = m_vertexInputs.at(vertexIndex);
+            inputs.x = static_cast<PRJM_EVAL_F>(vertex.x * 0.5f * aspectX + 0.5f);
+            inputs.y = static_cast<PRJM_EVAL_F>(vertex.y * -0.5f * aspectY + 0.5f);
+            inputs.rad = static_cast<PRJM_EVAL_F>(vertex.radius);
+            inputs.ang = static_cast<PRJM_EVAL_F>(vertex.angle);
+
             vertexIndex++;
         }
     }
@@ -217,76 +322,130 @@ void PerPixelMesh::InitializeMesh(const PresetState& presetState)
     }
 }
 
-void PerPixelMesh::CalculateMesh(const PresetState& presetState, const PerFrameContext& perFrameContext, PerPixelContext& perPixelContext)
+void PerPixelMesh::CalculateMesh(const PerFrameContext& perFrameContext, PerPixelContext& perPixelContext)
 {
-    // Cache some per-frame values as floats
-    float zoom = static_cast<float>(*perFrameContext.zoom);
-    float zoomExp = static_cast<float>(*perFrameContext.zoomexp);
-    float rot = static_cast<float>(*perFrameContext.rot);
-    float warp = static_cast<float>(*perFrameContext.warp);
-    float cx = static_cast<float>(*perFrameContext.cx);
-    float cy = static_cast<float>(*perFrameContext.cy);
-    float dx = static_cast<float>(*perFrameContext.dx);
-    float dy = static_cast<float>(*perFrameContext.dy);
-    float sx = static_cast<float>(*perFrameContext.sx);
-    float sy = static_cast<float>(*perFrameContext.sy);
-
-    int vertex = 0;
+    // Per-frame values each vertex starts with.
+    PRJM_EVAL_F zoom = *perFrameContext.zoom;
+    PRJM_EVAL_F zoomExp = *perFrameContext.zoomexp;
+    PRJM_EVAL_F rot = *perFrameContext.rot;
+    PRJM_EVAL_F warp = *perFrameContext.warp;
+    PRJM_EVAL_F cx = *perFrameContext.cx;
+    PRJM_EVAL_F cy = *perFrameContext.cy;
+    PRJM_EVAL_F dx = *perFrameContext.dx;
+    PRJM_EVAL_F dy = *perFrameContext.dy;
+    PRJM_EVAL_F sx = *perFrameContext.sx;
+    PRJM_EVAL_F sy = *perFrameContext.sy;
+
+    // Run the position-independent part of the per-pixel code only once and use the results for all vertices.
+    if (perPixelContext.perPixelInvariantCodeHandle)
+    {
+        *perPixelContext.zoom = zoom;
+        *perPixelContext.zoomexp = zoomExp;
+        *perPixelContext.rot = rot;
+        *perPixelContext.warp = warp;
+        *perPixelContext.cx = cx;
+        *perPixelContext.cy = cy;
+        *perPixelContext.dx = dx;
+        *perPixelContext.dy = dy;
+        *perPixelContext.sx = sx;
+        *perPixelContext.sy = sy;
+
+        perPixelContext.ExecutePerPixelInvariantCode();
+
+        zoom = *perPixelContext.zoom;
+        zoomExp = *perPixelContext.zoomexp;
+        rot = *perPixelContext.rot;
+        warp = *perPixelContext.warp;
+        cx = *perPixelContext.cx;
+        cy = *perPixelContext.cy;
+        dx = *perPixelContext.dx;
+        dy = *perPixelContext.dy;
+        sx = *perPixelContext.sx;
+        sy = *perPixelContext.sy;
+    }
 
-    // Can't make this multithreaded as per-pixel code may use gmegabuf or regXX vars.
-    for (int y = 0; y <= m_gridSizeY; y++)
+    // Per-vertex code is evaluated in the warp vertex shader, only pass the input values.
+    if (m_perPixelEquationsOnGpu && perPixelContext.perPixelCodeHandle)
     {
-        for (int x = 0; x <= m_gridSizeX; x++)
+        // Make the initial output values available as uniforms.
+        *perPixelContext.zoom = zoom;
+        *perPixelContext.zoomexp = zoomExp;
+        *perPixelContext.rot = rot;
+        *perPixelContext.warp = warp;
+        *perPixelContext.cx = cx;
+        *perPixelContext.cy = cy;
+        *perPixelContext.dx = dx;
+        *perPixelContext.dy = dy;
+        *perPixelContext.sx = sx;
+        *perPixelContext.sy = sy;
+
+        auto& uniforms = m_preparedFrame.perPixelEquationsUniforms;
+        uniforms.resize(m_perPixelEquationsUniformCount);
+        for (size_t index = 0; index < uniforms.size(); index++)
         {
-            auto& curVertex = m_vertices[vertex];
+            uniforms[index] = static_cast<float>(*perPixelContext.glslUniformVariables[index]);
+        }
 
-            // Execute per-vertex/per-pixel code if the preset uses it.
-            if (perPixelContext.perPixelCodeHandle)
-            {
-                *perPixelContext.x = static_cast<double>(curVertex.x * 0.5f * presetState.renderContext.aspectX + 0.5f);
-                *perPixelContext.y = static_cast<double>(curVertex.y * -0.5f * presetState.renderContext.aspectY + 0.5f);
-                *perPixelContext.rad = static_cast<double>(curVertex.radius);
-                *perPixelContext.ang = static_cast<double>(curVertex.angle);
-                *perPixelContext.zoom = static_cast<double>(*perFrameContext.zoom);
-                *perPixelContext.zoomexp = static_cast<double>(*perFrameContext.zoomexp);
-                *perPixelContext.rot = static_cast<double>(*perFrameContext.rot);
-                *perPixelContext.warp = static_cast<double>(*perFrameContext.warp);
-                *perPixelContext.cx = static_cast<double>(*perFrameContext.cx);
-                *perPixelContext.cy = static_cast<double>(*perFrameContext.cy);
-                *perPixelContext.dx = static_cast<double>(*perFrameContext.dx);
-                *perPixelContext.dy = static_cast<double>(*perFrameContext.dy);
-                *perPixelContext.sx = static_cast<double>(*perFrameContext.sx);
-                *perPixelContext.sy = static_cast<double>(*perFrameContext.sy);
-
-                perPixelContext.ExecutePerPixelCode();
-
-                curVertex.zoom = static_cast<float>(*perPixelContext.zoom);
-                curVertex.zoomExp = static_cast<float>(*perPixelContext.zoomexp);
-                curVertex.rot = static_cast<float>(*perPixelContext.rot);
-                curVertex.warp = static_cast<float>(*perPixelContext.warp);
-                curVertex.centerX = static_cast<float>(*perPixelContext.cx);
-                curVertex.centerY = static_cast<float>(*perPixelContext.cy);
-                curVertex.distanceX = static_cast<float>(*perPixelContext.dx);
-                curVertex.distanceY = static_cast<float>(*perPixelContext.dy);
-                curVertex.stretchX = static_cast<float>(*perPixelContext.sx);
-                curVertex.stretchY = static_cast<float>(*perPixelContext.sy);
-            }
-            else
-            {
-                curVertex.zoom = zoom;
-                curVertex.zoomExp = zoomExp;
-                curVertex.rot = rot;
-                curVertex.warp = warp;
-                curVertex.centerX = cx;
-                curVertex.centerY = cy;
-                curVertex.distanceX = dx;
-                curVertex.distanceY = dy;
-                curVertex.stretchX = sx;
-                curVertex.stretchY = sy;
-            }
+        return;
+    }
 
-            vertex++;
-        }
+    // Can't make this multithreaded as per-pixel code may use gmegabuf or regXX vars.
+    if (perPixelContext.perPixelCodeHandle)
+    {
+        // Execute per-vertex/per-pixel code if the preset uses it.
+        // The position inputs are read from the precalculated vertex inputs, all other inputs
+        // start with the per-frame values on each vertex.
+        constexpr size_t inputStride = sizeof(VertexInputs);
+        constexpr size_t outputStride = sizeof(MeshVertex);
+        auto& firstInputs = m_vertexInputs.front();
+        auto& firstVertex = m_vertices.front();
+
+        std::vector<ExpressionEngine::BatchInput> const inputs{
+            {perPixelContext.x, &firstInputs.x, inputStride},
+            {perPixelContext.y, &firstInputs.y, inputStride},
+            {perPixelContext.rad, &firstInputs.rad, inputStride},
+            {perPixelContext.ang, &firstInputs.ang, inputStride},
+            {perPixelContext.zoom, &zoom, 0},
+            {perPixelContext.zoomexp, &zoomExp, 0},
+            {perPixelContext.rot, &rot, 0},
+            {perPixelContext.warp, &warp, 0},
+            {perPixelContext.cx, &cx, 0},
+            {perPixelContext.cy, &cy, 0},
+            {perPixelContext.dx, &dx, 0},
+            {perPixelContext.dy, &dy, 0},
+            {perPixelContext.sx, &sx, 0},
+            {perPixelContext.sy, &sy, 0}};
+
+        std::vector<ExpressionEngine::BatchOutput> const outputs{
+            {perPixelContext.zoom, &firstVertex.zoom, outputStride},
+            {perPixelContext.zoomexp, &firstVertex.zoomExp, outputStride},
+            {perPixelContext.rot, &firstVertex.rot, outputStride},
+            {perPixelContext.warp, &firstVertex.warp, outputStride},
+            {perPixelContext.cx, &firstVertex.centerX, outputStride},
+            {perPixelContext.cy, &firstVertex.centerY, outputStride},
+            {perPixelContext.dx, &firstVertex.distanceX, outputStride},
+            {perPixelContext.dy, &firstVertex.distanceY, outputStride},
+            {perPixelContext.sx, &firstVertex.stretchX, outputStride},
+            {perPixelContext.sy, &firstVertex.stretchY, outputStride}};
+
+        perPixelContext.ExecutePerPixelCodeBatch(m_vertices.size(), inputs, outputs);
+
+        return;
+    }
+
+    // No position-dependent code, all vertices get the same values.
+    for (auto& curVertex : m_vertices)
+    {
+        curVertex.zoom = static_cast<float>(zoom);
+        curVertex.zoomExp = static_cast<float>(zoomExp);
+        curVertex.rot = static_cast<float>(rot);
+        curVertex.warp = static_cast<float>(warp);
+        curVertex.centerX = static_cast<float>(cx);
+        curVertex.centerY = static_cast<float>(cy);
+        curVertex.distanceX = static_cast<float>(dx);
+        curVertex.distanceY = static_cast<float>(dy);
+        curVertex.stretchX = static_cast<float>(sx);
+        curVertex.stretchY = static_cast<float>(sy);
     }
 }
 
@@ -294,7 +453,8 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
                               const PerFrameContext& perFrameContext)
 {
     // Warp stuff
-    float const warpTime = presetState.renderContext.time * presetState.warpAnimSpeed;
+    auto const& renderContext = presetState.drawnFrame.renderContext;
+    float const warpTime = renderContext.time * presetState.warpAnimSpeed;
     float const warpScaleInverse = 1.0f / presetState.warpScale;
     glm::vec4 const warpFactors{
         11.68f + 4.0f * cosf(warpTime * 1.413f + 10),
@@ -304,8 +464,8 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
     };
 
     // Texel alignment
-    glm::vec2 const texelOffsets{0.5f / static_cast<float>(presetState.renderContext.viewportSizeX),
-                                 0.5f / static_cast<float>(presetState.renderContext.viewportSizeY)};
+    glm::vec2 const texelOffsets{0.5f / static_cast<float>(renderContext.viewportSizeX),
+                                 0.5f / static_cast<float>(renderContext.viewportSizeY)};
 
     // Decay
     float decay = static_cast<float>(*perFrameContext.decay);
@@ -317,36 +477,40 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
     }
 
     // No blending between presets here, so we make sure blending is disabled.
-    glDisable(GL_BLEND);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.SetBlend(false);
 
+    Renderer::Shader* shader{};
     if (!m_warpShader)
     {
-        m_perPixelMeshShader.Bind();
-        m_perPixelMeshShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-        m_perPixelMeshShader.SetUniformInt("texture_sampler", 0);
-        m_perPixelMeshShader.SetUniformFloat4("aspect", {presetState.renderContext.aspectX,
-                                                         presetState.renderContext.aspectY,
-                                                         presetState.renderContext.invAspectX,
-                                                         presetState.renderContext.invAspectY});
-        m_perPixelMeshShader.SetUniformFloat("warpTime", warpTime);
-        m_perPixelMeshShader.SetUniformFloat("warpScaleInverse", warpScaleInverse);
-        m_perPixelMeshShader.SetUniformFloat4("warpFactors", warpFactors);
-        m_perPixelMeshShader.SetUniformFloat2("texelOffset", texelOffsets);
-        m_perPixelMeshShader.SetUniformFloat("decay", decay);
+        shader = m_perPixelEquationsOnGpu ? &m_perPixelEquationsShader : &m_perPixelMeshShader;
+        shader->Bind();
+        shader->SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
+        shader->SetUniformInt("texture_sampler", 0);
     }
     else
     {
         m_warpShader->LoadVariables(presetState, perFrameContext);
-        auto& shader = m_warpShader->Shader();
-        shader.SetUniformFloat4("aspect", {presetState.renderContext.aspectX,
-                                           presetState.renderContext.aspectY,
-                                           presetState.renderContext.invAspectX,
-                                           presetState.renderContext.invAspectY});
-        shader.SetUniformFloat("warpTime", warpTime);
-        shader.SetUniformFloat("warpScaleInverse", warpScaleInverse);
-        shader.SetUniformFloat4("warpFactors", warpFactors);
-        shader.SetUniformFloat2("texelOffset", texelOffsets);
-        shader.SetUniformFloat("decay", decay);
+        shader = &m_warpShader->Shader();
+    }
+
+    shader->SetUniformFloat4("aspect", {renderContext.aspectX,
+                                        renderContext.aspectY,
+                                        renderContext.invAspectX,
+                                        renderContext.invAspectY});
+    shader->SetUniformFloat("warpTime", warpTime);
+    shader->SetUniformFloat("warpScaleInverse", warpScaleInverse);
+    shader->SetUniformFloat4("warpFactors", warpFactors);
+    shader->SetUniformFloat2("texelOffset", texelOffsets);
+    shader->SetUniformFloat("decay", decay);
+
+    if (m_perPixelEquationsOnGpu)
+    {
+        auto const& uniforms = m_drawnFrame.perPixelEquationsUniforms;
+        for (size_t index = 0; index < uniforms.size(); index++)
+        {
+            shader->SetUniformFloat(PerPixelGlslTranslator::UniformName(index).c_str(), uniforms[index]);
+        }
     }
 
     assert(!presetState.mainTexture.expired());
@@ -363,40 +527,37 @@ void PerPixelMesh::WarpedBlit(const PresetState& presetState,
     }
     m_perPixelSampler.Bind(0);
 
-    glBindVertexArray(m_vaoID);
+    stateCache.BindVertexArray(m_vaoID);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
-    int trianglesPerBatch = static_cast<int>(m_drawVertices.size() / 3 - 4);
-    int triangleCount = m_gridSizeX * m_gridSizeY * 2; // Two triangles per quad/grid cell.
-    int sourceIndex = 0;
+    auto const& triangleVertices = m_drawnFrame.triangleVertices;
+    // Orphans the previous frame's buffer, so the driver doesn't need to wait until it was drawn.
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(MeshVertex) * triangleVertices.size()), triangleVertices.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(triangleVertices.size()));
 
-    while (sourceIndex < triangleCount * 3)
-    {
-        int trianglesQueued = 0;
-        int vertex = 0;
-        while (trianglesQueued < trianglesPerBatch && sourceIndex < triangleCount * 3)
-        {
-            // Copy one triangle/3 vertices
-            for (int i = 0; i < 3; i++)
-            {
-                m_drawVertices[vertex++] = m_vertices[m_listIndices[sourceIndex++]];
-            }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-            trianglesQueued++;
-        }
+    Renderer::Sampler::Unbind(0);
+}
 
-        if (trianglesQueued > 0)
-        {
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(MeshVertex) * trianglesQueued * 3, m_drawVertices.data());
-            glDrawArrays(GL_TRIANGLES, 0, trianglesQueued * 3);
-        }
+auto PerPixelMesh::PerPixelEquationsVertexShader(const PerPixelContext& perPixelContext) -> std::string
+{
+    auto const& perPixelEquations = perPixelContext.glslTranslator.Source();
+    if (perPixelEquations.empty())
+    {
+        return {};
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Insert the translated code right after the version header.
+    auto vertexShader = MilkdropStaticShaders::Get()->GetPresetWarpVertexShader();
+    auto const headerEnd = vertexShader.find('\n');
+    if (headerEnd == std::string::npos)
+    {
+        return {};
+    }
 
-    Renderer::Sampler::Unbind(0);
-    Renderer::Shader::Unbind();
+    vertexShader.insert(headerEnd + 1, perPixelEquations);
+    return vertexShader;
 }
 
 } // namespace MilkdropPreset
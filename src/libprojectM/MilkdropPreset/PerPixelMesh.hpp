@@ -3,7 +3,10 @@
 #include <Renderer/RenderItem.hpp>
 #include <Renderer/Shader.hpp>
 
+#include <projectm-eval.h>
+
 #include <cstdint>
+#include <string>
 #include <vector>
 
 namespace libprojectM {
@@ -41,20 +44,55 @@ public:
     void LoadWarpShader(const PresetState& presetState);
 
     /**
-     * @brief Loads the required textures and compiles the warp shader.
+     * @brief Loads the required textures and starts compiling the warp shader.
+     *
+     * If the per-pixel code could be translated to GLSL, the warp vertex shader is compiled with
+     * the translated code. If this fails, the per-pixel code is evaluated on the CPU.
+     *
+     * The result is checked in FinishCompilation(), which must be called before drawing.
+     *
      * @param presetState The preset state to retrieve the configuration values from.
+     * @param perPixelContext The per-pixel code context with the translated GLSL code.
+     */
+    void CompileWarpShader(PresetState& presetState, const PerPixelContext& perPixelContext);
+
+    /**
+     * @brief Returns whether the mesh and warp shaders are ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the mesh and warp shaders and applies the fallbacks if compilation failed.
+     * @throws Renderer::ShaderException Thrown if the built-in mesh shader failed to compile.
+     * @param presetState The preset state to update the required blur level in.
      */
-    void CompileWarpShader(PresetState& presetState);
+    void FinishCompilation(PresetState& presetState);
 
     /**
-     * @brief Renders the transformation mesh.
+     * @brief Calculates the transformation mesh for the next frame.
+     * Only runs on the CPU and doesn't issue any OpenGL calls.
      * @param presetState The preset state to retrieve the configuration values from.
      * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
      * @param perPixelContext The per-pixel code context to use.
      */
+    void Prepare(const PresetState& presetState,
+                 const PerFrameContext& perFrameContext,
+                 PerPixelContext& perPixelContext);
+
+    /**
+     * @brief Hands the mesh calculated in the last Prepare() call over to Draw().
+     * Prepare() can then calculate the next frame while the current one is drawn.
+     */
+    void SwapPreparedFrame();
+
+    /**
+     * @brief Renders the transformation mesh handed over in the last SwapPreparedFrame() call.
+     * @param presetState The preset state to retrieve the configuration values from.
+     * @param presetPerFrameContext The per-frame context of the drawn frame.
+     */
     void Draw(const PresetState& presetState,
-              const PerFrameContext& perFrameContext,
-              PerPixelContext& perPixelContext);
+              const PerFrameContext& perFrameContext);
 
 
 private:
@@ -84,6 +122,24 @@ private:
 
     using VertexList = std::vector<MeshVertex>;
 
+    /**
+     * Mesh data calculated in Prepare() and uploaded in Draw().
+     */
+    struct FrameData {
+        VertexList triangleVertices;                  //!< The vertices of all mesh triangles, in drawing order.
+        std::vector<float> perPixelEquationsUniforms; //!< Uniform values for the per-pixel code evaluated on the GPU.
+    };
+
+    /**
+     * Per-pixel code input values of a mesh vertex.
+     */
+    struct VertexInputs {
+        PRJM_EVAL_F x{};
+        PRJM_EVAL_F y{};
+        PRJM_EVAL_F rad{};
+        PRJM_EVAL_F ang{};
+    };
+
     /**
      * @brief Initializes the vertex array and fills in static data if needed.
      *
@@ -97,12 +153,10 @@ private:
     /**
      * @brief Executes the per-pixel code and calculates the u/v coordinates.
      * The x/y coordinates are either a static grid or computed by the per-vertex expression.
-     * @param presetState The preset state to retrieve the configuration values from.
      * @param presetPerFrameContext The per-frame context to retrieve the initial vars from.
      * @param perPixelContext The per-pixel code context to use.
      */
-    void CalculateMesh(const PresetState& presetState,
-                       const PerFrameContext& perFrameContext,
+    void CalculateMesh(const PerFrameContext& perFrameContext,
                        PerPixelContext& perPixelContext);
 
     /**
@@ -111,20 +165,37 @@ private:
      */
     void WarpedBlit(const PresetState& presetState, const PerFrameContext& perFrameContext);
 
+    /**
+     * @brief Returns the warp vertex shader with the translated per-pixel code inserted.
+     * @param perPixelContext The per-pixel code context with the translated GLSL code.
+     * @return The vertex shader source, or an empty string if the code can't run on the GPU.
+     */
+    static auto PerPixelEquationsVertexShader(const PerPixelContext& perPixelContext) -> std::string;
+
     int m_gridSizeX{}; //!< Warp mesh X resolution.
     int m_gridSizeY{}; //!< Warp mesh Y resolution.
 
     int m_viewportWidth{};  //!< Last known viewport width.
     int m_viewportHeight{}; //!< Last known viewport height.
 
-    VertexList m_vertices; //!< The calculated mesh vertices.
+    VertexList m_vertices;                   //!< The calculated mesh vertices.
+    std::vector<VertexInputs> m_vertexInputs; //!< The per-pixel code inputs of each vertex.
 
     std::vector<int> m_listIndices; //!< List of vertex indices to render.
-    VertexList m_drawVertices;      //!< Temp data buffer for the vertices to be drawn.
+
+    FrameData m_preparedFrame; //!< Mesh data of the frame being prepared.
+    FrameData m_drawnFrame;    //!< Mesh data of the frame being drawn.
 
     Renderer::Shader m_perPixelMeshShader;                            //!< Special shader which calculates the per-pixel UV coordinates.
+    Renderer::Shader m_perPixelEquationsShader;                       //!< Default warp shader with the per-pixel code evaluated in the vertex shader.
     std::unique_ptr<MilkdropShader> m_warpShader;           //!< The warp shader. Either preset-defined or a default shader.
     Renderer::Sampler m_perPixelSampler{GL_CLAMP_TO_EDGE, GL_LINEAR}; //!< The main texture sampler.
+
+    bool m_perPixelEquationsOnGpu{false};           //!< True if the per-pixel code is evaluated in the warp vertex shader.
+
+    bool m_warpShaderPending{false};                //!< True between CompileWarpShader() and FinishCompilation().
+    std::string m_perPixelEquationsVertexShader;    //!< Translated per-pixel vertex shader, kept until the warp shader is compiled.
+    size_t m_perPixelEquationsUniformCount{};       //!< Number of per-pixel uniforms, used if the vertex shader compiles.
 };
 
 } // namespace MilkdropPreset
@@ -0,0 +1,461 @@
+#include "PresetBundle.hpp"
+
+#include "Constants.hpp"
+#include "MilkdropShader.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+constexpr const char* PresetBundle::FileExtension;
+constexpr uint32_t PresetBundle::FormatVersion;
+constexpr size_t PresetBundle::HeaderSize;
+
+namespace {
+
+constexpr char Magic[8]{'P', 'R', 'J', 'M', 'B', 'N', 'D', 'L'}; //!< Magic bytes at the start of each bundle.
+constexpr size_t MaxBundleSize{0x1000000};                       //!< Maximum size of a bundle file. Used for sanity checks.
+
+constexpr size_t StringEntrySize{8};      //!< Offset and size.
+constexpr size_t StringPairEntrySize{16}; //!< Two string entries, for values, code blocks and samplers.
+constexpr size_t ShaderEntrySize{16};     //!< Translation key and string entry.
+
+/**
+ * Header field offsets.
+ */
+enum HeaderField : size_t
+{
+    MagicOffset = 0,
+    FormatVersionOffset = 8,
+    ValueCountOffset = 12,
+    CodeBlockCountOffset = 16,
+    SamplerCountOffset = 20,
+    ShaderCountOffset = 24,
+    // 28: Reserved, always 0.
+    SourceChecksumOffset = 32,
+    SourceSizeOffset = 40,
+    PayloadChecksumOffset = 48,
+    FileSizeOffset = 56,
+    SourceModificationTimeOffset = 64
+};
+
+constexpr const char* WarpShaderPrefix{"warp_"};      //!< Code block prefix of the warp shader.
+constexpr const char* CompositeShaderPrefix{"comp_"}; //!< Code block prefix of the composite shader.
+
+template<typename T>
+void WriteInteger(std::string& data, size_t offset, T value)
+{
+    for (size_t byte = 0; byte < sizeof(T); byte++)
+    {
+        data[offset + byte] = static_cast<char>((value >> (byte * 8)) & 0xFF);
+    }
+}
+
+template<typename T>
+auto ReadInteger(const char* data, size_t offset) -> T
+{
+    T value{};
+    for (size_t byte = 0; byte < sizeof(T); byte++)
+    {
+        value |= static_cast<T>(static_cast<unsigned char>(data[offset + byte])) << (byte * 8);
+    }
+    return value;
+}
+
+/**
+ * @brief Returns the key prefixes of all code blocks read by PresetState::Initialize().
+ * @return The code block prefixes.
+ */
+auto CodeBlockPrefixes() -> std::vector<std::string>
+{
+    std::vector<std::string> prefixes{"per_frame_init_", "per_frame_", "per_pixel_", "warp_", "comp_"};
+
+    for (int i = 0; i < CustomWaveformCount; i++)
+    {
+        std::string const wavePrefix = "wave_" + std::to_string(i) + "_";
+        prefixes.push_back(wavePrefix + "init");
+        prefixes.push_back(wavePrefix + "per_frame");
+        prefixes.push_back(wavePrefix + "per_point");
+    }
+
+    for (int i = 0; i < CustomShapeCount; i++)
+    {
+        std::string const shapePrefix = "shape_" + std::to_string(i) + "_";
+        prefixes.push_back(shapePrefix + "init");
+        prefixes.push_back(shapePrefix + "per_frame");
+    }
+
+    return prefixes;
+}
+
+/**
+ * @brief Reads a string entry and checks that the string is inside the data.
+ * @param data The bundle data.
+ * @param size The bundle size.
+ * @param entryOffset The offset of the string entry.
+ * @param[out] value The string.
+ * @return True if the string is valid, false if it points outside the data.
+ */
+auto ReadString(const char* data, size_t size, size_t entryOffset, std::string& value) -> bool
+{
+    auto const stringOffset = static_cast<uint64_t>(ReadInteger<uint32_t>(data, entryOffset));
+    auto const stringSize = static_cast<uint64_t>(ReadInteger<uint32_t>(data, entryOffset + 4));
+    if (stringOffset < PresetBundle::HeaderSize || stringOffset + stringSize > size)
+    {
+        return false;
+    }
+
+    value.assign(data + stringOffset, stringSize);
+    return true;
+}
+
+} // namespace
+
+auto PresetBundle::Build(const std::string& sourceData, int64_t sourceModificationTime) -> bool
+{
+    PresetFileParser parser;
+    std::istringstream sourceStream(sourceData);
+    if (!parser.Read(sourceStream))
+    {
+        return false;
+    }
+
+    m_sourceChecksum = Utils::Fnv1aHash(sourceData.data(), sourceData.size());
+    m_sourceSize = sourceData.size();
+    m_sourceModificationTime = sourceModificationTime;
+
+    // Store each code block once instead of its numbered lines.
+    m_presetValues = parser.PresetValues();
+    m_codeBlocks.clear();
+    for (const auto& prefix : CodeBlockPrefixes())
+    {
+        auto code = parser.GetCode(prefix);
+        for (int index = 1; m_presetValues.erase(prefix + std::to_string(index)) > 0; index++)
+        {
+        }
+
+        if (!code.empty())
+        {
+            m_codeBlocks.emplace(prefix, std::move(code));
+        }
+    }
+
+    // Translate the shaders for both GLSL versions used by MilkdropStaticShaders.
+    m_warpShaderSamplers.clear();
+    m_compositeShaderSamplers.clear();
+    m_shaders.clear();
+    for (const auto& shader : {std::make_pair(WarpShaderPrefix, MilkdropShader::ShaderType::WarpShader),
+                               std::make_pair(CompositeShaderPrefix, MilkdropShader::ShaderType::CompositeShader)})
+    {
+        auto const code = m_codeBlocks.find(shader.first);
+        if (code == m_codeBlocks.end())
+        {
+            continue;
+        }
+
+        auto& samplerNames = shader.second == MilkdropShader::ShaderType::WarpShader ? m_warpShaderSamplers : m_compositeShaderSamplers;
+        samplerNames = MilkdropShader::ReferencedSamplerNames(code->second);
+
+        for (auto version : {M4::GLSLGenerator::Version_330, M4::GLSLGenerator::Version_300_ES})
+        {
+            try
+            {
+                uint64_t key{};
+                auto glsl = MilkdropShader::PrecompileShader(code->second, shader.second, version, key);
+                if (!glsl.empty())
+                {
+                    m_shaders[key] = std::move(glsl);
+                }
+            }
+            catch (Renderer::ShaderException&)
+            {
+                // Translated again and reported on load.
+            }
+        }
+    }
+
+    return true;
+}
+
+auto PresetBundle::Serialize() const -> std::string
+{
+    size_t const tableSize = (m_presetValues.size() + m_codeBlocks.size()) * StringPairEntrySize +
+                             (m_warpShaderSamplers.size() + m_compositeShaderSamplers.size()) * StringPairEntrySize +
+                             m_shaders.size() * ShaderEntrySize;
+
+    std::string data(HeaderSize + tableSize, '\0');
+    size_t entryOffset{HeaderSize};
+
+    // Appends the string data and writes the entry pointing to it.
+    auto addString = [&data, &entryOffset](const std::string& value) {
+        WriteInteger<uint32_t>(data, entryOffset, static_cast<uint32_t>(data.size()));
+        WriteInteger<uint32_t>(data, entryOffset + 4, static_cast<uint32_t>(value.size()));
+        entryOffset += StringEntrySize;
+        data.append(value);
+    };
+
+    for (const auto& value : m_presetValues)
+    {
+        addString(value.first);
+        addString(value.second);
+    }
+    for (const auto& codeBlock : m_codeBlocks)
+    {
+        addString(codeBlock.first);
+        addString(codeBlock.second);
+    }
+    for (const auto& samplerName : m_warpShaderSamplers)
+    {
+        addString(WarpShaderPrefix);
+        addString(samplerName);
+    }
+    for (const auto& samplerName : m_compositeShaderSamplers)
+    {
+        addString(CompositeShaderPrefix);
+        addString(samplerName);
+    }
+    for (const auto& shader : m_shaders)
+    {
+        WriteInteger<uint64_t>(data, entryOffset, shader.first);
+        entryOffset += 8;
+        addString(shader.second);
+    }
+
+    std::copy(std::begin(Magic), std::end(Magic), data.begin() + MagicOffset);
+    WriteInteger<uint32_t>(data, FormatVersionOffset, FormatVersion);
+    WriteInteger<uint32_t>(data, ValueCountOffset, static_cast<uint32_t>(m_presetValues.size()));
+    WriteInteger<uint32_t>(data, CodeBlockCountOffset, static_cast<uint32_t>(m_codeBlocks.size()));
+    WriteInteger<uint32_t>(data, SamplerCountOffset, static_cast<uint32_t>(m_warpShaderSamplers.size() + m_compositeShaderSamplers.size()));
+    WriteInteger<uint32_t>(data, ShaderCountOffset, static_cast<uint32_t>(m_shaders.size()));
+    WriteInteger<uint64_t>(data, SourceChecksumOffset, m_sourceChecksum);
+    WriteInteger<uint64_t>(data, SourceSizeOffset, m_sourceSize);
+    WriteInteger<uint64_t>(data, PayloadChecksumOffset, Utils::Fnv1aHash(data.data() + HeaderSize, data.size() - HeaderSize));
+    WriteInteger<uint64_t>(data, FileSizeOffset, data.size());
+    WriteInteger<int64_t>(data, SourceModificationTimeOffset, m_sourceModificationTime);
+
+    return data;
+}
+
+auto PresetBundle::Read(const char* data, size_t size) -> bool
+{
+    if (data == nullptr || size < HeaderSize || size > MaxBundleSize ||
+        !std::equal(std::begin(Magic), std::end(Magic), data + MagicOffset) ||
+        ReadInteger<uint32_t>(data, FormatVersionOffset) != FormatVersion ||
+        ReadInteger<uint64_t>(data, FileSizeOffset) != size)
+    {
+        return false;
+    }
+
+    auto const valueCount = static_cast<uint64_t>(ReadInteger<uint32_t>(data, ValueCountOffset));
+    auto const codeBlockCount = static_cast<uint64_t>(ReadInteger<uint32_t>(data, CodeBlockCountOffset));
+    auto const samplerCount = static_cast<uint64_t>(ReadInteger<uint32_t>(data, SamplerCountOffset));
+    auto const shaderCount = static_cast<uint64_t>(ReadInteger<uint32_t>(data, ShaderCountOffset));
+
+    uint64_t const tableSize = (valueCount + codeBlockCount) * StringPairEntrySize +
+                               samplerCount * StringPairEntrySize +
+                               shaderCount * ShaderEntrySize;
+    if (HeaderSize + tableSize > size ||
+        ReadInteger<uint64_t>(data, PayloadChecksumOffset) != Utils::Fnv1aHash(data + HeaderSize, size - HeaderSize))
+    {
+        return false;
+    }
+
+    PresetFileParser::ValueMap presetValues;
+    PresetFileParser::ValueMap codeBlocks;
+    std::set<std::string> warpShaderSamplers;
+    std::set<std::string> compositeShaderSamplers;
+    ShaderMap shaders;
+
+    size_t entryOffset{HeaderSize};
+    std::string key;
+    std::string value;
+
+    for (uint64_t index = 0; index < valueCount; index++, entryOffset += StringPairEntrySize)
+    {
+        if (!ReadString(data, size, entryOffset, key) || !ReadString(data, size, entryOffset + StringEntrySize, value))
+        {
+            return false;
+        }
+        presetValues.emplace(key, value);
+    }
+
+    for (uint64_t index = 0; index < codeBlockCount; index++, entryOffset += StringPairEntrySize)
+    {
+        if (!ReadString(data, size, entryOffset, key) || !ReadString(data, size, entryOffset + StringEntrySize, value))
+        {
+            return false;
+        }
+        codeBlocks.emplace(key, value);
+    }
+
+    for (uint64_t index = 0; index < samplerCount; index++, entryOffset += StringPairEntrySize)
+    {
+        if (!ReadString(data, size, entryOffset, key) || !ReadString(data, size, entryOffset + StringEntrySize, value))
+        {
+            return false;
+        }
+
+        if (key == WarpShaderPrefix)
+        {
+            warpShaderSamplers.insert(value);
+        }
+        else if (key == CompositeShaderPrefix)
+        {
+            compositeShaderSamplers.insert(value);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    for (uint64_t index = 0; index < shaderCount; index++, entryOffset += ShaderEntrySize)
+    {
+        if (!ReadString(data, size, entryOffset + 8, value))
+        {
+            return false;
+        }
+        shaders.emplace(ReadInteger<uint64_t>(data, entryOffset), value);
+    }
+
+    m_presetValues = std::move(presetValues);
+    m_codeBlocks = std::move(codeBlocks);
+    m_warpShaderSamplers = std::move(warpShaderSamplers);
+    m_compositeShaderSamplers = std::move(compositeShaderSamplers);
+    m_shaders = std::move(shaders);
+    m_sourceChecksum = ReadInteger<uint64_t>(data, SourceChecksumOffset);
+    m_sourceSize = ReadInteger<uint64_t>(data, SourceSizeOffset);
+    m_sourceModificationTime = ReadInteger<int64_t>(data, SourceModificationTimeOffset);
+
+    return true;
+}
+
+auto PresetBundle::Read(std::istream& bundleStream) -> bool
+{
+    if (!bundleStream.good())
+    {
+        return false;
+    }
+
+    bundleStream.seekg(0, bundleStream.end);
+    auto const fileSize = bundleStream.tellg();
+    bundleStream.seekg(0, bundleStream.beg);
+
+    if (fileSize < 0 || static_cast<size_t>(fileSize) > MaxBundleSize)
+    {
+        return false;
+    }
+
+    std::vector<char> bundleContents(static_cast<size_t>(fileSize));
+    bundleStream.read(bundleContents.data(), fileSize);
+
+    if (bundleStream.fail() || bundleStream.bad())
+    {
+        return false;
+    }
+
+    return Read(bundleContents.data(), bundleContents.size());
+}
+
+auto PresetBundle::Read(const std::string& bundleFile) -> bool
+{
+    std::ifstream bundleStream(bundleFile.c_str(), std::ios_base::in | std::ios_base::binary);
+    return Read(bundleStream);
+}
+
+auto PresetBundle::IsUpToDate(const std::string& sourceFile) const -> bool
+{
+    uint64_t fileSize{};
+    int64_t modificationTime{};
+    if (!Utils::GetFileInfo(sourceFile, fileSize, modificationTime))
+    {
+        // Bundles can be distributed without the source file.
+        return true;
+    }
+
+    if (fileSize != m_sourceSize)
+    {
+        return false;
+    }
+
+    // Only hash the contents if the file was touched, e.g. by copying it without its time stamp.
+    if (m_sourceModificationTime != 0 && modificationTime == m_sourceModificationTime)
+    {
+        return true;
+    }
+
+    std::ifstream sourceStream(sourceFile.c_str(), std::ios_base::in | std::ios_base::binary);
+    std::vector<char> sourceContents(static_cast<size_t>(fileSize));
+    sourceStream.read(sourceContents.data(), static_cast<std::streamsize>(fileSize));
+
+    return !sourceStream.fail() &&
+           Utils::Fnv1aHash(sourceContents.data(), sourceContents.size()) == m_sourceChecksum;
+}
+
+void PresetBundle::Apply(PresetFileParser& parser) const
+{
+    parser.Assign(m_presetValues, m_codeBlocks);
+}
+
+auto PresetBundle::Shaders() const -> const ShaderMap&
+{
+    return m_shaders;
+}
+
+auto PresetBundle::WarpShaderSamplers() const -> const std::set<std::string>&
+{
+    return m_warpShaderSamplers;
+}
+
+auto PresetBundle::CompositeShaderSamplers() const -> const std::set<std::string>&
+{
+    return m_compositeShaderSamplers;
+}
+
+auto PresetBundle::TextureNames() const -> std::set<std::string>
+{
+    auto textureNames = MilkdropShader::TextureNames(m_warpShaderSamplers);
+    auto const compositeTextureNames = MilkdropShader::TextureNames(m_compositeShaderSamplers);
+    textureNames.insert(compositeTextureNames.begin(), compositeTextureNames.end());
+
+    return textureNames;
+}
+
+auto PresetBundle::IsBundleFileName(const std::string& fileName) -> bool
+{
+    size_t const extensionLength = std::strlen(FileExtension);
+    return fileName.length() > extensionLength &&
+           Utils::ToLower(fileName.substr(fileName.length() - extensionLength)) == FileExtension;
+}
+
+auto PresetBundle::IsBundle(std::istream& presetStream) -> bool
+{
+    char magic[sizeof(Magic)]{};
+    presetStream.read(magic, sizeof(magic));
+    bool const isBundle = presetStream.gcount() == sizeof(magic) &&
+                          std::equal(std::begin(Magic), std::end(Magic), magic);
+
+    presetStream.clear();
+    presetStream.seekg(0, presetStream.beg);
+
+    return isBundle;
+}
+
+auto PresetBundle::SourceFileName(const std::string& bundleFile) -> std::string
+{
+    if (!IsBundleFileName(bundleFile))
+    {
+        return bundleFile;
+    }
+
+    return bundleFile.substr(0, bundleFile.length() - std::strlen(FileExtension)) + ".milk";
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
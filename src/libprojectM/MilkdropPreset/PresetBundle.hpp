@@ -0,0 +1,172 @@
+/**
+ * @file PresetBundle.hpp
+ * @brief Reads and writes precompiled Milkdrop preset bundles.
+ */
+#pragma once
+
+#include "PresetFileParser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <set>
+#include <string>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief A Milkdrop preset with the parsing and shader translation already done.
+ *
+ * Loading a .milk file splits each line into a key/value pair, assembles the code blocks from the
+ * numbered lines and translates both preset shaders from HLSL to GLSL, which takes most of the
+ * load time. A bundle stores the result of these steps, so loading it only has to create the
+ * expression code contexts and the OpenGL programs.
+ *
+ * The translated shaders are stored for each supported GLSL version, indexed by their
+ * MilkdropShader::TranslationKey(). If the textures found on load don't match the ones predicted
+ * when building the bundle, the key differs and the shader is translated as usual. The samplers
+ * referenced by each shader are stored as well, so the shader code isn't searched again on load.
+ *
+ * File layout, with all integers stored in little-endian byte order:
+ * - A 72 byte header with the magic bytes, the format version, the number of entries in each table,
+ *   the size, checksum and modification time of the source preset and the checksum of all data
+ *   after the header.
+ * - The value, code block, sampler and shader tables. Strings are stored as a 32-bit offset from the
+ *   start of the file and a 32-bit size. Samplers are stored with the code block prefix of their
+ *   shader, shaders additionally have a 64-bit translation key.
+ * - The string data referenced by the tables.
+ *
+ * As all strings are referenced by their offset, the bundle can be read directly from a
+ * memory-mapped file.
+ */
+class PresetBundle
+{
+public:
+    using ShaderMap = std::map<uint64_t, std::string>; //!< Translated GLSL shaders, indexed by translation key.
+
+    static constexpr const char* FileExtension{".milkb"}; //!< File extension of preset bundles.
+    static constexpr uint32_t FormatVersion{2};           //!< Current format version. Older or newer bundles are rejected.
+    static constexpr size_t HeaderSize{72};               //!< Size of the file header in bytes.
+
+    /**
+     * @brief Creates a bundle from the contents of a .milk file.
+     *
+     * Both preset shaders are translated for all GLSL versions supported by the generator. Shaders
+     * which can't be precompiled or fail to translate are left out and translated on load.
+     *
+     * @param sourceData The preset file contents.
+     * @param sourceModificationTime The modification time of the preset file as returned by
+     *                               Utils::GetFileInfo(), or 0 if unknown.
+     * @return True if the preset was parsed successfully, false if it isn't a valid preset file.
+     */
+    auto Build(const std::string& sourceData, int64_t sourceModificationTime = 0) -> bool;
+
+    /**
+     * @brief Writes the bundle into a byte buffer.
+     * @return The serialized bundle.
+     */
+    auto Serialize() const -> std::string;
+
+    /**
+     * @brief Reads a bundle from a memory buffer.
+     * @param data The bundle data, e.g. a memory-mapped file.
+     * @param size The size of the data in bytes.
+     * @return True if the bundle was read successfully, false if the data is invalid, damaged or has a different format version.
+     */
+    auto Read(const char* data, size_t size) -> bool;
+
+    /**
+     * @brief Reads a bundle from a stream.
+     * @param bundleStream The stream to read the bundle from.
+     * @return True if the bundle was read successfully, false otherwise.
+     */
+    auto Read(std::istream& bundleStream) -> bool;
+
+    /**
+     * @brief Reads a bundle file.
+     * @param bundleFile The file name.
+     * @return True if the bundle was read successfully, false otherwise.
+     */
+    auto Read(const std::string& bundleFile) -> bool;
+
+    /**
+     * @brief Checks whether the bundle was built from the current version of the source file.
+     *
+     * The file is only read and hashed if it has the same size, but a different modification time
+     * than when the bundle was built.
+     *
+     * @param sourceFile The .milk file name.
+     * @return True if the source file doesn't exist or has the same size and checksum as when
+     *         the bundle was built, false if the file was modified.
+     */
+    auto IsUpToDate(const std::string& sourceFile) const -> bool;
+
+    /**
+     * @brief Fills a parser with the stored preset values and code blocks.
+     * @param parser The parser to pass to PresetState::Initialize().
+     */
+    void Apply(PresetFileParser& parser) const;
+
+    /**
+     * @brief Returns the translated shaders.
+     * @return The GLSL shaders for PresetState::precompiledShaders.
+     */
+    auto Shaders() const -> const ShaderMap&;
+
+    /**
+     * @brief Returns the samplers referenced by the warp shader.
+     * @return The sampler names for PresetState::warpShaderSamplers.
+     */
+    auto WarpShaderSamplers() const -> const std::set<std::string>&;
+
+    /**
+     * @brief Returns the samplers referenced by the composite shader.
+     * @return The sampler names for PresetState::compositeShaderSamplers.
+     */
+    auto CompositeShaderSamplers() const -> const std::set<std::string>&;
+
+    /**
+     * @brief Returns the textures loaded from files by the preset shaders.
+     * @return The unqualified texture names, without the built-in and random textures.
+     */
+    auto TextureNames() const -> std::set<std::string>;
+
+    /**
+     * @brief Returns whether the file name has the bundle file extension.
+     * @param fileName The file name to check.
+     * @return True if the file is a preset bundle.
+     */
+    static auto IsBundleFileName(const std::string& fileName) -> bool;
+
+    /**
+     * @brief Returns whether the stream starts with the bundle magic bytes.
+     *
+     * The stream is rewound to the start afterwards.
+     *
+     * @param presetStream The preset data stream.
+     * @return True if the stream contains a preset bundle.
+     */
+    static auto IsBundle(std::istream& presetStream) -> bool;
+
+    /**
+     * @brief Returns the name of the .milk file the bundle is usually built from.
+     * @param bundleFile The bundle file name.
+     * @return The bundle file name with the extension replaced by ".milk".
+     */
+    static auto SourceFileName(const std::string& bundleFile) -> std::string;
+
+private:
+    PresetFileParser::ValueMap m_presetValues;       //!< Preset values without the code block lines.
+    PresetFileParser::ValueMap m_codeBlocks;         //!< Assembled code blocks, indexed by key prefix.
+    std::set<std::string> m_warpShaderSamplers;      //!< Samplers referenced by the warp shader.
+    std::set<std::string> m_compositeShaderSamplers; //!< Samplers referenced by the composite shader.
+    ShaderMap m_shaders;                             //!< Translated GLSL shaders.
+    uint64_t m_sourceChecksum{};                     //!< FNV-1a hash of the source preset file.
+    uint64_t m_sourceSize{};                         //!< Size of the source preset file in bytes.
+    int64_t m_sourceModificationTime{};              //!< Modification time of the source preset file, 0 if unknown.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <functional>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 namespace libprojectM {
@@ -75,8 +76,20 @@ auto PresetFileParser::Read(std::istream& presetStream) -> bool
     return !m_presetValues.empty();
 }
 
+void PresetFileParser::Assign(ValueMap presetValues, ValueMap codeBlocks)
+{
+    m_presetValues = std::move(presetValues);
+    m_codeBlocks = std::move(codeBlocks);
+}
+
 auto PresetFileParser::GetCode(const std::string& keyPrefix) const -> std::string
 {
+    auto const codeBlock = m_codeBlocks.find(keyPrefix);
+    if (codeBlock != m_codeBlocks.end())
+    {
+        return codeBlock->second;
+    }
+
     std::stringstream code;                        //!< The parsed code
     std::string key(keyPrefix.length() + 5, '\0'); //!< Allocate a string that can hold up to 5 digits.
 
@@ -34,6 +34,16 @@ public:
      */
     [[nodiscard]] auto Read(std::istream& presetStream) -> bool;
 
+    /**
+     * @brief Fills the parser with the values and code blocks stored in a preset bundle.
+     *
+     * GetCode() returns the given code blocks as-is instead of assembling them from the values.
+     *
+     * @param presetValues The preset values, usually without the lines of the code blocks.
+     * @param codeBlocks The assembled code blocks, indexed by their key prefix.
+     */
+    void Assign(ValueMap presetValues, ValueMap codeBlocks);
+
     /**
      * @brief Returns a block of code, ready for parsing or use in shader compilation.
      *
@@ -119,6 +129,7 @@ protected:
 
 private:
     ValueMap m_presetValues; //!< Map with preset keys and their value.
+    ValueMap m_codeBlocks;   //!< Pre-assembled code blocks, indexed by key prefix.
 };
 
 } // namespace MilkdropPreset
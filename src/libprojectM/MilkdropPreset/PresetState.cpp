@@ -5,7 +5,7 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <random>
+#include <cstdlib>
 
 namespace libprojectM {
 namespace MilkdropPreset {
@@ -13,28 +13,35 @@ namespace MilkdropPreset {
 const glm::mat4 PresetState::orthogonalProjection = glm::ortho(-1.0f, 1.0f, 1.0f, -1.0f, -40.0f, 40.0f);
 const glm::mat4 PresetState::orthogonalProjectionFlipped = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -40.0f, 40.0f);
 
-PresetState::PresetState()
-    : globalMemory(projectm_eval_memory_buffer_create())
+PresetState::PresetState(ExpressionEngine& engine)
+    : expressionEngine(engine)
+    , globalMemory(expressionEngine.CreateMemoryBuffer())
 {
     auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
-    untexturedShader.CompileProgram(staticShaders->GetUntexturedDrawVertexShader(),
-                                    staticShaders->GetUntexturedDrawFragmentShader());
-    texturedShader.CompileProgram(staticShaders->GetTexturedDrawVertexShader(),
-                                  staticShaders->GetTexturedDrawFragmentShader());
-
-    std::random_device randomDevice;
-    std::mt19937 randomGenerator(randomDevice());
-    std::uniform_int_distribution<> distrib(0, std::numeric_limits<int>::max());
-
-    hueRandomOffsets[0] = static_cast<float>(distrib(randomGenerator) % 64841L) * 0.01f;
-    hueRandomOffsets[1] = static_cast<float>(distrib(randomGenerator) % 53751L) * 0.01f;
-    hueRandomOffsets[2] = static_cast<float>(distrib(randomGenerator) % 42661L) * 0.01f;
-    hueRandomOffsets[3] = static_cast<float>(distrib(randomGenerator) % 31571L) * 0.01f;
+    untexturedShader.CompileProgramAsync(staticShaders->GetUntexturedDrawVertexShader(),
+                                         staticShaders->GetUntexturedDrawFragmentShader());
+    texturedShader.CompileProgramAsync(staticShaders->GetTexturedDrawVertexShader(),
+                                       staticShaders->GetTexturedDrawFragmentShader());
+
+    // Uses rand() like the shaders' rand_preset values, so both follow the seed set with srand().
+    hueRandomOffsets[0] = static_cast<float>(rand() % 64841L) * 0.01f;
+    hueRandomOffsets[1] = static_cast<float>(rand() % 53751L) * 0.01f;
+    hueRandomOffsets[2] = static_cast<float>(rand() % 42661L) * 0.01f;
+    hueRandomOffsets[3] = static_cast<float>(rand() % 31571L) * 0.01f;
 }
 
-PresetState::~PresetState()
+auto PresetState::IsCompilationComplete() const -> bool
 {
-    projectm_eval_memory_buffer_destroy(globalMemory);
+    return untexturedShader.IsCompilationComplete() &&
+           texturedShader.IsCompilationComplete() &&
+           blurTexture.IsCompilationComplete();
+}
+
+void PresetState::FinishCompilation()
+{
+    untexturedShader.FinishCompilation();
+    texturedShader.FinishCompilation();
+    blurTexture.FinishCompilation();
 }
 
 void PresetState::Initialize(PresetFileParser& parsedFile)
@@ -8,6 +8,8 @@
 #include "Constants.hpp"
 
 #include "BlurTexture.hpp"
+#include "ExpressionEngine.hpp"
+#include "SharedVariableBlock.hpp"
 
 #include <Audio/FrameAudioData.hpp>
 
@@ -15,8 +17,10 @@
 #include <Renderer/Shader.hpp>
 #include <Renderer/TextureSamplerDescriptor.hpp>
 
-#include <projectm-eval.h>
-
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 
 namespace libprojectM {
@@ -35,9 +39,11 @@ using BlendableFloat = float; //!< Currently a placeholder to mark blendable val
 class PresetState
 {
 public:
-    PresetState();
-
-    ~PresetState();
+    /**
+     * @brief Constructor.
+     * @param engine The expression engine used to compile and run the preset code.
+     */
+    explicit PresetState(ExpressionEngine& engine = ExpressionEngine::Default());
 
     /**
      * @brief Loads the initial values and code from the preset file.
@@ -45,6 +51,18 @@ public:
      */
     void Initialize(PresetFileParser& parsedFile);
 
+    /**
+     * @brief Returns whether the shaders compiled in the constructor are ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the shaders compiled in the constructor.
+     * @throws Renderer::ShaderException Thrown if a shader failed to compile.
+     */
+    void FinishCompilation();
+
     BlendableFloat gammaAdj{2.0f};
     BlendableFloat videoEchoZoom{2.0f};
     BlendableFloat videoEchoAlpha{0.0f};
@@ -126,13 +144,29 @@ public:
 
     std::array<float, 4> hueRandomOffsets; //!< Per-preset constant offsets for the hue animation
 
-    projectm_eval_mem_buffer globalMemory{nullptr};  //!< gmegabuf data. Using per-frame buffers in projectM to reduce interference.
-    double globalRegisters[100]{};                   //!< Global reg00-reg99 variables.
-    std::array<double, QVarCount> frameQVariables{}; //!< Q variables after per-frame code evaluation.
+    ExpressionEngine& expressionEngine;                               //!< The engine used to compile and run all preset code.
+    std::unique_ptr<ExpressionEngine::MemoryBuffer> globalMemory;     //!< gmegabuf data. Using per-frame buffers in projectM to reduce interference.
+    double globalRegisters[100]{};                                    //!< Global reg00-reg99 variables.
+    std::array<double, QVarCount> frameQVariables{};                  //!< Q variables after per-frame code evaluation.
+    SharedVariableBlock frameVariables;                               //!< Time, audio and Q values shared by all code contexts.
 
     libprojectM::Audio::FrameAudioData audioData; //!< Holds audio/spectrum data and values for beat detection.
     Renderer::RenderContext renderContext;        //!< Current renderer state data like viewport size and generic shaders.
 
+    /**
+     * @brief Inputs of the frame currently being drawn.
+     *
+     * audioData, renderContext and frameQVariables belong to the frame being prepared, which
+     * may already be the next one. Everything issuing OpenGL calls reads this copy instead.
+     */
+    struct DrawnFrame {
+        libprojectM::Audio::FrameAudioData audioData;     //!< Audio data of the drawn frame.
+        Renderer::RenderContext renderContext;            //!< Render context of the drawn frame.
+        std::array<double, QVarCount> frameQVariables{}; //!< Q variables after the drawn frame's per-frame code.
+    };
+
+    DrawnFrame drawnFrame; //!< Inputs of the frame currently being drawn, updated when the prepared frame is handed over.
+
     std::string perFrameInitCode; //!< Preset init code, run once on load.
     std::string perFrameCode;     //!< Preset per-frame code, run once at the start of each frame.
     std::string perPixelCode;     //!< Preset per-pixel/per-vertex code, run once per warp mesh vertex.
@@ -147,6 +181,10 @@ public:
     std::string warpShader;      //!< Warp shader code.
     std::string compositeShader; //!< Composite shader code.
 
+    std::map<uint64_t, std::string> precompiledShaders; //!< GLSL code of both shaders from a preset bundle, indexed by MilkdropShader::TranslationKey().
+    std::set<std::string> warpShaderSamplers;           //!< Samplers referenced by the warp shader, from a preset bundle. Empty if the code has to be searched.
+    std::set<std::string> compositeShaderSamplers;      //!< Samplers referenced by the composite shader, from a preset bundle. Empty if the code has to be searched.
+
     Renderer::Shader untexturedShader; //!< Shader used to draw untextured primitives, e.g. waveforms.
     Renderer::Shader texturedShader;   //!< Shader used to draw textured primitives, e.g. textured shapes and the warp mesh.
 
@@ -156,7 +194,7 @@ public:
     std::map<int, Renderer::TextureSamplerDescriptor> randomTextureDescriptors; //!< Descriptors for random texture IDs. Should be the same across both warp and comp shaders.
 
     static const glm::mat4 orthogonalProjection;        //!< Projection matrix that transforms DirectX screen-space coordinates into the OpenGL coordinate frame.
-    static const glm::mat4 orthogonalProjectionFlipped; //!< Projection matrix that transforms DirectX screen-space coordinates into the OpenGL coordinate frame.
+    static const glm::mat4 orthogonalProjectionFlipped; //!< Same as orthogonalProjection, but vertically flipped. Used for all drawing into the preset framebuffer, which stores images bottom-up, so texture coordinates match the DirectX ones.
 };
 
 } // namespace MilkdropPreset
@@ -0,0 +1,122 @@
+#include "ProjectMEvalEngine.hpp"
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+namespace {
+
+class EvalMemoryBuffer : public ExpressionEngine::MemoryBuffer
+{
+public:
+    EvalMemoryBuffer()
+        : m_buffer(projectm_eval_memory_buffer_create())
+    {
+    }
+
+    ~EvalMemoryBuffer() override
+    {
+        projectm_eval_memory_buffer_destroy(m_buffer);
+    }
+
+    auto Handle() const -> projectm_eval_mem_buffer
+    {
+        return m_buffer;
+    }
+
+private:
+    projectm_eval_mem_buffer m_buffer{nullptr};
+};
+
+class EvalProgram : public ExpressionEngine::Program
+{
+public:
+    explicit EvalProgram(projectm_eval_code* code)
+        : m_code(code)
+    {
+    }
+
+    ~EvalProgram() override
+    {
+        projectm_eval_code_destroy(m_code);
+    }
+
+    void Execute() override
+    {
+        projectm_eval_code_execute(m_code);
+    }
+
+private:
+    projectm_eval_code* m_code{nullptr};
+};
+
+class EvalContext : public ExpressionEngine::Context
+{
+public:
+    EvalContext(projectm_eval_mem_buffer globalMemory, ExpressionEngine::GlobalRegisters* globalRegisters)
+        : m_context(projectm_eval_context_create(globalMemory, globalRegisters))
+    {
+    }
+
+    ~EvalContext() override
+    {
+        projectm_eval_context_destroy(m_context);
+    }
+
+    auto RegisterVariable(const std::string& name) -> PRJM_EVAL_F* override
+    {
+        return projectm_eval_context_register_variable(m_context, name.c_str());
+    }
+
+    void ResetVariables() override
+    {
+        projectm_eval_context_reset_variables(m_context);
+    }
+
+    auto Compile(const std::string& code) -> std::unique_ptr<ExpressionEngine::Program> override
+    {
+        auto* compiledCode = projectm_eval_code_compile(m_context, code.c_str());
+        if (compiledCode == nullptr)
+        {
+            return {};
+        }
+
+        return std::make_unique<EvalProgram>(compiledCode);
+    }
+
+    auto LastError(int& line, int& column) const -> std::string override
+    {
+        line = 0;
+        column = 0;
+
+        auto* errorMessage = projectm_eval_get_error(m_context, &line, &column);
+        if (errorMessage == nullptr)
+        {
+            return {};
+        }
+
+        return errorMessage;
+    }
+
+private:
+    projectm_eval_context* m_context{nullptr};
+};
+
+} // namespace
+
+auto ProjectMEvalEngine::Name() const -> std::string
+{
+    return "projectm-eval";
+}
+
+auto ProjectMEvalEngine::CreateMemoryBuffer() -> std::unique_ptr<MemoryBuffer>
+{
+    return std::make_unique<EvalMemoryBuffer>();
+}
+
+auto ProjectMEvalEngine::CreateContext(MemoryBuffer& globalMemory, GlobalRegisters* globalRegisters) -> std::unique_ptr<Context>
+{
+    return std::make_unique<EvalContext>(static_cast<EvalMemoryBuffer&>(globalMemory).Handle(), globalRegisters);
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ExpressionEngine.hpp"
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Expression engine implementation using the projectm-eval library.
+ *
+ * projectm-eval binds compiled code to the variables of the context it was compiled for and has
+ * no API to bind it to another context, so this engine doesn't use the ExpressionCache.
+ */
+class ProjectMEvalEngine : public ExpressionEngine
+{
+public:
+    auto Name() const -> std::string override;
+
+    auto CreateMemoryBuffer() -> std::unique_ptr<MemoryBuffer> override;
+
+    auto CreateContext(MemoryBuffer& globalMemory, GlobalRegisters* globalRegisters) -> std::unique_ptr<Context> override;
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,43 @@
+precision mediump float;
+
+in vec2 fragment_texture;
+
+uniform sampler2D texture_sampler;
+uniform vec4 _c0; // source texsize (.xy), and inverse (.zw)
+uniform vec4 _c1; // scale, bias, edge_darken_c1, edge_darken_c2
+uniform vec4 _c2; // sample offset (.xy)
+
+out vec4 color;
+
+void main(){
+    // DUAL FILTER DOWNSAMPLE:
+    #define srctexsize _c0
+    #define scale _c1.x
+    #define bias _c1.y
+    #define edge_darken_c1 _c1.z
+    #define edge_darken_c2 _c1.w
+
+    // The target is half the size of the source, so the center sample averages 2x2 source
+    // pixels and the diagonal samples each average the 2x2 pixels around one of its corners.
+    vec2 halfPixel = srctexsize.zw;
+
+    // Shifts the image like the horizontal passes of the exact blur.
+    vec2 uv = fragment_texture + _c2.xy;
+
+    vec3 blur = texture(texture_sampler, uv).xyz * 4.0;
+    blur += texture(texture_sampler, uv - halfPixel).xyz;
+    blur += texture(texture_sampler, uv + halfPixel).xyz;
+    blur += texture(texture_sampler, uv + vec2(halfPixel.x, -halfPixel.y)).xyz;
+    blur += texture(texture_sampler, uv - vec2(halfPixel.x, -halfPixel.y)).xyz;
+    blur = blur * 0.125 * scale + bias;
+
+    // tone it down at the edges (only done on the blur1 pass)
+    float t = min(min(fragment_texture.x, fragment_texture.y),
+    1.0 - max(fragment_texture.x, fragment_texture.y));
+    t = sqrt(t);
+    t = edge_darken_c1 + edge_darken_c2 * clamp(t * 5.0, 0.0, 1.0);
+    blur *= t;
+
+    color.xyz = blur;
+    color.w = 1.0;
+}
@@ -5,6 +5,12 @@ layout(location = 1) in vec4 vertex_color;
 layout(location = 2) in vec2 vertex_texture;
 layout(location = 3) in vec2 vertex_rad_ang;
 
+// Random hue colors of the four screen corners, interpolated over the mesh.
+uniform vec3 hue_shade_0;
+uniform vec3 hue_shade_1;
+uniform vec3 hue_shade_2;
+uniform vec3 hue_shade_3;
+
 out vec4 frag_COLOR;
 out vec2 frag_TEXCOORD0;
 out vec2 frag_TEXCOORD1;
@@ -12,7 +18,13 @@ out vec2 frag_TEXCOORD1;
 void main(){
     vec4 position = vec4(vertex_position, 0.0, 1.0);
     gl_Position = position;
-    frag_COLOR = vertex_color;
+
+    float x = vertex_position.x * 0.5 + 0.5;
+    float y = vertex_position.y * 0.5 + 0.5;
+    frag_COLOR = vec4(hue_shade_0 * x * y +
+                      hue_shade_1 * (1.0 - x) * y +
+                      hue_shade_2 * x * (1.0 - y) +
+                      hue_shade_3 * (1.0 - x) * (1.0 - y), 1.0);
     frag_TEXCOORD0 = vertex_texture;
     frag_TEXCOORD1 = vertex_rad_ang;
 }
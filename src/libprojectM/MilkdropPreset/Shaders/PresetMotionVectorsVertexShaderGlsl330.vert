@@ -1,45 +1,57 @@
 precision mediump float;
 
-layout(location = 0) in vec2 vertex_position;
 layout(location = 1) in vec4 vertex_color;
-layout(location = 2) in int vertex_index;
 
 uniform mat4 vertex_transformation;
-uniform float length_multiplier;
-uniform float minimum_length;
+uniform ivec2 grid_size;   // Number of vectors in X and Y direction.
+uniform vec4 grid_offset;  // Fractional grid size in xy, mv_dx/mv_dy in zw.
+uniform vec2 trail_length; // Length multiplier in x, minimum length in y.
 
 uniform sampler2D warp_coordinates;
 
 out vec4 fragment_color;
 
 void main() {
-    // Input positions are given in texture coordinates (0...1), not the usual
+    fragment_color = vertex_color;
+
+    // Each instance draws one vector, the grid is traversed row by row.
+    vec2 cell = vec2(float(gl_InstanceID % grid_size.x), float(gl_InstanceID / grid_size.x));
+
+    // Start positions are calculated in texture coordinates (0...1), not the usual
     // screen coordinates.
-    vec2 pos = vertex_position;
+    highp vec2 pos = (cell + 0.25) / (vec2(grid_size) + grid_offset.xy + 0.25 - 1.0) + vec2(grid_offset.z, -grid_offset.w);
 
-    if (vertex_index % 2 == 1)
+    // Vectors starting too close to the screen edges are skipped. Both end points are moved
+    // outside the clip volume, so the line is discarded.
+    if (any(lessThanEqual(pos, vec2(0.0001))) || any(greaterThanEqual(pos, vec2(0.9999))))
+    {
+        gl_Position = vec4(-2.0, -2.0, 0.0, 1.0);
+        return;
+    }
+
+    if (gl_VertexID == 1)
     {
         // Reverse propagation using the u/v texture written in the previous frame.
         // Milkdrop's original code did a simple bilinear interpolation, but here it was already
         // done by the fragment shader during the warp mesh drawing. We just need to look up the
         // motion vector coordinate.
-        // We simply invert the y coordinate because it's easier than flipping the u/v texture.
-        vec2 oldUV = texture(warp_coordinates, vec2(pos.x, 1.0 - pos.y)).xy;
+        // The u/v texture is stored bottom-up like the preset framebuffer, so no flip is needed.
+        vec2 oldUV = texture(warp_coordinates, pos).xy;
 
         // Enforce minimum trail length
         vec2 dist = oldUV - pos;
-        dist *= length_multiplier;
+        dist *= trail_length.x;
         float len = length(dist);
-        if (len > minimum_length)
+        if (len > trail_length.y)
         {}
         else if (len > 0.00000001f)
         {
-            len = minimum_length / len;
+            len = trail_length.y / len;
             dist *= len;
         }
         else
         {
-            dist = vec2(minimum_length);
+            dist = vec2(trail_length.y);
         }
 
         pos += dist;
@@ -53,5 +65,4 @@ void main() {
 
     // Now we've got the usual coordinates, apply our orthogonal transformation.
     gl_Position = vertex_transformation * vec4(pos, 0.0, 1.0);
-    fragment_color = vertex_color;
 }
@@ -35,6 +35,16 @@ out vec2 frag_TEXCOORD1;
 void main() {
     gl_Position = vertex_transformation * vec4(pos, 0.0, 1.0);
 
+#ifdef PER_PIXEL_EQUATIONS
+    // Per-pixel code translated to GLSL, replaces the per-vertex attributes.
+    vec4 transforms;
+    vec2 warp_center;
+    vec2 warp_distance;
+    vec2 stretch;
+    PerPixelEquations(pos.x * 0.5 * aspectX + 0.5, pos.y * -0.5 * aspectY + 0.5, radius, angle,
+                      transforms, warp_center, warp_distance, stretch);
+#endif
+
     float zoom2 = pow(zoom, pow(zoomExp, radius * 2.0 - 1.0));
     float zoom2Inverse = 1.0 / zoom2;
 
@@ -0,0 +1,62 @@
+precision highp float;
+
+in vec4 fragment_color;
+in vec2 fragment_texture;
+
+uniform sampler2D texture_sampler;
+uniform int echo_enabled;
+uniform vec2 echo_mix;
+uniform vec2 echo_uv_scale;
+uniform int draw_count;
+uniform float last_gamma;
+uniform int filters;
+
+out vec4 color;
+
+// Emulates storing a value in the 8-bit framebuffer between the original blend passes.
+vec4 Quantize(vec4 value) {
+    return floor(clamp(value, 0.0, 1.0) * 255.0 + 0.5) / 255.0;
+}
+
+// Adds the texture sample draw_count times, scaled by the gamma of each redraw.
+vec4 AddGammaLayers(vec4 target, vec4 source, float mixFactor) {
+    for (int redraw = 0; redraw < draw_count; redraw++) {
+        float gamma = (redraw == draw_count - 1) ? last_gamma : 1.0;
+        target = Quantize(target + clamp(vec4(gamma * mixFactor * fragment_color.rgb, 1.0) * source, 0.0, 1.0));
+    }
+    return target;
+}
+
+void main(){
+    vec4 result = AddGammaLayers(vec4(0.0), texture(texture_sampler, fragment_texture), echo_mix.x);
+
+    if (echo_enabled != 0) {
+        vec2 echoTexture = 0.5 + (fragment_texture - 0.5) * echo_uv_scale;
+        result = AddGammaLayers(result, texture(texture_sampler, echoTexture), echo_mix.y);
+    }
+
+    // Brighten
+    if ((filters & 1) != 0) {
+        result = Quantize(1.0 - result);
+        result = Quantize(result * result);
+        result = Quantize(1.0 - result);
+    }
+
+    // Darken
+    if ((filters & 2) != 0) {
+        result = Quantize(result * result);
+    }
+
+    // Solarize
+    if ((filters & 4) != 0) {
+        result = Quantize(result * (1.0 - result));
+        result = Quantize(result * 2.0);
+    }
+
+    // Invert
+    if ((filters & 8) != 0) {
+        result = Quantize(1.0 - result);
+    }
+
+    color = result;
+}
@@ -0,0 +1,21 @@
+precision mediump float;
+
+layout(location = 0) in vec2 vertex_position;
+layout(location = 1) in vec4 vertex_color;
+
+uniform mat4 vertex_transformation;
+uniform float vertex_point_size;
+uniform vec2 thick_offset; // Offset of the thick line passes.
+
+out vec4 fragment_color;
+
+void main(){
+    // Thick waves are drawn as four instances, shifted right, then down, then left:
+    // (0, 0), (x, 0), (x, y), (0, y)
+    vec2 offset = thick_offset * vec2(gl_InstanceID == 1 || gl_InstanceID == 2 ? 1.0 : 0.0,
+                                      gl_InstanceID >= 2 ? 1.0 : 0.0);
+
+    gl_Position = vertex_transformation * vec4(vertex_position + offset, 0.0, 1.0);
+    gl_PointSize = vertex_point_size;
+    fragment_color = vertex_color;
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "ExpressionEngine.hpp"
 #include "PresetState.hpp"
 
+#include <memory>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -17,27 +20,34 @@ class ShapePerFrameContext
 public:
     /**
      * @brief Constructor. Creates a new per-frame state object.
+     * @param engine The expression engine used to compile and run the code.
      * @param gmegabuf The global memory buffer to use in the code context.
      * @param globalRegisters The global variables to use in the code context.
      */
-    ShapePerFrameContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100]);
-
-    ~ShapePerFrameContext();
+    ShapePerFrameContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters);
 
     /**
      * @brief Registers the state variables in the expression evaluator context.
+     * @param sharedVariables The preset's shared frame variables.
+     */
+    void RegisterBuiltinVariables(const SharedVariableBlock& sharedVariables);
+
+    /**
+     * @brief Loads the time, audio and Q values from the shared variable block.
+     * Must be called once per frame before the first instance is evaluated.
      */
-    void RegisterBuiltinVariables();
+    void LoadSharedVariables();
 
     /**
      * @brief Loads the current state values into the expression evaluator variables.
-     * @param state The preset state container.
+     *
+     * Shared variables are only restored if the shape code can change them, so LoadSharedVariables()
+     * must have been called before in the same frame.
+     *
      * @param shape The shape this context belongs to.
      * @param inst The current shape instance.
      */
-    void LoadStateVariables(const PresetState& state,
-                            CustomShape& shape,
-                            int inst);
+    void LoadStateVariables(CustomShape& shape, int inst);
 
     /**
      * @brief Compiles and runs the preset init code.
@@ -60,8 +70,9 @@ public:
      */
     void ExecutePerFrameCode();
 
-    projectm_eval_context* perFrameCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
-    projectm_eval_code* perFrameCodeHandle{nullptr};     //!< The compiled per-frame code handle.
+    std::unique_ptr<ExpressionEngine::Context> perFrameCodeContext; //!< The code runtime context, holds memory buffers and variables.
+    std::unique_ptr<ExpressionEngine::Program> perFrameCodeHandle;  //!< The compiled per-frame code handle.
+    SharedVariableBinding sharedVariables;                          //!< Binding of the time, audio and Q variables to the shared block.
 
     // Expression variable pointers.
     PRJM_EVAL_F* time{};
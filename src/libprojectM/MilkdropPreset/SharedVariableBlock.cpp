@@ -0,0 +1,101 @@
+#include "SharedVariableBlock.hpp"
+
+#include "PerPixelCodeAnalysis.hpp"
+#include "PresetState.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+auto SharedVariableBlock::Name(size_t index) -> std::string
+{
+    static const std::array<const char*, Q1> names{
+        "time", "fps", "frame", "progress", "bass", "mid", "treb", "bass_att", "mid_att", "treb_att"};
+
+    if (index < Q1)
+    {
+        return names.at(index);
+    }
+
+    return "q" + std::to_string(index - Q1 + 1);
+}
+
+void SharedVariableBlock::Update(const PresetState& state)
+{
+    m_values[Time] = static_cast<PRJM_EVAL_F>(state.renderContext.time);
+    m_values[Fps] = static_cast<PRJM_EVAL_F>(state.renderContext.fps);
+    m_values[Frame] = static_cast<PRJM_EVAL_F>(state.renderContext.frame);
+    m_values[Progress] = static_cast<PRJM_EVAL_F>(state.renderContext.progress);
+    m_values[Bass] = static_cast<PRJM_EVAL_F>(state.audioData.bass);
+    m_values[Mid] = static_cast<PRJM_EVAL_F>(state.audioData.mid);
+    m_values[Treb] = static_cast<PRJM_EVAL_F>(state.audioData.treb);
+    m_values[BassAtt] = static_cast<PRJM_EVAL_F>(state.audioData.bassAtt);
+    m_values[MidAtt] = static_cast<PRJM_EVAL_F>(state.audioData.midAtt);
+    m_values[TrebAtt] = static_cast<PRJM_EVAL_F>(state.audioData.trebAtt);
+
+    std::copy(state.frameQVariables.begin(), state.frameQVariables.end(), m_values.begin() + Q1);
+}
+
+auto SharedVariableBlock::Value(size_t index) const -> const PRJM_EVAL_F*
+{
+    return &m_values.at(index);
+}
+
+void SharedVariableBinding::Register(ExpressionEngine::Context& context, const SharedVariableBlock& block)
+{
+    m_variables.clear();
+    m_sources.clear();
+    m_assignedVariables.clear();
+
+    for (size_t index = 0; index < SharedVariableBlock::Count; index++)
+    {
+        m_variables.push_back(context.RegisterVariable(SharedVariableBlock::Name(index)));
+        m_sources.push_back(block.Value(index));
+    }
+}
+
+auto SharedVariableBinding::Variable(size_t index) const -> PRJM_EVAL_F*
+{
+    if (index >= m_variables.size())
+    {
+        return nullptr;
+    }
+
+    return m_variables[index];
+}
+
+void SharedVariableBinding::AddCode(const std::string& code)
+{
+    std::set<std::string> assignedNames;
+    bool const analyzed = PerPixelCodeAnalysis::AssignedVariables(code, assignedNames);
+
+    for (size_t index = 0; index < m_variables.size(); index++)
+    {
+        if ((!analyzed || assignedNames.find(SharedVariableBlock::Name(index)) != assignedNames.end()) &&
+            std::find(m_assignedVariables.begin(), m_assignedVariables.end(), index) == m_assignedVariables.end())
+        {
+            m_assignedVariables.push_back(index);
+        }
+    }
+}
+
+void SharedVariableBinding::Load() const
+{
+    for (size_t index = 0; index < m_variables.size(); index++)
+    {
+        *m_variables[index] = *m_sources[index];
+    }
+}
+
+void SharedVariableBinding::Restore() const
+{
+    for (auto const index : m_assignedVariables)
+    {
+        *m_variables[index] = *m_sources[index];
+    }
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Constants.hpp"
+#include "ExpressionEngine.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+class PresetState;
+
+/**
+ * @brief Read-only frame inputs shared by all code contexts of a preset.
+ *
+ * Time, audio and Q values are the same for all shapes, waveforms and the per-pixel code
+ * of a frame. Instead of converting them from the preset state again in each context, they
+ * are stored once per frame in this block and copied into the contexts from there.
+ */
+class SharedVariableBlock
+{
+public:
+    /**
+     * Index of each variable in the block.
+     */
+    enum Index : size_t
+    {
+        Time,
+        Fps,
+        Frame,
+        Progress,
+        Bass,
+        Mid,
+        Treb,
+        BassAtt,
+        MidAtt,
+        TrebAtt,
+        Q1,
+        Count = Q1 + QVarCount
+    };
+
+    /**
+     * @brief Returns the expression variable name for the given index.
+     * @param index The variable index.
+     * @return The lower-case variable name.
+     */
+    static auto Name(size_t index) -> std::string;
+
+    /**
+     * @brief Updates the block with the current frame values.
+     *
+     * Must be called after the preset per-frame code has updated the Q variables.
+     *
+     * @param state The preset state with the render context, audio data and Q variables.
+     */
+    void Update(const PresetState& state);
+
+    /**
+     * @brief Returns a pointer to the value with the given index.
+     * @param index The variable index.
+     * @return A pointer into the block, valid as long as the block exists.
+     */
+    auto Value(size_t index) const -> const PRJM_EVAL_F*;
+
+private:
+    std::array<PRJM_EVAL_F, Count> m_values{}; //!< All variable values.
+};
+
+/**
+ * @brief Binds the variables of a code context to a shared variable block.
+ *
+ * Preset code may assign new values to the shared variables, which must not leak into the
+ * next shape instance. To avoid copying all values for each instance, the binding scans the
+ * code for assignments and only restores the variables the code can actually change.
+ */
+class SharedVariableBinding
+{
+public:
+    /**
+     * @brief Registers all variables of the block in the given context.
+     * @param context The code context.
+     * @param block The block the variables are loaded from.
+     */
+    void Register(ExpressionEngine::Context& context, const SharedVariableBlock& block);
+
+    /**
+     * @brief Returns the context variable for the given index.
+     * @param index The variable index.
+     * @return The variable pointer, or nullptr if Register() wasn't called yet.
+     */
+    auto Variable(size_t index) const -> PRJM_EVAL_F*;
+
+    /**
+     * @brief Adds the variables assigned in the given code to the list of variables to restore.
+     * @param code Code run in the bound context.
+     */
+    void AddCode(const std::string& code);
+
+    /**
+     * @brief Copies all values from the block into the context.
+     */
+    void Load() const;
+
+    /**
+     * @brief Copies only the values the code can change from the block into the context.
+     */
+    void Restore() const;
+
+private:
+    std::vector<PRJM_EVAL_F*> m_variables;     //!< The context variables, in block order.
+    std::vector<const PRJM_EVAL_F*> m_sources; //!< The block values, in block order.
+    std::vector<size_t> m_assignedVariables;   //!< Indices of the variables assigned by the code.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
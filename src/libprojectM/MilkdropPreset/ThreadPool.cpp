@@ -0,0 +1,121 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <system_error>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+ThreadPool::ThreadPool(size_t workerCount)
+{
+    for (size_t worker = 0; worker < workerCount; worker++)
+    {
+        try
+        {
+            m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+        catch (std::system_error&)
+        {
+            // Threads aren't available on this platform, e.g. Emscripten without pthreads.
+            break;
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_taskAdded.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+auto ThreadPool::Shared() -> ThreadPool&
+{
+    // Custom shapes and waves are the main users, so more than 7 workers won't help.
+    static ThreadPool pool(std::min(std::max(std::thread::hardware_concurrency(), 1U) - 1, 7U));
+    return pool;
+}
+
+auto ThreadPool::WorkerCount() const -> size_t
+{
+    return m_workers.size();
+}
+
+void ThreadPool::Run(size_t count, const Task& task)
+{
+    if (m_workers.empty() || count < 2)
+    {
+        for (size_t index = 0; index < count; index++)
+        {
+            task(index);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.task = &task;
+    batch.count = count;
+    batch.unfinished = count;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_batches.push_back(&batch);
+    m_taskAdded.notify_all();
+
+    // Only run this call's indices, so a caller never waits for tasks of another instance.
+    while (batch.nextIndex < batch.count)
+    {
+        RunNextIndex(batch, lock);
+    }
+
+    m_tasksDone.wait(lock, [&batch]() {
+        return batch.unfinished == 0;
+    });
+}
+
+void ThreadPool::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_taskAdded.wait(lock, [this]() {
+            return m_stop || !m_batches.empty();
+        });
+
+        if (m_stop)
+        {
+            return;
+        }
+
+        RunNextIndex(*m_batches.front(), lock);
+    }
+}
+
+void ThreadPool::RunNextIndex(Batch& batch, std::unique_lock<std::mutex>& lock)
+{
+    auto const index = batch.nextIndex++;
+    if (batch.nextIndex == batch.count)
+    {
+        m_batches.erase(std::find(m_batches.begin(), m_batches.end(), &batch));
+    }
+
+    lock.unlock();
+    (*batch.task)(index);
+    lock.lock();
+
+    // The caller returns as soon as the count reaches 0, so the batch must not be used afterwards.
+    if (--batch.unfinished == 0)
+    {
+        m_tasksDone.notify_all();
+    }
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief A small pool of worker threads running indexed tasks in parallel.
+ *
+ * Run() distributes the task indices over the workers and the calling thread, and returns
+ * after all tasks are done. Concurrent calls, e.g. from several projectM instances rendering on
+ * their own threads, don't wait for each other: each caller runs the indices of its own call,
+ * while the workers pick up indices from all pending calls in the order they were started.
+ * Tasks must not throw.
+ */
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t index)>;
+
+    /**
+     * @brief Creates a pool with the given number of worker threads.
+     * @param workerCount Number of threads to start. With 0 workers, all tasks run on the calling thread.
+     */
+    explicit ThreadPool(size_t workerCount);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+    /**
+     * @brief Returns the process-wide pool, using one worker less than the number of CPU cores.
+     * @return The shared pool.
+     */
+    static auto Shared() -> ThreadPool&;
+
+    /**
+     * @brief Returns the number of worker threads.
+     * @return The number of workers, not counting the calling thread.
+     */
+    auto WorkerCount() const -> size_t;
+
+    /**
+     * @brief Runs the task for each index from 0 to count - 1 and waits for all of them.
+     * @param count The number of task indices.
+     * @param task The task to run. Called once for each index, in no particular order.
+     */
+    void Run(size_t count, const Task& task);
+
+private:
+    /**
+     * The state of one Run() call, owned by the calling thread.
+     */
+    struct Batch {
+        const Task* task{nullptr}; //!< The task to run.
+        size_t count{};            //!< Number of task indices.
+        size_t nextIndex{};        //!< Next index to run.
+        size_t unfinished{};       //!< Number of indices not yet finished.
+    };
+
+    void WorkerLoop();
+
+    /**
+     * Runs the next index of the batch and removes the batch from the queue once all indices
+     * are started. Expects the lock to be held.
+     */
+    void RunNextIndex(Batch& batch, std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> m_workers; //!< The worker threads.
+
+    std::mutex m_mutex;                  //!< Guards the batch state below.
+    std::condition_variable m_taskAdded; //!< Signalled when a batch was queued or the pool is stopped.
+    std::condition_variable m_tasksDone; //!< Signalled when the last index of a batch finished.
+    std::deque<Batch*> m_batches;        //!< Batches with indices not yet started, oldest first.
+    bool m_stop{false};                  //!< Tells the workers to exit.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -1,5 +1,9 @@
 #include "VideoEcho.hpp"
 
+#include "MilkdropStaticShaders.hpp"
+
+#include <Renderer/StateCache.hpp>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -7,6 +11,10 @@ VideoEcho::VideoEcho(const PresetState& presetState)
     : RenderItem()
     , m_presetState(presetState)
 {
+    auto staticShaders = MilkdropStaticShaders::Get();
+    m_shader.CompileProgramAsync(staticShaders->GetTexturedDrawVertexShader(),
+                                 staticShaders->GetVideoEchoFragmentShader());
+
     RenderItem::Init();
 }
 
@@ -21,9 +29,19 @@ void VideoEcho::InitVertexAttrib()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedPoint), reinterpret_cast<void*>(offsetof(TexturedPoint, u))); // Texture coordinates
 }
 
+auto VideoEcho::IsCompilationComplete() const -> bool
+{
+    return m_shader.IsCompilationComplete();
+}
+
+void VideoEcho::FinishCompilation()
+{
+    m_shader.FinishCompilation();
+}
+
 void VideoEcho::Draw()
 {
-    float const aspect = m_presetState.renderContext.viewportSizeX / static_cast<float>(m_presetState.renderContext.viewportSizeY * m_presetState.renderContext.invAspectY);
+    float const aspect = m_presetState.drawnFrame.renderContext.viewportSizeX / static_cast<float>(m_presetState.drawnFrame.renderContext.viewportSizeY * m_presetState.drawnFrame.renderContext.invAspectY);
     float aspectMultX = 1.0f;
     float aspectMultY = 1.0f;
 
@@ -36,8 +54,8 @@ void VideoEcho::Draw()
         aspectMultX = 1.0f / aspect;
     }
 
-    float const fOnePlusInvWidth = 1.0f + 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
-    float const fOnePlusInvHeight = 1.0f + 1.0f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
+    float const fOnePlusInvWidth = 1.0f + 1.0f / static_cast<float>(m_presetState.drawnFrame.renderContext.viewportSizeX);
+    float const fOnePlusInvHeight = 1.0f + 1.0f / static_cast<float>(m_presetState.drawnFrame.renderContext.viewportSizeY);
     m_vertices[0].x = -fOnePlusInvWidth * aspectMultX;
     m_vertices[1].x = fOnePlusInvWidth * aspectMultX;
     m_vertices[2].x = -fOnePlusInvWidth * aspectMultX;
@@ -47,30 +65,29 @@ void VideoEcho::Draw()
     m_vertices[2].y = -fOnePlusInvHeight * aspectMultY;
     m_vertices[3].y = -fOnePlusInvHeight * aspectMultY;
 
-    for (int i = 0; i < 4; i++)
-    {
-        auto const indexFloat = static_cast<float>(i);
-        m_shade[i][0] = 0.6f + 0.3f * sinf(m_presetState.renderContext.time * 30.0f * 0.0143f + 3 + indexFloat * 21 + m_presetState.hueRandomOffsets[3]);
-        m_shade[i][1] = 0.6f + 0.3f * sinf(m_presetState.renderContext.time * 30.0f * 0.0107f + 1 + indexFloat * 13 + m_presetState.hueRandomOffsets[1]);
-        m_shade[i][2] = 0.6f + 0.3f * sinf(m_presetState.renderContext.time * 30.0f * 0.0129f + 6 + indexFloat * 9 + m_presetState.hueRandomOffsets[2]);
-
-        float const max = std::max(m_shade[i][0], std::max(m_shade[i][1], m_shade[i][2]));
-
-        for (int k = 0; k < 3; k++)
-        {
-            m_shade[i][k] /= max;
-            m_shade[i][k] = 0.5f + 0.5f * m_shade[i][k];
-        }
+    // The echo texture coordinates are derived from these in the fragment shader.
+    m_vertices[0].u = 0.0f;
+    m_vertices[0].v = 0.0f;
+    m_vertices[1].u = 1.0f;
+    m_vertices[1].v = 0.0f;
+    m_vertices[2].u = 0.0f;
+    m_vertices[2].v = 1.0f;
+    m_vertices[3].u = 1.0f;
+    m_vertices[3].v = 1.0f;
 
-        m_vertices[i].r = m_shade[i][0];
-        m_vertices[i].g = m_shade[i][1];
-        m_vertices[i].b = m_shade[i][2];
-        m_vertices[i].a = 1.0f;
+    auto const shade = HueShadeColors(m_presetState);
+    for (int vertex = 0; vertex < 4; vertex++)
+    {
+        m_vertices[vertex].r = shade[vertex].r;
+        m_vertices[vertex].g = shade[vertex].g;
+        m_vertices[vertex].b = shade[vertex].b;
+        m_vertices[vertex].a = 1.0f;
     }
 
-    m_presetState.texturedShader.Bind();
-    m_presetState.texturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-    m_presetState.texturedShader.SetUniformInt("texture_sampler", 0);
+    m_shader.Bind();
+    m_shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
+    m_shader.SetUniformInt("texture_sampler", 0);
+    SetEffectUniforms();
 
     auto mainTexture = m_presetState.mainTexture.lock();
     if (mainTexture)
@@ -79,24 +96,16 @@ void VideoEcho::Draw()
         m_sampler.Bind(0);
     }
 
-    glBindVertexArray(m_vaoID);
+    auto& stateCache = Renderer::StateCache::Current();
+    stateCache.SetBlend(false);
+
+    stateCache.BindVertexArray(m_vaoID);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
-    if (m_presetState.videoEchoAlpha > 0.001f)
-    {
-        DrawVideoEcho();
-    }
-    else
-    {
-        DrawGammaAdjustment();
-    }
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizei>(sizeof(TexturedPoint) * m_vertices.size()), m_vertices.data(), GL_DYNAMIC_DRAW);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, static_cast<GLsizei>(m_vertices.size()));
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    glDisable(GL_BLEND);
-
-    Renderer::Shader::Unbind();
 
     if (mainTexture)
     {
@@ -105,141 +114,89 @@ void VideoEcho::Draw()
     }
 }
 
-void VideoEcho::DrawVideoEcho()
+auto VideoEcho::HueShadeColors(const PresetState& presetState) -> std::array<glm::vec3, 4>
 {
-    auto const videoEchoZoom = m_presetState.videoEchoZoom;
-    auto const videoEchoAlpha = m_presetState.videoEchoAlpha;
-    auto const videoEchoOrientation = m_presetState.videoEchoOrientation % 4;
-    auto const gammaAdj = m_presetState.gammaAdj;
+    std::array<glm::vec3, 4> shade;
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ZERO);
-
-    for (int pass = 0; pass < 2; pass++)
+    for (int i = 0; i < 4; i++)
     {
-        float const zoom = (pass == 0) ? 1.0f : videoEchoZoom;
-
-        float const tempLow = 0.5f - 0.5f / zoom;
-        float const temphigh = 0.5f + 0.5f / zoom;
-        m_vertices[0].u = tempLow;
-        m_vertices[0].v = tempLow;
-        m_vertices[1].u = temphigh;
-        m_vertices[1].v = tempLow;
-        m_vertices[2].u = tempLow;
-        m_vertices[2].v = temphigh;
-        m_vertices[3].u = temphigh;
-        m_vertices[3].v = temphigh;
-
-        // Flipping
-        if (pass == 1)
-        {
-            for (int vertex = 0; vertex < 4; vertex++)
-            {
-                if (videoEchoOrientation % 2 == 1)
-                {
-                    m_vertices[vertex].u = 1.0f - m_vertices[vertex].u;
-                }
-                if (videoEchoOrientation >= 2)
-                {
-                    m_vertices[vertex].v = 1.0f - m_vertices[vertex].v;
-                }
-            }
-        }
-
-        float const mix = (pass == 1) ? videoEchoAlpha : 1.0f - videoEchoAlpha;
-        for (int vertex = 0; vertex < 4; vertex++)
-        {
-            m_vertices[vertex].r = mix * m_shade[vertex][0];
-            m_vertices[vertex].g = mix * m_shade[vertex][1];
-            m_vertices[vertex].b = mix * m_shade[vertex][2];
-            m_vertices[vertex].a = 1.0f;
-        }
-
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizei>(sizeof(TexturedPoint) * m_vertices.size()), m_vertices.data(), GL_DYNAMIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, static_cast<GLsizei>(m_vertices.size()));
+        auto const indexFloat = static_cast<float>(i);
+        shade[i][0] = 0.6f + 0.3f * sinf(presetState.drawnFrame.renderContext.time * 30.0f * 0.0143f + 3 + indexFloat * 21 + presetState.hueRandomOffsets[3]);
+        shade[i][1] = 0.6f + 0.3f * sinf(presetState.drawnFrame.renderContext.time * 30.0f * 0.0107f + 1 + indexFloat * 13 + presetState.hueRandomOffsets[1]);
+        shade[i][2] = 0.6f + 0.3f * sinf(presetState.drawnFrame.renderContext.time * 30.0f * 0.0129f + 6 + indexFloat * 9 + presetState.hueRandomOffsets[2]);
 
-        if (pass == 0)
-        {
-            glBlendFunc(GL_ONE, GL_ONE);
-        }
+        float const max = std::max(shade[i][0], std::max(shade[i][1], shade[i][2]));
 
-        if (gammaAdj > 0.001f)
+        for (int k = 0; k < 3; k++)
         {
-            int const redrawCount = static_cast<int>(gammaAdj - 0.0001f);
-
-            for (int redraw = 0; redraw < redrawCount; redraw++)
-            {
-                float gamma;
-                if (redraw == redrawCount - 1)
-                {
-                    gamma = gammaAdj - static_cast<float>(static_cast<int>(gammaAdj - 0.0001f));
-                }
-                else
-                {
-                    gamma = 1.0f;
-                }
-
-                for (int vertex = 0; vertex < 4; vertex++)
-                {
-                    m_vertices[vertex].r = gamma * mix * m_shade[vertex][0];
-                    m_vertices[vertex].g = gamma * mix * m_shade[vertex][1];
-                    m_vertices[vertex].b = gamma * mix * m_shade[vertex][2];
-                    m_vertices[vertex].a = 1.0f;
-                }
-
-                glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizei>(sizeof(TexturedPoint) * m_vertices.size()), m_vertices.data(), GL_DYNAMIC_DRAW);
-                glDrawArrays(GL_TRIANGLE_STRIP, 0, static_cast<GLsizei>(m_vertices.size()));
-            }
+            shade[i][k] /= max;
+            shade[i][k] = 0.5f + 0.5f * shade[i][k];
         }
     }
+
+    return shade;
 }
 
-void VideoEcho::DrawGammaAdjustment()
+void VideoEcho::SetEffectUniforms()
 {
-    m_vertices[0].u = 0.0f;
-    m_vertices[0].v = 0.0f;
-    m_vertices[1].u = 1.0f;
-    m_vertices[1].v = 0.0f;
-    m_vertices[2].u = 0.0f;
-    m_vertices[2].v = 1.0f;
-    m_vertices[3].u = 1.0f;
-    m_vertices[3].v = 1.0f;
-
-    glDisable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ZERO);
-
     auto const gammaAdj = m_presetState.gammaAdj;
-    int const redrawCount = static_cast<int>(gammaAdj - 0.0001f) + 1;
+    bool const echoEnabled = m_presetState.videoEchoAlpha > 0.001f;
 
-    for (int redraw = 0; redraw < redrawCount; redraw++)
+    // Milkdrop draws the image once, then adds it again for each full gamma step,
+    // with the last redraw adding the remaining fraction.
+    int drawCount;
+    float lastGamma;
+    if (echoEnabled)
     {
-        float gamma;
-        if (redraw == redrawCount - 1)
-        {
-            gamma = gammaAdj - static_cast<float>(redraw);
-        }
-        else
-        {
-            gamma = 1.0f;
-        }
+        // Video echo only brightens, but never darkens the image.
+        int const redrawCount = gammaAdj > 0.001f ? static_cast<int>(gammaAdj - 0.0001f) : 0;
+        drawCount = 1 + redrawCount;
+        lastGamma = redrawCount > 0 ? gammaAdj - static_cast<float>(redrawCount) : 1.0f;
+    }
+    else
+    {
+        drawCount = static_cast<int>(gammaAdj - 0.0001f) + 1;
+        lastGamma = gammaAdj - static_cast<float>(drawCount - 1);
+    }
 
-        for (int vertex = 0; vertex < 4; vertex++)
-        {
-            m_vertices[vertex].r = gamma * m_shade[vertex][0];
-            m_vertices[vertex].g = gamma * m_shade[vertex][1];
-            m_vertices[vertex].b = gamma * m_shade[vertex][2];
-            m_vertices[vertex].a = 1.0f;
-        }
+    m_shader.SetUniformInt("echo_enabled", echoEnabled ? 1 : 0);
+    m_shader.SetUniformInt("draw_count", drawCount);
+    m_shader.SetUniformFloat("last_gamma", lastGamma);
 
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizei>(sizeof(TexturedPoint) * m_vertices.size()), m_vertices.data(), GL_DYNAMIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, static_cast<GLsizei>(m_vertices.size()));
+    if (echoEnabled)
+    {
+        auto const videoEchoAlpha = m_presetState.videoEchoAlpha;
+        auto const videoEchoOrientation = m_presetState.videoEchoOrientation % 4;
+        float const inverseZoom = 1.0f / m_presetState.videoEchoZoom;
 
-        if (redraw == 0)
-        {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_ONE, GL_ONE);
-        }
+        m_shader.SetUniformFloat2("echo_mix", {1.0f - videoEchoAlpha, videoEchoAlpha});
+        m_shader.SetUniformFloat2("echo_uv_scale", {videoEchoOrientation % 2 == 1 ? -inverseZoom : inverseZoom,
+                                                    videoEchoOrientation >= 2 ? -inverseZoom : inverseZoom});
+    }
+    else
+    {
+        m_shader.SetUniformFloat2("echo_mix", {1.0f, 0.0f});
+        m_shader.SetUniformFloat2("echo_uv_scale", {1.0f, 1.0f});
+    }
+
+    int filters{};
+    if (m_presetState.brighten)
+    {
+        filters |= 1;
+    }
+    if (m_presetState.darken)
+    {
+        filters |= 2;
+    }
+    if (m_presetState.solarize)
+    {
+        filters |= 4;
+    }
+    if (m_presetState.invert)
+    {
+        filters |= 8;
     }
+    m_shader.SetUniformInt("filters", filters);
 }
 
 } // namespace MilkdropPreset
@@ -7,11 +7,17 @@
 
 #include <Renderer/RenderItem.hpp>
 
+#include <array>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
 /**
- * @brief Renders a video "echo" (ghost image) effect and gamma adjustments.
+ * @brief Renders a video "echo" (ghost image) effect, gamma adjustments and the Milkdrop 1 filters.
+ *
+ * All effects are applied in a single full-screen pass. The fragment shader emulates the
+ * additive blend passes used by Milkdrop, including the rounding to 8 bits after each pass,
+ * so the result matches the original multi-pass rendering.
  */
 class VideoEcho: public Renderer::RenderItem
 {
@@ -21,16 +27,36 @@ public:
 
     void InitVertexAttrib() override;
 
+    /**
+     * @brief Returns whether the shaders compiled in the constructor are ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the shaders compiled in the constructor.
+     * @throws Renderer::ShaderException Thrown if a shader failed to compile.
+     */
+    void FinishCompilation();
+
 	void Draw();
 
-private:
-    void DrawVideoEcho();
+    /**
+     * @brief Calculates the randomized, slowly changing hue colors for the four screen corners.
+     * @param presetState The preset state to retrieve the time and random offsets from.
+     * @return The top-left, top-right, bottom-left and bottom-right colors.
+     */
+    static auto HueShadeColors(const PresetState& presetState) -> std::array<glm::vec3, 4>;
 
-    void DrawGammaAdjustment();
+private:
+    /**
+     * @brief Sets the effect uniforms from the preset state.
+     */
+    void SetEffectUniforms();
 
     const PresetState& m_presetState; //!< The global preset state.
 
-    std::array<std::array<float, 3>, 4> m_shade; // !< Random, changing color values for the four corners
+    Renderer::Shader m_shader;               //!< The combined echo, gamma and filter shader.
     std::array<TexturedPoint, 4> m_vertices; //!< The video echo/gamma adj mesh
     Renderer::Sampler m_sampler{GL_CLAMP_TO_EDGE, GL_LINEAR};
 };
@@ -2,41 +2,23 @@
 
 #include "PerFrameContext.hpp"
 #include "PresetState.hpp"
+#include "WaveformBatch.hpp"
 
 #include "Waveforms/Factory.hpp"
 
-#include <projectM-opengl.h>
-
-#include <Audio/AudioConstants.hpp>
-
 #include <algorithm>
 #include <cmath>
 
-using libprojectM::Renderer::RenderItem;
-
 namespace libprojectM {
 namespace MilkdropPreset {
 
 Waveform::Waveform(PresetState& presetState)
-    : RenderItem()
-    , m_presetState(presetState)
-{
-    RenderItem::Init();
-}
-
-void Waveform::InitVertexAttrib()
+    : m_presetState(presetState)
 {
-    glEnableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    std::vector<Point> vertexData;
-    vertexData.resize(std::max(libprojectM::Audio::SpectrumSamples, libprojectM::Audio::WaveformSamples) * 2 + 2);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Point) * vertexData.size(), vertexData.data(), GL_STREAM_DRAW);
+    m_coloredVertices.reserve(WaveformMaxPoints * 2);
 }
 
-void Waveform::Draw(const PerFrameContext& presetPerFrameContext)
+void Waveform::AddToBatch(const PerFrameContext& presetPerFrameContext, WaveformBatch& batch)
 {
     m_mode = static_cast<WaveformMode>(m_presetState.waveMode % static_cast<int>(WaveformMode::Count));
 
@@ -49,31 +31,9 @@ void Waveform::Draw(const PerFrameContext& presetPerFrameContext)
         }
     }
 
-#ifndef USE_GLES
-    glDisable(GL_LINE_SMOOTH);
-#endif
-    glLineWidth(1);
+    auto& smoothedVertices = m_waveformMath->GetVertices(m_presetState, presetPerFrameContext);
 
-    m_presetState.untexturedShader.Bind();
-    m_presetState.untexturedShader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjection);
-
-    glBindVertexArray(m_vaoID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
-
-    // Additive wave drawing (vice overwrite)
-    glEnable(GL_BLEND);
-    if (m_presetState.additiveWaves)
-    {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    }
-    else
-    {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    }
-
-    auto smoothedVertices = m_waveformMath->GetVertices(m_presetState, presetPerFrameContext);
-
-    for (auto& smoothedWave : smoothedVertices)
+    for (const auto& smoothedWave : smoothedVertices)
     {
         if (smoothedWave.empty())
         {
@@ -83,56 +43,23 @@ void Waveform::Draw(const PerFrameContext& presetPerFrameContext)
         m_tempAlpha = static_cast<float>(*presetPerFrameContext.wave_a);
         MaximizeColors(presetPerFrameContext);
 
+        m_coloredVertices.resize(smoothedWave.size());
+        for (size_t vertex = 0; vertex < smoothedWave.size(); vertex++)
+        {
+            m_coloredVertices[vertex] = {smoothedWave[vertex].x, smoothedWave[vertex].y, m_color[0], m_color[1], m_color[2], m_color[3]};
+        }
+
         // Always draw "thick" dots.
-        const auto iterations = m_presetState.waveThick || m_presetState.waveDots ? 4 : 1;
+        bool const thick = m_presetState.waveThick || m_presetState.waveDots;
 
         const auto incrementX = 2.0f / static_cast<float>(m_presetState.renderContext.viewportSizeX);
         const auto incrementY = 2.0f / static_cast<float>(m_presetState.renderContext.viewportSizeY);
 
-        GLuint drawType = m_presetState.waveDots ? GL_POINTS : (m_waveformMath->IsLoop() ? GL_LINE_LOOP : GL_LINE_STRIP);
-
-        // If thick outline is used, draw the shape four times with slight offsets
-        // (top left, top right, bottom right, bottom left).
-        for (auto iteration = 0; iteration < iterations; iteration++)
-        {
-            switch (iteration)
-            {
-                case 0:
-                    break;
-
-                case 1:
-                    for (auto j = 0U; j < smoothedWave.size(); j++)
-                    {
-                        smoothedWave[j].x += incrementX;
-                    }
-                    break;
-
-                case 2:
-                    for (auto j = 0U; j < smoothedWave.size(); j++)
-                    {
-                        smoothedWave[j].y += incrementY;
-                    }
-                    break;
+        GLenum drawType = m_presetState.waveDots ? GL_POINTS : (m_waveformMath->IsLoop() ? GL_LINE_LOOP : GL_LINE_STRIP);
 
-                case 3:
-                    for (auto j = 0U; j < smoothedWave.size(); j++)
-                    {
-                        smoothedWave[j].x -= incrementX;
-                    }
-                    break;
-            }
-
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Point) * smoothedWave.size(), smoothedWave.data());
-            glDrawArrays(drawType, 0, static_cast<GLsizei>(smoothedWave.size()));
-        }
+        batch.Add(m_coloredVertices.data(), m_coloredVertices.size(), drawType, m_presetState.additiveWaves,
+                  thick, incrementX, incrementY);
     }
-
-    glDisable(GL_BLEND);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    Renderer::Shader::Unbind();
 }
 
 void Waveform::ModulateOpacityByVolume(const PerFrameContext& presetPerFrameContext)
@@ -255,7 +182,7 @@ void Waveform::MaximizeColors(const PerFrameContext& presetPerFrameContext)
         }
     }
 
-    glVertexAttrib4f(1, waveR, waveG, waveB, m_tempAlpha);
+    m_color = {waveR, waveG, waveB, m_tempAlpha};
 }
 
 } // namespace MilkdropPreset
@@ -7,6 +7,7 @@
 
 #include <Renderer/RenderItem.hpp>
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -15,15 +16,19 @@ namespace MilkdropPreset {
 
 class PresetState;
 class PerFrameContext;
+class WaveformBatch;
 
-class Waveform : public Renderer::RenderItem
+class Waveform
 {
 public:
     explicit Waveform(PresetState& presetState);
 
-    void Draw(const PerFrameContext& presetPerFrameContext);
-
-    void InitVertexAttrib() override;
+    /**
+     * @brief Calculates the waveform vertices and adds them to the batch.
+     * @param presetPerFrameContext The per-frame context variables.
+     * @param batch The batch which draws all waveforms of the frame.
+     */
+    void AddToBatch(const PerFrameContext& presetPerFrameContext, WaveformBatch& batch);
 
 private:
     void MaximizeColors(const PerFrameContext& presetPerFrameContext);
@@ -35,11 +40,10 @@ private:
 
     std::unique_ptr<Waveforms::WaveformMath> m_waveformMath; //!< The waveform vertex math implementation.
 
-    float m_tempAlpha{0.0f}; //!< Calculated alpha value.
-    int m_samples{};         //!< Number of samples in the current waveform. Depends on the mode.
+    float m_tempAlpha{0.0f};       //!< Calculated alpha value.
+    std::array<float, 4> m_color{}; //!< Wave color, calculated by MaximizeColors().
 
-    std::vector<Point> m_wave1Vertices;
-    std::vector<Point> m_wave2Vertices;
+    std::vector<Renderer::RenderItem::ColoredPoint> m_coloredVertices; //!< Colored vertices of the wave added last.
 };
 
 } // namespace MilkdropPreset
@@ -0,0 +1,125 @@
+#include "WaveformBatch.hpp"
+
+#include "Constants.hpp"
+#include "MilkdropStaticShaders.hpp"
+#include "PresetState.hpp"
+
+#include <Renderer/StateCache.hpp>
+
+#include <initializer_list>
+#include <utility>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+WaveformBatch::WaveformBatch()
+    : RenderItem()
+{
+    auto staticShaders = libprojectM::MilkdropPreset::MilkdropStaticShaders::Get();
+    m_shader.CompileProgramAsync(staticShaders->GetWaveformVertexShader(),
+                                 staticShaders->GetUntexturedDrawFragmentShader());
+
+    // Enough room for all custom waves and the default waveform, each smoothed to twice the points.
+    for (auto* frame : {&m_preparedFrame, &m_drawnFrame})
+    {
+        frame->vertices.reserve((CustomWaveformCount + 2) * WaveformMaxPoints * 2);
+        frame->waves.reserve(CustomWaveformCount + 2);
+    }
+
+    RenderItem::Init();
+}
+
+void WaveformBatch::InitVertexAttrib()
+{
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ColoredPoint), nullptr);                                    // points
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ColoredPoint), reinterpret_cast<void*>(sizeof(float) * 2)); // colors
+}
+
+auto WaveformBatch::IsCompilationComplete() const -> bool
+{
+    return m_shader.IsCompilationComplete();
+}
+
+void WaveformBatch::FinishCompilation()
+{
+    m_shader.FinishCompilation();
+}
+
+void WaveformBatch::Add(const ColoredPoint* vertices, size_t vertexCount, GLenum drawType, bool additive,
+                        bool thick, float offsetX, float offsetY)
+{
+    if (vertexCount == 0)
+    {
+        return;
+    }
+
+    Wave wave;
+    wave.firstVertex = static_cast<GLint>(m_preparedFrame.vertices.size());
+    wave.vertexCount = static_cast<GLsizei>(vertexCount);
+    wave.drawType = drawType;
+    wave.additive = additive;
+    wave.passes = thick ? 4 : 1;
+    wave.offsetX = offsetX;
+    wave.offsetY = offsetY;
+    m_preparedFrame.waves.push_back(wave);
+
+    m_preparedFrame.vertices.insert(m_preparedFrame.vertices.end(), vertices, vertices + vertexCount);
+}
+
+void WaveformBatch::SwapPreparedFrame()
+{
+    std::swap(m_preparedFrame, m_drawnFrame);
+
+    m_preparedFrame.vertices.clear();
+    m_preparedFrame.waves.clear();
+}
+
+void WaveformBatch::Draw()
+{
+    if (m_drawnFrame.waves.empty())
+    {
+        return;
+    }
+
+    auto& stateCache = Renderer::StateCache::Current();
+
+    stateCache.BindVertexArray(m_vaoID);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
+    // Orphans the previous frame's buffer, so the driver doesn't need to wait until it was drawn.
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(ColoredPoint) * m_drawnFrame.vertices.size()), m_drawnFrame.vertices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+#ifndef USE_GLES
+    glDisable(GL_LINE_SMOOTH);
+#endif
+    glLineWidth(1);
+
+    m_shader.Bind();
+    m_shader.SetUniformMat4x4("vertex_transformation", PresetState::orthogonalProjectionFlipped);
+
+    stateCache.SetBlend(true);
+
+    for (const auto& wave : m_drawnFrame.waves)
+    {
+        // Additive wave drawing (vice overwrite)
+        if (wave.additive)
+        {
+            stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE);
+        }
+        else
+        {
+            stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+
+        m_shader.SetUniformFloat2("thick_offset", {wave.offsetX, wave.offsetY});
+
+        // Instances are drawn in order, so the passes blend like separate draw calls.
+        glDrawArraysInstanced(wave.drawType, wave.firstVertex, wave.vertexCount, wave.passes);
+    }
+}
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
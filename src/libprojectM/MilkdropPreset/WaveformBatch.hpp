@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Renderer/RenderItem.hpp>
+#include <Renderer/Shader.hpp>
+
+#include <vector>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+
+/**
+ * @brief Collects the vertices of all waveforms drawn in a frame and renders them together.
+ *
+ * All vertices are uploaded into a single streaming buffer with one call. Each wave is then
+ * drawn with a single instanced draw call, the vertex shader applies the thick line offsets
+ * based on the instance ID. Waves are drawn in the order they were added, so blending works
+ * the same as drawing each wave separately.
+ *
+ * Waves are added while preparing a frame, possibly on a worker thread, and handed over to
+ * Draw() with SwapPreparedFrame(), so the next frame can be prepared while one is drawn.
+ */
+class WaveformBatch : public Renderer::RenderItem
+{
+public:
+    WaveformBatch();
+
+    void InitVertexAttrib() override;
+
+    /**
+     * @brief Returns whether the shaders compiled in the constructor are ready to use.
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the shaders compiled in the constructor.
+     * @throws Renderer::ShaderException Thrown if a shader failed to compile.
+     */
+    void FinishCompilation();
+
+    /**
+     * @brief Adds a wave to the batch.
+     * @param vertices The wave vertices, including the color of each point.
+     * @param vertexCount The number of vertices.
+     * @param drawType GL_LINE_STRIP, GL_LINE_LOOP or GL_POINTS.
+     * @param additive If true, uses additive blending, otherwise alpha blending.
+     * @param thick If true, the wave is drawn four times, shifted by the offset.
+     * @param offsetX Horizontal offset of the thick line passes.
+     * @param offsetY Vertical offset of the thick line passes.
+     */
+    void Add(const ColoredPoint* vertices, size_t vertexCount, GLenum drawType, bool additive,
+             bool thick, float offsetX, float offsetY);
+
+    /**
+     * @brief Hands the waves added since the last call over to Draw() and empties the batch.
+     */
+    void SwapPreparedFrame();
+
+    /**
+     * @brief Uploads and draws all waves handed over in the last SwapPreparedFrame() call.
+     */
+    void Draw();
+
+private:
+    /**
+     * @brief Draw parameters of a single wave.
+     */
+    struct Wave {
+        GLint firstVertex{};            //!< Index of the first vertex in the buffer.
+        GLsizei vertexCount{};          //!< Number of vertices.
+        GLenum drawType{GL_LINE_STRIP}; //!< Primitive type.
+        bool additive{false};           //!< Additive or alpha blending.
+        GLsizei passes{1};              //!< Number of instances, 4 for thick waves.
+        float offsetX{};                //!< Horizontal thick line offset.
+        float offsetY{};                //!< Vertical thick line offset.
+    };
+
+    /**
+     * @brief All waves of a frame.
+     */
+    struct FrameData {
+        std::vector<ColoredPoint> vertices; //!< Vertices of all waves.
+        std::vector<Wave> waves;            //!< Waves to draw, in order.
+    };
+
+    Renderer::Shader m_shader; //!< Untextured draw shader with thick line offsets.
+    FrameData m_preparedFrame; //!< Waves added for the frame being prepared.
+    FrameData m_drawnFrame;    //!< Waves of the frame being drawn.
+};
+
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -9,56 +9,42 @@
 #endif
 
 #define REG_VAR(var) \
-    var = projectm_eval_context_register_variable(perFrameCodeContext, #var);
+    var = perFrameCodeContext->RegisterVariable(#var);
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
-WaveformPerFrameContext::WaveformPerFrameContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
-    : perFrameCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
+WaveformPerFrameContext::WaveformPerFrameContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters)
+    : perFrameCodeContext(engine.CreateContext(gmegabuf, globalRegisters))
 {
 }
 
-WaveformPerFrameContext::~WaveformPerFrameContext()
+void WaveformPerFrameContext::RegisterBuiltinVariables(const SharedVariableBlock& sharedVariableBlock)
 {
-    if (perFrameCodeHandle != nullptr)
-    {
-        projectm_eval_code_destroy(perFrameCodeHandle);
-    }
-
-    if (perFrameCodeContext != nullptr)
-    {
-        projectm_eval_context_destroy(perFrameCodeContext);
-    }
-}
-
-void WaveformPerFrameContext::RegisterBuiltinVariables()
-{
-    projectm_eval_context_reset_variables(perFrameCodeContext);
-
-    REG_VAR(time);
-    REG_VAR(fps);
-    REG_VAR(frame);
-    REG_VAR(progress);
-
+    perFrameCodeContext->ResetVariables();
+
+    sharedVariables.Register(*perFrameCodeContext, sharedVariableBlock);
+    time = sharedVariables.Variable(SharedVariableBlock::Time);
+    fps = sharedVariables.Variable(SharedVariableBlock::Fps);
+    frame = sharedVariables.Variable(SharedVariableBlock::Frame);
+    progress = sharedVariables.Variable(SharedVariableBlock::Progress);
+    bass = sharedVariables.Variable(SharedVariableBlock::Bass);
+    mid = sharedVariables.Variable(SharedVariableBlock::Mid);
+    treb = sharedVariables.Variable(SharedVariableBlock::Treb);
+    bass_att = sharedVariables.Variable(SharedVariableBlock::BassAtt);
+    mid_att = sharedVariables.Variable(SharedVariableBlock::MidAtt);
+    treb_att = sharedVariables.Variable(SharedVariableBlock::TrebAtt);
     for (int q = 0; q < QVarCount; q++)
     {
-        std::string qvar = "q" + std::to_string(q + 1);
-        q_vars[q] = projectm_eval_context_register_variable(perFrameCodeContext, qvar.c_str());
+        q_vars[q] = sharedVariables.Variable(SharedVariableBlock::Q1 + q);
     }
 
     for (int t = 0; t < TVarCount; t++)
     {
         std::string tvar = "t" + std::to_string(t + 1);
-        t_vars[t] = projectm_eval_context_register_variable(perFrameCodeContext, tvar.c_str());
+        t_vars[t] = perFrameCodeContext->RegisterVariable(tvar);
     }
 
-    REG_VAR(bass);
-    REG_VAR(mid);
-    REG_VAR(treb);
-    REG_VAR(bass_att);
-    REG_VAR(mid_att);
-    REG_VAR(treb_att);
     REG_VAR(r);
     REG_VAR(g);
     REG_VAR(b);
@@ -66,23 +52,9 @@ void WaveformPerFrameContext::RegisterBuiltinVariables()
     REG_VAR(samples);
 }
 
-void WaveformPerFrameContext::LoadStateVariables(PresetState& state, const PerFrameContext& presetPerFrameContext, CustomWaveform& waveform)
+void WaveformPerFrameContext::LoadStateVariables(CustomWaveform& waveform)
 {
-    *time = static_cast<double>(state.renderContext.time);
-    *frame = static_cast<double>(state.renderContext.frame);
-    *fps = static_cast<double>(state.renderContext.fps);
-    *progress = static_cast<double>(state.renderContext.progress);
-    *bass = static_cast<double>(state.audioData.bass);
-    *mid = static_cast<double>(state.audioData.mid);
-    *treb = static_cast<double>(state.audioData.treb);
-    *bass_att = static_cast<double>(state.audioData.bassAtt);
-    *mid_att = static_cast<double>(state.audioData.midAtt);
-    *treb_att = static_cast<double>(state.audioData.trebAtt);
-
-    for (int q = 0; q < QVarCount; q++)
-    {
-        *q_vars[q] = *presetPerFrameContext.q_vars[q];
-    }
+    sharedVariables.Load();
 
     for (int t = 0; t < TVarCount; t++)
     {
@@ -104,14 +76,14 @@ void WaveformPerFrameContext::EvaluateInitCode(const std::string& perFrameInitCo
         return;
     }
 
-    auto* initCode = projectm_eval_code_compile(perFrameCodeContext, perFrameInitCode.c_str());
+    auto initCode = perFrameCodeContext->Compile(perFrameInitCode);
     if (initCode == nullptr)
     {
 #ifdef MILKDROP_PRESET_DEBUG
         int line;
         int col;
-        auto* errmsg = projectm_eval_get_error(perFrameCodeContext, &line, &col);
-        if (errmsg)
+        auto const errmsg = perFrameCodeContext->LastError(line, col);
+        if (!errmsg.empty())
         {
             std::cerr << "[Preset] Could not compile custom wave " << waveform.m_index << " per-frame INIT code: " << errmsg << "(L" << line << " C" << col << ")" << std::endl;
         }
@@ -119,8 +91,7 @@ void WaveformPerFrameContext::EvaluateInitCode(const std::string& perFrameInitCo
         throw MilkdropCompileException("Could not compile custom wave " + std::to_string(waveform.m_index) + " per-frame init code");
     }
 
-    projectm_eval_code_execute(initCode);
-    projectm_eval_code_destroy(initCode);
+    initCode->Execute();
 }
 
 void WaveformPerFrameContext::CompilePerFrameCode(const std::string& perFrameCode,
@@ -131,14 +102,14 @@ void WaveformPerFrameContext::CompilePerFrameCode(const std::string& perFrameCod
         return;
     }
 
-    perFrameCodeHandle = projectm_eval_code_compile(perFrameCodeContext, perFrameCode.c_str());
+    perFrameCodeHandle = perFrameCodeContext->Compile(perFrameCode);
     if (perFrameCodeHandle == nullptr)
     {
 #ifdef MILKDROP_PRESET_DEBUG
             int line;
         int col;
-        auto* errmsg = projectm_eval_get_error(perFrameCodeContext, &line, &col);
-        if (errmsg)
+        auto const errmsg = perFrameCodeContext->LastError(line, col);
+        if (!errmsg.empty())
         {
             std::cerr << "[Preset] Could not compile custom wave " << waveform.m_index << " per-frame code: " << errmsg << "(L" << line << " C" << col << ")" << std::endl;
         }
@@ -151,7 +122,7 @@ void WaveformPerFrameContext::ExecutePerFrameCode()
 {
     if (perFrameCodeHandle != nullptr)
     {
-        projectm_eval_code_execute(perFrameCodeHandle);
+        perFrameCodeHandle->Execute();
     }
 }
 
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "ExpressionEngine.hpp"
 #include "PresetState.hpp"
 
+#include <memory>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -13,25 +16,24 @@ class WaveformPerFrameContext
 public:
     /**
      * @brief Constructor. Creates a new per-frame state object.
+     * @param engine The expression engine used to compile and run the code.
      * @param gmegabuf The global memory buffer to use in the code context.
      * @param globalRegisters The global variables to use in the code context.
      */
-    WaveformPerFrameContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100]);
-
-    ~WaveformPerFrameContext();
+    WaveformPerFrameContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters);
 
     /**
      * @brief Registers the state variables in the expression evaluator context.
+     * @param sharedVariables The preset's shared frame variables.
      */
-    void RegisterBuiltinVariables();
+    void RegisterBuiltinVariables(const SharedVariableBlock& sharedVariables);
 
     /**
      * @brief Loads the current state values into the expression evaluator variables.
-     * @param state The preset state container.
-     * @param presetPerFrameContext The preset per-frame context (for q vars).
+     * Time, audio and Q values are taken from the preset's shared variable block.
      * @param waveform The waveform this context belongs to.
      */
-    void LoadStateVariables(PresetState& state, const PerFrameContext& presetPerFrameContext, CustomWaveform& waveform);
+    void LoadStateVariables(CustomWaveform& waveform);
 
     /**
      * @brief Compiles and runs the preset init code.
@@ -54,8 +56,9 @@ public:
      */
     void ExecutePerFrameCode();
 
-    projectm_eval_context* perFrameCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
-    projectm_eval_code* perFrameCodeHandle{nullptr}; //!< The compiled per-frame code handle.
+    std::unique_ptr<ExpressionEngine::Context> perFrameCodeContext; //!< The code runtime context, holds memory buffers and variables.
+    std::unique_ptr<ExpressionEngine::Program> perFrameCodeHandle;  //!< The compiled per-frame code handle.
+    SharedVariableBinding sharedVariables;                          //!< Binding of the time, audio and Q variables to the shared block.
 
     PRJM_EVAL_F* time{};
     PRJM_EVAL_F* fps{};
@@ -9,32 +9,19 @@
 #endif
 
 #define REG_VAR(var) \
-    var = projectm_eval_context_register_variable(perPointCodeContext, #var);
+    var = perPointCodeContext->RegisterVariable(#var);
 
 namespace libprojectM {
 namespace MilkdropPreset {
 
-WaveformPerPointContext::WaveformPerPointContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100])
-    : perPointCodeContext(projectm_eval_context_create(gmegabuf, globalRegisters))
+WaveformPerPointContext::WaveformPerPointContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters)
+    : perPointCodeContext(engine.CreateContext(gmegabuf, globalRegisters))
 {
 }
 
-WaveformPerPointContext::~WaveformPerPointContext()
-{
-    if (perPointCodeHandle != nullptr)
-    {
-        projectm_eval_code_destroy(perPointCodeHandle);
-    }
-
-    if (perPointCodeContext != nullptr)
-    {
-        projectm_eval_context_destroy(perPointCodeContext);
-    }
-}
-
 void WaveformPerPointContext::RegisterBuiltinVariables()
 {
-    projectm_eval_context_reset_variables(perPointCodeContext);
+    perPointCodeContext->ResetVariables();
 
     REG_VAR(time);
     REG_VAR(fps);
@@ -44,13 +31,13 @@ void WaveformPerPointContext::RegisterBuiltinVariables()
     for (int q = 0; q < QVarCount; q++)
     {
         std::string const qvar = "q" + std::to_string(q + 1);
-        q_vars[q] = projectm_eval_context_register_variable(perPointCodeContext, qvar.c_str());
+        q_vars[q] = perPointCodeContext->RegisterVariable(qvar);
     }
 
     for (int t = 0; t < TVarCount; t++)
     {
         std::string const tvar = "t" + std::to_string(t + 1);
-        t_vars[t] = projectm_eval_context_register_variable(perPointCodeContext, tvar.c_str());
+        t_vars[t] = perPointCodeContext->RegisterVariable(tvar);
     }
 
     REG_VAR(bass);
@@ -92,14 +79,14 @@ void WaveformPerPointContext::CompilePerPointCode(const std::string& perPointCod
         return;
     }
 
-    perPointCodeHandle = projectm_eval_code_compile(perPointCodeContext, perPointCode.c_str());
+    perPointCodeHandle = perPointCodeContext->Compile(perPointCode);
     if (perPointCodeHandle == nullptr)
     {
 #ifdef MILKDROP_PRESET_DEBUG
         int line;
         int col;
-        auto* errmsg = projectm_eval_get_error(perPointCodeContext, &line, &col);
-        if (errmsg)
+        auto const errmsg = perPointCodeContext->LastError(line, col);
+        if (!errmsg.empty())
         {
             std::cerr << "[Preset] Could not compile custom wave " << waveform.m_index << " per-point code: " << errmsg << "(L" << line << " C" << col << ")" << std::endl;
         }
@@ -112,7 +99,7 @@ void WaveformPerPointContext::ExecutePerPointCode()
 {
     if (perPointCodeHandle != nullptr)
     {
-        projectm_eval_code_execute(perPointCodeHandle);
+        perPointCodeHandle->Execute();
     }
 }
 
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "ExpressionEngine.hpp"
 #include "PresetState.hpp"
 
+#include <memory>
+
 namespace libprojectM {
 namespace MilkdropPreset {
 
@@ -13,12 +16,11 @@ class WaveformPerPointContext
 public:
     /**
      * @brief Constructor. Creates a new waveform per-point state object.
+     * @param engine The expression engine used to compile and run the code.
      * @param gmegabuf The global memory buffer to use in the code context.
      * @param globalRegisters The global variables to use in the code context.
      */
-    WaveformPerPointContext(projectm_eval_mem_buffer gmegabuf, PRJM_EVAL_F (*globalRegisters)[100]);
-
-    ~WaveformPerPointContext();
+    WaveformPerPointContext(ExpressionEngine& engine, ExpressionEngine::MemoryBuffer& gmegabuf, ExpressionEngine::GlobalRegisters* globalRegisters);
 
     /**
      * @brief Registers the state variables in the expression evaluator context.
@@ -45,8 +47,8 @@ public:
      */
     void ExecutePerPointCode();
 
-    projectm_eval_context* perPointCodeContext{nullptr}; //!< The code runtime context, holds memory buffers and variables.
-    projectm_eval_code* perPointCodeHandle{nullptr}; //!< The compiled waveform per-point code handle.
+    std::unique_ptr<ExpressionEngine::Context> perPointCodeContext; //!< The code runtime context, holds memory buffers and variables.
+    std::unique_ptr<ExpressionEngine::Program> perPointCodeHandle;  //!< The compiled waveform per-point code handle.
 
     PRJM_EVAL_F* time{};
     PRJM_EVAL_F* fps{};
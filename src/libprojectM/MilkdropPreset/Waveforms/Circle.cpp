@@ -1,5 +1,7 @@
 #include "Waveforms/Circle.hpp"
 
+#include "Waveforms/SinCos.hpp"
+
 #include "PerFrameContext.hpp"
 
 #include <cmath>
@@ -28,11 +30,17 @@ void Circle::GenerateVertices(const PresetState& presetState,
     const int sampleOffset{(Audio::WaveformSamples - m_samples) / 2};
 
     const float inverseSamplesMinusOne{1.0f / static_cast<float>(m_samples)};
+    const float angleOffset{presetState.renderContext.time * 0.2f};
+
+    for (int i = 0; i < m_samples; i++)
+    {
+        m_angles[i] = static_cast<float>(i) * inverseSamplesMinusOne * 6.28f + angleOffset;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
 
     for (int i = 0; i < m_samples; i++)
     {
         float radius = 0.5f + 0.4f * m_pcmDataR[i + sampleOffset] + m_mysteryWaveParam;
-        float const angle = static_cast<float>(i) * inverseSamplesMinusOne * 6.28f + presetState.renderContext.time * 0.2f;
         if (i < m_samples / 10)
         {
             float mix = static_cast<float>(i) / (static_cast<float>(m_samples) * 0.1f);
@@ -41,8 +49,8 @@ void Circle::GenerateVertices(const PresetState& presetState,
             radius = radius2 * (1.0f - mix) + radius * (mix);
         }
 
-        m_wave1Vertices[i].x = radius * cosf(angle) * m_aspectY + m_waveX;
-        m_wave1Vertices[i].y = radius * sinf(angle) * m_aspectX + m_waveY;
+        m_wave1Vertices[i].x = radius * m_cosines[i] * m_aspectY + m_waveX;
+        m_wave1Vertices[i].y = radius * m_sines[i] * m_aspectX + m_waveY;
     }
 }
 
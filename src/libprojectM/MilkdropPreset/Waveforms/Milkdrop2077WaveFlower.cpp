@@ -1,5 +1,7 @@
 #include "Waveforms/Milkdrop2077WaveFlower.hpp"
 
+#include "Waveforms/SinCos.hpp"
+
 #include "PerFrameContext.hpp"
 
 #include <cmath>
@@ -24,11 +26,27 @@ void Milkdrop2077WaveFlower::GenerateVertices(const PresetState& presetState,
 
     float const invertedSamplesMinusOne = 1.0f / static_cast<float>(m_samples - 1);
     float const tenthSamples = static_cast<float>(m_samples) * 0.1f;
+    float const angleOffset = presetState.renderContext.time * 0.2f;
+    float const timeOffset = presetState.renderContext.time / 3.0f;
+    float const flip = cosf(3.1416f);
+
+    // X and Y use different angles, so only the cosines of the first and the sines of the second run are used.
+    for (int sample = 0; sample < m_samples; sample++)
+    {
+        m_angles[sample] = (static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + angleOffset) * 3.1416f;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
+
+    for (int sample = 0; sample < m_samples; sample++)
+    {
+        m_wave1Vertices[sample].x = m_cosines[sample];
+        m_angles[sample] = static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + angleOffset - timeOffset;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
 
     for (int sample = 0; sample < m_samples; sample++)
     {
         float radius = 0.7f + 0.7f * m_pcmDataR[sample + sampleOffset] + m_mysteryWaveParam;
-        float angle = static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + presetState.renderContext.time * 0.2f;
         if (static_cast<float>(sample) < static_cast<float>(m_samples) / radius)
         {
             float mix = static_cast<float>(sample) / tenthSamples;
@@ -39,8 +57,8 @@ void Milkdrop2077WaveFlower::GenerateVertices(const PresetState& presetState,
             radius = radius2 * (1.0f - mix) + radius * mix * .25f;
         }
 
-        m_wave1Vertices[sample].x = radius * cosf(angle * 3.1416f) * m_aspectY / 1.5f + m_waveX * cosf(3.1416f);
-        m_wave1Vertices[sample].y = radius * sinf(angle - presetState.renderContext.time / 3.0f) * m_aspectX / 1.5f + m_waveY * cosf(3.1416f);
+        m_wave1Vertices[sample].x = radius * m_wave1Vertices[sample].x * m_aspectY / 1.5f + m_waveX * flip;
+        m_wave1Vertices[sample].y = radius * m_sines[sample] * m_aspectX / 1.5f + m_waveY * flip;
     }
 }
 
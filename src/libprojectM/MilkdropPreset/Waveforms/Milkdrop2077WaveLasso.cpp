@@ -1,5 +1,7 @@
 #include "Waveforms/Milkdrop2077WaveLasso.hpp"
 
+#include "Waveforms/SinCos.hpp"
+
 #include "PerFrameContext.hpp"
 
 #include <cmath>
@@ -15,12 +17,29 @@ void Milkdrop2077WaveLasso::GenerateVertices(const PresetState& presetState,
 
     m_wave1Vertices.resize(m_samples);
 
+    float const time = presetState.renderContext.time;
+    float const offsetX = cosf(time) / 2.0f;
+    float const scaleY = sinf(time) * 2.0f;
+
+    // X and Y use different angles, so only the cosines of the first and the sines of the second run are used.
     for (int sample = 0; sample < m_samples; sample++)
     {
-        float const angle = m_pcmDataL[sample + 32] * 1.57f + presetState.renderContext.time * 2.0f;
+        float const angle = m_pcmDataL[sample + 32] * 1.57f + time * 2.0f;
+        m_angles[sample] = angle * 2.0f + tanf(time / angle);
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
 
-        m_wave1Vertices[sample].x = cosf(presetState.renderContext.time) / 2.0f + cosf(angle * 2.0f + tanf(presetState.renderContext.time / angle));
-        m_wave1Vertices[sample].y = sinf(presetState.renderContext.time) * 2.0f * sinf(angle * 3.14f) * m_aspectX / 2.8f + m_waveY;
+    for (int sample = 0; sample < m_samples; sample++)
+    {
+        float const angle = m_pcmDataL[sample + 32] * 1.57f + time * 2.0f;
+        m_wave1Vertices[sample].x = offsetX + m_cosines[sample];
+        m_angles[sample] = angle * 3.14f;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
+
+    for (int sample = 0; sample < m_samples; sample++)
+    {
+        m_wave1Vertices[sample].y = scaleY * m_sines[sample] * m_aspectX / 2.8f + m_waveY;
     }
 }
 
@@ -1,5 +1,7 @@
 #include "Waveforms/Milkdrop2077WaveSkewed.hpp"
 
+#include "Waveforms/SinCos.hpp"
+
 #include "PerFrameContext.hpp"
 
 #include <algorithm>
@@ -23,12 +25,23 @@ void Milkdrop2077WaveSkewed::GenerateVertices(const PresetState& presetState,
     }
     alpha = std::max(0.0f, std::min(1.0f, alpha));
 
+    float const angleOffset = presetState.renderContext.time * 3.3f;
+
+    for (size_t i = 0; i < static_cast<size_t>(m_samples); i++)
+    {
+        m_angles[i] = m_pcmDataL[i + 32] * 0.9f + angleOffset;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
+
+    // cos(ang + alpha) = cos(ang) * cos(alpha) - sin(ang) * sin(alpha)
+    float const cosAlpha = cosf(alpha);
+    float const sinAlpha = sinf(alpha);
+
     for (size_t i = 0; i < static_cast<size_t>(m_samples); i++)
     {
         float rad = 0.63f + 0.23f * m_pcmDataR[i] + m_mysteryWaveParam;
-        float ang = m_pcmDataL[i + 32] * 0.9f + presetState.renderContext.time * 3.3f;
-        m_wave1Vertices[i].x = rad * cosf(ang + alpha) * m_aspectY + m_waveX;
-        m_wave1Vertices[i].y = rad * sinf(ang) * m_aspectX + m_waveY;
+        m_wave1Vertices[i].x = rad * (m_cosines[i] * cosAlpha - m_sines[i] * sinAlpha) * m_aspectY + m_waveX;
+        m_wave1Vertices[i].y = rad * m_sines[i] * m_aspectX + m_waveY;
     }
 }
 
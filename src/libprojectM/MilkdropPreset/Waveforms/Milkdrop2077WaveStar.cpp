@@ -1,5 +1,7 @@
 #include "Waveforms/Milkdrop2077WaveStar.hpp"
 
+#include "Waveforms/SinCos.hpp"
+
 #include "PerFrameContext.hpp"
 
 #include <cmath>
@@ -24,11 +26,17 @@ void Milkdrop2077WaveStar::GenerateVertices(const PresetState& presetState,
 
     float const invertedSamplesMinusOne = 1.0f / static_cast<float>(m_samples - 1);
     float const tenthSamples = static_cast<float>(m_samples) * 0.1f;
+    float const angleOffset = presetState.renderContext.time * 0.2f;
+
+    for (int sample = 0; sample < m_samples; sample++)
+    {
+        m_angles[sample] = static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + angleOffset;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
 
     for (int sample = 0; sample < m_samples; sample++)
     {
         float radius = 0.7f + 0.4f * m_pcmDataR[sample + sampleOffset] + m_mysteryWaveParam;
-        float const angle = static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + presetState.renderContext.time * 0.2f;
         if (static_cast<float>(sample) < m_samples / radius)
         {
             float mix = static_cast<float>(sample) / tenthSamples;
@@ -37,8 +45,8 @@ void Milkdrop2077WaveStar::GenerateVertices(const PresetState& presetState,
             float const radius2 = 0.5f + 0.4f * m_pcmDataR[sample + m_samples - sampleOffset] + m_mysteryWaveParam;
             radius = radius2 * (1.0f - mix) + radius * mix;
         }
-        m_wave1Vertices[sample].x = radius * cosf(angle) * m_aspectY + m_waveX;
-        m_wave1Vertices[sample].y = radius * sinf(angle) * m_aspectX + m_waveY;
+        m_wave1Vertices[sample].x = radius * m_cosines[sample] * m_aspectY + m_waveX;
+        m_wave1Vertices[sample].y = radius * m_sines[sample] * m_aspectX + m_waveY;
     }
 }
 
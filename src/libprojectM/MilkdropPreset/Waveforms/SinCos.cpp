@@ -0,0 +1,69 @@
+#include "Waveforms/SinCos.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+namespace Waveforms {
+
+void SinCos(const float* angles, float* sines, float* cosines, size_t count)
+{
+    // Pi/2 split into three parts, so the quadrant multiples can be subtracted without losing precision.
+    constexpr float piOverTwo1{1.5703125f};
+    constexpr float piOverTwo2{4.837512969970703125e-4f};
+    constexpr float piOverTwo3{7.54978995489188216e-8f};
+    constexpr float twoOverPi{0.636619772367581343f};
+
+    // Converting the quadrant to int below is undefined for NaN, infinity and huge values. These are rare,
+    // so the whole batch falls back to the standard library if any angle is out of range. The check
+    // compares the float bits as integers, as float comparisons may trap and prevent vectorization.
+    int32_t maxAngleBits;
+    std::memcpy(&maxAngleBits, &SinCosMaxAngle, sizeof(maxAngleBits));
+    int32_t outOfRange{0};
+    for (size_t index = 0; index < count; index++)
+    {
+        int32_t angleBits;
+        std::memcpy(&angleBits, &angles[index], sizeof(angleBits));
+        outOfRange |= static_cast<int32_t>((angleBits & 0x7FFFFFFF) > maxAngleBits);
+    }
+
+    if (outOfRange != 0)
+    {
+        for (size_t index = 0; index < count; index++)
+        {
+            sines[index] = sinf(angles[index]);
+            cosines[index] = cosf(angles[index]);
+        }
+        return;
+    }
+
+    for (size_t index = 0; index < count; index++)
+    {
+        float const angle = angles[index];
+
+        // Reduce the angle to [-pi/4, pi/4] and remember the quadrant.
+        int const quadrant = static_cast<int>(angle * twoOverPi + std::copysign(0.5f, angle));
+        float const quadrantFloat = static_cast<float>(quadrant);
+        float const x = ((angle - quadrantFloat * piOverTwo1) - quadrantFloat * piOverTwo2) - quadrantFloat * piOverTwo3;
+        float const x2 = x * x;
+
+        // Minimax polynomials from the Cephes library.
+        float const sine = x + x * x2 * ((-1.9515295891e-4f * x2 + 8.3321608736e-3f) * x2 - 1.6666654611e-1f);
+        float const cosine = 1.0f - 0.5f * x2 + x2 * x2 * ((2.443315711809948e-5f * x2 - 1.388731625493765e-3f) * x2 + 4.166664568298827e-2f);
+
+        // Odd quadrants swap sine and cosine, the quadrant also determines the signs.
+        // Integer math and multiplications with 0 or 1 instead of conditions keep the loop free of branches.
+        auto const swap = static_cast<float>(quadrant & 1);
+        auto const sineSign = static_cast<float>(1 - (quadrant & 2));
+        auto const cosineSign = static_cast<float>(1 - ((quadrant + 1) & 2));
+
+        sines[index] = (sine * (1.0f - swap) + cosine * swap) * sineSign;
+        cosines[index] = (cosine * (1.0f - swap) + sine * swap) * cosineSign;
+    }
+}
+
+} // namespace Waveforms
+} // namespace MilkdropPreset
+} // namespace libprojectM
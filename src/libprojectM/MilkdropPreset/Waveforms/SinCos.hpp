@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+namespace libprojectM {
+namespace MilkdropPreset {
+namespace Waveforms {
+
+constexpr float SinCosMaxAngle{100000.0f}; //!< Largest absolute angle calculated by the approximation.
+
+/**
+ * @brief Calculates the sine and cosine of a list of angles.
+ *
+ * Uses a branch-free polynomial approximation the compiler can vectorize, which is a lot faster
+ * than calling sinf() and cosf() for each vertex. The absolute error is below 1e-6 for angles
+ * in the range [-SinCosMaxAngle, SinCosMaxAngle]. Angles outside this range, infinity and NaN are passed
+ * to sinf() and cosf() instead. Waveform angles depend on the preset time and audio data, and
+ * some modes divide by values which can get close to 0, so any float value may occur.
+ *
+ * @param angles The input angles in radians.
+ * @param sines Receives the sine of each angle.
+ * @param cosines Receives the cosine of each angle.
+ * @param count The number of angles.
+ */
+void SinCos(const float* angles, float* sines, float* cosines, size_t count);
+
+} // namespace Waveforms
+} // namespace MilkdropPreset
+} // namespace libprojectM
@@ -10,8 +10,19 @@ namespace libprojectM {
 namespace MilkdropPreset {
 namespace Waveforms {
 
+WaveformMath::WaveformMath()
+{
+    // Some modes add one unused vertex, smoothing roughly doubles the point count.
+    m_wave1Vertices.reserve(WaveformMaxPoints + 1);
+    m_wave2Vertices.reserve(WaveformMaxPoints + 1);
+    for (auto& smoothedVertices : m_smoothedVertices)
+    {
+        smoothedVertices.reserve(WaveformMaxPoints * 2);
+    }
+}
+
 auto WaveformMath::GetVertices(const PresetState& presetState,
-                               const PerFrameContext& presetPerFrameContext) -> std::array<VertexList, 2>
+                               const PerFrameContext& presetPerFrameContext) -> std::array<VertexList, 2>&
 {
     static_assert(WaveformMaxPoints >= libprojectM::Audio::SpectrumSamples, "WaveformMaxPoints is smaller than SpectrumSamples");
     static_assert(WaveformMaxPoints >= libprojectM::Audio::WaveformSamples, "WaveformMaxPoints is smaller than WaveformSamples");
@@ -84,11 +95,10 @@ auto WaveformMath::GetVertices(const PresetState& presetState,
 
     GenerateVertices(presetState, presetPerFrameContext);
 
-    std::array<VertexList, 2> smoothedVertices;
-    SmoothWave(m_wave1Vertices, smoothedVertices.at(0));
-    SmoothWave(m_wave2Vertices, smoothedVertices.at(1));
+    SmoothWave(m_wave1Vertices, m_smoothedVertices.at(0));
+    SmoothWave(m_wave2Vertices, m_smoothedVertices.at(1));
 
-    return smoothedVertices;
+    return m_smoothedVertices;
 }
 
 auto WaveformMath::IsLoop() -> bool
@@ -21,18 +21,25 @@ class WaveformMath
 public:
     using VertexList = std::vector<Renderer::RenderItem::Point>;
 
+    /**
+     * @brief Reserves all vertex buffers for the maximum number of points.
+     * This way, no memory is allocated while rendering frames.
+     */
+    WaveformMath();
+
     virtual ~WaveformMath() = default;
 
     /**
      * @brief Calculates and smoothes the samples and outputs vertices ready for drawing.
      * Depending on the waveform type, only the first set of vertices might be present.
+     * The returned buffers are reused in the next call and may be modified by the caller.
      * @param presetState The preset state older, including the render context.
      * @param presetPerFrameContext The preset per-frame context.
-     * @return An array with either one or two sets of waveform vertices.
+     * @return A reference to an array with either one or two sets of waveform vertices.
      */
     auto GetVertices(const PresetState& presetState,
                      const PerFrameContext& presetPerFrameContext)
-        -> std::array<VertexList, 2>;
+        -> std::array<VertexList, 2>&;
 
     /**
      * @brief Indicates whether the waveform should be drawn as a closed line loop instead of a strip.
@@ -88,6 +95,14 @@ protected:
 
     VertexList m_wave1Vertices;
     VertexList m_wave2Vertices;
+
+    // Scratch buffers for calculating sines and cosines of all vertices in one go.
+    std::array<float, WaveformMaxPoints> m_angles{};
+    std::array<float, WaveformMaxPoints> m_sines{};
+    std::array<float, WaveformMaxPoints> m_cosines{};
+
+private:
+    std::array<VertexList, 2> m_smoothedVertices; //!< The smoothed output vertices.
 };
 
 } // namespace Waveforms
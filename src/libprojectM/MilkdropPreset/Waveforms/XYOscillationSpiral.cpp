@@ -1,5 +1,7 @@
 #include "Waveforms/XYOscillationSpiral.hpp"
 
+#include "Waveforms/SinCos.hpp"
+
 #include "PerFrameContext.hpp"
 
 namespace libprojectM {
@@ -23,13 +25,20 @@ void XYOscillationSpiral::GenerateVertices(const PresetState& presetState,
 
     m_wave1Vertices.resize(m_samples);
 
+    float const angleOffset = presetState.renderContext.time * 2.3f;
+
+    for (int i = 0; i < m_samples; i++)
+    {
+        m_angles[i] = m_pcmDataL[i + 32] * 1.57f + angleOffset;
+    }
+    SinCos(m_angles.data(), m_sines.data(), m_cosines.data(), m_samples);
+
     for (int i = 0; i < m_samples; i++)
     {
         float const radius = (0.53f + 0.43f * m_pcmDataR[i] + m_mysteryWaveParam);
-        float const angle = m_pcmDataL[i + 32] * 1.57f + presetState.renderContext.time * 2.3f;
 
-        m_wave1Vertices[i].x = radius * cosf(angle) * m_aspectY + m_waveX;
-        m_wave1Vertices[i].y = radius * sinf(angle) * m_aspectX + m_waveY;
+        m_wave1Vertices[i].x = radius * m_cosines[i] * m_aspectY + m_waveX;
+        m_wave1Vertices[i].y = radius * m_sines[i] * m_aspectX + m_waveY;
     }
 }
 
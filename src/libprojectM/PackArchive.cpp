@@ -0,0 +1,382 @@
+#include "PackArchive.hpp"
+
+#include "Lz4.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace libprojectM {
+
+constexpr const char* PackArchive::FileExtension;
+constexpr uint32_t PackArchive::FormatVersion;
+constexpr size_t PackArchive::HeaderSize;
+constexpr size_t PackArchive::IndexEntrySize;
+constexpr size_t PackArchive::InvalidIndex;
+constexpr uint64_t PackArchive::MaxMemberSize;
+constexpr char PackArchive::Magic[8];
+
+namespace {
+
+/**
+ * Header field offsets.
+ */
+enum HeaderField : size_t
+{
+    MagicOffset = 0,
+    FormatVersionOffset = 8,
+    MemberCountOffset = 12,
+    IndexOffsetOffset = 16,
+    FileSizeOffset = 24
+};
+
+/**
+ * Index entry field offsets.
+ */
+enum IndexField : size_t
+{
+    NameOffsetOffset = 0,
+    NameSizeOffset = 8,
+    CompressionOffset = 12,
+    DataOffsetOffset = 16,
+    StoredSizeOffset = 24,
+    SizeOffset = 32
+};
+
+template<typename T>
+auto ReadInteger(const char* data, size_t offset) -> T
+{
+    T value{};
+    for (size_t byte = 0; byte < sizeof(T); byte++)
+    {
+        value |= static_cast<T>(static_cast<unsigned char>(data[offset + byte])) << (byte * 8);
+    }
+    return value;
+}
+
+auto FoldCharacter(char character) -> int
+{
+    if (character == '\\')
+    {
+        return '/';
+    }
+    return std::tolower(static_cast<unsigned char>(character));
+}
+
+/**
+ * @brief Compares two member names case-insensitively, treating backslashes as forward slashes.
+ * @return A negative value if the first name sorts first, 0 if both are equal, a positive value otherwise.
+ */
+auto CompareNames(const char* first, size_t firstSize, const char* second, size_t secondSize) -> int
+{
+    auto const commonSize = std::min(firstSize, secondSize);
+    for (size_t index = 0; index < commonSize; index++)
+    {
+        auto const difference = FoldCharacter(first[index]) - FoldCharacter(second[index]);
+        if (difference != 0)
+        {
+            return difference;
+        }
+    }
+
+    if (firstSize == secondSize)
+    {
+        return 0;
+    }
+
+    return firstSize < secondSize ? -1 : 1;
+}
+
+} // namespace
+
+PackArchive::~PackArchive()
+{
+    Close();
+}
+
+auto PackArchive::Open(const std::string& packFile) -> bool
+{
+    Close();
+
+#ifdef _WIN32
+    m_fileHandle = CreateFileA(packFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+    {
+        m_fileHandle = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(HeaderSize))
+    {
+        Close();
+        return false;
+    }
+
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        Close();
+        return false;
+    }
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int const fileDescriptor = open(packFile.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStatus{};
+    if (fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size < static_cast<off_t>(HeaderSize))
+    {
+        close(fileDescriptor);
+        return false;
+    }
+
+    auto* mapping = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+    // The mapping stays valid after closing the file.
+    close(fileDescriptor);
+
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_data = static_cast<const char*>(mapping);
+    m_size = static_cast<size_t>(fileStatus.st_size);
+#endif
+
+    if (memcmp(m_data + MagicOffset, Magic, sizeof(Magic)) != 0 ||
+        ReadInteger<uint32_t>(m_data, FormatVersionOffset) != FormatVersion ||
+        ReadInteger<uint64_t>(m_data, FileSizeOffset) != m_size)
+    {
+        Close();
+        return false;
+    }
+
+    m_memberCount = ReadInteger<uint32_t>(m_data, MemberCountOffset);
+    auto const indexOffset = ReadInteger<uint64_t>(m_data, IndexOffsetOffset);
+    if (indexOffset < HeaderSize || indexOffset > m_size ||
+        m_memberCount > (m_size - indexOffset) / IndexEntrySize)
+    {
+        Close();
+        return false;
+    }
+    m_index = m_data + indexOffset;
+
+    if (!ValidateIndex())
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void PackArchive::Close()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle != nullptr)
+    {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+    }
+    if (m_fileHandle != nullptr)
+    {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = nullptr;
+    }
+#else
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_memberCount = 0;
+    m_index = nullptr;
+}
+
+auto PackArchive::MemberCount() const -> size_t
+{
+    return m_memberCount;
+}
+
+auto PackArchive::MemberName(size_t index) const -> std::string
+{
+    auto const* entry = IndexEntry(index);
+    return {m_data + ReadInteger<uint64_t>(entry, NameOffsetOffset), ReadInteger<uint32_t>(entry, NameSizeOffset)};
+}
+
+auto PackArchive::MemberSize(size_t index) const -> size_t
+{
+    return static_cast<size_t>(ReadInteger<uint64_t>(IndexEntry(index), SizeOffset));
+}
+
+auto PackArchive::Find(const std::string& memberName) const -> size_t
+{
+    auto const name = NormalizeName(memberName);
+
+    size_t first{0};
+    size_t last{m_memberCount};
+    while (first < last)
+    {
+        auto const middle = first + (last - first) / 2;
+        auto const* entry = IndexEntry(middle);
+        auto const comparison = CompareNames(m_data + ReadInteger<uint64_t>(entry, NameOffsetOffset),
+                                             ReadInteger<uint32_t>(entry, NameSizeOffset),
+                                             name.data(), name.size());
+        if (comparison == 0)
+        {
+            return middle;
+        }
+
+        if (comparison < 0)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return InvalidIndex;
+}
+
+auto PackArchive::Read(size_t index, std::vector<char>& buffer) const -> View
+{
+    auto const* entry = IndexEntry(index);
+    auto const* data = m_data + ReadInteger<uint64_t>(entry, DataOffsetOffset);
+    auto const storedSize = static_cast<size_t>(ReadInteger<uint64_t>(entry, StoredSizeOffset));
+    auto const size = static_cast<size_t>(ReadInteger<uint64_t>(entry, SizeOffset));
+
+    if (static_cast<Compression>(ReadInteger<uint32_t>(entry, CompressionOffset)) == Compression::Stored || size == 0)
+    {
+        return {data, size};
+    }
+
+    buffer.resize(size);
+    if (!Lz4::DecompressBlock(data, storedSize, buffer.data(), size))
+    {
+        return {};
+    }
+
+    return {buffer.data(), size};
+}
+
+auto PackArchive::IsPackFileName(const std::string& fileName) -> bool
+{
+    std::string const extension{FileExtension};
+    return fileName.length() > extension.length() &&
+           Utils::ToLower(fileName.substr(fileName.length() - extension.length())) == extension;
+}
+
+auto PackArchive::SplitPath(const std::string& path, std::string& packFile, std::string& memberName) -> bool
+{
+    auto const lowerCasePath = Utils::ToLower(path);
+    auto const extensionLength = strlen(FileExtension);
+
+    auto position = lowerCasePath.find(FileExtension);
+    while (position != std::string::npos)
+    {
+        auto const separator = position + extensionLength;
+        if (separator + 1 < path.length() && (path.at(separator) == '/' || path.at(separator) == '\\'))
+        {
+            packFile = path.substr(0, separator);
+            memberName = path.substr(separator + 1);
+            return true;
+        }
+
+        position = lowerCasePath.find(FileExtension, position + 1);
+    }
+
+    return false;
+}
+
+auto PackArchive::NormalizeName(const std::string& memberName) -> std::string
+{
+    std::string name = Utils::ToLower(memberName);
+    std::replace(name.begin(), name.end(), '\\', '/');
+    name.erase(0, name.find_first_not_of('/'));
+    return name;
+}
+
+auto PackArchive::IndexEntry(size_t index) const -> const char*
+{
+    return m_index + index * IndexEntrySize;
+}
+
+auto PackArchive::ValidateIndex() const -> bool
+{
+    const char* previousName{};
+    size_t previousNameSize{};
+
+    for (size_t index = 0; index < m_memberCount; index++)
+    {
+        auto const* entry = IndexEntry(index);
+        auto const nameOffset = ReadInteger<uint64_t>(entry, NameOffsetOffset);
+        auto const nameSize = ReadInteger<uint32_t>(entry, NameSizeOffset);
+        auto const compression = static_cast<Compression>(ReadInteger<uint32_t>(entry, CompressionOffset));
+        auto const dataOffset = ReadInteger<uint64_t>(entry, DataOffsetOffset);
+        auto const storedSize = ReadInteger<uint64_t>(entry, StoredSizeOffset);
+        auto const size = ReadInteger<uint64_t>(entry, SizeOffset);
+
+        if (nameSize == 0 || nameOffset > m_size || nameSize > m_size - nameOffset ||
+            dataOffset > m_size || storedSize > m_size - dataOffset)
+        {
+            return false;
+        }
+
+        if (compression == Compression::Stored ? storedSize != size : compression != Compression::Lz4)
+        {
+            return false;
+        }
+
+        // Read() allocates the uncompressed size up front. LZ4 can't expand a block by more than
+        // a factor of 255, so anything above that or the size limit is a damaged or malicious index.
+        if (compression == Compression::Lz4 && (size > MaxMemberSize || size > storedSize * 255))
+        {
+            return false;
+        }
+
+        // Binary search requires unique, sorted names.
+        auto const* name = m_data + nameOffset;
+        if (previousName != nullptr && CompareNames(previousName, previousNameSize, name, nameSize) >= 0)
+        {
+            return false;
+        }
+
+        previousName = name;
+        previousNameSize = nameSize;
+    }
+
+    return true;
+}
+
+} // namespace libprojectM
@@ -0,0 +1,163 @@
+/**
+ * @file PackArchive.hpp
+ * @brief Read-only access to memory-mapped preset and texture pack files.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+
+/**
+ * @brief A single file containing a whole preset library, including its textures.
+ *
+ * Large preset collections consist of tens of thousands of small files. Scanning the directories
+ * and opening each file takes much longer than parsing the presets, especially on slow storage.
+ * A pack stores all files in one archive which is mapped into memory once. The members are found
+ * via a sorted index and read directly from the mapping without any copies.
+ *
+ * Members are either stored as-is or compressed as a single LZ4 block, which is decompressed into
+ * a caller-provided buffer.
+ *
+ * Files inside a pack are addressed with the pack file name followed by the member name, e.g.
+ * "presets.milkpack/Geiss/Reaction Diffusion.milk". Member names always use forward slashes and
+ * are matched case-insensitively.
+ *
+ * File layout, with all integers stored in little-endian byte order:
+ * - A 32 byte header with the magic bytes, the format version, the member count, the offset of
+ *   the index and the total file size.
+ * - The member data, in any order.
+ * - The index with one 40 byte entry per member, sorted by the lower-case member name. Each entry
+ *   contains the offset and size of the name, the compression method, the offset and stored size
+ *   of the data and the uncompressed size.
+ * - The member names referenced by the index.
+ */
+class PackArchive
+{
+public:
+    /**
+     * Compression methods of pack members.
+     */
+    enum class Compression : uint32_t
+    {
+        Stored = 0, //!< Data is stored uncompressed.
+        Lz4 = 1     //!< Data is stored as a single LZ4 block.
+    };
+
+    /**
+     * A view of a member's data.
+     */
+    struct View {
+        const char* data{}; //!< Pointer to the data, nullptr if the member couldn't be read.
+        size_t size{};      //!< Size of the data in bytes.
+    };
+
+    static constexpr const char* FileExtension{".milkpack"};                 //!< File extension of pack files.
+    static constexpr uint32_t FormatVersion{1};                              //!< Current format version. Other versions are rejected.
+    static constexpr size_t HeaderSize{32};                                  //!< Size of the file header in bytes.
+    static constexpr size_t IndexEntrySize{40};                              //!< Size of a single index entry in bytes.
+    static constexpr size_t InvalidIndex{static_cast<size_t>(-1)};           //!< Returned by Find() if no member matches.
+    static constexpr uint64_t MaxMemberSize{256 * 1024 * 1024};              //!< Largest uncompressed member size accepted for compressed members.
+    static constexpr char Magic[8]{'P', 'R', 'J', 'M', 'P', 'A', 'C', 'K'}; //!< Magic bytes at the start of each pack.
+
+    PackArchive() = default;
+
+    ~PackArchive();
+
+    PackArchive(const PackArchive&) = delete;
+    auto operator=(const PackArchive&) -> PackArchive& = delete;
+
+    /**
+     * @brief Maps a pack file into memory and validates its index.
+     * @param packFile The pack file name.
+     * @return True if the pack was opened successfully, false if the file can't be mapped or isn't a valid pack.
+     */
+    auto Open(const std::string& packFile) -> bool;
+
+    /**
+     * @brief Unmaps the pack file.
+     */
+    void Close();
+
+    /**
+     * @brief Returns the number of members in the pack.
+     * @return The member count, 0 if no pack is open.
+     */
+    auto MemberCount() const -> size_t;
+
+    /**
+     * @brief Returns the name of a member.
+     * @param index The member index, sorted by the lower-case name.
+     * @return The member name as stored in the pack.
+     */
+    auto MemberName(size_t index) const -> std::string;
+
+    /**
+     * @brief Returns the uncompressed size of a member.
+     * @param index The member index.
+     * @return The size of the member's data in bytes.
+     */
+    auto MemberSize(size_t index) const -> size_t;
+
+    /**
+     * @brief Finds a member by name.
+     * @param memberName The member name. Case-insensitive, backslashes are treated as forward slashes.
+     * @return The member index, or InvalidIndex if the pack has no such member.
+     */
+    auto Find(const std::string& memberName) const -> size_t;
+
+    /**
+     * @brief Returns the data of a member.
+     *
+     * Stored members are returned directly from the mapped file, compressed members are
+     * decompressed into the given buffer. In both cases, the view is valid until the pack is
+     * closed or the buffer is modified.
+     *
+     * @param index The member index.
+     * @param buffer A buffer for the decompressed data, only used for compressed members.
+     * @return A view of the member's data, with a nullptr data pointer if the member is damaged.
+     */
+    auto Read(size_t index, std::vector<char>& buffer) const -> View;
+
+    /**
+     * @brief Returns whether the file name has the pack file extension.
+     * @param fileName The file name to check.
+     * @return True if the file is a pack.
+     */
+    static auto IsPackFileName(const std::string& fileName) -> bool;
+
+    /**
+     * @brief Splits a path to a pack member into the pack file name and member name.
+     * @param path The path, e.g. "presets.milkpack/Geiss/Reaction Diffusion.milk".
+     * @param packFile Receives the pack file name.
+     * @param memberName Receives the member name inside the pack.
+     * @return True if the path points into a pack, false if it's a regular file path.
+     */
+    static auto SplitPath(const std::string& path, std::string& packFile, std::string& memberName) -> bool;
+
+    /**
+     * @brief Normalizes a member name for sorting and lookups.
+     * @param memberName The member name.
+     * @return The lower-case name with all backslashes replaced by forward slashes and leading slashes removed.
+     */
+    static auto NormalizeName(const std::string& memberName) -> std::string;
+
+private:
+    auto IndexEntry(size_t index) const -> const char*;
+
+    auto ValidateIndex() const -> bool;
+
+    const char* m_data{};   //!< Start of the mapped file.
+    size_t m_size{};        //!< Size of the mapped file in bytes.
+    size_t m_memberCount{}; //!< Number of members in the index.
+    const char* m_index{};  //!< Start of the index in the mapped file.
+#ifdef _WIN32
+    void* m_fileHandle{};    //!< Handle of the opened file.
+    void* m_mappingHandle{}; //!< Handle of the file mapping object.
+#endif
+};
+
+} // namespace libprojectM
@@ -0,0 +1,121 @@
+#include "PackArchiveWriter.hpp"
+
+#include "Lz4.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+namespace libprojectM {
+
+namespace {
+
+template<typename T>
+void WriteInteger(std::string& data, size_t offset, T value)
+{
+    for (size_t byte = 0; byte < sizeof(T); byte++)
+    {
+        data[offset + byte] = static_cast<char>((value >> (byte * 8)) & 0xFF);
+    }
+}
+
+} // namespace
+
+PackArchiveWriter::PackArchiveWriter(std::ostream& packStream, bool compress)
+    : m_packStream(packStream)
+    , m_compress(compress)
+{
+    // The header is written by Finish(), reserve the space for now.
+    std::string const header(PackArchive::HeaderSize, '\0');
+    m_packStream.write(header.data(), static_cast<std::streamsize>(header.size()));
+    m_offset = PackArchive::HeaderSize;
+}
+
+auto PackArchiveWriter::Add(const std::string& memberName, const std::string& data) -> bool
+{
+    Member member;
+    member.name = memberName;
+    std::replace(member.name.begin(), member.name.end(), '\\', '/');
+    member.name.erase(0, member.name.find_first_not_of('/'));
+    if (member.name.empty())
+    {
+        return false;
+    }
+
+    member.sortKey = PackArchive::NormalizeName(member.name);
+    member.dataOffset = m_offset;
+    member.size = data.size();
+
+    // Already compressed formats like JPEG or PNG won't get any smaller and are better stored as-is.
+    std::string compressedData;
+    if (m_compress)
+    {
+        compressedData = Lz4::CompressBlock(data.data(), data.size());
+    }
+
+    const std::string& storedData = m_compress && compressedData.size() < data.size() ? compressedData : data;
+    member.compression = &storedData == &compressedData ? PackArchive::Compression::Lz4 : PackArchive::Compression::Stored;
+    member.storedSize = storedData.size();
+
+    m_packStream.write(storedData.data(), static_cast<std::streamsize>(storedData.size()));
+    m_offset += storedData.size();
+
+    m_members.push_back(std::move(member));
+
+    return m_packStream.good();
+}
+
+auto PackArchiveWriter::Finish() -> bool
+{
+    std::sort(m_members.begin(), m_members.end(), [](const Member& first, const Member& second) {
+        return first.sortKey < second.sortKey;
+    });
+
+    auto const duplicate = std::adjacent_find(m_members.begin(), m_members.end(), [](const Member& first, const Member& second) {
+        return first.sortKey == second.sortKey;
+    });
+    if (duplicate != m_members.end())
+    {
+        return false;
+    }
+
+    auto const indexOffset = m_offset;
+    auto nameOffset = indexOffset + m_members.size() * PackArchive::IndexEntrySize;
+
+    std::string index(m_members.size() * PackArchive::IndexEntrySize, '\0');
+    std::string names;
+    for (size_t memberIndex = 0; memberIndex < m_members.size(); memberIndex++)
+    {
+        const auto& member = m_members.at(memberIndex);
+        auto const entryOffset = memberIndex * PackArchive::IndexEntrySize;
+
+        WriteInteger<uint64_t>(index, entryOffset, nameOffset);
+        WriteInteger<uint32_t>(index, entryOffset + 8, static_cast<uint32_t>(member.name.size()));
+        WriteInteger<uint32_t>(index, entryOffset + 12, static_cast<uint32_t>(member.compression));
+        WriteInteger<uint64_t>(index, entryOffset + 16, member.dataOffset);
+        WriteInteger<uint64_t>(index, entryOffset + 24, member.storedSize);
+        WriteInteger<uint64_t>(index, entryOffset + 32, member.size);
+
+        names.append(member.name);
+        nameOffset += member.name.size();
+    }
+
+    m_packStream.write(index.data(), static_cast<std::streamsize>(index.size()));
+    m_packStream.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+    std::string header(PackArchive::HeaderSize, '\0');
+    memcpy(&header[0], PackArchive::Magic, sizeof(PackArchive::Magic));
+    WriteInteger<uint32_t>(header, 8, PackArchive::FormatVersion);
+    WriteInteger<uint32_t>(header, 12, static_cast<uint32_t>(m_members.size()));
+    WriteInteger<uint64_t>(header, 16, indexOffset);
+    WriteInteger<uint64_t>(header, 24, nameOffset);
+
+    m_packStream.seekp(0, std::ios_base::beg);
+    m_packStream.write(header.data(), static_cast<std::streamsize>(header.size()));
+    m_packStream.seekp(0, std::ios_base::end);
+    m_packStream.flush();
+
+    return m_packStream.good();
+}
+
+} // namespace libprojectM
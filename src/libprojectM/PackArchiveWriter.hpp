@@ -0,0 +1,65 @@
+/**
+ * @file PackArchiveWriter.hpp
+ * @brief Writes preset and texture pack files.
+ */
+#pragma once
+
+#include "PackArchive.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+
+/**
+ * @brief Creates a pack file which can be read by PackArchive.
+ *
+ * Member data is written to the stream as soon as it's added, so only the index is kept in
+ * memory. The index is sorted and written when calling Finish().
+ */
+class PackArchiveWriter
+{
+public:
+    /**
+     * @brief Creates a new writer.
+     * @param packStream The output stream. Must be opened in binary mode and support seeking.
+     * @param compress If true, members are compressed with LZ4 if this makes them smaller.
+     */
+    PackArchiveWriter(std::ostream& packStream, bool compress);
+
+    /**
+     * @brief Adds a member to the pack.
+     * @param memberName The member name, relative to the pack root. Backslashes are converted to forward slashes.
+     * @param data The member data.
+     * @return True if the member was written, false if the name is empty or a write error occurred.
+     */
+    auto Add(const std::string& memberName, const std::string& data) -> bool;
+
+    /**
+     * @brief Writes the index and updates the header.
+     * @return True if the pack was written successfully, false if a write error occurred or two members have the same name.
+     */
+    auto Finish() -> bool;
+
+private:
+    /**
+     * An index entry of an added member.
+     */
+    struct Member {
+        std::string name;                                                       //!< The member name as stored in the pack.
+        std::string sortKey;                                                    //!< The normalized name used to sort the index.
+        PackArchive::Compression compression{PackArchive::Compression::Stored}; //!< The compression method.
+        uint64_t dataOffset{};                                                  //!< Offset of the data from the start of the file.
+        uint64_t storedSize{};                                                  //!< Size of the stored data.
+        uint64_t size{};                                                        //!< Size of the uncompressed data.
+    };
+
+    std::ostream& m_packStream;    //!< The output stream.
+    bool m_compress{false};        //!< If true, members are compressed.
+    uint64_t m_offset{};           //!< Current write offset.
+    std::vector<Member> m_members; //!< All added members.
+};
+
+} // namespace libprojectM
@@ -21,8 +21,73 @@ public:
      */
     virtual void Initialize(const Renderer::RenderContext& renderContext) = 0;
 
+    /**
+     * @brief Returns whether the shaders compiled in Initialize() are ready to use.
+     *
+     * Shader programs are compiled in the background if the driver supports it. Presets not
+     * compiling any shaders can keep the default implementation.
+     *
+     * @return true if FinishCompilation() won't wait for the driver.
+     */
+    virtual auto IsCompilationComplete() const -> bool
+    {
+        return true;
+    }
+
+    /**
+     * @brief Waits for the shaders compiled in Initialize() and checks the results.
+     *
+     * Must be called before the first frame is rendered. Calling it again does nothing.
+     *
+     * @throws std::exception Thrown if a required shader failed to compile.
+     */
+    virtual void FinishCompilation()
+    {
+    }
+
+    /**
+     * @brief Replaces the render context passed to Initialize().
+     *
+     * A preset waiting for its shaders may be activated several frames after it was initialized.
+     * This is called right before FinishCompilation() so the textures and framebuffer sizes used
+     * to finish loading are the current ones, not those of the frame the preset was loaded in.
+     *
+     * @param renderContext The current render context.
+     */
+    virtual void UpdateRenderContext(const Renderer::RenderContext& /*renderContext*/)
+    {
+    }
+
+    /**
+     * @brief Runs the CPU-side part of the next frame without issuing any OpenGL calls.
+     *
+     * This includes evaluating all expressions and calculating the vertices and uniform values
+     * of everything drawn in the frame. It may be called from a different thread than the one
+     * owning the OpenGL context. Besides running concurrently with RenderFrame() after a
+     * BeginFrame() call, it must never run concurrently with any other method of the same preset.
+     *
+     * @param audioData Audio data to be used by the preset.
+     * @param renderContext The render context data of the frame being prepared.
+     */
+    virtual void PrepareFrame(const libprojectM::Audio::FrameAudioData& audioData,
+                              const Renderer::RenderContext& renderContext) = 0;
+
+    /**
+     * @brief Hands the prepared frame over to RenderFrame().
+     *
+     * Prepares the frame synchronously if PrepareFrame() wasn't called before. After this call,
+     * PrepareFrame() may prepare the following frame on another thread while RenderFrame() draws
+     * this one. Must be called on the thread owning the OpenGL context.
+     *
+     * @param audioData Audio data to be used by the preset.
+     * @param renderContext The current render context data.
+     */
+    virtual void BeginFrame(const libprojectM::Audio::FrameAudioData& audioData,
+                            const Renderer::RenderContext& renderContext) = 0;
+
     /**
      * @brief Renders the preset into the current framebuffer.
+     * Calls BeginFrame() first if it wasn't called for this frame.
      * @param audioData Audio data to be used by the preset.
      * @param renderContext The current render context data.
      */
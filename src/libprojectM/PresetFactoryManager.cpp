@@ -26,6 +26,7 @@ void PresetFactoryManager::ClearFactories()
         delete (*pos);
     }
     m_factoryList.clear();
+    m_milkdropFactory = nullptr;
 }
 
 void PresetFactoryManager::initialize()
@@ -33,7 +34,27 @@ void PresetFactoryManager::initialize()
     ClearFactories();
 
     auto* milkdropFactory = new MilkdropPreset::Factory();
+    milkdropFactory->SetExpressionJitEnabled(m_expressionJitEnabled);
     registerFactory(milkdropFactory->supportedExtensions(), milkdropFactory);
+    m_milkdropFactory = milkdropFactory;
+}
+
+void PresetFactoryManager::SetExpressionJitEnabled(bool enabled)
+{
+    m_expressionJitEnabled = enabled;
+    if (m_milkdropFactory != nullptr)
+    {
+        m_milkdropFactory->SetExpressionJitEnabled(enabled);
+    }
+}
+
+bool PresetFactoryManager::ExpressionJitEnabled() const
+{
+    if (m_milkdropFactory != nullptr)
+    {
+        return m_milkdropFactory->ExpressionJitEnabled();
+    }
+    return m_expressionJitEnabled;
 }
 
 // Current behavior if a conflict is occurs is to override the previous request
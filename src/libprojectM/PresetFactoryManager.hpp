@@ -8,6 +8,10 @@
 
 namespace libprojectM {
 
+namespace MilkdropPreset {
+class Factory;
+}
+
 /// A simple exception class to strongly type all preset factory related issues
 class PresetFactoryException : public std::exception
 {
@@ -78,6 +82,17 @@ public:
 
     std::vector<std::string> extensionsHandled() const;
 
+    /**
+     * @brief Sets whether Milkdrop presets loaded afterwards compile their code to native code.
+     * @param enabled True to use the expression JIT if available, false to use the interpreter.
+     */
+    void SetExpressionJitEnabled(bool enabled);
+
+    /**
+     * @brief Returns whether Milkdrop presets use the expression JIT.
+     * @return True if the JIT is enabled and was built into the library, false otherwise.
+     */
+    bool ExpressionJitEnabled() const;
 
 private:
     void registerFactory(const std::string& extension, PresetFactory* factory);
@@ -86,6 +101,8 @@ private:
 
     mutable std::map<std::string, PresetFactory*> m_factoryMap;
     mutable std::vector<PresetFactory*> m_factoryList;
+    MilkdropPreset::Factory* m_milkdropFactory{nullptr}; //!< The Milkdrop factory, owned by m_factoryList.
+    bool m_expressionJitEnabled{false};                  //!< Expression JIT setting, applied to new factories.
     void ClearFactories();
 };
 
@@ -23,19 +23,30 @@
 
 #include "Preset.hpp"
 #include "PresetFactoryManager.hpp"
+#include "QualityGovernor.hpp"
 #include "TimeKeeper.hpp"
 
 #include <Audio/PCM.hpp>
 
 #include <Renderer/CopyTexture.hpp>
+#include <Renderer/Framebuffer.hpp>
 #include <Renderer/PresetTransition.hpp>
+#include <Renderer/StateCache.hpp>
 #include <Renderer/TextureManager.hpp>
 #include <Renderer/TransitionShaderManager.hpp>
 
+#include <SOIL2/stb_image_write.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <ctime>
+
 namespace libprojectM {
 
 ProjectM::ProjectM()
     : m_presetFactoryManager(std::make_unique<PresetFactoryManager>())
+    , m_qualityGovernor(std::make_unique<QualityGovernor>())
 {
     Initialize();
 }
@@ -43,6 +54,8 @@ ProjectM::ProjectM()
 ProjectM::~ProjectM()
 {
     // Can't use "=default" in the header due to unique_ptr requiring the actual type declarations.
+    WaitForPreparedFrame();
+    ReleaseFrameTexture();
 }
 
 void ProjectM::PresetSwitchRequestedEvent(bool) const
@@ -53,8 +66,14 @@ void ProjectM::PresetSwitchFailedEvent(const std::string&, const std::string&) c
 {
 }
 
+void ProjectM::QualityLevelChangedEvent(int) const
+{
+}
+
 void ProjectM::LoadPresetFile(const std::string& presetFilename, bool smoothTransition)
 {
+    WaitForPreparedFrame();
+
     try
     {
         m_textureManager->PurgeTextures();
@@ -68,6 +87,8 @@ void ProjectM::LoadPresetFile(const std::string& presetFilename, bool smoothTran
 
 void ProjectM::LoadPresetData(std::istream& presetData, bool smoothTransition)
 {
+    WaitForPreparedFrame();
+
     try
     {
         m_textureManager->PurgeTextures();
@@ -79,28 +100,66 @@ void ProjectM::LoadPresetData(std::istream& presetData, bool smoothTransition)
     }
 }
 
+void ProjectM::SwitchToPendingPreset()
+{
+    WaitForPreparedFrame();
+
+    ActivatePendingPreset(true);
+}
+
 void ProjectM::SetTexturePaths(std::vector<std::string> texturePaths)
 {
+    WaitForPreparedFrame();
+
     m_textureSearchPaths = std::move(texturePaths);
     m_textureManager = std::make_unique<Renderer::TextureManager>(m_textureSearchPaths);
 }
 
 void ProjectM::ResetTextures()
 {
+    WaitForPreparedFrame();
+
     m_textureManager = std::make_unique<Renderer::TextureManager>(m_textureSearchPaths);
 }
 
 void ProjectM::RenderFrame(uint32_t targetFramebufferObject /*= 0*/)
 {
+    RenderFrameInternal(targetFramebufferObject, nullptr);
+}
+
+auto ProjectM::RenderFrameToTexture() -> FrameTexture
+{
+    FrameTexture frameTexture;
+    RenderFrameInternal(0, &frameTexture);
+    return frameTexture;
+}
+
+void ProjectM::RenderFrameInternal(uint32_t targetFramebufferObject, FrameTexture* frameTexture)
+{
+    // The presets must not be touched while the next frame is still being prepared.
+    WaitForPreparedFrame();
+
+    // The image returned by the last call is only guaranteed to be valid until now.
+    ReleaseFrameTexture();
+
     // Don't render if window area is zero.
     if (m_windowWidth == 0 || m_windowHeight == 0)
     {
         return;
     }
 
+    // Skips redundant state changes and resets or restores the application's GL state when done.
+    Renderer::StateCache::ScopedFrame stateCacheFrame(m_stateCache);
+
     // Update FPS and other timer values.
     m_timeKeeper->UpdateTimers();
 
+    // Adjust rendering quality if frames take longer than the target FPS allows.
+    if (m_qualityGovernor->Update(m_timeKeeper->SecondsSinceLastFrame()))
+    {
+        QualityLevelChangedEvent(m_qualityGovernor->QualityLevel());
+    }
+
     // Update and retrieve audio data
     m_audioStorage.UpdateFrameAudioData(m_timeKeeper->SecondsSinceLastFrame(), m_frameCount);
     auto audioData = m_audioStorage.GetFrameAudioData();
@@ -136,6 +195,8 @@ void ProjectM::RenderFrame(uint32_t targetFramebufferObject /*= 0*/)
         m_activePreset->Initialize(GetRenderContext());
     }
 
+    ActivatePendingPreset();
+
     if (m_timeKeeper->IsSmoothing() && m_transitioningPreset != nullptr)
     {
         // ToDo: check if new preset is loaded.
@@ -148,39 +209,280 @@ void ProjectM::RenderFrame(uint32_t targetFramebufferObject /*= 0*/)
 
     auto renderContext = GetRenderContext();
 
-    if (m_transition != nullptr && m_transitioningPreset != nullptr)
+    if (m_transition != nullptr && m_transitioningPreset != nullptr &&
+        m_transition->IsDone(m_timeKeeper->GetFrameTime()))
+    {
+        m_activePreset = std::move(m_transitioningPreset);
+        m_transitioningPreset.reset();
+        m_transition.reset();
+    }
+
+    bool const transitioning = m_transition != nullptr && m_transitioningPreset != nullptr;
+
+    // Hand the prepared frames over to the drawing code. With a deeper pipeline, the next frame
+    // is prepared on a worker thread while this one is drawn.
+    if (transitioning)
     {
-        if (m_transition->IsDone(m_timeKeeper->GetFrameTime()))
+        m_transitioningPreset->BeginFrame(audioData, renderContext);
+    }
+    m_activePreset->BeginFrame(audioData, renderContext);
+
+    if (m_pipelineDepth > 1)
+    {
+        PrepareNextFrame(audioData, renderContext);
+    }
+
+    if (transitioning)
+    {
+        m_transitioningPreset->RenderFrame(audioData, renderContext);
+    }
+
+    // ToDo: Call the to-be-implemented render method in Renderer
+    m_activePreset->RenderFrame(audioData, renderContext);
+
+    bool const readBackFrame = m_frameReadbackEnabled || m_debugImageRequested;
+    bool const nativeSize = renderContext.viewportSizeX == static_cast<int>(m_windowWidth) &&
+                            renderContext.viewportSizeY == static_cast<int>(m_windowHeight);
+
+    if (frameTexture != nullptr && !readBackFrame && !transitioning && nativeSize)
+    {
+        // The preset's output can be handed out as-is, no copy needed.
+        m_frameTexture = m_activePreset->OutputTexture();
+    }
+    else
+    {
+        // If the frame is read back or returned as a texture, render the final image into an internal framebuffer first.
+        if (readBackFrame || frameTexture != nullptr)
         {
-            m_activePreset = std::move(m_transitioningPreset);
-            m_transitioningPreset.reset();
-            m_transition.reset();
+            if (!m_outputFramebuffer)
+            {
+                m_outputFramebuffer = std::make_unique<Renderer::Framebuffer>(1);
+                m_outputFramebuffer->CreateColorAttachment(0, 0);
+            }
+            m_outputFramebuffer->SetSize(static_cast<int>(m_windowWidth), static_cast<int>(m_windowHeight));
+            m_outputFramebuffer->BindDraw(0);
         }
         else
         {
-            m_transitioningPreset->RenderFrame(audioData, renderContext);
+            m_stateCache.BindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(targetFramebufferObject));
         }
-    }
 
+        // The preset may have been rendered in a different resolution, always output in window size.
+        m_stateCache.Viewport(0, 0, static_cast<GLsizei>(m_windowWidth), static_cast<GLsizei>(m_windowHeight));
 
-    // ToDo: Call the to-be-implemented render method in Renderer
-    m_activePreset->RenderFrame(audioData, renderContext);
+        if (transitioning)
+        {
+            m_transition->Draw(*m_activePreset, *m_transitioningPreset, renderContext, audioData, m_timeKeeper->GetFrameTime());
+        }
+        else
+        {
+            if (nativeSize)
+            {
+                m_textureCopier->SetFilter(Renderer::CopyTexture::Filter::Nearest);
+            }
+            else if (m_upscaleFilter == UpscaleFilter::Bicubic)
+            {
+                m_textureCopier->SetFilter(Renderer::CopyTexture::Filter::Bicubic);
+            }
+            else
+            {
+                m_textureCopier->SetFilter(Renderer::CopyTexture::Filter::Bilinear);
+            }
+
+            m_textureCopier->Draw(m_activePreset->OutputTexture(), false, false);
+        }
 
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(targetFramebufferObject));
+        if (readBackFrame)
+        {
+            ReadBackFrame();
+        }
 
-    if (m_transition != nullptr && m_transitioningPreset != nullptr)
+        if (frameTexture != nullptr)
+        {
+            m_frameTexture = m_outputFramebuffer->GetColorAttachmentTexture(0, 0);
+        }
+        else if (readBackFrame)
+        {
+            // Now draw the final image into the actual target framebuffer.
+            m_stateCache.BindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(targetFramebufferObject));
+            m_stateCache.Viewport(0, 0, static_cast<GLsizei>(m_windowWidth), static_cast<GLsizei>(m_windowHeight));
+
+            m_textureCopier->SetFilter(Renderer::CopyTexture::Filter::Nearest);
+            m_textureCopier->Draw(m_outputFramebuffer->GetColorAttachmentTexture(0, 0), false, false);
+        }
+    }
+
+    if (frameTexture != nullptr)
     {
-        m_transition->Draw(*m_activePreset, *m_transitioningPreset, renderContext, audioData, m_timeKeeper->GetFrameTime());
+        // Don't leave the texture attached to a bound framebuffer while the host samples it.
+        Renderer::Framebuffer::Unbind();
+
+        // Flush, so hosts can wait for the fence in a shared context.
+        m_frameTextureFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        frameTexture->textureId = m_frameTexture->TextureID();
+        frameTexture->width = static_cast<uint32_t>(m_frameTexture->Width());
+        frameTexture->height = static_cast<uint32_t>(m_frameTexture->Height());
+        frameTexture->topRowFirst = false;
+        frameTexture->fence = m_frameTextureFence;
     }
-    else
+
+    if (m_frameReadback && m_frameReadbackHandler)
     {
-        m_textureCopier->Draw(m_activePreset->OutputTexture(), false, false);
+        while (m_frameReadback->ReadCompleted(m_frameReadbackHandler))
+        {
+        }
     }
 
+    WriteDebugImage();
+
     m_frameCount++;
     m_previousFrameVolume = audioData.vol;
 }
 
+void ProjectM::PrepareNextFrame(const Audio::FrameAudioData& audioData, const Renderer::RenderContext& currentRenderContext)
+{
+    auto* activePreset = m_activePreset.get();
+    auto* transitioningPreset = m_transition != nullptr ? m_transitioningPreset.get() : nullptr;
+
+    if (activePreset == nullptr)
+    {
+        return;
+    }
+
+    // Predict the context of the next frame, assuming the frame time stays the same.
+    // The audio data of the next frame isn't known yet, so the current one is used.
+    auto const secondsPerFrame = m_timeKeeper->SecondsSinceLastFrame();
+    if (secondsPerFrame <= 0.0)
+    {
+        // No frame time to extrapolate from yet, the next frame is prepared when it is drawn.
+        return;
+    }
+
+    auto renderContext = currentRenderContext;
+    renderContext.time = static_cast<float>(m_timeKeeper->GetRunningTime() + secondsPerFrame);
+    renderContext.progress = static_cast<float>(m_timeKeeper->PresetProgressA(secondsPerFrame));
+    renderContext.frame++;
+
+    m_preparedFrame = std::async(std::launch::async, [activePreset, transitioningPreset, audioData, renderContext]() {
+        if (transitioningPreset != nullptr)
+        {
+            transitioningPreset->PrepareFrame(audioData, renderContext);
+        }
+        activePreset->PrepareFrame(audioData, renderContext);
+    });
+}
+
+void ProjectM::WaitForPreparedFrame()
+{
+    if (m_preparedFrame.valid())
+    {
+        m_preparedFrame.get();
+    }
+}
+
+void ProjectM::SetFrameReadback(bool enabled, Renderer::FrameReadback::Format format, int ringSize)
+{
+    m_frameReadbackEnabled = enabled;
+    m_frameReadbackFormat = format;
+    m_frameReadbackRingSize = ringSize;
+
+    if (!m_frameReadbackEnabled)
+    {
+        m_frameReadback.reset();
+        return;
+    }
+
+    if (m_frameReadback)
+    {
+        m_frameReadback->SetFormat(format);
+        if (m_frameReadback->RingSize() != ringSize)
+        {
+            m_frameReadback->SetRingSize(ringSize);
+        }
+    }
+}
+
+void ProjectM::SetFrameReadbackHandler(Renderer::FrameReadback::FrameHandler handler)
+{
+    m_frameReadbackHandler = std::move(handler);
+}
+
+auto ProjectM::PollFrameReadback(const Renderer::FrameReadback::FrameHandler& handler) -> bool
+{
+    if (!m_frameReadback)
+    {
+        return false;
+    }
+
+    return m_frameReadback->ReadCompleted(handler);
+}
+
+void ProjectM::WriteDebugImageOnNextFrame(const std::string& outputFile)
+{
+    m_debugImageFilename = outputFile;
+    m_debugImageRequested = true;
+}
+
+void ProjectM::ReadBackFrame()
+{
+    auto outputTexture = m_outputFramebuffer->GetColorAttachmentTexture(0, 0);
+
+    if (m_frameReadbackEnabled)
+    {
+        if (!m_frameReadback)
+        {
+            m_frameReadback = std::make_unique<Renderer::FrameReadback>(m_frameReadbackRingSize);
+            m_frameReadback->SetFormat(m_frameReadbackFormat);
+        }
+        m_frameReadback->Queue(outputTexture, static_cast<uint32_t>(m_frameCount));
+    }
+
+    if (m_debugImageRequested)
+    {
+        if (!m_debugImageReadback)
+        {
+            m_debugImageReadback = std::make_unique<Renderer::FrameReadback>(1);
+        }
+        m_debugImageReadback->Queue(outputTexture, static_cast<uint32_t>(m_frameCount));
+        m_debugImageRequested = false;
+    }
+}
+
+void ProjectM::ReleaseFrameTexture()
+{
+    m_frameTexture.reset();
+
+    if (m_frameTextureFence != nullptr)
+    {
+        glDeleteSync(m_frameTextureFence);
+        m_frameTextureFence = nullptr;
+    }
+}
+
+void ProjectM::WriteDebugImage()
+{
+    if (!m_debugImageReadback || m_debugImageReadback->PendingFrames() == 0)
+    {
+        return;
+    }
+
+    m_debugImageReadback->ReadCompleted([this](const Renderer::FrameReadback::Frame& frame) {
+        std::string filename = m_debugImageFilename;
+        if (filename.empty())
+        {
+            std::array<char, 32> timeString{};
+            auto const currentTime = std::time(nullptr);
+            std::strftime(timeString.data(), timeString.size(), "%Y-%m-%d-%H:%M:%S", std::localtime(&currentTime));
+
+            filename = "frame_texture_contents-" + std::string(timeString.data()) + "-" + std::to_string(frame.frameNumber) + ".bmp";
+        }
+
+        stbi_write_bmp(filename.c_str(), frame.width, frame.height, 4, frame.data);
+    });
+}
+
 void ProjectM::Initialize()
 {
     /** Initialise start time */
@@ -189,6 +491,8 @@ void ProjectM::Initialize()
                                                 m_hardCutDuration,
                                                 m_easterEgg);
 
+    m_qualityGovernor->SetFrameTimeBudget(1.0 / static_cast<double>(m_targetFps));
+
     /** Nullify frame stash */
 
     /** Initialise per-pixel matrix calculations */
@@ -224,15 +528,67 @@ void ProjectM::SetWindowSize(uint32_t width, uint32_t height)
 
 void ProjectM::StartPresetTransition(std::unique_ptr<Preset>&& preset, bool hardCut)
 {
-    m_presetChangeNotified = m_presetLocked;
-
     if (preset == nullptr)
     {
+        m_presetChangeNotified = m_presetLocked;
         return;
     }
 
     preset->Initialize(GetRenderContext());
 
+    // Nothing to display while waiting, so wait for the shaders now.
+    if (!m_activePreset)
+    {
+        preset->FinishCompilation();
+        ActivatePreset(std::move(preset), hardCut);
+        return;
+    }
+
+    // Keep rendering the current preset until the shaders are compiled. A preset loaded in
+    // the meantime replaces the pending one. Don't request another switch while waiting.
+    m_pendingPreset = std::move(preset);
+    m_pendingPresetHardCut = hardCut;
+    m_presetChangeNotified = true;
+}
+
+void ProjectM::ActivatePendingPreset(bool waitForShaders)
+{
+    if (!m_pendingPreset)
+    {
+        return;
+    }
+
+    // A soft cut also needs the transition shaders, so the blend doesn't stall on the driver.
+    if (!waitForShaders &&
+        (!m_pendingPreset->IsCompilationComplete() ||
+         (!m_pendingPresetHardCut && !m_transitionShaderManager->IsCompilationComplete())))
+    {
+        return;
+    }
+
+    auto preset = std::move(m_pendingPreset);
+
+    // The texture manager or viewport may have changed since the preset was loaded.
+    preset->UpdateRenderContext(GetRenderContext());
+
+    try
+    {
+        preset->FinishCompilation();
+    }
+    catch (const std::exception& ex)
+    {
+        m_presetChangeNotified = m_presetLocked;
+        PresetSwitchFailedEvent(preset->Filename(), ex.what());
+        return;
+    }
+
+    ActivatePreset(std::move(preset), m_pendingPresetHardCut);
+}
+
+void ProjectM::ActivatePreset(std::unique_ptr<Preset>&& preset, bool hardCut)
+{
+    m_presetChangeNotified = m_presetLocked;
+
     // If already in a transition, force immediate completion.
     if (m_transitioningPreset != nullptr)
     {
@@ -245,7 +601,14 @@ void ProjectM::StartPresetTransition(std::unique_ptr<Preset>&& preset, bool hard
         preset->DrawInitialImage(m_activePreset->OutputTexture(), GetRenderContext());
     }
 
-    if (hardCut)
+    // Without a working transition shader, there's nothing to blend with.
+    std::shared_ptr<Renderer::Shader> transitionShader;
+    if (!hardCut)
+    {
+        transitionShader = m_transitionShaderManager->RandomTransition();
+    }
+
+    if (hardCut || !transitionShader)
     {
         m_activePreset = std::move(preset);
         m_timeKeeper->StartPreset();
@@ -254,7 +617,7 @@ void ProjectM::StartPresetTransition(std::unique_ptr<Preset>&& preset, bool hard
     {
         m_transitioningPreset = std::move(preset);
         m_timeKeeper->StartSmoothing();
-        m_transition = std::make_unique<Renderer::PresetTransition>(m_transitionShaderManager->RandomTransition(), m_softCutDuration, m_timeKeeper->GetFrameTime());
+        m_transition = std::make_unique<Renderer::PresetTransition>(transitionShader, m_softCutDuration, m_timeKeeper->GetFrameTime());
     }
 }
 
@@ -361,6 +724,11 @@ auto ProjectM::TargetFramesPerSecond() const -> int32_t
 void ProjectM::SetTargetFramesPerSecond(int32_t fps)
 {
     m_targetFps = fps;
+
+    if (fps > 0)
+    {
+        m_qualityGovernor->SetFrameTimeBudget(1.0 / static_cast<double>(fps));
+    }
 }
 
 auto ProjectM::AspectCorrection() const -> bool
@@ -411,6 +779,107 @@ void ProjectM::SetMeshSize(uint32_t meshResolutionX, uint32_t meshResolutionY)
     m_meshY = std::max(8u, std::min(400u, m_meshY));
 }
 
+auto ProjectM::RenderScale() const -> float
+{
+    return m_renderScale;
+}
+
+void ProjectM::SetRenderScale(float scale)
+{
+    m_renderScale = std::max(0.1f, std::min(2.0f, scale));
+}
+
+auto ProjectM::GetUpscaleFilter() const -> UpscaleFilter
+{
+    return m_upscaleFilter;
+}
+
+void ProjectM::SetUpscaleFilter(UpscaleFilter filter)
+{
+    m_upscaleFilter = filter;
+}
+
+auto ProjectM::QualityGovernorEnabled() const -> bool
+{
+    return m_qualityGovernor->Enabled();
+}
+
+void ProjectM::SetQualityGovernorEnabled(bool enabled)
+{
+    if (m_qualityGovernor->Enabled() == enabled)
+    {
+        return;
+    }
+
+    auto const previousQualityLevel = m_qualityGovernor->QualityLevel();
+
+    m_qualityGovernor->SetEnabled(enabled);
+
+    if (m_qualityGovernor->QualityLevel() != previousQualityLevel)
+    {
+        QualityLevelChangedEvent(m_qualityGovernor->QualityLevel());
+    }
+}
+
+auto ProjectM::QualityLevel() const -> int
+{
+    return m_qualityGovernor->QualityLevel();
+}
+
+auto ProjectM::PipelineDepth() const -> int
+{
+    return m_pipelineDepth;
+}
+
+void ProjectM::SetPipelineDepth(int depth)
+{
+    WaitForPreparedFrame();
+
+    m_pipelineDepth = std::max(1, std::min(2, depth));
+}
+
+auto ProjectM::ExpressionJitEnabled() const -> bool
+{
+    return m_presetFactoryManager->ExpressionJitEnabled();
+}
+
+void ProjectM::SetExpressionJitEnabled(bool enabled)
+{
+    m_presetFactoryManager->SetExpressionJitEnabled(enabled);
+}
+
+auto ProjectM::FastBlurEnabled() const -> bool
+{
+    return m_fastBlurEnabled;
+}
+
+void ProjectM::SetFastBlurEnabled(bool enabled)
+{
+    WaitForPreparedFrame();
+
+    m_fastBlurEnabled = enabled;
+}
+
+auto ProjectM::RestoreGLState() const -> bool
+{
+    return m_stateCache.SaveHostState();
+}
+
+void ProjectM::SetRestoreGLState(bool enabled)
+{
+    m_stateCache.SetSaveHostState(enabled);
+}
+
+auto ProjectM::GLStateStatistics() const -> Renderer::StateCache::Statistics
+{
+    return m_stateCache.GetStatistics();
+}
+
+void ProjectM::ResetGLStateStatistics()
+{
+    m_stateCache.ResetStatistics();
+}
+
 auto ProjectM::PCM() -> libprojectM::Audio::PCM&
 {
     return m_audioStorage;
@@ -438,9 +907,28 @@ void ProjectM::TouchDestroyAll()
 
 auto ProjectM::GetRenderContext() -> Renderer::RenderContext
 {
+    auto const& quality = m_qualityGovernor->Settings();
+
+    // Presets render in the scaled internal resolution, but use the window aspect ratio.
+    auto const renderScale = m_renderScale * quality.renderScale;
+    auto const scaledSize = [renderScale](uint32_t windowSize) {
+        if (windowSize == 0)
+        {
+            return 0;
+        }
+        return std::max(1, static_cast<int>(std::lround(static_cast<float>(windowSize) * renderScale)));
+    };
+
+    // Mesh sizes must stay multiples of two, see SetMeshSize().
+    auto const scaledMeshSize = [&quality](uint32_t meshSize) {
+        auto size = static_cast<int>(static_cast<float>(meshSize) * quality.meshScale);
+        size += size % 2;
+        return std::max(8, size);
+    };
+
     Renderer::RenderContext ctx{};
-    ctx.viewportSizeX = m_windowWidth;
-    ctx.viewportSizeY = m_windowHeight;
+    ctx.viewportSizeX = scaledSize(m_windowWidth);
+    ctx.viewportSizeY = scaledSize(m_windowHeight);
     ctx.time = static_cast<float>(m_timeKeeper->GetRunningTime());
     ctx.progress = static_cast<float>(m_timeKeeper->PresetProgressA());
     ctx.fps = static_cast<float>(m_targetFps);
@@ -449,8 +937,11 @@ auto ProjectM::GetRenderContext() -> Renderer::RenderContext
     ctx.aspectY = (m_windowWidth > m_windowHeight) ? static_cast<float>(m_windowHeight) / static_cast<float>(m_windowWidth) : 1.0f;
     ctx.invAspectX = 1.0f / ctx.aspectX;
     ctx.invAspectY = 1.0f / ctx.aspectY;
-    ctx.perPixelMeshX = static_cast<int>(m_meshX);
-    ctx.perPixelMeshY = static_cast<int>(m_meshY);
+    ctx.perPixelMeshX = scaledMeshSize(m_meshX);
+    ctx.perPixelMeshY = scaledMeshSize(m_meshY);
+    ctx.maxBlurLevel = quality.maxBlurLevel;
+    ctx.maxShapeInstances = quality.maxShapeInstances;
+    ctx.fastBlur = m_fastBlurEnabled;
     ctx.textureManager = m_textureManager.get();
 
     return ctx;
@@ -22,10 +22,13 @@
 
 #include <projectM-4/projectM_export.h>
 
+#include <Renderer/FrameReadback.hpp>
 #include <Renderer/RenderContext.hpp>
+#include <Renderer/StateCache.hpp>
 
 #include <Audio/PCM.hpp>
 
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -42,11 +45,33 @@ class TransitionShaderManager;
 
 class Preset;
 class PresetFactoryManager;
+class QualityGovernor;
 class TimeKeeper;
 
 class PROJECTM_EXPORT ProjectM
 {
 public:
+    /**
+     * Filters used to upscale the internal render resolution to the window size.
+     */
+    enum class UpscaleFilter : int
+    {
+        Bilinear, //!< Bilinear interpolation.
+        Bicubic   //!< Catmull-Rom bicubic interpolation, gives sharper results.
+    };
+
+    /**
+     * @brief The final image of a frame rendered with RenderFrameToTexture().
+     */
+    struct FrameTexture
+    {
+        GLuint textureId{};      //!< The 2D texture holding the image, or 0 if no frame was rendered.
+        uint32_t width{};        //!< Texture width in pixels.
+        uint32_t height{};       //!< Texture height in pixels.
+        bool topRowFirst{false}; //!< True if the first texture row is the top of the image, false for the usual OpenGL bottom-up order.
+        GLsync fence{};          //!< Fence signalled when the GPU has finished rendering the image.
+    };
+
     ProjectM();
 
     virtual ~ProjectM();
@@ -68,8 +93,18 @@ public:
      */
     virtual void PresetSwitchFailedEvent(const std::string& presetFilename, const std::string& message) const;
 
+    /**
+     * @brief Callback for notifying the integrating app that the quality governor changed the quality level.
+     * @param qualityLevel The new quality level. 0 is full quality, higher values mean reduced quality.
+     */
+    virtual void QualityLevelChangedEvent(int qualityLevel) const;
+
     /**
      * @brief Loads the given preset file and performs a smooth or immediate transition.
+     *
+     * If another preset is active, the transition starts in a later RenderFrame() call once the
+     * new preset's shaders are compiled. Shader errors are then reported from that call.
+     *
      * @param presetFilename The preset filename to load.
      * @param smoothTransition If set to true, old and new presets will be blended over smoothly.
      *                         If set to false, the new preset will be rendered immediately.
@@ -81,12 +116,22 @@ public:
      *
      * This function assumes the data to be in Milkdrop format.
      *
+     * Like LoadPresetFile(), the transition may start in a later RenderFrame() call.
+     *
      * @param presetData The preset data stream to load from.
      * @param smoothTransition If set to true, old and new presets will be blended over smoothly.
      *                         If set to false, the new preset will be rendered immediately.
      */
     void LoadPresetData(std::istream& presetData, bool smoothTransition);
 
+    /**
+     * @brief Switches to a loaded preset without waiting for a later RenderFrame() call.
+     *
+     * Blocks until the pending preset's shaders are compiled. Useful if each frame must show the
+     * requested preset, e.g. when rendering offline. Does nothing if no switch is pending.
+     */
+    void SwitchToPendingPreset();
+
     void SetWindowSize(uint32_t width, uint32_t height);
 
     /**
@@ -103,6 +148,52 @@ public:
 
     void RenderFrame(uint32_t targetFramebufferObject = 0);
 
+    /**
+     * @brief Renders a frame and returns the texture holding the final image.
+     *
+     * Unlike RenderFrame(), the image isn't copied into a framebuffer, so hosts can sample it directly.
+     * If no transition is running and the internal render resolution equals the window size, the
+     * preset's own output texture is returned, otherwise the final image is drawn into an internal
+     * texture of the window size.
+     *
+     * The texture and fence remain valid until the next render call and must not be modified or deleted.
+     *
+     * @return The texture information. The texture ID is 0 if no frame was rendered.
+     */
+    auto RenderFrameToTexture() -> FrameTexture;
+
+    /**
+     * @brief Enables or disables asynchronous readback of the rendered frames.
+     *
+     * If enabled, each rendered frame is queued for readback into a ring of pixel buffers. Completed
+     * frames are either passed to the frame readback handler after rendering a frame, or can be
+     * retrieved with PollFrameReadback() if no handler is set.
+     *
+     * @param enabled True to enable frame readback, false to disable it and discard pending frames.
+     * @param format The pixel format of the read back frames.
+     * @param ringSize The number of frames that can be in flight. Determines the maximum latency.
+     */
+    void SetFrameReadback(bool enabled, Renderer::FrameReadback::Format format, int ringSize);
+
+    /**
+     * @brief Sets the function which receives the completed frames after rendering.
+     * @param handler The handler function. If empty, frames need to be retrieved with PollFrameReadback().
+     */
+    void SetFrameReadbackHandler(Renderer::FrameReadback::FrameHandler handler);
+
+    /**
+     * @brief Passes the oldest completed frame to the given handler.
+     * @param handler The function receiving the frame data.
+     * @return True if a completed frame was available, false if not.
+     */
+    auto PollFrameReadback(const Renderer::FrameReadback::FrameHandler& handler) -> bool;
+
+    /**
+     * @brief Writes the next rendered frame into a .bmp file.
+     * @param outputFile The filename to write the image to. If empty, a name including the current date and time is used.
+     */
+    void WriteDebugImageOnNextFrame(const std::string& outputFile);
+
     /**
      * @brief Sets a user-specified time for rendering the next frame
      * Negative values will make projectM use the system clock instead.
@@ -171,6 +262,139 @@ public:
 
     void SetMeshSize(uint32_t meshResolutionX, uint32_t meshResolutionY);
 
+    /**
+     * @brief Returns the internal render resolution scale.
+     * @return The scale factor applied to the window size to get the preset render resolution.
+     */
+    auto RenderScale() const -> float;
+
+    /**
+     * @brief Sets the internal render resolution scale.
+     *
+     * Presets are rendered at the window size multiplied by this factor, then scaled to the
+     * window size in the final output pass. Aspect ratio calculations always use the window size.
+     *
+     * @param scale The new render scale. Will be clamped to [0.1, 2.0].
+     */
+    void SetRenderScale(float scale);
+
+    /**
+     * @brief Returns the filter used to scale the internal render resolution to the window size.
+     * @return The currently used upscale filter.
+     */
+    auto GetUpscaleFilter() const -> UpscaleFilter;
+
+    /**
+     * @brief Sets the filter used to scale the internal render resolution to the window size.
+     * Only used if the render scale is not 1.0.
+     * @param filter The new upscale filter.
+     */
+    void SetUpscaleFilter(UpscaleFilter filter);
+
+    /**
+     * @brief Returns whether the adaptive quality governor is enabled.
+     * @return True if the quality governor is enabled, false otherwise.
+     */
+    auto QualityGovernorEnabled() const -> bool;
+
+    /**
+     * @brief Enables or disables the adaptive quality governor.
+     *
+     * If enabled, rendering quality is reduced in steps if the frame time exceeds the budget
+     * given by the target FPS value, and restored once there's enough headroom again.
+     * Disabling the governor immediately restores full quality.
+     *
+     * @param enabled True to enable the quality governor, false to disable it.
+     */
+    void SetQualityGovernorEnabled(bool enabled);
+
+    /**
+     * @brief Returns the quality level currently selected by the quality governor.
+     * @return The current quality level. 0 is full quality, higher values mean reduced quality.
+     */
+    auto QualityLevel() const -> int;
+
+    /**
+     * @brief Returns the frame pipelining depth.
+     * @return 1 if frames are prepared and rendered in sequence, 2 if preparing the next frame overlaps with the current one.
+     */
+    auto PipelineDepth() const -> int;
+
+    /**
+     * @brief Sets the frame pipelining depth.
+     *
+     * With a depth of 1, each call to RenderFrame() evaluates the preset code and then issues
+     * the OpenGL commands. With a depth of 2, the CPU-side preparation of the next frame is
+     * started on a worker thread after the current frame has been submitted, overlapping with
+     * the application's buffer swap and other work. This adds one frame of audio latency.
+     *
+     * @param depth The new pipeline depth. Will be clamped to [1, 2].
+     */
+    void SetPipelineDepth(int depth);
+
+    /**
+     * @brief Returns whether preset expression code is compiled to native machine code.
+     * @return True if the expression JIT is enabled and was built into the library, false otherwise.
+     */
+    auto ExpressionJitEnabled() const -> bool;
+
+    /**
+     * @brief Enables or disables compiling preset expression code to native machine code.
+     *
+     * Only affects presets loaded afterwards. Code the JIT can't handle is still run by the
+     * interpreter. Has no effect if the library was built without ENABLE_EXPRESSION_JIT.
+     *
+     * @param enabled True to enable the expression JIT, false to always use the interpreter.
+     */
+    void SetExpressionJitEnabled(bool enabled);
+
+    /**
+     * @brief Returns whether the fast approximate blur is used for the preset blur textures.
+     * @return True if the fast blur is enabled, false if the exact Milkdrop blur is used.
+     */
+    auto FastBlurEnabled() const -> bool;
+
+    /**
+     * @brief Enables or disables the fast approximate blur for the preset blur textures.
+     *
+     * The fast blur renders blur1 to blur3 from a single downsample pyramid with fewer passes
+     * and texture fetches. It looks slightly different from Milkdrop's blur.
+     *
+     * @param enabled True to use the fast blur, false to use the exact Milkdrop blur.
+     */
+    void SetFastBlurEnabled(bool enabled);
+
+    /**
+     * @brief Returns whether the application's OpenGL state is saved and restored in each frame.
+     * @return True if the application's state is restored, false if OpenGL's defaults are set.
+     */
+    auto RestoreGLState() const -> bool;
+
+    /**
+     * @brief Sets whether the application's OpenGL state is saved and restored in each frame.
+     *
+     * If disabled, projectM doesn't query any state and resets everything it changed, except
+     * the target framebuffer and viewport, to OpenGL's defaults after each frame.
+     *
+     * @param enabled True to restore the application's state, false to reset to OpenGL's defaults.
+     */
+    void SetRestoreGLState(bool enabled);
+
+    /**
+     * @brief Returns how many OpenGL state changes were issued and skipped as redundant.
+     *
+     * The counters include all frames rendered since the instance was created or the counters
+     * were last reset. Meant for profiling.
+     *
+     * @return The state cache counters.
+     */
+    auto GLStateStatistics() const -> Renderer::StateCache::Statistics;
+
+    /**
+     * @brief Resets the OpenGL state change counters to zero.
+     */
+    void ResetGLStateStatistics();
+
     void Touch(float touchX, float touchY, int pressure, int touchType);
 
     void TouchDrag(float touchX, float touchY, int pressure);
@@ -194,12 +418,72 @@ public:
 private:
     void Initialize();
 
+    /**
+     * @brief Initializes a new preset and switches to it once its shaders are compiled.
+     *
+     * If a preset is active, it keeps rendering while the new preset's shaders compile in the
+     * background. Without an active preset, the new one is activated immediately.
+     *
+     * @param preset The new preset.
+     * @param hardCut If true, the preset is shown immediately, otherwise a transition is started.
+     */
     void StartPresetTransition(std::unique_ptr<Preset>&& preset, bool hardCut);
 
+    /**
+     * @brief Activates the pending preset if its shaders are ready.
+     * For soft cuts, the transition shaders must be ready as well.
+     * @param waitForShaders If true, waits for the shaders instead of keeping the preset pending.
+     */
+    void ActivatePendingPreset(bool waitForShaders = false);
+
+    /**
+     * @brief Makes the preset the active one, or starts a transition to it.
+     * @param preset The new preset, with all shaders compiled.
+     * @param hardCut If true, the preset is shown immediately, otherwise a transition is started.
+     *                If no transition shader compiled successfully, the preset is always shown immediately.
+     */
+    void ActivatePreset(std::unique_ptr<Preset>&& preset, bool hardCut);
+
     void LoadIdlePreset();
 
     auto GetRenderContext() -> Renderer::RenderContext;
 
+    /**
+     * @brief Renders a frame, either into the target framebuffer or into a texture.
+     * @param targetFramebufferObject The framebuffer to draw the final image to. Ignored if frameTexture is given.
+     * @param frameTexture If not null, receives the texture holding the final image instead of drawing it to a framebuffer.
+     */
+    void RenderFrameInternal(uint32_t targetFramebufferObject, FrameTexture* frameTexture);
+
+    /**
+     * @brief Queues the frame rendered into the output framebuffer for readback.
+     */
+    void ReadBackFrame();
+
+    /**
+     * @brief Releases the texture and fence returned by the last RenderFrameToTexture() call.
+     */
+    void ReleaseFrameTexture();
+
+    /**
+     * @brief Writes the debug image if the readback has finished.
+     */
+    void WriteDebugImage();
+
+    /**
+     * @brief Starts preparing the next frame on a worker thread.
+     * Must be called after the presets began the current frame.
+     * @param audioData The audio data used for the next frame.
+     * @param currentRenderContext The render context of the current frame, used to predict the next one.
+     */
+    void PrepareNextFrame(const Audio::FrameAudioData& audioData, const Renderer::RenderContext& currentRenderContext);
+
+    /**
+     * @brief Waits until a frame being prepared in the background has finished.
+     * Must be called before accessing or replacing any preset.
+     */
+    void WaitForPreparedFrame();
+
     uint32_t m_meshX{32};              //!< Per-point mesh horizontal resolution.
     uint32_t m_meshY{24};              //!< Per-point mesh vertical resolution.
     uint32_t m_targetFps{35};          //!< Target frames per second.
@@ -214,6 +498,9 @@ private:
     bool m_aspectCorrection{true};   //!< If true, corrects aspect ratio for non-rectangular windows.
     float m_easterEgg{1.0};          //!< Random preset duration modifier. See TimeKeeper class.
     float m_previousFrameVolume{};   //!< Volume in previous frame, used for hard cuts.
+    float m_renderScale{1.0f};       //!< Internal render resolution, relative to the window size.
+
+    UpscaleFilter m_upscaleFilter{UpscaleFilter::Bilinear}; //!< Filter used to scale the rendered image to the window size.
 
     std::vector<std::string> m_textureSearchPaths; ///!< List of paths to search for texture files
 
@@ -231,8 +518,30 @@ private:
     std::unique_ptr<Renderer::CopyTexture> m_textureCopier;                       //!< Class that copies textures 1:1 to another texture or framebuffer.
     std::unique_ptr<Preset> m_activePreset;                                       //!< Currently loaded preset.
     std::unique_ptr<Preset> m_transitioningPreset;                                //!< Destination preset when smooth preset switching.
+    std::unique_ptr<Preset> m_pendingPreset;                                      //!< Loaded preset waiting for its shaders to compile.
+    bool m_pendingPresetHardCut{false};                                           //!< Whether the pending preset is shown with a hard cut.
     std::unique_ptr<Renderer::PresetTransition> m_transition;                     //!< Transition effect used for blending.
     std::unique_ptr<TimeKeeper> m_timeKeeper;                                     //!< Keeps the different timers used to render and switch presets.
+    std::unique_ptr<QualityGovernor> m_qualityGovernor;                           //!< Reduces rendering quality if the frame time budget is exceeded.
+    Renderer::StateCache m_stateCache;                                            //!< Filters redundant OpenGL state changes while rendering.
+
+    bool m_frameReadbackEnabled{false};                                                             //!< If true, each frame is queued for readback.
+    Renderer::FrameReadback::Format m_frameReadbackFormat{Renderer::FrameReadback::Format::RGBA8}; //!< Pixel format for frame readback.
+    int m_frameReadbackRingSize{3};                                                                 //!< Number of frames in flight for readback.
+    Renderer::FrameReadback::FrameHandler m_frameReadbackHandler;                                   //!< Receives completed frames after rendering.
+    std::unique_ptr<Renderer::FrameReadback> m_frameReadback;                                       //!< Reads back rendered frames.
+    std::unique_ptr<Renderer::Framebuffer> m_outputFramebuffer;                                     //!< Holds the final image if it's read back or rendered to a texture.
+
+    std::shared_ptr<Renderer::Texture> m_frameTexture; //!< Keeps the texture returned by RenderFrameToTexture() alive until the next frame.
+    GLsync m_frameTextureFence{};                      //!< Fence returned by RenderFrameToTexture().
+
+    bool m_debugImageRequested{false};                             //!< If true, the next frame is written to a file.
+    std::string m_debugImageFilename;                              //!< Filename of the requested debug image.
+    std::unique_ptr<Renderer::FrameReadback> m_debugImageReadback; //!< Reads back the frame for the debug image.
+
+    int m_pipelineDepth{1};             //!< Number of frames in flight, 1 or 2.
+    bool m_fastBlurEnabled{false};      //!< If true, presets use the fast approximate blur.
+    std::future<void> m_preparedFrame; //!< Result of the next frame's preparation running in the background.
 };
 
 } // namespace libprojectM
@@ -2,10 +2,15 @@
 
 #include <projectM-4/projectM.h>
 
+#include "MemoryStream.hpp"
+#include "PackArchive.hpp"
+#include "Utils.hpp"
+
 #include <Audio/AudioConstants.hpp>
 
+#include <algorithm>
 #include <cstring>
-#include <sstream>
+#include <vector>
 #include <projectM-4/render_opengl.h>
 #include <projectM-4/parameters.h>
 
@@ -30,6 +35,14 @@ void projectMWrapper::PresetSwitchFailedEvent(const std::string& presetFilename,
     }
 }
 
+void projectMWrapper::QualityLevelChangedEvent(int qualityLevel) const
+{
+    if (m_qualityLevelChangedEventCallback)
+    {
+        m_qualityLevelChangedEventCallback(qualityLevel, m_qualityLevelChangedEventUserData);
+    }
+}
+
 } // namespace libprojectM
 
 libprojectM::projectMWrapper* handle_to_instance(projectm_handle instance)
@@ -64,6 +77,20 @@ void projectm_free_string(const char* str)
     delete[] str;
 }
 
+void projectm_free_string_array(char** array)
+{
+    if (array == nullptr)
+    {
+        return;
+    }
+
+    for (size_t index = 0; array[index] != nullptr; index++)
+    {
+        delete[] array[index];
+    }
+    delete[] array;
+}
+
 projectm_handle projectm_create()
 {
     try
@@ -93,11 +120,17 @@ void projectm_load_preset_file(projectm_handle instance, const char* filename,
 void projectm_load_preset_data(projectm_handle instance, const char* data,
                                bool smooth_transition)
 {
-    std::stringstream presetDataStream(data);
+    libprojectM::MemoryStream presetDataStream(data, strlen(data));
     auto projectMInstance = handle_to_instance(instance);
     projectMInstance->LoadPresetData(presetDataStream, smooth_transition);
 }
 
+void projectm_switch_to_pending_preset(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SwitchToPendingPreset();
+}
+
 void projectm_set_preset_switch_requested_event_callback(projectm_handle instance,
                                                          projectm_preset_switch_requested_event callback, void* user_data)
 {
@@ -114,6 +147,14 @@ void projectm_set_preset_switch_failed_event_callback(projectm_handle instance,
     projectMInstance->m_presetSwitchFailedEventUserData = user_data;
 }
 
+void projectm_set_quality_level_changed_event_callback(projectm_handle instance,
+                                                       projectm_quality_level_changed_event callback, void* user_data)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->m_qualityLevelChangedEventCallback = callback;
+    projectMInstance->m_qualityLevelChangedEventUserData = user_data;
+}
+
 void projectm_set_texture_search_paths(projectm_handle instance,
                                        const char** texture_search_paths,
                                        size_t count)
@@ -168,6 +209,47 @@ char* projectm_get_vcs_version_string()
     return buffer;
 }
 
+char** projectm_get_pack_preset_files(const char* pack_filename)
+{
+    try
+    {
+        libprojectM::PackArchive pack;
+        if (pack_filename == nullptr || !pack.Open(pack_filename))
+        {
+            return nullptr;
+        }
+
+        std::vector<std::string> presetFiles;
+        for (size_t index = 0; index < pack.MemberCount(); index++)
+        {
+            auto const memberName = pack.MemberName(index);
+            auto const lowerCaseName = libprojectM::Utils::ToLower(memberName);
+            auto const extension = lowerCaseName.substr(std::min(lowerCaseName.find_last_of('.'), lowerCaseName.length()));
+
+            // Only list the bundle if the pack contains both the preset and the bundle built from it.
+            if (extension != ".milkb" &&
+                (extension != ".milk" || pack.Find(memberName + "b") != libprojectM::PackArchive::InvalidIndex))
+            {
+                continue;
+            }
+
+            presetFiles.push_back(std::string(pack_filename) + "/" + memberName);
+        }
+
+        auto* array = new char* [presetFiles.size() + 1] {};
+        for (size_t index = 0; index < presetFiles.size(); index++)
+        {
+            array[index] = projectm_alloc_string_from_std_string(presetFiles.at(index));
+        }
+
+        return array;
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
 void projectm_opengl_render_frame(projectm_handle instance)
 {
     auto projectMInstance = handle_to_instance(instance);
@@ -180,6 +262,110 @@ void projectm_opengl_render_frame_fbo(projectm_handle instance, uint32_t framebu
     projectMInstance->RenderFrame(framebuffer_object_id);
 }
 
+void projectm_opengl_set_restore_state(projectm_handle instance, bool enabled)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetRestoreGLState(enabled);
+}
+
+bool projectm_opengl_get_restore_state(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->RestoreGLState();
+}
+
+void projectm_opengl_render_frame_texture(projectm_handle instance, projectm_output_texture* output)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    auto const frameTexture = projectMInstance->RenderFrameToTexture();
+
+    if (output == nullptr)
+    {
+        return;
+    }
+
+    output->texture_id = frameTexture.textureId;
+    output->width = frameTexture.width;
+    output->height = frameTexture.height;
+    output->top_row_first = frameTexture.topRowFirst;
+    output->fence = frameTexture.fence;
+}
+
+void projectm_opengl_set_frame_readback(projectm_handle instance, bool enabled,
+                                        projectm_readback_format format, uint32_t ring_size)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetFrameReadback(enabled,
+                                       format == PROJECTM_READBACK_FORMAT_YUV420
+                                           ? libprojectM::Renderer::FrameReadback::Format::YUV420
+                                           : libprojectM::Renderer::FrameReadback::Format::RGBA8,
+                                       static_cast<int>(ring_size));
+}
+
+static auto ToReadbackFormat(libprojectM::Renderer::FrameReadback::Format format) -> projectm_readback_format
+{
+    return format == libprojectM::Renderer::FrameReadback::Format::YUV420
+               ? PROJECTM_READBACK_FORMAT_YUV420
+               : PROJECTM_READBACK_FORMAT_RGBA8;
+}
+
+void projectm_opengl_set_frame_readback_callback(projectm_handle instance,
+                                                 projectm_frame_readback_event callback,
+                                                 void* user_data)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->m_frameReadbackEventCallback = callback;
+    projectMInstance->m_frameReadbackEventUserData = user_data;
+
+    if (callback == nullptr)
+    {
+        projectMInstance->SetFrameReadbackHandler({});
+        return;
+    }
+
+    projectMInstance->SetFrameReadbackHandler([projectMInstance](const libprojectM::Renderer::FrameReadback::Frame& frame) {
+        projectMInstance->m_frameReadbackEventCallback(frame.data, frame.size,
+                                                       static_cast<uint32_t>(frame.width), static_cast<uint32_t>(frame.height),
+                                                       ToReadbackFormat(frame.format), frame.frameNumber,
+                                                       projectMInstance->m_frameReadbackEventUserData);
+    });
+}
+
+bool projectm_opengl_poll_frame_readback(projectm_handle instance, uint8_t* buffer, size_t buffer_size,
+                                         size_t* data_size, uint32_t* width, uint32_t* height,
+                                         uint32_t* frame_number)
+{
+    auto projectMInstance = handle_to_instance(instance);
+
+    bool copied{false};
+    bool const frameAvailable = projectMInstance->PollFrameReadback([&](const libprojectM::Renderer::FrameReadback::Frame& frame) {
+        if (data_size != nullptr)
+        {
+            *data_size = frame.size;
+        }
+        if (width != nullptr)
+        {
+            *width = static_cast<uint32_t>(frame.width);
+        }
+        if (height != nullptr)
+        {
+            *height = static_cast<uint32_t>(frame.height);
+        }
+        if (frame_number != nullptr)
+        {
+            *frame_number = frame.frameNumber;
+        }
+
+        if (buffer != nullptr && buffer_size >= frame.size)
+        {
+            memcpy(buffer, frame.data, frame.size);
+            copied = true;
+        }
+    });
+
+    return frameAvailable && copied;
+}
+
 void projectm_set_frame_time(projectm_handle instance, double seconds_since_first_frame)
 {
     auto projectMInstance = handle_to_instance(instance);
@@ -364,6 +550,88 @@ void projectm_set_window_size(projectm_handle instance, size_t width, size_t hei
     projectMInstance->SetWindowSize(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
 }
 
+void projectm_set_render_scale(projectm_handle instance, float scale)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetRenderScale(scale);
+}
+
+float projectm_get_render_scale(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->RenderScale();
+}
+
+void projectm_set_upscale_filter(projectm_handle instance, projectm_upscale_filter filter)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetUpscaleFilter(filter == PROJECTM_UPSCALE_FILTER_BICUBIC
+                                           ? libprojectM::ProjectM::UpscaleFilter::Bicubic
+                                           : libprojectM::ProjectM::UpscaleFilter::Bilinear);
+}
+
+projectm_upscale_filter projectm_get_upscale_filter(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->GetUpscaleFilter() == libprojectM::ProjectM::UpscaleFilter::Bicubic
+               ? PROJECTM_UPSCALE_FILTER_BICUBIC
+               : PROJECTM_UPSCALE_FILTER_BILINEAR;
+}
+
+void projectm_set_quality_governor_enabled(projectm_handle instance, bool enabled)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetQualityGovernorEnabled(enabled);
+}
+
+bool projectm_get_quality_governor_enabled(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->QualityGovernorEnabled();
+}
+
+int projectm_get_quality_level(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->QualityLevel();
+}
+
+void projectm_set_pipeline_depth(projectm_handle instance, int depth)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetPipelineDepth(depth);
+}
+
+int projectm_get_pipeline_depth(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->PipelineDepth();
+}
+
+void projectm_set_expression_jit_enabled(projectm_handle instance, bool enabled)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetExpressionJitEnabled(enabled);
+}
+
+bool projectm_get_expression_jit_enabled(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->ExpressionJitEnabled();
+}
+
+void projectm_set_fast_blur_enabled(projectm_handle instance, bool enabled)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->SetFastBlurEnabled(enabled);
+}
+
+bool projectm_get_fast_blur_enabled(projectm_handle instance)
+{
+    auto projectMInstance = handle_to_instance(instance);
+    return projectMInstance->FastBlurEnabled();
+}
+
 unsigned int projectm_pcm_get_max_samples()
 {
     return libprojectM::Audio::WaveformSamples;
@@ -392,7 +660,8 @@ auto projectm_pcm_add_uint8(projectm_handle instance, const uint8_t* samples, un
     PcmAdd(instance, samples, count, channels);
 }
 
-auto projectm_write_debug_image_on_next_frame(projectm_handle, const char*) -> void
+auto projectm_write_debug_image_on_next_frame(projectm_handle instance, const char* output_file) -> void
 {
-    // UNIMPLEMENTED
+    auto projectMInstance = handle_to_instance(instance);
+    projectMInstance->WriteDebugImageOnNextFrame(output_file != nullptr ? output_file : "");
 }
\ No newline at end of file
@@ -33,12 +33,19 @@ public:
     void PresetSwitchFailedEvent(const std::string& presetFilename,
                                  const std::string& failureMessage) const override;
     void PresetSwitchRequestedEvent(bool isHardCut) const override;
+    void QualityLevelChangedEvent(int qualityLevel) const override;
 
     projectm_preset_switch_failed_event m_presetSwitchFailedEventCallback{nullptr};
     void* m_presetSwitchFailedEventUserData{nullptr};
 
     projectm_preset_switch_requested_event m_presetSwitchRequestedEventCallback{nullptr};
     void* m_presetSwitchRequestedEventUserData{nullptr};
+
+    projectm_quality_level_changed_event m_qualityLevelChangedEventCallback{nullptr};
+    void* m_qualityLevelChangedEventUserData{nullptr};
+
+    projectm_frame_readback_event m_frameReadbackEventCallback{nullptr};
+    void* m_frameReadbackEventUserData{nullptr};
 };
 
 } // namespace libprojectM
@@ -0,0 +1,142 @@
+#include "QualityGovernor.hpp"
+
+#include <array>
+
+namespace libprojectM {
+
+constexpr int QualityGovernor::EvaluationFrames;
+constexpr int QualityGovernor::RestoreWindows;
+
+namespace {
+
+constexpr double DegradeThreshold{1.1}; //!< Average frame time relative to the budget above which quality is reduced.
+constexpr double RestoreThreshold{0.7}; //!< Average frame time relative to the budget below which quality is restored.
+constexpr double MaximumFrameTime{1.0}; //!< Longer frames are ignored, e.g. if the application was paused.
+
+/**
+ * Quality settings for each level. Cheap CPU-side reductions come first, the most
+ * visible changes are applied last.
+ */
+const std::array<QualityGovernor::QualitySettings, 6> QualityLevels{{
+    // renderScale, meshScale, maxBlurLevel, maxShapeInstances
+    {1.0f, 1.0f, 3, 1024},
+    {1.0f, 0.5f, 3, 1024},
+    {0.75f, 0.5f, 3, 256},
+    {0.75f, 0.5f, 2, 256},
+    {0.5f, 0.5f, 1, 64},
+    {0.5f, 0.25f, 1, 16},
+}};
+
+} // namespace
+
+void QualityGovernor::SetEnabled(bool enabled)
+{
+    m_enabled = enabled;
+
+    if (!m_enabled)
+    {
+        Reset();
+    }
+}
+
+auto QualityGovernor::Enabled() const -> bool
+{
+    return m_enabled;
+}
+
+void QualityGovernor::SetFrameTimeBudget(double seconds)
+{
+    if (seconds <= 0.0)
+    {
+        return;
+    }
+
+    m_frameTimeBudget = seconds;
+    ResetWindow();
+}
+
+auto QualityGovernor::FrameTimeBudget() const -> double
+{
+    return m_frameTimeBudget;
+}
+
+auto QualityGovernor::Update(double frameTime) -> bool
+{
+    if (!m_enabled || frameTime <= 0.0 || frameTime > MaximumFrameTime)
+    {
+        return false;
+    }
+
+    m_windowFrameTime += frameTime;
+    m_windowFrameCount++;
+
+    if (m_windowFrameCount < EvaluationFrames)
+    {
+        return false;
+    }
+
+    double const averageFrameTime = m_windowFrameTime / static_cast<double>(m_windowFrameCount);
+    ResetWindow();
+
+    if (averageFrameTime > m_frameTimeBudget * DegradeThreshold)
+    {
+        m_headroomWindows = 0;
+
+        if (m_qualityLevel < MaxQualityLevel())
+        {
+            m_qualityLevel++;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (averageFrameTime < m_frameTimeBudget * RestoreThreshold)
+    {
+        m_headroomWindows++;
+
+        if (m_headroomWindows >= RestoreWindows && m_qualityLevel > 0)
+        {
+            m_headroomWindows = 0;
+            m_qualityLevel--;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Within budget, but not enough headroom to restore quality.
+    m_headroomWindows = 0;
+
+    return false;
+}
+
+auto QualityGovernor::QualityLevel() const -> int
+{
+    return m_qualityLevel;
+}
+
+auto QualityGovernor::MaxQualityLevel() -> int
+{
+    return static_cast<int>(QualityLevels.size()) - 1;
+}
+
+auto QualityGovernor::Settings() const -> const QualitySettings&
+{
+    return QualityLevels.at(m_qualityLevel);
+}
+
+void QualityGovernor::Reset()
+{
+    m_qualityLevel = 0;
+    m_headroomWindows = 0;
+    ResetWindow();
+}
+
+void QualityGovernor::ResetWindow()
+{
+    m_windowFrameCount = 0;
+    m_windowFrameTime = 0.0;
+}
+
+} // namespace libprojectM
@@ -0,0 +1,103 @@
+#pragma once
+
+namespace libprojectM {
+
+/**
+ * @brief Adjusts the rendering quality to keep frame times within a given budget.
+ *
+ * The governor averages the measured frame times over a fixed number of frames. If the average
+ * exceeds the budget, quality is reduced by one level. Quality is only restored by one level
+ * after the frame time stayed well below the budget for several consecutive evaluation windows.
+ * The different thresholds and window counts act as a hysteresis, preventing the quality from
+ * oscillating between two levels.
+ *
+ * The governor only uses the frame times passed to Update(), so it works deterministically when
+ * projectM is driven with user-specified frame times.
+ */
+class QualityGovernor
+{
+public:
+    /**
+     * @brief Quality settings applied at a given quality level.
+     */
+    struct QualitySettings
+    {
+        float renderScale{1.0f};     //!< Multiplier for the user-defined render scale.
+        float meshScale{1.0f};       //!< Multiplier for the user-defined per-pixel mesh size.
+        int maxBlurLevel{3};         //!< Highest blur level rendered for presets (1-3).
+        int maxShapeInstances{1024}; //!< Maximum number of instances drawn for each custom shape.
+    };
+
+    static constexpr int EvaluationFrames{30}; //!< Number of frames averaged before making a decision.
+    static constexpr int RestoreWindows{3};    //!< Number of consecutive windows with headroom required to restore quality.
+
+    /**
+     * @brief Enables or disables the governor.
+     * Disabling the governor will immediately reset the quality level to full quality.
+     * @param enabled True to enable the governor, false to disable it.
+     */
+    void SetEnabled(bool enabled);
+
+    /**
+     * @brief Returns whether the governor is enabled.
+     * @return True if the governor is enabled, false if not.
+     */
+    auto Enabled() const -> bool;
+
+    /**
+     * @brief Sets the frame time budget, usually the inverse of the target FPS.
+     * @param seconds The maximum time one frame should take, in seconds.
+     */
+    void SetFrameTimeBudget(double seconds);
+
+    /**
+     * @brief Returns the current frame time budget.
+     * @return The maximum time one frame should take, in seconds.
+     */
+    auto FrameTimeBudget() const -> double;
+
+    /**
+     * @brief Adds the time of the last frame and adjusts the quality level if required.
+     * @param frameTime The time the last frame took to render, in seconds.
+     * @return True if the quality level has changed, false otherwise.
+     */
+    auto Update(double frameTime) -> bool;
+
+    /**
+     * @brief Returns the current quality level.
+     * @return The current quality level. 0 is full quality, higher levels reduce quality.
+     */
+    auto QualityLevel() const -> int;
+
+    /**
+     * @brief Returns the lowest quality level the governor can use.
+     * @return The highest quality level number.
+     */
+    static auto MaxQualityLevel() -> int;
+
+    /**
+     * @brief Returns the quality settings for the current quality level.
+     * @return The quality settings to apply.
+     */
+    auto Settings() const -> const QualitySettings&;
+
+    /**
+     * @brief Resets the governor to full quality and discards all collected frame times.
+     */
+    void Reset();
+
+private:
+    /**
+     * @brief Discards the collected frame times of the current evaluation window.
+     */
+    void ResetWindow();
+
+    bool m_enabled{false};                //!< If true, the quality level is adjusted in Update().
+    double m_frameTimeBudget{1.0 / 35.0}; //!< Maximum frame time in seconds.
+    int m_qualityLevel{0};                //!< Current quality level.
+    int m_windowFrameCount{0};            //!< Number of frames collected in the current window.
+    double m_windowFrameTime{0.0};        //!< Sum of all frame times in the current window.
+    int m_headroomWindows{0};             //!< Consecutive windows with enough headroom to restore quality.
+};
+
+} // namespace libprojectM
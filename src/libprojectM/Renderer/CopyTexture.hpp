@@ -16,6 +16,16 @@ namespace Renderer {
 class CopyTexture : public RenderItem
 {
 public:
+    /**
+     * Texture filter used when sampling the original texture.
+     */
+    enum class Filter : int
+    {
+        Nearest,  //!< Nearest-neighbor sampling. Used for exact 1:1 copies.
+        Bilinear, //!< Bilinear interpolation, e.g. for upscaling to a larger target.
+        Bicubic   //!< Catmull-Rom bicubic interpolation. Sharper upscaling, but uses 9 texture fetches per pixel.
+    };
+
     CopyTexture();
 
     void InitVertexAttrib() override;
@@ -60,6 +70,12 @@ public:
      */
     auto Texture() -> std::shared_ptr<class Texture>;
 
+    /**
+     * @brief Sets the filter used to sample the original texture in subsequent copy operations.
+     * @param filter The new texture filter. Default is Filter::Nearest.
+     */
+    void SetFilter(Filter filter);
+
 private:
     /**
      * Updates the mesh
@@ -71,6 +87,7 @@ private:
     Shader m_shader;                                 //!< Simple textured shader
     Framebuffer m_framebuffer{1};                    //!< Framebuffer for drawing the flipped texture
     Sampler m_sampler{GL_CLAMP_TO_EDGE, GL_NEAREST}; //!< Texture sampler settings
+    Filter m_filter{Filter::Nearest};                //!< Current texture filter.
 
     int m_width{};  //!< Last known framebuffer/texture width
     int m_height{}; //!< Last known framebuffer/texture height
@@ -0,0 +1,322 @@
+#include "FrameReadback.hpp"
+
+#include "Renderer/StateCache.hpp"
+#include "Renderer/Texture.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace libprojectM {
+namespace Renderer {
+
+#ifdef USE_GLES
+static constexpr char ShaderVersion[] = "#version 300 es\n\n";
+#else
+static constexpr char ShaderVersion[] = "#version 330\n\n";
+#endif
+
+static constexpr char FrameReadbackVertexShader[] = R"(
+precision mediump float;
+
+layout(location = 0) in vec2 position;
+
+void main() {
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+static constexpr char FrameReadbackFragmentShader[] = R"(
+precision highp float;
+precision highp int;
+
+uniform sampler2D source_texture;
+uniform ivec2 source_size;
+uniform int yuv;
+uniform int packed_width;
+
+out vec4 color;
+
+vec3 SourcePixel(ivec2 pos)
+{
+    // Flip vertically, so the output is stored top row first.
+    pos = clamp(pos, ivec2(0), source_size - 1);
+    return texelFetch(source_texture, ivec2(pos.x, source_size.y - 1 - pos.y), 0).rgb;
+}
+
+// Returns the byte at the given offset of the I420 image, BT.601 limited range.
+float PlaneByte(int offset)
+{
+    int lumaSize = source_size.x * source_size.y;
+    if (offset < lumaSize)
+    {
+        vec3 rgb = SourcePixel(ivec2(offset % source_size.x, offset / source_size.x));
+        return (16.0 + dot(rgb, vec3(65.481, 128.553, 24.966))) / 255.0;
+    }
+
+    ivec2 chromaSize = (source_size + 1) / 2;
+    int chromaOffset = offset - lumaSize;
+    int plane = chromaOffset / (chromaSize.x * chromaSize.y);
+    chromaOffset -= plane * chromaSize.x * chromaSize.y;
+
+    ivec2 pos = ivec2(chromaOffset % chromaSize.x, chromaOffset / chromaSize.x) * 2;
+    vec3 rgb = (SourcePixel(pos) + SourcePixel(pos + ivec2(1, 0)) +
+                SourcePixel(pos + ivec2(0, 1)) + SourcePixel(pos + ivec2(1, 1))) * 0.25;
+
+    if (plane == 0)
+    {
+        return (128.0 + dot(rgb, vec3(-37.797, -74.203, 112.0))) / 255.0;
+    }
+    return (128.0 + dot(rgb, vec3(112.0, -93.786, -18.214))) / 255.0;
+}
+
+void main() {
+    ivec2 pos = ivec2(gl_FragCoord.xy);
+
+    if (yuv == 0)
+    {
+        color = texelFetch(source_texture, ivec2(pos.x, source_size.y - 1 - pos.y), 0);
+        return;
+    }
+
+    // Each output texel stores four consecutive bytes of the planar image.
+    int offset = (pos.y * packed_width + pos.x) * 4;
+    color = vec4(PlaneByte(offset), PlaneByte(offset + 1), PlaneByte(offset + 2), PlaneByte(offset + 3));
+}
+)";
+
+FrameReadback::FrameReadback(int ringSize)
+{
+    RenderItem::Init();
+
+    m_framebuffer.CreateColorAttachment(0, 0);
+
+    std::string vertexShader(static_cast<const char*>(ShaderVersion));
+    std::string fragmentShader(static_cast<const char*>(ShaderVersion));
+    vertexShader.append(static_cast<const char*>(FrameReadbackVertexShader));
+    fragmentShader.append(static_cast<const char*>(FrameReadbackFragmentShader));
+
+    m_shader.CompileProgram(vertexShader, fragmentShader);
+
+    SetRingSize(ringSize);
+}
+
+FrameReadback::~FrameReadback()
+{
+    Discard();
+
+    for (auto& slot : m_slots)
+    {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+void FrameReadback::InitVertexAttrib()
+{
+    static const std::array<RenderItem::Point, 4> points{{{-1.0f, 1.0f},
+                                                          {1.0f, 1.0f},
+                                                          {-1.0f, -1.0f},
+                                                          {1.0f, -1.0f}}};
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Point), reinterpret_cast<void*>(offsetof(Point, x))); // Position
+    glBufferData(GL_ARRAY_BUFFER, sizeof(points), points.data(), GL_STATIC_DRAW);
+}
+
+void FrameReadback::SetFormat(Format format)
+{
+    m_format = format;
+}
+
+auto FrameReadback::GetFormat() const -> Format
+{
+    return m_format;
+}
+
+void FrameReadback::SetRingSize(int ringSize)
+{
+    ringSize = std::max(1, std::min(16, ringSize));
+
+    Discard();
+
+    for (auto& slot : m_slots)
+    {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+
+    m_slots.clear();
+    m_slots.resize(static_cast<size_t>(ringSize));
+    m_oldestSlot = 0;
+
+    for (auto& slot : m_slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+    }
+}
+
+auto FrameReadback::RingSize() const -> int
+{
+    return static_cast<int>(m_slots.size());
+}
+
+void FrameReadback::Queue(const std::shared_ptr<class Texture>& texture, uint32_t frameNumber)
+{
+    if (texture == nullptr || texture->Empty())
+    {
+        return;
+    }
+
+    int const width = texture->Width();
+    int const height = texture->Height();
+
+    // Determine the output size. YUV data is packed into RGBA texels, four bytes each.
+    size_t dataSize = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+    int packedWidth = width;
+    int packedHeight = height;
+
+    if (m_format == Format::YUV420)
+    {
+        auto const chromaWidth = static_cast<size_t>((width + 1) / 2);
+        auto const chromaHeight = static_cast<size_t>((height + 1) / 2);
+        dataSize = static_cast<size_t>(width) * static_cast<size_t>(height) + chromaWidth * chromaHeight * 2;
+        packedWidth = (width + 3) / 4;
+        auto const packedRowSize = static_cast<size_t>(packedWidth) * 4;
+        packedHeight = static_cast<int>((dataSize + packedRowSize - 1) / packedRowSize);
+    }
+
+    if (m_pendingCount == m_slots.size())
+    {
+        ReleaseOldest();
+        m_droppedFrames++;
+    }
+
+    auto& slot = m_slots[(m_oldestSlot + m_pendingCount) % m_slots.size()];
+
+    // Convert the image into the output format.
+    m_framebuffer.SetSize(packedWidth, packedHeight);
+    m_framebuffer.Bind(0);
+    auto& stateCache = StateCache::Current();
+    stateCache.Viewport(0, 0, packedWidth, packedHeight);
+    stateCache.SetBlend(false);
+
+    m_shader.Bind();
+    m_shader.SetUniformInt("source_texture", 0);
+    m_shader.SetUniformInt2("source_size", {width, height});
+    m_shader.SetUniformInt("yuv", m_format == Format::YUV420 ? 1 : 0);
+    m_shader.SetUniformInt("packed_width", packedWidth);
+
+    texture->Bind(0);
+
+    stateCache.BindVertexArray(m_vaoID);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    texture->Unbind(0);
+
+    // Start the asynchronous transfer into the pixel buffer.
+    size_t const transferSize = static_cast<size_t>(packedWidth) * static_cast<size_t>(packedHeight) * 4;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < transferSize)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(transferSize), nullptr, GL_STREAM_READ);
+        slot.capacity = transferSize;
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, packedWidth, packedHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame.size = dataSize;
+    slot.frame.width = width;
+    slot.frame.height = height;
+    slot.frame.format = m_format;
+    slot.frame.frameNumber = frameNumber;
+
+    m_pendingCount++;
+
+    Framebuffer::Unbind();
+}
+
+auto FrameReadback::ReadCompleted(const FrameHandler& handler, bool wait) -> bool
+{
+    if (m_pendingCount == 0)
+    {
+        return false;
+    }
+
+    auto& slot = m_slots[m_oldestSlot];
+
+    if (slot.fence == nullptr)
+    {
+        ReleaseOldest();
+        return false;
+    }
+
+    GLuint64 const timeout = wait ? 1000000000 : 0; // 1 second if waiting.
+    GLenum const waitResult = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+    if (waitResult != GL_ALREADY_SIGNALED && waitResult != GL_CONDITION_SATISFIED)
+    {
+        return false;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    auto* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(slot.frame.size), GL_MAP_READ_BIT);
+
+    if (data != nullptr)
+    {
+        Frame frame = slot.frame;
+        frame.data = static_cast<const uint8_t*>(data);
+
+        if (handler)
+        {
+            handler(frame);
+        }
+
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    ReleaseOldest();
+
+    return data != nullptr;
+}
+
+void FrameReadback::Discard()
+{
+    while (m_pendingCount > 0)
+    {
+        ReleaseOldest();
+    }
+}
+
+auto FrameReadback::PendingFrames() const -> int
+{
+    return static_cast<int>(m_pendingCount);
+}
+
+auto FrameReadback::DroppedFrames() const -> uint32_t
+{
+    return m_droppedFrames;
+}
+
+void FrameReadback::ReleaseOldest()
+{
+    if (m_pendingCount == 0)
+    {
+        return;
+    }
+
+    auto& slot = m_slots[m_oldestSlot];
+    if (slot.fence != nullptr)
+    {
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    m_oldestSlot = (m_oldestSlot + 1) % m_slots.size();
+    m_pendingCount--;
+}
+
+} // namespace Renderer
+} // namespace libprojectM
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Renderer/Framebuffer.hpp"
+#include "Renderer/RenderItem.hpp"
+#include "Renderer/Shader.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace libprojectM {
+namespace Renderer {
+
+/**
+ * @class FrameReadback
+ * @brief Asynchronously reads texture contents back into system memory.
+ *
+ * Each queued texture is first converted into the requested pixel format on the GPU, then copied
+ * into one of several pixel buffer objects (PBOs) organized as a ring. A fence is inserted after
+ * each copy, so the data can be mapped later without stalling the pipeline once the GPU has finished
+ * the transfer. Completed frames are retrieved in the order they were queued.
+ *
+ * If all buffers in the ring are in use when queueing a new frame, the oldest pending frame is dropped.
+ *
+ * Output images are always stored top row first, as expected by image writers and video encoders.
+ */
+class FrameReadback : public RenderItem
+{
+public:
+    /**
+     * Pixel formats available for readback.
+     */
+    enum class Format : int
+    {
+        RGBA8, //!< 8 bits per channel RGBA, 4 bytes per pixel.
+        YUV420 //!< Planar 8-bit Y'CbCr 4:2:0 (I420), BT.601 limited range. Y plane, followed by U and V planes.
+    };
+
+    /**
+     * A completed frame. The data pointer is only valid inside the frame handler.
+     */
+    struct Frame
+    {
+        const uint8_t* data{nullptr}; //!< Pointer to the pixel data.
+        size_t size{};                //!< Size of the pixel data in bytes.
+        int width{};                  //!< Image width in pixels.
+        int height{};                 //!< Image height in pixels.
+        Format format{Format::RGBA8}; //!< Pixel format of the image data.
+        uint32_t frameNumber{};       //!< The frame number passed to Queue().
+    };
+
+    using FrameHandler = std::function<void(const Frame& frame)>;
+
+    /**
+     * @brief Constructor.
+     * @param ringSize Number of pixel buffers in the ring. Determines the maximum latency in frames.
+     */
+    explicit FrameReadback(int ringSize = 3);
+
+    ~FrameReadback() override;
+
+    void InitVertexAttrib() override;
+
+    /**
+     * @brief Sets the pixel format used for subsequently queued frames.
+     * @param format The new pixel format.
+     */
+    void SetFormat(Format format);
+
+    /**
+     * @brief Returns the pixel format used for queued frames.
+     * @return The current pixel format.
+     */
+    auto GetFormat() const -> Format;
+
+    /**
+     * @brief Changes the number of pixel buffers in the ring.
+     * All pending frames are discarded.
+     * @param ringSize The new ring size. Will be clamped to [1, 16].
+     */
+    void SetRingSize(int ringSize);
+
+    /**
+     * @brief Returns the number of pixel buffers in the ring.
+     * @return The number of pixel buffers in the ring.
+     */
+    auto RingSize() const -> int;
+
+    /**
+     * @brief Queues the contents of the given texture for readback.
+     * Changes the current framebuffer and viewport.
+     * @param texture The texture to read back.
+     * @param frameNumber A frame number which is passed back with the completed frame.
+     */
+    void Queue(const std::shared_ptr<class Texture>& texture, uint32_t frameNumber);
+
+    /**
+     * @brief Passes the oldest pending frame to the handler if the GPU has finished the transfer.
+     * @param handler The function receiving the frame data.
+     * @param wait If true, waits for the GPU to finish the transfer instead of returning immediately.
+     * @return True if a frame was passed to the handler, false if no completed frame was available.
+     */
+    auto ReadCompleted(const FrameHandler& handler, bool wait = false) -> bool;
+
+    /**
+     * @brief Discards all pending frames.
+     */
+    void Discard();
+
+    /**
+     * @brief Returns the number of queued frames not yet read.
+     * @return The number of pending frames.
+     */
+    auto PendingFrames() const -> int;
+
+    /**
+     * @brief Returns the number of frames dropped because the ring was full.
+     * @return The number of dropped frames since creating the object.
+     */
+    auto DroppedFrames() const -> uint32_t;
+
+private:
+    /**
+     * A single pixel buffer in the ring.
+     */
+    struct Slot
+    {
+        GLuint buffer{};       //!< The pixel buffer object ID.
+        size_t capacity{};     //!< Allocated buffer size in bytes.
+        GLsync fence{nullptr}; //!< Fence signaled when the transfer is done.
+        Frame frame;           //!< Frame information, without the data pointer.
+    };
+
+    /**
+     * @brief Releases the oldest pending slot.
+     */
+    void ReleaseOldest();
+
+    Shader m_shader;              //!< Conversion shader.
+    Framebuffer m_framebuffer{1}; //!< Framebuffer holding the converted image.
+
+    Format m_format{Format::RGBA8}; //!< Format of newly queued frames.
+    std::vector<Slot> m_slots;      //!< The pixel buffer ring.
+    size_t m_oldestSlot{};          //!< Index of the oldest pending slot.
+    size_t m_pendingCount{};        //!< Number of pending slots.
+    uint32_t m_droppedFrames{};     //!< Number of frames dropped because all slots were pending.
+};
+
+} // namespace Renderer
+} // namespace libprojectM
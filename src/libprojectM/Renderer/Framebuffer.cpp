@@ -1,5 +1,7 @@
 #include "Framebuffer.hpp"
 
+#include "StateCache.hpp"
+
 namespace libprojectM {
 namespace Renderer {
 
@@ -27,6 +29,7 @@ Framebuffer::~Framebuffer()
         // Delete attached textures first
         m_attachments.clear();
 
+        StateCache::Current().FramebuffersDeleted(static_cast<GLsizei>(m_framebufferIds.size()), m_framebufferIds.data());
         glDeleteFramebuffers(static_cast<int>(m_framebufferIds.size()), m_framebufferIds.data());
         m_framebufferIds.clear();
     }
@@ -44,7 +47,7 @@ void Framebuffer::Bind(int framebufferIndex)
         return;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
 
     m_readFramebuffer = m_drawFramebuffer = framebufferIndex;
 }
@@ -56,7 +59,7 @@ void Framebuffer::BindRead(int framebufferIndex)
         return;
     }
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
+    StateCache::Current().BindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
 
     m_readFramebuffer = framebufferIndex;
 }
@@ -68,14 +71,14 @@ void Framebuffer::BindDraw(int framebufferIndex)
         return;
     }
 
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
+    StateCache::Current().BindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
 
     m_drawFramebuffer = framebufferIndex;
 }
 
 void Framebuffer::Unbind()
 {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    StateCache::Current().BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
 bool Framebuffer::SetSize(int width, int height)
@@ -98,7 +101,7 @@ bool Framebuffer::SetSize(int width, int height)
             glFramebufferTexture2D(GL_FRAMEBUFFER, texture.first, GL_TEXTURE_2D, texture.second->Texture()->TextureID(), 0);
         }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
     return true;
 }
@@ -177,7 +180,7 @@ void Framebuffer::SetAttachment(int framebufferIndex, int attachmentIndex, const
     }
     m_attachments.at(framebufferIndex).insert({textureType, attachment});
 
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
 
     if (m_width > 0 && m_height > 0)
     {
@@ -186,8 +189,8 @@ void Framebuffer::SetAttachment(int framebufferIndex, int attachmentIndex, const
     UpdateDrawBuffers(framebufferIndex);
 
     // Reset to previous read/draw buffers
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIds.at(m_readFramebuffer));
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebufferIds.at(m_drawFramebuffer));
+    StateCache::Current().BindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIds.at(m_readFramebuffer));
+    StateCache::Current().BindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebufferIds.at(m_drawFramebuffer));
 }
 
 void Framebuffer::CreateColorAttachment(int framebufferIndex, int attachmentIndex)
@@ -212,7 +215,7 @@ void Framebuffer::CreateColorAttachment(int framebufferIndex, int attachmentInde
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + attachmentIndex, GL_TEXTURE_2D, texture->TextureID(), 0);
     }
     UpdateDrawBuffers(framebufferIndex);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::RemoveColorAttachment(int framebufferIndex, int attachmentIndex)
@@ -253,7 +256,7 @@ void Framebuffer::CreateDepthAttachment(int framebufferIndex)
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture->TextureID(), 0);
     }
     UpdateDrawBuffers(framebufferIndex);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::RemoveDepthAttachment(int framebufferIndex)
@@ -278,7 +281,7 @@ void Framebuffer::CreateStencilAttachment(int framebufferIndex)
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_TEXTURE_2D, texture->TextureID(), 0);
     }
     UpdateDrawBuffers(framebufferIndex);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::RemoveStencilAttachment(int framebufferIndex)
@@ -303,7 +306,7 @@ void Framebuffer::CreateDepthStencilAttachment(int framebufferIndex)
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, texture->TextureID(), 0);
     }
     UpdateDrawBuffers(framebufferIndex);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::RemoveDepthStencilAttachment(int framebufferIndex)
@@ -387,7 +390,7 @@ void Framebuffer::RemoveAttachment(int framebufferIndex, GLenum attachmentType)
         return;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
+    StateCache::Current().BindFramebuffer(GL_FRAMEBUFFER, m_framebufferIds.at(framebufferIndex));
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, attachmentType, GL_TEXTURE_2D, 0, 0);
     UpdateDrawBuffers(framebufferIndex);
@@ -395,8 +398,8 @@ void Framebuffer::RemoveAttachment(int framebufferIndex, GLenum attachmentType)
     m_attachments.at(framebufferIndex).erase(attachmentType);
 
     // Reset to previous read/draw buffers
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIds.at(m_readFramebuffer));
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebufferIds.at(m_drawFramebuffer));
+    StateCache::Current().BindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferIds.at(m_readFramebuffer));
+    StateCache::Current().BindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebufferIds.at(m_drawFramebuffer));
 }
 
 } // namespace Renderer
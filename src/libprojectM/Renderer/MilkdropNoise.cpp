@@ -1,5 +1,7 @@
 #include "MilkdropNoise.hpp"
 
+#include "StateCache.hpp"
+
 #include "projectM-opengl.h"
 
 #include <chrono>
@@ -15,7 +17,7 @@ auto MilkdropNoise::LowQuality() -> std::shared_ptr<Texture>
         auto textureData = generate2D(256, 1);
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        StateCache::Current().BindTexture(0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GetPreferredInternalFormat(), GL_UNSIGNED_BYTE, textureData.data());
     }
     return std::make_shared<Texture>("noise_lq", texture, GL_TEXTURE_2D, 256, 256, false);
@@ -29,7 +31,7 @@ auto MilkdropNoise::LowQualityLite() -> std::shared_ptr<Texture>
         auto textureData = generate2D(32, 1);
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        StateCache::Current().BindTexture(0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 32, 32, 0, GetPreferredInternalFormat(), GL_UNSIGNED_BYTE, textureData.data());
     }
 
@@ -44,7 +46,7 @@ auto MilkdropNoise::MediumQuality() -> std::shared_ptr<Texture>
         auto textureData = generate2D(256, 4);
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        StateCache::Current().BindTexture(0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GetPreferredInternalFormat(), GL_UNSIGNED_BYTE, textureData.data());
     }
     return std::make_shared<Texture>("noise_mq", texture, GL_TEXTURE_2D, 256, 256, false);
@@ -58,7 +60,7 @@ auto MilkdropNoise::HighQuality() -> std::shared_ptr<Texture>
         auto textureData = generate2D(256, 8);
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        StateCache::Current().BindTexture(0, GL_TEXTURE_2D, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GetPreferredInternalFormat(), GL_UNSIGNED_BYTE, textureData.data());
     }
 
@@ -73,7 +75,7 @@ auto MilkdropNoise::LowQualityVolume() -> std::shared_ptr<Texture>
         auto textureData = generate3D(32, 1);
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_3D, texture);
+        StateCache::Current().BindTexture(0, GL_TEXTURE_3D, texture);
         glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, 32, 32, 32, 0, GetPreferredInternalFormat(), GL_UNSIGNED_BYTE, textureData.data());
     }
 
@@ -88,7 +90,7 @@ auto MilkdropNoise::HighQualityVolume() -> std::shared_ptr<Texture>
         auto textureData = generate3D(32, 4);
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_3D, texture);
+        StateCache::Current().BindTexture(0, GL_TEXTURE_3D, texture);
         glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, 32, 32, 32, 0, GetPreferredInternalFormat(), GL_UNSIGNED_BYTE, textureData.data());
     }
 
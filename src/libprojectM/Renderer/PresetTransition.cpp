@@ -1,5 +1,6 @@
 #include "PresetTransition.hpp"
 
+#include "StateCache.hpp"
 #include "TextureManager.hpp"
 
 #include <array>
@@ -114,9 +115,10 @@ void PresetTransition::Draw(const Preset& oldPreset,
     }
 
     // Render the transition quad
-    glBindVertexArray(m_vaoID);
+    auto& stateCache = StateCache::Current();
+    stateCache.SetBlend(false);
+    stateCache.BindVertexArray(m_vaoID);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 
     // Clean up
     oldPreset.OutputTexture()->Unbind(0);
@@ -127,8 +129,6 @@ void PresetTransition::Draw(const Preset& oldPreset,
         noiseDescriptors[i - 2].Unbind(textureUnit);
     }
 
-    Shader::Unbind();
-
     // Update last frame time.
     m_lastFrameTime = currentFrameTime;
 }
@@ -29,6 +29,10 @@ public:
     int perPixelMeshX{64}; //!< Per-pixel/per-vertex mesh X resolution.
     int perPixelMeshY{48}; //!< Per-pixel/per-vertex mesh Y resolution.
 
+    int maxBlurLevel{3};         //!< Highest blur level rendered. Presets using higher levels get this level instead.
+    int maxShapeInstances{1024}; //!< Maximum number of instances drawn for each custom shape.
+    bool fastBlur{false};        //!< If true, blur textures are rendered with the fast approximate blur.
+
     TextureManager* textureManager{nullptr}; //!< Holds all loaded textures for shader access.
 };
 
@@ -1,5 +1,7 @@
 #include "RenderItem.hpp"
 
+#include "StateCache.hpp"
+
 namespace libprojectM {
 namespace Renderer {
 
@@ -8,18 +10,19 @@ void RenderItem::Init()
     glGenVertexArrays(1, &m_vaoID);
     glGenBuffers(1, &m_vboID);
 
-    glBindVertexArray(m_vaoID);
+    StateCache::Current().BindVertexArray(m_vaoID);
     glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
     InitVertexAttrib();
 
-    glBindVertexArray(0);
+    StateCache::Current().BindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 RenderItem::~RenderItem()
 {
     glDeleteBuffers(1, &m_vboID);
+    StateCache::Current().VertexArrayDeleted(m_vaoID);
     glDeleteVertexArrays(1, &m_vaoID);
 }
 
@@ -1,5 +1,7 @@
 #include "Sampler.hpp"
 
+#include "StateCache.hpp"
+
 namespace libprojectM {
 namespace Renderer {
 
@@ -17,17 +19,18 @@ Sampler::Sampler(const GLint wrapMode, const GLint filterMode)
 
 Sampler::~Sampler()
 {
+    StateCache::Current().SamplerDeleted(m_samplerId);
     glDeleteSamplers(1, &m_samplerId);
 }
 
 void Sampler::Bind(GLuint unit) const
 {
-    glBindSampler(unit, m_samplerId);
+    StateCache::Current().BindSampler(unit, m_samplerId);
 }
 
 void Sampler::Unbind(GLuint unit)
 {
-    glBindSampler(unit, 0);
+    StateCache::Current().BindSampler(unit, 0);
 }
 
 auto Sampler::WrapMode() const -> GLint
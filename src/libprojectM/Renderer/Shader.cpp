@@ -1,9 +1,17 @@
 #include "Shader.hpp"
 
+#include "StateCache.hpp"
+
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstring>
 #include <vector>
 
+// Same value for the KHR and ARB extensions, but not defined in all GL headers.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace libprojectM {
 namespace Renderer {
 
@@ -14,8 +22,11 @@ Shader::Shader()
 
 Shader::~Shader()
 {
+    DeletePendingShaders();
+
     if (m_shaderProgram)
     {
+        StateCache::Current().ProgramDeleted(m_shaderProgram);
         glDeleteProgram(m_shaderProgram);
     }
 }
@@ -23,33 +34,83 @@ Shader::~Shader()
 void Shader::CompileProgram(const std::string& vertexShaderSource,
                             const std::string& fragmentShaderSource)
 {
-    auto vertexShader = CompileShader(vertexShaderSource, GL_VERTEX_SHADER);
-    auto fragmentShader = CompileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
+    CompileProgramAsync(vertexShaderSource, fragmentShaderSource);
+    FinishCompilation();
+}
+
+void Shader::CompileProgramAsync(const std::string& vertexShaderSource,
+                                 const std::string& fragmentShaderSource)
+{
+    DeletePendingShaders();
+    m_compileError.clear();
 
-    glAttachShader(m_shaderProgram, vertexShader);
-    glAttachShader(m_shaderProgram, fragmentShader);
+    m_vertexShader = CompileShader(vertexShaderSource, GL_VERTEX_SHADER);
+    m_fragmentShader = CompileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
+
+    glAttachShader(m_shaderProgram, m_vertexShader);
+    glAttachShader(m_shaderProgram, m_fragmentShader);
 
     glLinkProgram(m_shaderProgram);
 
-    // Shader objects are no longer needed after linking, free the memory.
-    glDetachShader(m_shaderProgram, vertexShader);
-    glDetachShader(m_shaderProgram, fragmentShader);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    m_compilationPending = true;
+}
+
+auto Shader::IsCompilationComplete() const -> bool
+{
+    if (!m_compilationPending || !ParallelCompileSupported())
+    {
+        return true;
+    }
+
+    GLint completed{GL_FALSE};
+    glGetProgramiv(m_shaderProgram, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+void Shader::FinishCompilation()
+{
+    if (!m_compilationPending)
+    {
+        if (!m_compileError.empty())
+        {
+            throw ShaderException(m_compileError);
+        }
+        return;
+    }
+
+    m_compilationPending = false;
 
     GLint programLinked;
     glGetProgramiv(m_shaderProgram, GL_LINK_STATUS, &programLinked);
     if (programLinked == GL_TRUE)
     {
+        // Shader objects are no longer needed after linking, free the memory.
+        DeletePendingShaders();
         return;
     }
 
+    // A shader compile error is more helpful than the resulting link error.
+    try
+    {
+        CheckShaderCompileStatus(m_vertexShader);
+        CheckShaderCompileStatus(m_fragmentShader);
+    }
+    catch (ShaderException& ex)
+    {
+        DeletePendingShaders();
+        m_compileError = ex.message();
+        throw;
+    }
+
+    DeletePendingShaders();
+
     GLint infoLogLength{};
     glGetProgramiv(m_shaderProgram, GL_INFO_LOG_LENGTH, &infoLogLength);
     std::vector<char> message(infoLogLength + 1);
     glGetProgramInfoLog(m_shaderProgram, infoLogLength, nullptr, message.data());
 
-    throw ShaderException("Error compiling shader: " + std::string(message.data()));
+    m_compileError = "Error compiling shader: " + std::string(message.data());
+    throw ShaderException(m_compileError);
 }
 
 bool Shader::Validate(std::string& validationMessage) const
@@ -75,13 +136,13 @@ void Shader::Bind() const
 {
     if (m_shaderProgram > 0)
     {
-        glUseProgram(m_shaderProgram);
+        StateCache::Current().UseProgram(m_shaderProgram);
     }
 }
 
 void Shader::Unbind()
 {
-    glUseProgram(0);
+    StateCache::Current().UseProgram(0);
 }
 
 void Shader::SetUniformFloat(const char* uniform, float value) const
@@ -186,29 +247,66 @@ void Shader::SetUniformMat4x4(const char* uniform, const glm::mat4x4& values) co
 
 GLuint Shader::CompileShader(const std::string& source, GLenum type)
 {
-    GLint shaderCompiled{};
-
     auto shader = glCreateShader(type);
     const auto* shaderSourceCStr = source.c_str();
     glShaderSource(shader, 1, &shaderSourceCStr, nullptr);
 
     glCompileShader(shader);
 
+    return shader;
+}
+
+void Shader::CheckShaderCompileStatus(GLuint shader)
+{
+    GLint shaderCompiled{};
     glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
     if (shaderCompiled == GL_TRUE)
     {
-        return shader;
+        return;
     }
 
     GLint infoLogLength{};
     glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
     std::vector<char> message(infoLogLength + 1);
     glGetShaderInfoLog(shader, infoLogLength, nullptr, message.data());
-    glDeleteShader(shader);
 
     throw ShaderException("Error compiling shader: " + std::string(message.data()));
 }
 
+void Shader::DeletePendingShaders()
+{
+    for (auto* shader : {&m_vertexShader, &m_fragmentShader})
+    {
+        if (*shader != 0)
+        {
+            glDetachShader(m_shaderProgram, *shader);
+            glDeleteShader(*shader);
+            *shader = 0;
+        }
+    }
+}
+
+auto Shader::ParallelCompileSupported() -> bool
+{
+    static bool const supported = []() {
+        GLint extensionCount{};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint index = 0; index < extensionCount; index++)
+        {
+            const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index)));
+            if (extension != nullptr &&
+                (std::strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+                 std::strcmp(extension, "GL_ARB_parallel_shader_compile") == 0))
+            {
+                return true;
+            }
+        }
+        return false;
+    }();
+
+    return supported;
+}
+
 auto Shader::GetShaderLanguageVersion() -> Shader::GlslVersion
 {
     const char* shaderLanguageVersion = reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION));
@@ -74,6 +74,35 @@ public:
     void CompileProgram(const std::string& vertexShaderSource,
                         const std::string& fragmentShaderSource);
 
+    /**
+     * @brief Starts compiling a vertex and fragment shader into a program without waiting for the result.
+     *
+     * Checking the compile or link status forces the driver to finish the work, so this is
+     * deferred to FinishCompilation(). Drivers supporting GL_KHR_parallel_shader_compile
+     * compile the program in the background in the meantime.
+     *
+     * @param vertexShaderSource The vertex shader source.
+     * @param fragmentShaderSource The fragment shader source.
+     */
+    void CompileProgramAsync(const std::string& vertexShaderSource,
+                             const std::string& fragmentShaderSource);
+
+    /**
+     * @brief Returns whether FinishCompilation() can be called without waiting for the driver.
+     *
+     * Without GL_KHR_parallel_shader_compile, this can't be queried and always returns true.
+     *
+     * @return true if the program is compiled and linked, or no compilation is pending.
+     */
+    auto IsCompilationComplete() const -> bool;
+
+    /**
+     * @brief Waits for the compilation started by CompileProgramAsync() and checks the result.
+     * Does nothing if the program was linked successfully.
+     * @throws ShaderException Thrown if compilation of a shader or program linking failed, also on later calls.
+     */
+    void FinishCompilation();
+
     /**
      * @brief Validates that the program can run in the current state.
      * @param validationMessage The error message if validation failed.
@@ -181,15 +210,36 @@ public:
 
 private:
     /**
-     * @brief Compiles a single shader.
-     * @throws ShaderException Thrown if compilation of the shader failed.
+     * @brief Starts compiling a single shader.
      * @param source The shader source.
      * @param type The shader type, e.g. GL_VERTEX_SHADER.
      * @return The shader ID.
      */
-    auto CompileShader(const std::string& source, GLenum type) -> GLuint;
+    static auto CompileShader(const std::string& source, GLenum type) -> GLuint;
+
+    /**
+     * @brief Throws an exception with the info log if the shader failed to compile.
+     * @throws ShaderException Thrown if compilation of the shader failed.
+     * @param shader The shader ID.
+     */
+    static void CheckShaderCompileStatus(GLuint shader);
+
+    /**
+     * @brief Detaches and deletes the shaders of a pending compilation.
+     */
+    void DeletePendingShaders();
+
+    /**
+     * @brief Checks whether the driver supports GL_KHR_parallel_shader_compile.
+     * @return true if the completion status of a program can be queried.
+     */
+    static auto ParallelCompileSupported() -> bool;
 
-    GLuint m_shaderProgram{}; //!< The program ID.
+    GLuint m_shaderProgram{};  //!< The program ID.
+    GLuint m_vertexShader{};   //!< Vertex shader of a pending compilation.
+    GLuint m_fragmentShader{}; //!< Fragment shader of a pending compilation.
+    bool m_compilationPending{false}; //!< True between CompileProgramAsync() and FinishCompilation().
+    std::string m_compileError;       //!< Error message if the last compilation failed.
 };
 
 } // namespace Renderer
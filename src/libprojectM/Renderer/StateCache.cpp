@@ -0,0 +1,409 @@
+#include "StateCache.hpp"
+
+namespace libprojectM {
+namespace Renderer {
+
+constexpr GLuint StateCache::TrackedTextureUnits;
+constexpr GLuint StateCache::Unknown;
+
+static_assert(StateCache::TrackedTextureUnits <= 32, "Tracked texture units must fit into the touched unit bit mask.");
+
+namespace {
+thread_local StateCache* currentCache{nullptr}; //!< The cache of the frame being rendered on this thread.
+} // namespace
+
+StateCache::ScopedFrame::ScopedFrame(StateCache& stateCache)
+    : m_stateCache(stateCache)
+{
+    m_stateCache.Begin();
+}
+
+StateCache::ScopedFrame::~ScopedFrame()
+{
+    m_stateCache.End();
+}
+
+auto StateCache::Current() -> StateCache&
+{
+    if (currentCache != nullptr)
+    {
+        return *currentCache;
+    }
+
+    // Never activated, so it passes all calls to OpenGL.
+    thread_local StateCache passThroughCache;
+    return passThroughCache;
+}
+
+void StateCache::SetSaveHostState(bool saveHostState)
+{
+    m_saveHostState = saveHostState;
+}
+
+auto StateCache::SaveHostState() const -> bool
+{
+    return m_saveHostState;
+}
+
+void StateCache::Begin()
+{
+    if (m_active)
+    {
+        return;
+    }
+
+    Invalidate();
+    m_hostState = {};
+    m_hostTextureUnits.clear();
+    m_touchedTextureUnits = 0;
+
+    if (m_saveHostState)
+    {
+        glGetIntegerv(GL_CURRENT_PROGRAM, &m_hostState.program);
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_hostState.vertexArray);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &m_hostState.activeTexture);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &m_hostState.readFramebuffer);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_hostState.drawFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, m_hostState.viewport.data());
+        m_hostState.blend = glIsEnabled(GL_BLEND);
+        glGetIntegerv(GL_BLEND_SRC_RGB, &m_hostState.blendFunc[0]);
+        glGetIntegerv(GL_BLEND_DST_RGB, &m_hostState.blendFunc[1]);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &m_hostState.blendFunc[2]);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &m_hostState.blendFunc[3]);
+
+        // The saved state is also the current state, so the cache starts with known values.
+        m_program = static_cast<GLuint>(m_hostState.program);
+        m_vertexArray = static_cast<GLuint>(m_hostState.vertexArray);
+        m_activeTexture = static_cast<GLuint>(m_hostState.activeTexture - GL_TEXTURE0);
+        m_readFramebuffer = static_cast<GLuint>(m_hostState.readFramebuffer);
+        m_drawFramebuffer = static_cast<GLuint>(m_hostState.drawFramebuffer);
+        m_viewport = m_hostState.viewport;
+        m_blend = m_hostState.blend == GL_TRUE ? 1 : 0;
+        if (m_hostState.blendFunc[0] == m_hostState.blendFunc[2] &&
+            m_hostState.blendFunc[1] == m_hostState.blendFunc[3])
+        {
+            m_blendFunc = {static_cast<GLenum>(m_hostState.blendFunc[0]), static_cast<GLenum>(m_hostState.blendFunc[1])};
+        }
+    }
+
+    m_active = true;
+    m_previousCache = currentCache;
+    currentCache = this;
+}
+
+void StateCache::End()
+{
+    if (!m_active)
+    {
+        return;
+    }
+
+    UseProgram(static_cast<GLuint>(m_hostState.program));
+    BindVertexArray(static_cast<GLuint>(m_hostState.vertexArray));
+
+    for (const auto& hostUnit : m_hostTextureUnits)
+    {
+        BindTexture(hostUnit.first, GL_TEXTURE_2D, hostUnit.second.texture2D);
+        BindTexture(hostUnit.first, GL_TEXTURE_3D, hostUnit.second.texture3D);
+        BindSampler(hostUnit.first, hostUnit.second.sampler);
+    }
+    ActiveTexture(static_cast<GLuint>(m_hostState.activeTexture - GL_TEXTURE0));
+
+    // Without the saved state, the final image's framebuffer and viewport are kept.
+    if (m_saveHostState)
+    {
+        BindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(m_hostState.readFramebuffer));
+        BindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(m_hostState.drawFramebuffer));
+        Viewport(m_hostState.viewport[0], m_hostState.viewport[1], m_hostState.viewport[2], m_hostState.viewport[3]);
+    }
+
+    SetBlend(m_hostState.blend == GL_TRUE);
+
+    if (m_blendFunc[0] != static_cast<GLenum>(m_hostState.blendFunc[0]) ||
+        m_blendFunc[1] != static_cast<GLenum>(m_hostState.blendFunc[1]) ||
+        m_hostState.blendFunc[0] != m_hostState.blendFunc[2] ||
+        m_hostState.blendFunc[1] != m_hostState.blendFunc[3])
+    {
+        glBlendFuncSeparate(m_hostState.blendFunc[0], m_hostState.blendFunc[1], m_hostState.blendFunc[2], m_hostState.blendFunc[3]);
+        m_statistics.issuedCalls++;
+    }
+    else
+    {
+        m_statistics.filteredCalls++;
+    }
+
+    m_active = false;
+    currentCache = m_previousCache;
+    m_previousCache = nullptr;
+}
+
+void StateCache::UseProgram(GLuint program)
+{
+    if (NeedsUpdate(m_program, program))
+    {
+        glUseProgram(program);
+        m_program = program;
+    }
+}
+
+void StateCache::BindVertexArray(GLuint vertexArray)
+{
+    if (NeedsUpdate(m_vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        m_vertexArray = vertexArray;
+    }
+}
+
+void StateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    TouchTextureUnit(unit);
+
+    // Always select the unit, as callers may modify the bound texture afterwards.
+    ActiveTexture(unit);
+
+    if (unit >= TrackedTextureUnits)
+    {
+        glBindTexture(target, texture);
+        m_statistics.issuedCalls++;
+        return;
+    }
+
+    auto& boundTexture = target == GL_TEXTURE_3D ? m_textureUnits[unit].texture3D : m_textureUnits[unit].texture2D;
+    if (NeedsUpdate(boundTexture, texture))
+    {
+        glBindTexture(target, texture);
+        boundTexture = texture;
+    }
+}
+
+void StateCache::BindSampler(GLuint unit, GLuint sampler)
+{
+    TouchTextureUnit(unit);
+
+    if (unit >= TrackedTextureUnits)
+    {
+        glBindSampler(unit, sampler);
+        m_statistics.issuedCalls++;
+        return;
+    }
+
+    if (NeedsUpdate(m_textureUnits[unit].sampler, sampler))
+    {
+        glBindSampler(unit, sampler);
+        m_textureUnits[unit].sampler = sampler;
+    }
+}
+
+void StateCache::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    bool const read = target != GL_DRAW_FRAMEBUFFER;
+    bool const draw = target != GL_READ_FRAMEBUFFER;
+
+    std::array<GLuint, 2> const bound{read ? m_readFramebuffer : framebuffer,
+                                      draw ? m_drawFramebuffer : framebuffer};
+    if (NeedsUpdate(bound, {framebuffer, framebuffer}))
+    {
+        glBindFramebuffer(target, framebuffer);
+        if (read)
+        {
+            m_readFramebuffer = framebuffer;
+        }
+        if (draw)
+        {
+            m_drawFramebuffer = framebuffer;
+        }
+    }
+}
+
+void StateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    std::array<GLint, 4> const viewport{x, y, width, height};
+    if (NeedsUpdate(m_viewport, viewport))
+    {
+        glViewport(x, y, width, height);
+        m_viewport = viewport;
+    }
+}
+
+void StateCache::SetBlend(bool enabled)
+{
+    GLuint const blend = enabled ? 1 : 0;
+    if (NeedsUpdate(m_blend, blend))
+    {
+        if (enabled)
+        {
+            glEnable(GL_BLEND);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+        }
+        m_blend = blend;
+    }
+}
+
+void StateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+    std::array<GLenum, 2> const blendFunc{sourceFactor, destinationFactor};
+    if (NeedsUpdate(m_blendFunc, blendFunc))
+    {
+        glBlendFunc(sourceFactor, destinationFactor);
+        m_blendFunc = blendFunc;
+    }
+}
+
+void StateCache::ProgramDeleted(GLuint program)
+{
+    // A deleted program stays in use until another one is installed, but its ID may be reused.
+    if (m_program == program)
+    {
+        m_program = Unknown;
+    }
+}
+
+void StateCache::VertexArrayDeleted(GLuint vertexArray)
+{
+    if (m_vertexArray == vertexArray)
+    {
+        m_vertexArray = 0;
+    }
+}
+
+void StateCache::TextureDeleted(GLuint texture)
+{
+    for (auto& unit : m_textureUnits)
+    {
+        if (unit.texture2D == texture)
+        {
+            unit.texture2D = 0;
+        }
+        if (unit.texture3D == texture)
+        {
+            unit.texture3D = 0;
+        }
+    }
+}
+
+void StateCache::SamplerDeleted(GLuint sampler)
+{
+    for (auto& unit : m_textureUnits)
+    {
+        if (unit.sampler == sampler)
+        {
+            unit.sampler = 0;
+        }
+    }
+}
+
+void StateCache::FramebuffersDeleted(GLsizei count, const GLuint* framebuffers)
+{
+    for (GLsizei index = 0; index < count; index++)
+    {
+        if (m_readFramebuffer == framebuffers[index])
+        {
+            m_readFramebuffer = 0;
+        }
+        if (m_drawFramebuffer == framebuffers[index])
+        {
+            m_drawFramebuffer = 0;
+        }
+    }
+}
+
+void StateCache::InvalidateTextureBindings()
+{
+    m_activeTexture = Unknown;
+    m_textureUnits.fill({});
+}
+
+void StateCache::Invalidate()
+{
+    m_program = Unknown;
+    m_vertexArray = Unknown;
+    m_readFramebuffer = Unknown;
+    m_drawFramebuffer = Unknown;
+    m_viewport = {-1, -1, -1, -1};
+    m_blend = Unknown;
+    m_blendFunc = {Unknown, Unknown};
+    InvalidateTextureBindings();
+}
+
+auto StateCache::GetStatistics() const -> Statistics
+{
+    return m_statistics;
+}
+
+void StateCache::ResetStatistics()
+{
+    m_statistics = {};
+}
+
+void StateCache::ActiveTexture(GLuint unit)
+{
+    if (NeedsUpdate(m_activeTexture, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeTexture = unit;
+    }
+}
+
+void StateCache::TouchTextureUnit(GLuint unit)
+{
+    if (!m_active)
+    {
+        return;
+    }
+
+    if (unit < TrackedTextureUnits)
+    {
+        auto const unitBit = uint32_t{1} << unit;
+        if ((m_touchedTextureUnits & unitBit) != 0)
+        {
+            return;
+        }
+        m_touchedTextureUnits |= unitBit;
+    }
+    else if (m_hostTextureUnits.find(unit) != m_hostTextureUnits.end())
+    {
+        return;
+    }
+
+    TextureUnit hostUnit{0, 0, 0};
+    if (m_saveHostState)
+    {
+        // The bindings can only be queried for the active unit.
+        ActiveTexture(unit);
+
+        GLint texture2D{};
+        GLint texture3D{};
+        GLint sampler{};
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture2D);
+        glGetIntegerv(GL_TEXTURE_BINDING_3D, &texture3D);
+        glGetIntegerv(GL_SAMPLER_BINDING, &sampler);
+        hostUnit = {static_cast<GLuint>(texture2D), static_cast<GLuint>(texture3D), static_cast<GLuint>(sampler)};
+
+        if (unit < TrackedTextureUnits)
+        {
+            m_textureUnits[unit] = hostUnit;
+        }
+    }
+
+    m_hostTextureUnits.emplace(unit, hostUnit);
+}
+
+template<typename T>
+auto StateCache::NeedsUpdate(const T& cachedValue, const T& newValue) -> bool
+{
+    if (m_active && cachedValue == newValue)
+    {
+        m_statistics.filteredCalls++;
+        return false;
+    }
+
+    m_statistics.issuedCalls++;
+    return true;
+}
+
+} // namespace Renderer
+} // namespace libprojectM
@@ -0,0 +1,290 @@
+/**
+* @file StateCache.hpp
+* @brief Defines a class which filters redundant OpenGL state changes.
+*/
+#pragma once
+
+#include <projectM-opengl.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+
+namespace libprojectM {
+namespace Renderer {
+
+/**
+ * @brief Tracks the bound OpenGL objects and a few fixed-function states to skip redundant calls.
+ *
+ * Render items bind their shader, vertex array, textures and blend state for each draw call,
+ * and previously reset everything afterwards. Most of these calls don't change anything, but
+ * still cost driver time. All of projectM's state changes go through the current cache, which
+ * only calls into OpenGL if the value actually changes.
+ *
+ * Each projectM instance owns a cache. Tracking is only active between Begin() and End(), which
+ * are called at the start and end of each rendered frame. Outside a frame, e.g. while loading
+ * presets, Current() returns a pass-through cache which always calls OpenGL.
+ *
+ * By default, the cache doesn't query any state. It assumes the host application uses OpenGL's
+ * default state for everything projectM changes, and End() resets the program, vertex array,
+ * blend state and the texture and sampler bindings of every unit used during the frame to these
+ * defaults. The framebuffer and viewport are left as projectM set them for the final image. If
+ * the host needs its own state back, SetSaveHostState() makes Begin() read it and End() restore
+ * it, including framebuffers and viewport. Texture units are then read the first time projectM
+ * uses them in a frame, so the cost is a few glGet calls per frame.
+ *
+ * Code calling OpenGL functions tracked here directly, e.g. third-party texture loaders, must
+ * call the matching Invalidate function afterwards. Deleting a bound object must be reported
+ * with the matching *Deleted() function, as OpenGL resets the binding in this case.
+ */
+class StateCache
+{
+public:
+    /**
+     * @brief Call counters for profiling.
+     */
+    struct Statistics
+    {
+        uint64_t issuedCalls{};   //!< Number of state changes passed to OpenGL.
+        uint64_t filteredCalls{}; //!< Number of state changes skipped because the state was already set.
+    };
+
+    /**
+     * @brief Calls Begin() on construction and End() when leaving the scope.
+     */
+    class ScopedFrame
+    {
+    public:
+        explicit ScopedFrame(StateCache& stateCache);
+        ~ScopedFrame();
+
+        ScopedFrame(const ScopedFrame&) = delete;
+        auto operator=(const ScopedFrame&) -> ScopedFrame& = delete;
+
+    private:
+        StateCache& m_stateCache; //!< The cache used for the frame.
+    };
+
+    static constexpr GLuint TrackedTextureUnits{32}; //!< Texture units tracked by the cache. Higher units are always set.
+
+    StateCache() = default;
+
+    StateCache(const StateCache&) = delete;
+    auto operator=(const StateCache&) -> StateCache& = delete;
+
+    /**
+     * @brief Returns the cache of the frame currently rendered on this thread.
+     * @return The active cache, or a pass-through cache if no frame is being rendered.
+     */
+    static auto Current() -> StateCache&;
+
+    /**
+     * @brief Sets whether the host application's state is read and restored in each frame.
+     * @param saveHostState True to restore the host's state after each frame, false to reset
+     *                      the changed state to OpenGL's defaults.
+     */
+    void SetSaveHostState(bool saveHostState);
+
+    /**
+     * @brief Returns whether the host application's state is read and restored in each frame.
+     * @return True if the host's state is restored, false if OpenGL's defaults are used.
+     */
+    auto SaveHostState() const -> bool;
+
+    /**
+     * @brief Makes this cache the current one, saving the host application's state if enabled.
+     */
+    void Begin();
+
+    /**
+     * @brief Restores the host's state, or OpenGL's defaults, and stops tracking.
+     *
+     * The texture and sampler bindings are restored on every unit used since Begin().
+     */
+    void End();
+
+    /**
+     * @brief Calls glUseProgram() if the program isn't already in use.
+     * @param program The shader program ID, or 0 to unbind the current program.
+     */
+    void UseProgram(GLuint program);
+
+    /**
+     * @brief Calls glBindVertexArray() if the vertex array isn't already bound.
+     * @param vertexArray The vertex array ID, or 0 to unbind the current vertex array.
+     */
+    void BindVertexArray(GLuint vertexArray);
+
+    /**
+     * @brief Binds a texture to the given unit if it isn't already bound.
+     *
+     * The unit is made active in any case, so the texture can be modified afterwards.
+     *
+     * @param unit The texture unit, starting at 0.
+     * @param target The texture target, GL_TEXTURE_2D or GL_TEXTURE_3D.
+     * @param texture The texture ID, or 0 to unbind the current texture.
+     */
+    void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    /**
+     * @brief Calls glBindSampler() if the sampler isn't already bound to the unit.
+     * @param unit The texture unit, starting at 0.
+     * @param sampler The sampler ID, or 0 to unbind the current sampler.
+     */
+    void BindSampler(GLuint unit, GLuint sampler);
+
+    /**
+     * @brief Binds a framebuffer if it isn't already bound.
+     * @param target GL_FRAMEBUFFER, GL_READ_FRAMEBUFFER or GL_DRAW_FRAMEBUFFER.
+     * @param framebuffer The framebuffer ID, or 0 for the default framebuffer.
+     */
+    void BindFramebuffer(GLenum target, GLuint framebuffer);
+
+    /**
+     * @brief Calls glViewport() if the viewport differs from the current one.
+     * @param x Left edge in pixels.
+     * @param y Bottom edge in pixels.
+     * @param width Width in pixels.
+     * @param height Height in pixels.
+     */
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    /**
+     * @brief Enables or disables GL_BLEND if needed.
+     * @param enabled True to enable blending, false to disable it.
+     */
+    void SetBlend(bool enabled);
+
+    /**
+     * @brief Calls glBlendFunc() if the blend function differs from the current one.
+     * @param sourceFactor The source blend factor.
+     * @param destinationFactor The destination blend factor.
+     */
+    void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+
+    /**
+     * @brief Reports a deleted shader program.
+     * @param program The deleted program ID.
+     */
+    void ProgramDeleted(GLuint program);
+
+    /**
+     * @brief Reports a deleted vertex array.
+     * @param vertexArray The deleted vertex array ID.
+     */
+    void VertexArrayDeleted(GLuint vertexArray);
+
+    /**
+     * @brief Reports a deleted texture.
+     * @param texture The deleted texture ID.
+     */
+    void TextureDeleted(GLuint texture);
+
+    /**
+     * @brief Reports a deleted sampler.
+     * @param sampler The deleted sampler ID.
+     */
+    void SamplerDeleted(GLuint sampler);
+
+    /**
+     * @brief Reports deleted framebuffers.
+     * @param count Number of IDs in the list.
+     * @param framebuffers The deleted framebuffer IDs.
+     */
+    void FramebuffersDeleted(GLsizei count, const GLuint* framebuffers);
+
+    /**
+     * @brief Forgets the texture bindings and active texture unit, e.g. after loading textures with SOIL.
+     */
+    void InvalidateTextureBindings();
+
+    /**
+     * @brief Forgets all tracked state.
+     */
+    void Invalidate();
+
+    /**
+     * @brief Returns the call counters.
+     * @return A copy of the counters.
+     */
+    auto GetStatistics() const -> Statistics;
+
+    /**
+     * @brief Resets the call counters to zero.
+     */
+    void ResetStatistics();
+
+private:
+    static constexpr GLuint Unknown{0xFFFFFFFFu}; //!< Marks a state value as unknown.
+
+    /**
+     * @brief Bindings of a single texture unit.
+     */
+    struct TextureUnit
+    {
+        GLuint texture2D{Unknown}; //!< Bound GL_TEXTURE_2D texture.
+        GLuint texture3D{Unknown}; //!< Bound GL_TEXTURE_3D texture.
+        GLuint sampler{Unknown};   //!< Bound sampler.
+    };
+
+    /**
+     * @brief The host application's state, saved at the start of a frame.
+     *
+     * The default values are OpenGL's initial state. Texture bindings are saved per unit in
+     * m_hostTextureUnits.
+     */
+    struct HostState
+    {
+        GLint program{};
+        GLint vertexArray{};
+        GLint activeTexture{GL_TEXTURE0};
+        GLint readFramebuffer{};
+        GLint drawFramebuffer{};
+        std::array<GLint, 4> viewport{};
+        GLboolean blend{GL_FALSE};
+        std::array<GLint, 4> blendFunc{GL_ONE, GL_ZERO, GL_ONE, GL_ZERO}; //!< Source RGB, destination RGB, source alpha, destination alpha.
+    };
+
+    /**
+     * @brief Makes the given unit active if needed.
+     * @param unit The texture unit, starting at 0.
+     */
+    void ActiveTexture(GLuint unit);
+
+    /**
+     * @brief Remembers that a texture unit is used in this frame, saving the host's bindings if enabled.
+     * @param unit The texture unit, starting at 0.
+     */
+    void TouchTextureUnit(GLuint unit);
+
+    /**
+     * @brief Updates the counters and returns whether a call changing the value is needed.
+     * @param cachedValue The cached value.
+     * @param newValue The requested value.
+     * @return True if the call must be issued.
+     */
+    template<typename T>
+    auto NeedsUpdate(const T& cachedValue, const T& newValue) -> bool;
+
+    bool m_active{false};                                //!< True between Begin() and End().
+    bool m_saveHostState{false};                         //!< If true, the host's state is read in Begin() and restored in End().
+    StateCache* m_previousCache{nullptr};                //!< The cache current before Begin() was called.
+    HostState m_hostState;                               //!< The state saved in Begin().
+    std::map<GLuint, TextureUnit> m_hostTextureUnits;    //!< Host bindings of the texture units used in the current frame.
+    uint32_t m_touchedTextureUnits{};                    //!< Bit mask of the tracked texture units in m_hostTextureUnits.
+
+    GLuint m_program{Unknown};                                 //!< Program in use.
+    GLuint m_vertexArray{Unknown};                             //!< Bound vertex array.
+    GLuint m_activeTexture{Unknown};                           //!< Active texture unit, starting at 0.
+    std::array<TextureUnit, TrackedTextureUnits> m_textureUnits; //!< Texture and sampler bindings per unit.
+    GLuint m_readFramebuffer{Unknown};                         //!< Bound read framebuffer.
+    GLuint m_drawFramebuffer{Unknown};                         //!< Bound draw framebuffer.
+    std::array<GLint, 4> m_viewport{-1, -1, -1, -1};           //!< Current viewport.
+    GLuint m_blend{Unknown};                                   //!< GL_BLEND state, 0 or 1.
+    std::array<GLenum, 2> m_blendFunc{Unknown, Unknown};       //!< Current source and destination blend factors.
+
+    Statistics m_statistics; //!< Call counters.
+};
+
+} // namespace Renderer
+} // namespace libprojectM
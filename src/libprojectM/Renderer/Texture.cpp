@@ -1,5 +1,7 @@
 #include "Renderer/Texture.hpp"
 
+#include "Renderer/StateCache.hpp"
+
 #include <utility>
 
 namespace libprojectM {
@@ -47,6 +49,7 @@ Texture::~Texture()
 {
     if (m_textureId > 0)
     {
+        StateCache::Current().TextureDeleted(m_textureId);
         glDeleteTextures(1, &m_textureId);
         m_textureId = 0;
     }
@@ -54,8 +57,7 @@ Texture::~Texture()
 
 void Texture::Bind(GLint slot, const Sampler::Ptr& sampler) const
 {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(m_target, m_textureId);
+    StateCache::Current().BindTexture(slot, m_target, m_textureId);
 
     if (sampler)
     {
@@ -65,8 +67,7 @@ void Texture::Bind(GLint slot, const Sampler::Ptr& sampler) const
 
 void Texture::Unbind(GLint slot) const
 {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(m_target, 0);
+    StateCache::Current().BindTexture(slot, m_target, 0);
 }
 
 auto Texture::TextureID() const -> GLuint
@@ -107,9 +108,9 @@ auto Texture::Empty() const -> bool
 void Texture::CreateNewTexture()
 {
     glGenTextures(1, &m_textureId);
-    glBindTexture(m_target, m_textureId);
+    StateCache::Current().BindTexture(0, m_target, m_textureId);
     glTexImage2D(m_target, 0, m_internalFormat, m_width, m_height, 0, m_format, m_type, nullptr);
-    glBindTexture(m_target, 0);
+    StateCache::Current().BindTexture(0, m_target, 0);
 }
 
 } // namespace Renderer
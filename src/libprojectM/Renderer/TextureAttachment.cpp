@@ -1,5 +1,7 @@
 #include "TextureAttachment.hpp"
 
+#include "StateCache.hpp"
+
 // OpenGL ES might not define this constant in its headers, e.g. in the iOS and Emscripten SDKs.
 #ifndef GL_STENCIL_INDEX
 #define GL_STENCIL_INDEX 0x1901
@@ -108,7 +110,7 @@ void TextureAttachment::ReplaceTexture(int width, int height)
 
     GLuint textureId;
     glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    StateCache::Current().BindTexture(0, GL_TEXTURE_2D, textureId);
     glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, textureFormat, pixelFormat, nullptr);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -116,7 +118,7 @@ void TextureAttachment::ReplaceTexture(int width, int height)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache::Current().BindTexture(0, GL_TEXTURE_2D, 0);
 
     m_texture = std::make_shared<class Texture>("", textureId, GL_TEXTURE_2D, width, height, false);
 }
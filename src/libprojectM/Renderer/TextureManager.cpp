@@ -3,6 +3,7 @@
 #include "FileScanner.hpp"
 #include "IdleTextures.hpp"
 #include "MilkdropNoise.hpp"
+#include "StateCache.hpp"
 #include "Texture.hpp"
 #include "Utils.hpp"
 
@@ -10,6 +11,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <vector>
 
@@ -25,6 +27,16 @@
 namespace libprojectM {
 namespace Renderer {
 
+namespace {
+
+/**
+ * SOIL keeps its error string and the queried GL capabilities in globals. Images loaded by
+ * several projectM instances at once must be decoded one at a time.
+ */
+std::mutex soilMutex;
+
+} // namespace
+
 TextureManager::TextureManager(const std::vector<std::string>& textureSearchPaths)
     : m_textureSearchPaths(textureSearchPaths)
     , m_placeholderTexture(std::make_shared<Texture>("placeholder", 1, 1, false))
@@ -73,6 +85,8 @@ void TextureManager::Preload()
     int width{};
     int height{};
 
+    std::unique_lock<std::mutex> soilLock(soilMutex);
+
     unsigned int tex = SOIL_load_OGL_texture_from_memory(
         M_data,
         M_bytes,
@@ -91,6 +105,11 @@ void TextureManager::Preload()
 
     m_textures["idleheadphones"] = std::make_shared<Texture>("idleheadphones", tex, GL_TEXTURE_2D, width, height, false);;
 
+    soilLock.unlock();
+
+    // SOIL binds the new textures directly.
+    StateCache::Current().InvalidateTextureBindings();
+
     // Noise textures
     m_textures["noise_lq_lite"] = MilkdropNoise::LowQualityLite();
     m_textures["noise_lq"] = MilkdropNoise::LowQuality();
@@ -213,11 +232,36 @@ auto TextureManager::LoadTexture(const ScannedFile& file) -> std::shared_ptr<Tex
     int width{};
     int height{};
 
-    unsigned int const tex = SOIL_load_OGL_texture(
-        file.filePath.c_str(),
-        SOIL_LOAD_RGBA,
-        SOIL_CREATE_NEW_ID,
-        SOIL_FLAG_MULTIPLY_ALPHA, &width, &height);
+    unsigned int tex{};
+    if (file.pack != nullptr)
+    {
+        // Decode the image directly from the mapped pack file.
+        std::vector<char> buffer;
+        auto const memberData = file.pack->Read(file.memberIndex, buffer);
+        if (memberData.data == nullptr)
+        {
+            return {};
+        }
+
+        std::lock_guard<std::mutex> soilLock(soilMutex);
+        tex = SOIL_load_OGL_texture_from_memory(
+            reinterpret_cast<const unsigned char*>(memberData.data),
+            static_cast<unsigned int>(memberData.size),
+            SOIL_LOAD_RGBA,
+            SOIL_CREATE_NEW_ID,
+            SOIL_FLAG_MULTIPLY_ALPHA, &width, &height);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> soilLock(soilMutex);
+        tex = SOIL_load_OGL_texture(
+            file.filePath.c_str(),
+            SOIL_LOAD_RGBA,
+            SOIL_CREATE_NEW_ID,
+            SOIL_FLAG_MULTIPLY_ALPHA, &width, &height);
+    }
+
+    StateCache::Current().InvalidateTextureBindings();
 
     if (tex == 0)
     {
@@ -302,6 +346,45 @@ void TextureManager::AddTextureFile(const std::string& fileName, const std::stri
     m_scannedTextureFiles.push_back(std::move(file));
 }
 
+void TextureManager::ScanTexturePack(const std::string& packFile)
+{
+    auto& pack = m_packs[packFile];
+    if (!pack)
+    {
+        pack = std::make_unique<PackArchive>();
+        if (!pack->Open(packFile))
+        {
+#ifdef DEBUG
+            std::cerr << "Failed to open texture pack " << packFile << std::endl;
+#endif
+            // Try again on the next scan.
+            m_packs.erase(packFile);
+            return;
+        }
+    }
+
+    for (size_t index = 0; index < pack->MemberCount(); index++)
+    {
+        auto const memberName = pack->MemberName(index);
+        auto const separator = memberName.find_last_of('/');
+        auto const fileName = separator == std::string::npos ? memberName : memberName.substr(separator + 1);
+        auto const extension = fileName.find_last_of('.');
+        if (extension == std::string::npos || extension == 0 ||
+            std::find(m_extensions.begin(), m_extensions.end(), Utils::ToLower(fileName.substr(extension))) == m_extensions.end())
+        {
+            continue;
+        }
+
+        ScannedFile file;
+        file.filePath = packFile + "/" + memberName;
+        file.lowerCaseBaseName = Utils::ToLower(fileName.substr(0, extension));
+        file.pack = pack.get();
+        file.memberIndex = index;
+
+        m_scannedTextureFiles.push_back(std::move(file));
+    }
+}
+
 void TextureManager::ExtractTextureSettings(const std::string& qualifiedName, GLint& wrapMode, GLint& filterMode, std::string& name)
 {
     if (qualifiedName.length() <= 3 || qualifiedName.at(2) != '_')
@@ -354,10 +437,20 @@ void TextureManager::ScanTextures()
 {
     if (!m_filesScanned)
     {
-        FileScanner fileScanner = FileScanner(m_textureSearchPaths, m_extensions);
-
         using namespace std::placeholders;
-        fileScanner.Scan(std::bind(&TextureManager::AddTextureFile, this, _1, _2));
+
+        // Scan each path separately to keep the search order if packs and directories are mixed.
+        for (const auto& searchPath : m_textureSearchPaths)
+        {
+            if (PackArchive::IsPackFileName(searchPath))
+            {
+                ScanTexturePack(searchPath);
+                continue;
+            }
+
+            FileScanner fileScanner = FileScanner({searchPath}, m_extensions);
+            fileScanner.Scan(std::bind(&TextureManager::AddTextureFile, this, _1, _2));
+        }
         m_filesScanned = true;
     }
 }
@@ -2,7 +2,10 @@
 
 #include "Renderer/TextureSamplerDescriptor.hpp"
 
+#include <PackArchive.hpp>
+
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,6 +20,7 @@ public:
     /**
      * Constructor.
      * @param textureSearchPaths List of paths to search for textures. These paths are searched in the given order.
+     *                           Paths to pack files are searched for texture members in the pack.
      */
     TextureManager(const std::vector<std::string>& textureSearchPaths);
 
@@ -71,11 +75,13 @@ private:
     };
 
     /**
-     * A scanned texture file on the disk.
+     * A scanned texture file on the disk or in a pack.
      */
     struct ScannedFile {
         std::string filePath;          //!< Full path to the texture file
         std::string lowerCaseBaseName; //!< Texture base file name, lower case.
+        const PackArchive* pack{};     //!< The pack containing the texture, or nullptr for regular files.
+        size_t memberIndex{};          //!< Index of the texture in the pack.
     };
 
     auto TryLoadingTexture(const std::string& name) -> TextureSamplerDescriptor;
@@ -86,14 +92,22 @@ private:
 
     void AddTextureFile(const std::string& fileName, const std::string& baseName);
 
+    /**
+     * @brief Adds all textures stored in a pack file to the scanned file list.
+     * The pack is opened on first use and stays mapped until the texture manager is destroyed.
+     * @param packFile The pack file name.
+     */
+    void ScanTexturePack(const std::string& packFile);
+
     static void ExtractTextureSettings(const std::string& qualifiedName, GLint& wrapMode, GLint& filterMode, std::string& name);
 
     void ScanTextures();
 
-    std::vector<std::string> m_textureSearchPaths;  //!< Search paths to scan for textures.
-    std::string m_currentPresetDir;                 //!< Path of the current preset to add to the search list.
-    std::vector<ScannedFile> m_scannedTextureFiles; //!< The cached list with scanned texture files.
-    bool m_filesScanned{false};                     //!< true if files were scanned since last preset load.
+    std::vector<std::string> m_textureSearchPaths;               //!< Search paths to scan for textures.
+    std::string m_currentPresetDir;                              //!< Path of the current preset to add to the search list.
+    std::vector<ScannedFile> m_scannedTextureFiles;              //!< The cached list with scanned texture files.
+    bool m_filesScanned{false};                                  //!< true if files were scanned since last preset load.
+    std::map<std::string, std::unique_ptr<PackArchive>> m_packs; //!< Opened texture packs, indexed by file name.
 
     std::shared_ptr<Texture> m_placeholderTexture;                          //!< Texture used if a requested file couldn't be found. A black 1x1 texture.
     std::map<std::string, std::shared_ptr<Texture>> m_textures;             //!< All loaded textures, including generated ones.
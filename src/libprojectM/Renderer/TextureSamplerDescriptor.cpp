@@ -83,8 +83,25 @@ auto TextureSamplerDescriptor::SamplerDeclaration() const -> std::string
         return {};
     }
 
+    return SamplerDeclaration(m_samplerName, texture->Type() == GL_TEXTURE_3D);
+}
+
+auto TextureSamplerDescriptor::TexSizeDeclaration() const -> std::string
+{
+    auto texture = m_texture.lock();
+    auto sampler = m_sampler.lock();
+    if (!texture || !sampler)
+    {
+        return {};
+    }
+
+    return TexSizeDeclaration(m_sizeName);
+}
+
+auto TextureSamplerDescriptor::SamplerDeclaration(const std::string& samplerName, bool volumeTexture) -> std::string
+{
     std::string declaration = "uniform ";
-    if (texture->Type() == GL_TEXTURE_3D)
+    if (volumeTexture)
     {
         declaration.append("sampler3D sampler_");
     }
@@ -92,34 +109,27 @@ auto TextureSamplerDescriptor::SamplerDeclaration() const -> std::string
     {
         declaration.append("sampler2D sampler_");
     }
-    declaration.append(m_samplerName);
+    declaration.append(samplerName);
     declaration.append(";\n");
 
     return declaration;
 }
 
-auto TextureSamplerDescriptor::TexSizeDeclaration() const -> std::string
+auto TextureSamplerDescriptor::TexSizeDeclaration(const std::string& sizeName) -> std::string
 {
-    auto texture = m_texture.lock();
-    auto sampler = m_sampler.lock();
-    if (!texture || !sampler)
-    {
-        return {};
-    }
-
     std::string declaration;
-    if (!m_sizeName.empty())
+    if (!sizeName.empty())
     {
         declaration.append("uniform float4 texsize_");
-        declaration.append(m_sizeName);
+        declaration.append(sizeName);
         declaration.append(";\n");
 
         // Add short texsize uniform for prefixed random textures.
         // E.g. "texsize_rand00" if a sampler "sampler_rand00_smalltiled" was declared
-        if (m_sizeName.substr(0, 4) == "rand" && m_sizeName.length() > 7 && m_sizeName.at(6) == '_')
+        if (sizeName.substr(0, 4) == "rand" && sizeName.length() > 7 && sizeName.at(6) == '_')
         {
             declaration.append("uniform float4 texsize_");
-            declaration.append(m_sizeName.substr(0, 6));
+            declaration.append(sizeName.substr(0, 6));
             declaration.append(";\n");
         }
     }
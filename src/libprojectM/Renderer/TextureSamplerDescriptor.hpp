@@ -89,6 +89,22 @@ public:
      */
     auto TexSizeDeclaration() const -> std::string;
 
+    /**
+     * @brief Returns the shader sampler HLSL declaration for a sampler name.
+     * Also used to predict the declarations without loading the texture, e.g. for preset bundles.
+     * @param samplerName The name of the sampler as referenced in the shader, e.g. "mytex_pw".
+     * @param volumeTexture True if the texture is a 3D texture.
+     * @return The sampler declaration for use in the preset HLSL shaders.
+     */
+    static auto SamplerDeclaration(const std::string& samplerName, bool volumeTexture) -> std::string;
+
+    /**
+     * @brief Returns the shader texsize HLSL declaration for a texsize uniform name.
+     * @param sizeName The name of the "texsize_" uniform, e.g. "mytex".
+     * @return The texsize declaration for use in the preset HLSL shaders, or an empty string if the name is empty.
+     */
+    static auto TexSizeDeclaration(const std::string& sizeName) -> std::string;
+
     /**
      * @brief Tries to update the texture and sampler from the given texture manager if invalid.
      * @param textureManager The texture manager to retrieve the new data from.
@@ -2,30 +2,56 @@
 
 #include "BuiltInTransitionsResources.hpp"
 
-#include <iostream>
+#include <algorithm>
 
 namespace libprojectM {
 namespace Renderer {
 
 TransitionShaderManager::TransitionShaderManager()
-    : m_transitionShaders({CompileTransitionShader(kTransitionShaderBuiltInCircleGlsl330),
-                           CompileTransitionShader(kTransitionShaderBuiltInPlasmaGlsl330),
-                           CompileTransitionShader(kTransitionShaderBuiltInSimpleBlendGlsl330),
-                           CompileTransitionShader(kTransitionShaderBuiltInSweepGlsl330),
-                           CompileTransitionShader(kTransitionShaderBuiltInWarpGlsl330),
-                           CompileTransitionShader(kTransitionShaderBuiltInZoomBlurGlsl330)})
-    , m_mersenneTwister(m_randomDevice())
+    : m_mersenneTwister(m_randomDevice())
 {
+    for (const auto& shaderBodyCode : {kTransitionShaderBuiltInCircleGlsl330,
+                                       kTransitionShaderBuiltInPlasmaGlsl330,
+                                       kTransitionShaderBuiltInSimpleBlendGlsl330,
+                                       kTransitionShaderBuiltInSweepGlsl330,
+                                       kTransitionShaderBuiltInWarpGlsl330,
+                                       kTransitionShaderBuiltInZoomBlurGlsl330})
+    {
+        m_transitionShaders.push_back(CompileTransitionShader(shaderBodyCode));
+    }
+}
+
+auto TransitionShaderManager::IsCompilationComplete() const -> bool
+{
+    return std::all_of(m_transitionShaders.begin(), m_transitionShaders.end(), [](const std::shared_ptr<Shader>& shader) {
+        return shader->IsCompilationComplete();
+    });
 }
 
 auto TransitionShaderManager::RandomTransition() -> std::shared_ptr<Shader>
 {
+    // Drop all shaders which failed to compile, so they're never selected.
+    m_transitionShaders.erase(std::remove_if(m_transitionShaders.begin(), m_transitionShaders.end(), [](const std::shared_ptr<Shader>& shader) {
+                                  try
+                                  {
+                                      shader->FinishCompilation();
+                                      return false;
+                                  }
+                                  catch (const ShaderException&)
+                                  {
+                                      // ToDo: Log proper shader compile error once logging API is in place
+                                      return true;
+                                  }
+                              }),
+                              m_transitionShaders.end());
+
     if (m_transitionShaders.empty())
     {
         return {};
     }
 
-    return m_transitionShaders.at(m_mersenneTwister() % m_transitionShaders.size());
+    auto const index = m_mersenneTwister() % m_transitionShaders.size();
+    return m_transitionShaders.at(index);
 }
 
 auto TransitionShaderManager::CompileTransitionShader(const std::string& shaderBodyCode) -> std::shared_ptr<Shader>
@@ -44,17 +70,10 @@ auto TransitionShaderManager::CompileTransitionShader(const std::string& shaderB
     fragmentShaderSource.append("\n");
     fragmentShaderSource.append(kTransitionShaderMainGlsl330);
 
-    try
-    {
-        auto transitionShader = std::make_shared<Shader>();
-        transitionShader->CompileProgram(static_cast<const char*>(versionHeader) + kTransitionVertexShaderGlsl330, fragmentShaderSource);
-        return transitionShader;
-    }
-    catch (const ShaderException&)
-    {
-        // ToDo: Log proper shader compile error once logging API is in place
-        return {};
-    }
+    // Errors are reported by FinishCompilation() when a transition is selected.
+    auto transitionShader = std::make_shared<Shader>();
+    transitionShader->CompileProgramAsync(static_cast<const char*>(versionHeader) + kTransitionVertexShaderGlsl330, fragmentShaderSource);
+    return transitionShader;
 }
 
 } // namespace Renderer
@@ -9,26 +9,39 @@ namespace Renderer {
 
 /**
  * @brief Manages all available transition shaders.
+ *
+ * All shaders start compiling on construction without waiting for the driver. Shaders which
+ * fail to compile are removed from the list when their result is checked.
  */
 class TransitionShaderManager
 {
 public:
     TransitionShaderManager();
 
+    /**
+     * @brief Returns whether all transition shaders have finished compiling.
+     *
+     * RandomTransition() won't wait for the driver if this returns true.
+     * @return true if no shader compilation is still in progress.
+     */
+    auto IsCompilationComplete() const -> bool;
+
     /**
      * @brief Selects a random transition shader from the list.
-     * @return A shared pointer to a transition shader.
+     *
+     * Waits for any pending compilations and removes shaders which failed to compile first.
+     * @return A shared pointer to a transition shader, or an empty pointer if none is available.
      */
     auto RandomTransition() -> std::shared_ptr<Shader>;
 
 private:
     /**
-     * @brief Compiles a single transition shader program.
+     * @brief Starts compiling a single transition shader program.
      * @param shaderBodyCode The mainImage() fragment shader code, without any headers etc.
      */
     static auto CompileTransitionShader(const std::string& shaderBodyCode) -> std::shared_ptr<Shader>;
 
-    std::vector<std::shared_ptr<Shader>> m_transitionShaders; //!< Currently loaded and compiled transition shaders.
+    std::vector<std::shared_ptr<Shader>> m_transitionShaders; //!< All usable transition shaders.
 
     std::random_device m_randomDevice; //!< Seed for the random number generator
     std::mt19937 m_mersenneTwister; //!< Random engine to select shader
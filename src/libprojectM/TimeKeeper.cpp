@@ -84,14 +84,14 @@ double TimeKeeper::GetRunningTime()
     return m_currentTime;
 }
 
-double TimeKeeper::PresetProgressA()
+double TimeKeeper::PresetProgressA(double secondsAhead)
 {
     if (m_isSmoothing)
     {
         return 1.0;
     }
 
-    return std::min((m_currentTime - m_presetTimeA) / m_presetDurationA, 1.0);
+    return std::min((m_currentTime + secondsAhead - m_presetTimeA) / m_presetDurationA, 1.0);
 }
 
 double TimeKeeper::PresetProgressB()
@@ -46,7 +46,12 @@ public:
 
     double GetRunningTime();
 
-    double PresetProgressA();
+    /**
+     * @brief Returns the progress of the active preset.
+     * @param secondsAhead Time after the current frame to calculate the progress for.
+     * @return The progress between 0.0 and 1.0, or 1.0 while smoothing.
+     */
+    double PresetProgressA(double secondsAhead = 0.0);
 
     double PresetProgressB();
 
@@ -2,6 +2,9 @@
 
 #include <algorithm>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
 namespace libprojectM {
 namespace Utils {
 
@@ -29,5 +32,34 @@ void ToUpperInPlace(std::string& str)
     std::transform(str.begin(), str.end(), str.begin(), ::toupper);
 }
 
+auto Fnv1aHash(const void* data, size_t size, uint64_t hash) -> uint64_t
+{
+    auto const* bytes = static_cast<const unsigned char*>(data);
+    for (size_t index = 0; index < size; index++)
+    {
+        hash ^= bytes[index];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+auto GetFileInfo(const std::string& fileName, uint64_t& size, int64_t& modificationTime) -> bool
+{
+#ifdef _WIN32
+    struct _stat64 fileStatus{};
+    if (_stat64(fileName.c_str(), &fileStatus) != 0)
+#else
+    struct stat fileStatus{};
+    if (stat(fileName.c_str(), &fileStatus) != 0)
+#endif
+    {
+        return false;
+    }
+
+    size = static_cast<uint64_t>(fileStatus.st_size);
+    modificationTime = static_cast<int64_t>(fileStatus.st_mtime);
+    return true;
+}
+
 } // namespace Utils
 } // namespace libprojectM
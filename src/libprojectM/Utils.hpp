@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace libprojectM {
@@ -11,5 +13,25 @@ auto ToUpper(const std::string& str) -> std::string;
 void ToLowerInPlace(std::string& str);
 void ToUpperInPlace(std::string& str);
 
+constexpr uint64_t Fnv1aOffsetBasis{0xcbf29ce484222325ull}; //!< Initial value of a 64-bit FNV-1a hash.
+
+/**
+ * @brief Calculates the 64-bit FNV-1a hash of the given data.
+ * @param data The data to hash.
+ * @param size The number of bytes to hash.
+ * @param hash The hash of previous data to continue from, or Fnv1aOffsetBasis to start a new hash.
+ * @return The hash value.
+ */
+auto Fnv1aHash(const void* data, size_t size, uint64_t hash = Fnv1aOffsetBasis) -> uint64_t;
+
+/**
+ * @brief Returns the size and modification time of a file without reading it.
+ * @param fileName The file name.
+ * @param[out] size The file size in bytes.
+ * @param[out] modificationTime The time of the last modification, in seconds since the epoch.
+ * @return True if the file exists, false otherwise.
+ */
+auto GetFileInfo(const std::string& fileName, uint64_t& size, int64_t& modificationTime) -> bool;
+
 } // namespace Utils
 } // namespace libprojectM
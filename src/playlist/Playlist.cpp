@@ -1,6 +1,10 @@
 #include "Playlist.hpp"
 
+#include <projectM-4/core.h>
+#include <projectM-4/memory.h>
+
 #include <algorithm>
+#include <cctype>
 
 // Fall back to boost if compiler doesn't support C++17
 #include PROJECTM_FILESYSTEM_INCLUDE
@@ -9,6 +13,30 @@ using namespace PROJECTM_FILESYSTEM_NAMESPACE::filesystem;
 namespace libprojectM {
 namespace Playlist {
 
+namespace {
+
+/**
+ * @brief Returns whether the given path has the preset pack file extension.
+ * @param filename The path to check.
+ * @return True if the file is a preset pack.
+ */
+auto IsPresetPack(const std::string& filename) -> bool
+{
+    static const std::string packExtension{".milkpack"};
+
+    if (filename.length() <= packExtension.length())
+    {
+        return false;
+    }
+
+    return std::equal(packExtension.begin(), packExtension.end(), filename.end() - packExtension.length(),
+                      [](char extensionCharacter, char filenameCharacter) {
+                          return extensionCharacter == std::tolower(static_cast<unsigned char>(filenameCharacter));
+                      });
+}
+
+} // namespace
+
 const char* PlaylistEmptyException::what() const noexcept
 {
     return "Playlist is empty";
@@ -84,6 +112,34 @@ auto Playlist::AddPath(const std::string& path, uint32_t index, bool recursive,
     uint32_t presetsAdded{0};
 
     m_presetHistory.clear();
+
+    // The pack index is read by libprojectM, which also loads the presets from the pack.
+    if (IsPresetPack(path))
+    {
+        auto* presetFiles = projectm_get_pack_preset_files(path.c_str());
+        if (presetFiles == nullptr)
+        {
+            return presetsAdded;
+        }
+
+        for (size_t fileIndex = 0; presetFiles[fileIndex] != nullptr; fileIndex++)
+        {
+            uint32_t currentIndex{InsertAtEnd};
+            if (index < InsertAtEnd)
+            {
+                currentIndex = index + presetsAdded;
+            }
+            if (AddItem(presetFiles[fileIndex], currentIndex, allowDuplicates))
+            {
+                presetsAdded++;
+            }
+        }
+
+        projectm_free_string_array(presetFiles);
+
+        return presetsAdded;
+    }
+
     if (recursive)
     {
         try
@@ -122,6 +122,8 @@ public:
      * The order of the added files is unspecified. Use the Sort() method to sort the playlist or
      * the newly added range.
      *
+     * If the path is a preset pack file, all presets in the pack are added instead.
+     *
      * @param path The path to scan for preset files.
      * @param index The index to insert the files at. If larger than the playlist size, it's added
 *                   to the end of the playlist.
@@ -83,6 +83,9 @@ PROJECTM_PLAYLIST_EXPORT char* projectm_playlist_item(projectm_playlist_handle i
  *
  * Symbolic links are not followed.
  *
+ * If the path is a preset pack file (".milkpack"), all presets stored in the pack are added
+ * instead. The subdirectory setting is ignored in this case.
+ *
  * @param instance The playlist manager instance.
  * @param path A local filesystem path to scan for presets.
  * @param recurse_subdirs If true, subdirectories of the given path will also be scanned. If false,
@@ -103,6 +106,9 @@ PROJECTM_PLAYLIST_EXPORT uint32_t projectm_playlist_add_path(projectm_playlist_h
  *
  * Symbolic links are not followed.
  *
+ * If the path is a preset pack file (".milkpack"), all presets stored in the pack are added
+ * instead. The subdirectory setting is ignored in this case.
+ *
  * @param instance The playlist manager instance.
  * @param path A local filesystem path to scan for presets.
  * @param index The index to insert the presets at. If it exceeds the playlist size, the presets are
@@ -0,0 +1,229 @@
+/**
+ * @file BuildPresetPack.cpp
+ * @brief Command line tool to pack preset and texture directories into a single pack file.
+ *
+ * All presets, preset bundles and textures found in the given directories are added to the pack,
+ * named by their path relative to the directory they were found in. projectM maps the pack into
+ * memory and loads presets and textures directly from it, which avoids scanning large preset
+ * libraries and opening each file separately.
+ *
+ * Optionally, each preset is also stored as a precompiled bundle and text files are compressed.
+ */
+
+#include <MilkdropPreset/PresetBundle.hpp>
+#include <PackArchive.hpp>
+#include <PackArchiveWriter.hpp>
+#include <Utils.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Fall back to boost if compiler doesn't support C++17
+#include PROJECTM_FILESYSTEM_INCLUDE
+using namespace PROJECTM_FILESYSTEM_NAMESPACE::filesystem;
+
+using libprojectM::PackArchive;
+using libprojectM::PackArchiveWriter;
+using libprojectM::MilkdropPreset::PresetBundle;
+
+namespace {
+
+const std::vector<std::string> presetExtensions{".milk", ".prjm", ".milkb"};
+const std::vector<std::string> textureExtensions{".jpg", ".jpeg", ".dds", ".png", ".tga", ".bmp", ".dib"};
+
+void PrintUsage(const char* programName)
+{
+    std::cerr << "Usage: " << programName << " [-c] [-b] -o <output" << PackArchive::FileExtension << "> <directory> [<directory> ...]" << std::endl
+              << std::endl
+              << "  -c  Compress presets and other compressible files with LZ4." << std::endl
+              << "  -b  Also store each .milk file as a precompiled preset bundle." << std::endl;
+}
+
+/**
+ * @brief Reads a whole file.
+ * @param fileName The file name.
+ * @param data Receives the file contents.
+ * @return True if the file was read, false if an error occurred.
+ */
+auto ReadFile(const std::string& fileName, std::string& data) -> bool
+{
+    std::ifstream fileStream(fileName.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!fileStream.good())
+    {
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>());
+
+    return !fileStream.bad();
+}
+
+/**
+ * @brief Adds all presets and textures in a directory to the pack.
+ * @param writer The pack writer.
+ * @param directory The directory to scan recursively.
+ * @param buildBundles If true, a bundle is added for each .milk file.
+ * @param memberCount Incremented for each added member.
+ * @return True if all files were added, false if an error occurred.
+ */
+auto AddDirectory(PackArchiveWriter& writer, const std::string& directory, bool buildBundles, size_t& memberCount) -> bool
+{
+    bool success{true};
+    path const basePath(directory);
+
+    try
+    {
+        for (const auto& entry : recursive_directory_iterator(basePath))
+        {
+            if (!is_regular_file(entry.path()))
+            {
+                continue;
+            }
+
+            auto const extension = libprojectM::Utils::ToLower(entry.path().extension().string());
+            bool const isPreset = std::find(presetExtensions.begin(), presetExtensions.end(), extension) != presetExtensions.end();
+            bool const isTexture = std::find(textureExtensions.begin(), textureExtensions.end(), extension) != textureExtensions.end();
+            if (!isPreset && !isTexture)
+            {
+                continue;
+            }
+
+            auto const fileName = entry.path().string();
+            auto const memberName = relative(entry.path(), basePath).generic_string();
+
+            std::string data;
+            if (!ReadFile(fileName, data))
+            {
+                std::cerr << fileName << ": Could not read file." << std::endl;
+                success = false;
+                continue;
+            }
+
+            if (!writer.Add(memberName, data))
+            {
+                std::cerr << fileName << ": Could not add file to pack." << std::endl;
+                return false;
+            }
+            memberCount++;
+
+            if (!buildBundles || extension != ".milk")
+            {
+                continue;
+            }
+
+            // A bundle which already exists next to the preset is added by the directory scan.
+            if (exists(path(fileName + "b")))
+            {
+                continue;
+            }
+
+            PresetBundle bundle;
+            if (!bundle.Build(data))
+            {
+                std::cerr << fileName << ": Not a valid preset file, bundle not added." << std::endl;
+                continue;
+            }
+
+            if (!writer.Add(memberName + "b", bundle.Serialize()))
+            {
+                std::cerr << fileName << ": Could not add bundle to pack." << std::endl;
+                return false;
+            }
+            memberCount++;
+        }
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << directory << ": " << ex.what() << std::endl;
+        return false;
+    }
+
+    return success;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string packFile;
+    std::vector<std::string> directories;
+    bool compress{false};
+    bool buildBundles{false};
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string const argument = argv[arg];
+        if (argument == "-o")
+        {
+            if (arg + 1 >= argc)
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            packFile = argv[++arg];
+            continue;
+        }
+
+        if (argument == "-c")
+        {
+            compress = true;
+            continue;
+        }
+
+        if (argument == "-b")
+        {
+            buildBundles = true;
+            continue;
+        }
+
+        if (argument == "-h" || argument == "--help")
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+
+        directories.push_back(argument);
+    }
+
+    if (packFile.empty() || directories.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (!PackArchive::IsPackFileName(packFile))
+    {
+        std::cerr << packFile << ": Pack files must have the " << PackArchive::FileExtension << " extension to be recognized by projectM." << std::endl;
+        return 1;
+    }
+
+    std::ofstream packStream(packFile.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!packStream.good())
+    {
+        std::cerr << packFile << ": Could not create file." << std::endl;
+        return 2;
+    }
+
+    PackArchiveWriter writer(packStream, compress);
+    size_t memberCount{0};
+    bool success{true};
+
+    for (const auto& directory : directories)
+    {
+        success = AddDirectory(writer, directory, buildBundles, memberCount) && success;
+    }
+
+    if (!writer.Finish())
+    {
+        std::cerr << packFile << ": Could not write pack. Make sure no two files have the same relative path." << std::endl;
+        return 2;
+    }
+
+    std::cout << packFile << ": " << memberCount << " files" << std::endl;
+
+    return success ? 0 : 2;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file BundlePresets.cpp
+ * @brief Command line tool to convert Milkdrop presets into precompiled preset bundles.
+ *
+ * Each .milk file is written as a .milkb file next to it, or into the given output directory.
+ * The bundles contain the parsed preset values, the assembled code and the preset shaders
+ * translated to GLSL, so projectM can load them without parsing and translating the preset.
+ *
+ * No OpenGL context is required.
+ */
+
+#include <MilkdropPreset/PresetBundle.hpp>
+
+#include <Utils.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using libprojectM::MilkdropPreset::PresetBundle;
+
+namespace {
+
+void PrintUsage(const char* programName)
+{
+    std::cerr << "Usage: " << programName << " [-o <output directory>] <preset.milk> [<preset.milk> ...]" << std::endl;
+}
+
+/**
+ * @brief Returns the bundle file name for the given preset.
+ * @param presetFile The preset file name.
+ * @param outputDirectory The output directory, or an empty string to write the bundle next to the preset.
+ * @return The bundle file name.
+ */
+auto BundleFileName(const std::string& presetFile, const std::string& outputDirectory) -> std::string
+{
+    auto baseName = presetFile;
+    auto const extension = baseName.find_last_of('.');
+    auto const separator = baseName.find_last_of("/\\");
+    if (extension != std::string::npos && (separator == std::string::npos || extension > separator))
+    {
+        baseName.resize(extension);
+    }
+
+    if (outputDirectory.empty())
+    {
+        return baseName + PresetBundle::FileExtension;
+    }
+
+    if (separator != std::string::npos)
+    {
+        baseName.erase(0, separator + 1);
+    }
+
+    return outputDirectory + "/" + baseName + PresetBundle::FileExtension;
+}
+
+/**
+ * @brief Builds and writes the bundle for a single preset.
+ * @param presetFile The preset file name.
+ * @param outputDirectory The output directory, or an empty string to write the bundle next to the preset.
+ * @return True if the bundle was written, false if an error occurred.
+ */
+auto BundlePreset(const std::string& presetFile, const std::string& outputDirectory) -> bool
+{
+    std::ifstream presetStream(presetFile.c_str(), std::ios_base::in | std::ios_base::binary);
+    std::string const presetData{std::istreambuf_iterator<char>(presetStream), std::istreambuf_iterator<char>()};
+    if (presetStream.bad() || presetData.empty())
+    {
+        std::cerr << presetFile << ": Could not read file." << std::endl;
+        return false;
+    }
+
+    // Lets projectM check the bundle against the preset without reading the preset again.
+    uint64_t presetSize{};
+    int64_t modificationTime{};
+    libprojectM::Utils::GetFileInfo(presetFile, presetSize, modificationTime);
+
+    PresetBundle bundle;
+    if (!bundle.Build(presetData, modificationTime))
+    {
+        std::cerr << presetFile << ": Not a valid preset file." << std::endl;
+        return false;
+    }
+
+    auto const bundleFile = BundleFileName(presetFile, outputDirectory);
+    auto const bundleData = bundle.Serialize();
+
+    std::ofstream bundleStream(bundleFile.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    bundleStream.write(bundleData.data(), static_cast<std::streamsize>(bundleData.size()));
+    if (!bundleStream.good())
+    {
+        std::cerr << bundleFile << ": Could not write file." << std::endl;
+        return false;
+    }
+
+    std::cout << bundleFile << ": " << bundle.Shaders().size() << " precompiled shaders";
+    if (!bundle.TextureNames().empty())
+    {
+        std::cout << ", textures:";
+        for (const auto& textureName : bundle.TextureNames())
+        {
+            std::cout << " " << textureName;
+        }
+    }
+    std::cout << std::endl;
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string outputDirectory;
+    int presetCount{0};
+    int failedCount{0};
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string const argument = argv[arg];
+        if (argument == "-o")
+        {
+            if (arg + 1 >= argc)
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            outputDirectory = argv[++arg];
+            continue;
+        }
+
+        if (argument == "-h" || argument == "--help")
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+
+        presetCount++;
+        if (!BundlePreset(argument, outputDirectory))
+        {
+            failedCount++;
+        }
+    }
+
+    if (presetCount == 0)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    return failedCount == 0 ? 0 : 2;
+}
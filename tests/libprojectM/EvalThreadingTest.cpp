@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <projectm-eval.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Touches many different megabuf/gmegabuf blocks to force allocations in each iteration.
+constexpr auto memoryHeavyCode = "i = 0;"
+                                 "loop(1024, megabuf(i * 64) = i + seed; gmegabuf(i * 128) = i * seed; i += 1);"
+                                 "result = megabuf(1023 * 64) + gmegabuf(1023 * 128);";
+
+/**
+ * Runs the memory-heavy code in a new, independent evaluation context, like a projectM instance.
+ * @return The final value of the result variable, or 0 if the code didn't compile.
+ */
+auto RunIndependentContext(double seedValue, int iterations) -> double
+{
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto* globalMemory = projectm_eval_memory_buffer_create();
+    auto* context = projectm_eval_context_create(globalMemory, &globalRegisters);
+
+    auto* seed = projectm_eval_context_register_variable(context, "seed");
+    auto* result = projectm_eval_context_register_variable(context, "result");
+
+    double finalResult{};
+    auto* codeHandle = projectm_eval_code_compile(context, memoryHeavyCode);
+    if (codeHandle != nullptr)
+    {
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            projectm_eval_context_reset_variables(context);
+            *seed = static_cast<PRJM_EVAL_F>(seedValue);
+            projectm_eval_code_execute(codeHandle);
+        }
+
+        finalResult = *result;
+        projectm_eval_code_destroy(codeHandle);
+    }
+
+    projectm_eval_context_destroy(context);
+    projectm_eval_memory_buffer_destroy(globalMemory);
+
+    return finalResult;
+}
+
+} // namespace
+
+/**
+ * Runs memory-heavy expression code in several independent evaluation contexts concurrently,
+ * mimicking multiple projectM instances rendering presets on separate threads. Build with
+ * -fsanitize=thread to check the host memory mutex implementation for data races.
+ */
+TEST(EvalThreading, ConcurrentIndependentContexts)
+{
+    static constexpr int threadCount = 8;
+    static constexpr int iterations = 200;
+
+    std::array<double, threadCount> results{};
+    std::vector<std::thread> threads;
+
+    for (int threadIndex = 0; threadIndex < threadCount; threadIndex++)
+    {
+        threads.emplace_back([threadIndex, &results]() {
+            results[threadIndex] = RunIndependentContext(threadIndex + 1, iterations);
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (int threadIndex = 0; threadIndex < threadCount; threadIndex++)
+    {
+        auto const seed = static_cast<double>(threadIndex + 1);
+        EXPECT_DOUBLE_EQ(results[threadIndex], (1023.0 + seed) + (1023.0 * seed));
+    }
+}
+
+/**
+ * Measures how the memory-heavy code scales with the number of threads, each using its own
+ * context. All memory buffer accesses take the process-wide host mutex, so this shows the cost
+ * of that lock. Disabled by default, run with
+ * --gtest_also_run_disabled_tests --gtest_filter=EvalThreading.DISABLED_ThroughputScaling
+ */
+TEST(EvalThreading, DISABLED_ThroughputScaling)
+{
+    static constexpr int iterations = 2000;
+
+    auto const maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    double singleThreadRate{};
+
+    for (unsigned int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+    {
+        std::vector<std::thread> threads;
+        auto const start = std::chrono::steady_clock::now();
+        for (unsigned int threadIndex = 0; threadIndex < threadCount; threadIndex++)
+        {
+            threads.emplace_back([threadIndex]() {
+                RunIndependentContext(threadIndex + 1, iterations);
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+
+        auto const rate = threadCount * iterations / elapsed.count();
+        if (threadCount == 1)
+        {
+            singleThreadRate = rate;
+        }
+
+        std::cout << threadCount << " threads: " << static_cast<int>(rate) << " executions/s, "
+                  << static_cast<int>(100.0 * rate / (threadCount * singleThreadRate)) << "% scaling efficiency" << std::endl;
+    }
+}
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/ExpressionEngine.hpp>
+#include <MilkdropPreset/PresetFileParser.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+static constexpr auto expressionEngineTestDataPath{PROJECTM_TEST_DATA_DIR "/ExpressionEngine/"};
+
+using libprojectM::MilkdropPreset::ExpressionEngine;
+using libprojectM::MilkdropPreset::PresetFileParser;
+
+namespace {
+
+constexpr int conformanceFrames{120};
+constexpr int conformanceGridSize{8};
+
+/**
+ * Runs the per-frame and per-pixel code of a preset file with the given engine for a number
+ * of frames, feeding deterministic input values. Returns all relevant variable values after
+ * each execution, in execution order.
+ */
+auto RunPreset(ExpressionEngine& engine, const std::string& presetFile) -> std::vector<PRJM_EVAL_F>
+{
+    PresetFileParser parser;
+    EXPECT_TRUE(parser.Read(std::string(expressionEngineTestDataPath) + presetFile));
+
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto globalMemory = engine.CreateMemoryBuffer();
+    auto perFrameContext = engine.CreateContext(*globalMemory, &globalRegisters);
+    auto perPixelContext = engine.CreateContext(*globalMemory, &globalRegisters);
+
+    auto* time = perFrameContext->RegisterVariable("time");
+    auto* frame = perFrameContext->RegisterVariable("frame");
+    auto* bass = perFrameContext->RegisterVariable("bass");
+    auto* zoom = perFrameContext->RegisterVariable("zoom");
+    auto* rot = perFrameContext->RegisterVariable("rot");
+
+    std::vector<PRJM_EVAL_F*> qVars;
+    std::vector<PRJM_EVAL_F*> pixelQVars;
+    for (int q = 1; q <= 4; q++)
+    {
+        qVars.push_back(perFrameContext->RegisterVariable("q" + std::to_string(q)));
+        pixelQVars.push_back(perPixelContext->RegisterVariable("q" + std::to_string(q)));
+    }
+
+    auto* pixelTime = perPixelContext->RegisterVariable("time");
+    auto* x = perPixelContext->RegisterVariable("x");
+    auto* y = perPixelContext->RegisterVariable("y");
+    auto* rad = perPixelContext->RegisterVariable("rad");
+    auto* ang = perPixelContext->RegisterVariable("ang");
+    std::vector<PRJM_EVAL_F*> pixelOutputs;
+    for (const auto* name : {"zoom", "rot", "dx", "dy", "sx", "sy"})
+    {
+        pixelOutputs.push_back(perPixelContext->RegisterVariable(name));
+    }
+
+    auto initCode = perFrameContext->Compile(parser.GetCode("per_frame_init_"));
+    auto perFrameCode = perFrameContext->Compile(parser.GetCode("per_frame_"));
+    auto perPixelCode = perPixelContext->Compile(parser.GetCode("per_pixel_"));
+
+    EXPECT_TRUE(initCode);
+    EXPECT_TRUE(perFrameCode);
+    EXPECT_TRUE(perPixelCode);
+    if (!initCode || !perFrameCode || !perPixelCode)
+    {
+        return {};
+    }
+
+    std::vector<PRJM_EVAL_F> trace;
+
+    initCode->Execute();
+
+    for (int frameIndex = 0; frameIndex < conformanceFrames; frameIndex++)
+    {
+        *time = frameIndex / 60.0;
+        *frame = frameIndex;
+        *bass = 1.0 + std::sin(frameIndex * 0.37);
+        *zoom = 1.0;
+        *rot = 0.0;
+
+        perFrameCode->Execute();
+
+        trace.push_back(*zoom);
+        trace.push_back(*rot);
+        for (size_t q = 0; q < qVars.size(); q++)
+        {
+            trace.push_back(*qVars[q]);
+            *pixelQVars[q] = *qVars[q];
+        }
+        trace.push_back(globalRegisters[0]);
+
+        *pixelTime = *time;
+
+        // Batch execution stores single precision results, so run each vertex separately to keep the full precision.
+        for (int vertex = 0; vertex < conformanceGridSize * conformanceGridSize; vertex++)
+        {
+            *x = static_cast<PRJM_EVAL_F>(vertex % conformanceGridSize) / (conformanceGridSize - 1);
+            *y = static_cast<PRJM_EVAL_F>(vertex / conformanceGridSize) / (conformanceGridSize - 1);
+            *rad = std::hypot(*x - 0.5, *y - 0.5);
+            *ang = std::atan2(*y - 0.5, *x - 0.5);
+            *pixelOutputs[0] = *zoom;
+            *pixelOutputs[1] = *rot;
+            *pixelOutputs[2] = 0.0;
+            *pixelOutputs[3] = 0.0;
+            *pixelOutputs[4] = 1.0;
+            *pixelOutputs[5] = 1.0;
+
+            perPixelCode->Execute();
+
+            for (const auto* output : pixelOutputs)
+            {
+                trace.push_back(*output);
+            }
+        }
+
+        trace.push_back(globalRegisters[1]);
+    }
+
+    return trace;
+}
+
+/**
+ * Compares the variable outputs of all available engines against the default engine.
+ */
+void CheckConformance(const std::string& presetFile)
+{
+    auto const& engines = ExpressionEngine::Available();
+    ASSERT_FALSE(engines.empty());
+
+    auto const reference = RunPreset(*engines.front(), presetFile);
+    ASSERT_FALSE(reference.empty());
+
+    for (auto* engine : engines)
+    {
+        SCOPED_TRACE(engine->Name());
+
+        auto const result = RunPreset(*engine, presetFile);
+        ASSERT_EQ(result.size(), reference.size());
+
+        for (size_t index = 0; index < reference.size(); index++)
+        {
+            ASSERT_NEAR(result[index], reference[index], 1e-9 * std::max(1.0, std::abs(reference[index])))
+                << "Value " << index << " differs from the " << engines.front()->Name() << " result.";
+        }
+    }
+}
+
+} // namespace
+
+TEST(ExpressionEngine, DefaultIsFirstAvailable)
+{
+    auto const& engines = ExpressionEngine::Available();
+    ASSERT_FALSE(engines.empty());
+    EXPECT_EQ(&ExpressionEngine::Default(), engines.front());
+    EXPECT_FALSE(ExpressionEngine::Default().Name().empty());
+}
+
+TEST(ExpressionEngine, ExecutesCode)
+{
+    for (auto* engine : ExpressionEngine::Available())
+    {
+        SCOPED_TRACE(engine->Name());
+
+        PRJM_EVAL_F globalRegisters[100]{};
+        auto globalMemory = engine->CreateMemoryBuffer();
+        auto context = engine->CreateContext(*globalMemory, &globalRegisters);
+
+        auto* input = context->RegisterVariable("input");
+        auto* output = context->RegisterVariable("output");
+        EXPECT_EQ(context->RegisterVariable("input"), input);
+
+        auto program = context->Compile("output = input * 2 + 1; reg42 = output;");
+        ASSERT_TRUE(program);
+
+        *input = 20.0;
+        program->Execute();
+
+        EXPECT_DOUBLE_EQ(*output, 41.0);
+        EXPECT_DOUBLE_EQ(globalRegisters[42], 41.0);
+    }
+}
+
+TEST(ExpressionEngine, ReportsCompileErrors)
+{
+    for (auto* engine : ExpressionEngine::Available())
+    {
+        SCOPED_TRACE(engine->Name());
+
+        PRJM_EVAL_F globalRegisters[100]{};
+        auto globalMemory = engine->CreateMemoryBuffer();
+        auto context = engine->CreateContext(*globalMemory, &globalRegisters);
+
+        EXPECT_FALSE(context->Compile("x = (1 + ;"));
+
+        int line{};
+        int column{};
+        EXPECT_FALSE(context->LastError(line, column).empty());
+    }
+}
+
+TEST(ExpressionEngine, ExecuteBatchRunsInOrder)
+{
+    for (auto* engine : ExpressionEngine::Available())
+    {
+        SCOPED_TRACE(engine->Name());
+
+        PRJM_EVAL_F globalRegisters[100]{};
+        auto globalMemory = engine->CreateMemoryBuffer();
+        auto context = engine->CreateContext(*globalMemory, &globalRegisters);
+
+        auto* value = context->RegisterVariable("value");
+        auto* sum = context->RegisterVariable("sum");
+
+        auto* offset = context->RegisterVariable("offset");
+
+        auto program = context->Compile("sum = sum + value + offset; value = sum * 10;");
+        ASSERT_TRUE(program);
+
+        // Interleaved input and output values, like in a vertex array.
+        struct Item
+        {
+            PRJM_EVAL_F value;
+            float result;
+        };
+        std::vector<Item> items{{0.0, -1.0f}, {1.0, -1.0f}, {2.0, -1.0f}, {3.0, -1.0f}, {4.0, -1.0f}};
+        PRJM_EVAL_F const offsetValue{0.5};
+
+        program->ExecuteBatch(
+            items.size(),
+            {{value, &items[0].value, sizeof(Item)}, {offset, &offsetValue, 0}},
+            {{value, &items[0].result, sizeof(Item)}});
+
+        std::vector<float> results;
+        for (const auto& item : items)
+        {
+            results.push_back(item.result);
+        }
+        EXPECT_EQ(results, (std::vector<float>{5.0f, 20.0f, 45.0f, 80.0f, 125.0f}));
+        EXPECT_DOUBLE_EQ(*sum, 12.5);
+    }
+}
+
+TEST(ExpressionEngine, ConformanceMath)
+{
+    CheckConformance("conformance-math.milk");
+}
+
+TEST(ExpressionEngine, ConformanceMemory)
+{
+    CheckConformance("conformance-memory.milk");
+}
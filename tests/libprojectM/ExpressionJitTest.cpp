@@ -0,0 +1,547 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/ExpressionCache.hpp>
+#include <MilkdropPreset/ExpressionJit.hpp>
+#include <MilkdropPreset/ExpressionParser.hpp>
+#include <MilkdropPreset/JitExpressionEngine.hpp>
+#include <MilkdropPreset/PresetFileParser.hpp>
+
+#include <Renderer/FileScanner.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using libprojectM::MilkdropPreset::ExpressionCache;
+using libprojectM::MilkdropPreset::ExpressionEngine;
+using libprojectM::MilkdropPreset::ExpressionJit;
+using libprojectM::MilkdropPreset::ExpressionParser;
+using libprojectM::MilkdropPreset::JitExpressionEngine;
+using libprojectM::MilkdropPreset::PresetFileParser;
+
+namespace {
+
+/**
+ * Compiles and runs code with the JIT, using a simple map for variable storage.
+ */
+class JitRunner
+{
+public:
+    auto Compile(const std::string& code) -> std::unique_ptr<ExpressionJit::NativeCode>
+    {
+        return ExpressionJit::Compile(code, [this](const std::string& name) {
+            return &m_variables[name];
+        });
+    }
+
+    auto Run(const std::string& code) -> PRJM_EVAL_F
+    {
+        auto nativeCode = Compile(code);
+        EXPECT_TRUE(nativeCode) << code;
+        if (!nativeCode)
+        {
+            return 0.0;
+        }
+        return nativeCode->Execute();
+    }
+
+    auto operator[](const std::string& name) -> PRJM_EVAL_F&
+    {
+        return m_variables[name];
+    }
+
+private:
+    std::map<std::string, PRJM_EVAL_F> m_variables;
+};
+
+/**
+ * Returns the bundled test presets, sorted by name.
+ */
+auto PresetFiles() -> std::vector<std::string>
+{
+    std::vector<std::string> extensions{".milk"};
+    libprojectM::Renderer::FileScanner scanner({PROJECTM_TEST_PRESETS_DIR}, extensions);
+
+    std::set<std::string> presetFiles;
+    scanner.Scan([&presetFiles](const std::string& path, const std::string&) {
+        presetFiles.insert(path);
+    });
+    return {presetFiles.begin(), presetFiles.end()};
+}
+
+/**
+ * Returns the key prefixes of all expression code blocks in a preset.
+ */
+auto CodeBlockPrefixes() -> std::vector<std::string>
+{
+    std::vector<std::string> prefixes{"per_frame_init_", "per_frame_", "per_pixel_"};
+    for (int index = 0; index < 4; index++)
+    {
+        for (const auto& suffix : {"init", "per_frame", "per_point"})
+        {
+            prefixes.push_back("wave_" + std::to_string(index) + "_" + suffix);
+        }
+        for (const auto& suffix : {"init", "per_frame"})
+        {
+            prefixes.push_back("shape_" + std::to_string(index) + "_" + suffix);
+        }
+    }
+    return prefixes;
+}
+
+/**
+ * Collects the variable names used in a syntax tree and whether it calls rand().
+ */
+void CollectVariables(const ExpressionParser::Node& node, std::set<std::string>& variables, bool& random)
+{
+    if (node.type == ExpressionParser::Node::Type::Variable)
+    {
+        variables.insert(node.name);
+    }
+    if (node.type == ExpressionParser::Node::Type::Call && node.name == "rand")
+    {
+        random = true;
+    }
+    for (const auto& argument : node.arguments)
+    {
+        CollectVariables(*argument, variables, random);
+    }
+}
+
+/**
+ * Runs code a few times with the given engine, starting with seeded variables.
+ * Returns the final variable values, or an empty map if the code doesn't compile.
+ */
+auto RunWithEngine(const std::string& engineName, const std::string& code,
+                   const std::set<std::string>& variables) -> std::map<std::string, PRJM_EVAL_F>
+{
+    auto* engine = ExpressionEngine::Find(engineName);
+    EXPECT_NE(engine, nullptr) << engineName;
+    if (engine == nullptr)
+    {
+        return {};
+    }
+
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto globalMemory = engine->CreateMemoryBuffer();
+    auto context = engine->CreateContext(*globalMemory, &globalRegisters);
+
+    std::map<std::string, PRJM_EVAL_F*> pointers;
+    int seed{1};
+    for (const auto& name : variables)
+    {
+        pointers[name] = context->RegisterVariable(name);
+        *pointers[name] = 0.37 * seed++;
+    }
+
+    auto program = context->Compile(code);
+    if (!program)
+    {
+        return {};
+    }
+
+    for (int run = 0; run < 3; run++)
+    {
+        program->Execute();
+    }
+
+    std::map<std::string, PRJM_EVAL_F> result;
+    for (const auto& pointer : pointers)
+    {
+        result[pointer.first] = *pointer.second;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(ExpressionJit, Arithmetic)
+{
+    if (!ExpressionJit::Supported())
+    {
+        GTEST_SKIP() << "Expression JIT not supported on this platform.";
+    }
+
+    JitRunner jit;
+    jit["x"] = 3.0;
+
+    EXPECT_DOUBLE_EQ(jit.Run("y = x * 2 + 1; y - 0.5"), 6.5);
+    EXPECT_DOUBLE_EQ(jit["y"], 7.0);
+    EXPECT_DOUBLE_EQ(jit.Run("-x * -(2 - .5)"), 4.5);
+    EXPECT_DOUBLE_EQ(jit.Run("y += 3; y *= 2; y -= 1; y /= 2"), 9.5);
+    EXPECT_DOUBLE_EQ(jit.Run("Y / 0"), 0.0);
+    EXPECT_DOUBLE_EQ(jit.Run("$PI"), 3.141592653589793);
+    EXPECT_DOUBLE_EQ(jit.Run(""), 0.0);
+}
+
+TEST(ExpressionJit, Functions)
+{
+    if (!ExpressionJit::Supported())
+    {
+        GTEST_SKIP() << "Expression JIT not supported on this platform.";
+    }
+
+    JitRunner jit;
+
+    EXPECT_DOUBLE_EQ(jit.Run("sin(1) + cos(2)"), std::sin(1.0) + std::cos(2.0));
+    EXPECT_DOUBLE_EQ(jit.Run("atan2(1, -2)"), std::atan2(1.0, -2.0));
+    EXPECT_DOUBLE_EQ(jit.Run("sqrt(-16)"), 4.0);
+    EXPECT_DOUBLE_EQ(jit.Run("min(3, max(1, 2))"), 2.0);
+    EXPECT_DOUBLE_EQ(jit.Run("sign(-0.3) + sqr(3) + abs(-1)"), 9.0);
+    EXPECT_DOUBLE_EQ(jit.Run("pow(2, 10)"), 1024.0);
+    EXPECT_DOUBLE_EQ(jit.Run("exec2(a = 4, a * 2)"), 8.0);
+}
+
+TEST(ExpressionJit, Logic)
+{
+    if (!ExpressionJit::Supported())
+    {
+        GTEST_SKIP() << "Expression JIT not supported on this platform.";
+    }
+
+    JitRunner jit;
+
+    EXPECT_DOUBLE_EQ(jit.Run("equal(1, 1.000001)"), 1.0);
+    EXPECT_DOUBLE_EQ(jit.Run("1 == 1.001"), 0.0);
+    EXPECT_DOUBLE_EQ(jit.Run("1 != 1.001"), 1.0);
+    EXPECT_DOUBLE_EQ(jit.Run("above(2, 1) + below(2, 1) + (1 <= 1) + (2 >= 3)"), 2.0);
+    EXPECT_DOUBLE_EQ(jit.Run("!0.5 + bnot(0)"), 1.0);
+    EXPECT_DOUBLE_EQ(jit.Run("if(0.2, 5, 6) + (0 ? 1 : 2)"), 7.0);
+
+    jit["b"] = 0.0;
+    EXPECT_DOUBLE_EQ(jit.Run("0 && (b = 1)"), 0.0);
+    EXPECT_DOUBLE_EQ(jit["b"], 0.0);
+    EXPECT_DOUBLE_EQ(jit.Run("1 || (b = 1)"), 1.0);
+    EXPECT_DOUBLE_EQ(jit["b"], 0.0);
+    EXPECT_DOUBLE_EQ(jit.Run("band(3, 2) + bor(0, 0)"), 1.0);
+
+    EXPECT_DOUBLE_EQ(jit.Run("if(1, c = 1, d = 1); c + d"), 1.0);
+}
+
+TEST(ExpressionJit, UnsupportedCodeFails)
+{
+    JitRunner jit;
+
+    EXPECT_FALSE(jit.Compile("megabuf(1) = 2"));
+    EXPECT_FALSE(jit.Compile("x = rand(10)"));
+    EXPECT_FALSE(jit.Compile("x = 2 ^ 3"));
+    EXPECT_FALSE(jit.Compile("x = 5 % 3"));
+    EXPECT_FALSE(jit.Compile("loop(3, x += 1)"));
+    EXPECT_FALSE(jit.Compile("x = 1e3"));
+    EXPECT_FALSE(jit.Compile("x = (1 + ;"));
+    EXPECT_FALSE(jit.Compile("1 = x"));
+    EXPECT_FALSE(jit.Compile(std::string(10000, '(') + "1" + std::string(10000, ')')));
+}
+
+TEST(ExpressionJit, EngineUsesNativeCode)
+{
+    auto* engine = dynamic_cast<JitExpressionEngine*>(ExpressionEngine::Find("native-jit"));
+    ASSERT_NE(engine, nullptr);
+
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto globalMemory = engine->CreateMemoryBuffer();
+    auto context = engine->CreateContext(*globalMemory, &globalRegisters);
+
+    auto* x = context->RegisterVariable("x");
+
+    auto const nativeBefore = engine->NativePrograms();
+    auto const fallbackBefore = engine->FallbackPrograms();
+
+    auto nativeProgram = context->Compile("reg07 = x * 2;");
+    auto fallbackProgram = context->Compile("megabuf(0) = x; x = megabuf(0) + 1;");
+    ASSERT_TRUE(nativeProgram);
+    ASSERT_TRUE(fallbackProgram);
+
+    if (ExpressionJit::Supported())
+    {
+        EXPECT_EQ(engine->NativePrograms(), nativeBefore + 1);
+        EXPECT_EQ(engine->FallbackPrograms(), fallbackBefore + 1);
+    }
+    else
+    {
+        EXPECT_EQ(engine->FallbackPrograms(), fallbackBefore + 2);
+    }
+
+    *x = 4.0;
+    nativeProgram->Execute();
+    fallbackProgram->Execute();
+
+    EXPECT_DOUBLE_EQ(globalRegisters[7], 8.0);
+    EXPECT_DOUBLE_EQ(*x, 5.0);
+}
+
+TEST(ExpressionJit, TemplateInstances)
+{
+    if (!ExpressionJit::Supported())
+    {
+        GTEST_SKIP() << "Expression JIT not supported on this platform.";
+    }
+
+    auto compiledTemplate = ExpressionJit::CompileTemplate("y = X * 2 + y;");
+    ASSERT_TRUE(compiledTemplate);
+    EXPECT_EQ(compiledTemplate->Variables(), (std::vector<std::string>{"y", "x"}));
+
+    JitRunner first;
+    JitRunner second;
+    first["x"] = 1.0;
+    second["x"] = 10.0;
+    second["y"] = 1.0;
+
+    auto firstCode = compiledTemplate->Instantiate([&first](const std::string& name) { return &first[name]; });
+    auto secondCode = compiledTemplate->Instantiate([&second](const std::string& name) { return &second[name]; });
+    ASSERT_TRUE(firstCode);
+    ASSERT_TRUE(secondCode);
+
+    firstCode->Execute();
+    secondCode->Execute();
+
+    EXPECT_DOUBLE_EQ(first["y"], 2.0);
+    EXPECT_DOUBLE_EQ(second["y"], 21.0);
+
+    EXPECT_FALSE(compiledTemplate->Instantiate([](const std::string&) { return nullptr; }));
+}
+
+TEST(ExpressionJit, MatchesProjectMEvalOnTestPresets)
+{
+    auto const prefixes = CodeBlockPrefixes();
+    auto const nativeBefore = dynamic_cast<JitExpressionEngine*>(ExpressionEngine::Find("native-jit"))->NativePrograms();
+
+    int comparedBlocks{0};
+    for (const auto& presetFile : PresetFiles())
+    {
+        PresetFileParser parser;
+        ASSERT_TRUE(parser.Read(presetFile)) << presetFile;
+
+        for (const auto& prefix : prefixes)
+        {
+            auto const code = parser.GetCode(prefix);
+            auto const tree = ExpressionParser::Parse(code);
+            if (code.empty() || !tree)
+            {
+                continue;
+            }
+
+            // Random numbers differ between evaluator instances.
+            std::set<std::string> variables;
+            bool random{false};
+            CollectVariables(*tree, variables, random);
+            if (random)
+            {
+                continue;
+            }
+
+            auto const expected = RunWithEngine("projectm-eval", code, variables);
+            auto const actual = RunWithEngine("native-jit", code, variables);
+            ASSERT_EQ(actual.size(), expected.size()) << presetFile << " " << prefix;
+
+            for (const auto& value : expected)
+            {
+                if (std::isnan(value.second))
+                {
+                    EXPECT_TRUE(std::isnan(actual.at(value.first))) << presetFile << " " << prefix << " " << value.first;
+                }
+                else
+                {
+                    EXPECT_NEAR(actual.at(value.first), value.second, 1e-9 * (1.0 + std::fabs(value.second)))
+                        << presetFile << " " << prefix << " " << value.first;
+                }
+            }
+            comparedBlocks++;
+        }
+    }
+
+    EXPECT_GT(comparedBlocks, 0);
+    if (ExpressionJit::Supported())
+    {
+        EXPECT_GT(dynamic_cast<JitExpressionEngine*>(ExpressionEngine::Find("native-jit"))->NativePrograms(), nativeBefore);
+    }
+}
+
+TEST(ExpressionCache, NormalizeCode)
+{
+    EXPECT_EQ(ExpressionCache::NormalizeCode("  X = 1;\n\tY  =  2 ; "), "x = 1; y = 2 ;");
+    EXPECT_EQ(ExpressionCache::NormalizeCode("x = 1; // comment\ny = 2;"), "x = 1; y = 2;");
+    EXPECT_EQ(ExpressionCache::NormalizeCode("x = 1;/* multi\nline */y = 2;"), "x = 1; y = 2;");
+    EXPECT_EQ(ExpressionCache::NormalizeCode("a b"), "a b");
+}
+
+TEST(ExpressionCache, LeastRecentlyUsedEviction)
+{
+    ExpressionCache cache;
+    cache.SetCapacity(2);
+
+    ExpressionCache::Entry first;
+    first.sharedCode = std::make_shared<ExpressionCache::SharedCode>();
+
+    ExpressionCache::Entry found;
+    EXPECT_FALSE(cache.Find("a", found));
+
+    cache.Insert("a", first);
+    cache.Insert("b", {});
+    EXPECT_TRUE(cache.Find("a", found));
+    EXPECT_EQ(found.sharedCode, first.sharedCode);
+
+    // "b" is now the least recently used entry.
+    cache.Insert("c", {});
+    EXPECT_TRUE(cache.Find("a", found));
+    EXPECT_FALSE(cache.Find("b", found));
+    EXPECT_TRUE(cache.Find("c", found));
+    EXPECT_FALSE(found.sharedCode);
+
+    auto const statistics = cache.GetStatistics();
+    EXPECT_EQ(statistics.hits, 3);
+    EXPECT_EQ(statistics.misses, 2);
+    EXPECT_EQ(statistics.evictions, 1);
+    EXPECT_EQ(statistics.entries, 2);
+    EXPECT_EQ(statistics.capacity, 2);
+
+    cache.SetCapacity(0);
+    cache.Insert("d", {});
+    EXPECT_EQ(cache.GetStatistics().entries, 0);
+}
+
+TEST(ExpressionCache, EngineReusesCompiledCode)
+{
+    auto* engine = ExpressionEngine::Find("native-jit");
+    ASSERT_NE(engine, nullptr);
+
+    PRJM_EVAL_F globalRegisters[100]{};
+    auto globalMemory = engine->CreateMemoryBuffer();
+    auto firstContext = engine->CreateContext(*globalMemory, &globalRegisters);
+    auto secondContext = engine->CreateContext(*globalMemory, &globalRegisters);
+
+    std::string const code = "cache_test_out = cache_test_in * 3; // EngineReusesCompiledCode";
+    auto const before = ExpressionCache::Instance().GetStatistics();
+
+    auto firstProgram = firstContext->Compile(code);
+    auto secondProgram = secondContext->Compile("CACHE_TEST_OUT = cache_test_in * 3;");
+    ASSERT_TRUE(firstProgram);
+    ASSERT_TRUE(secondProgram);
+
+    auto const after = ExpressionCache::Instance().GetStatistics();
+    EXPECT_EQ(after.misses, before.misses + 1);
+    EXPECT_EQ(after.hits, before.hits + 1);
+
+    *firstContext->RegisterVariable("cache_test_in") = 2.0;
+    *secondContext->RegisterVariable("cache_test_in") = 5.0;
+    firstProgram->Execute();
+    secondProgram->Execute();
+
+    EXPECT_DOUBLE_EQ(*firstContext->RegisterVariable("cache_test_out"), 6.0);
+    EXPECT_DOUBLE_EQ(*secondContext->RegisterVariable("cache_test_out"), 15.0);
+
+    // Code with errors fails with the cached error.
+    std::string const invalidCode = "cache_test_out = (1 + ; // EngineReusesCompiledCode";
+    EXPECT_FALSE(firstContext->Compile(invalidCode));
+    EXPECT_FALSE(secondContext->Compile(invalidCode));
+
+    int firstLine{};
+    int firstColumn{};
+    int secondLine{};
+    int secondColumn{};
+    EXPECT_FALSE(firstContext->LastError(firstLine, firstColumn).empty());
+    EXPECT_EQ(secondContext->LastError(secondLine, secondColumn), firstContext->LastError(firstLine, firstColumn));
+    EXPECT_EQ(secondLine, firstLine);
+    EXPECT_EQ(secondColumn, firstColumn);
+    EXPECT_EQ(ExpressionCache::Instance().GetStatistics().hits, after.hits + 1);
+
+    // The same code in a different place is compiled again, so the location refers to its own text.
+    std::string const movedCode = "\n\n    " + invalidCode;
+    EXPECT_FALSE(secondContext->Compile(movedCode));
+
+    auto& defaultEngine = ExpressionEngine::Default();
+    auto defaultMemory = defaultEngine.CreateMemoryBuffer();
+    auto defaultContext = defaultEngine.CreateContext(*defaultMemory, &globalRegisters);
+    EXPECT_FALSE(defaultContext->Compile(movedCode));
+
+    int expectedLine{};
+    int expectedColumn{};
+    EXPECT_EQ(secondContext->LastError(secondLine, secondColumn), defaultContext->LastError(expectedLine, expectedColumn));
+    EXPECT_EQ(secondLine, expectedLine);
+    EXPECT_EQ(secondColumn, expectedColumn);
+}
+
+/**
+ * Compares loading and running the code of all bundled test presets with both engines.
+ * Loading is measured twice, as the second load uses the cached native code. Disabled by
+ * default, run with --gtest_also_run_disabled_tests --gtest_filter=ExpressionJit.DISABLED_SpeedupOnTestPresets
+ */
+TEST(ExpressionJit, DISABLED_SpeedupOnTestPresets)
+{
+    static constexpr int executions{10000}; //!< About the number of per-pixel code runs per frame in a small mesh.
+
+    std::vector<std::string> codeBlocks;
+    for (const auto& presetFile : PresetFiles())
+    {
+        PresetFileParser parser;
+        ASSERT_TRUE(parser.Read(presetFile)) << presetFile;
+
+        for (const auto& prefix : CodeBlockPrefixes())
+        {
+            auto code = parser.GetCode(prefix);
+            if (!code.empty())
+            {
+                codeBlocks.push_back(std::move(code));
+            }
+        }
+    }
+    ASSERT_FALSE(codeBlocks.empty());
+
+    using Clock = std::chrono::steady_clock;
+    auto const milliseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    std::map<std::string, double> executionTimes;
+    for (const auto& engineName : {"projectm-eval", "native-jit"})
+    {
+        auto* engine = ExpressionEngine::Find(engineName);
+        ASSERT_NE(engine, nullptr) << engineName;
+        ExpressionCache::Instance().Clear();
+
+        PRJM_EVAL_F globalRegisters[100]{};
+        auto globalMemory = engine->CreateMemoryBuffer();
+
+        std::vector<std::unique_ptr<ExpressionEngine::Context>> contexts;
+        std::vector<std::unique_ptr<ExpressionEngine::Program>> programs;
+        double loadTimes[2]{};
+        for (auto& loadTime : loadTimes)
+        {
+            contexts.clear();
+            programs.clear();
+
+            auto const start = Clock::now();
+            for (const auto& code : codeBlocks)
+            {
+                contexts.push_back(engine->CreateContext(*globalMemory, &globalRegisters));
+                auto program = contexts.back()->Compile(code);
+                if (program)
+                {
+                    programs.push_back(std::move(program));
+                }
+            }
+            loadTime = milliseconds(Clock::now() - start);
+        }
+
+        auto const start = Clock::now();
+        for (int execution = 0; execution < executions; execution++)
+        {
+            for (auto& program : programs)
+            {
+                program->Execute();
+            }
+        }
+        executionTimes[engineName] = milliseconds(Clock::now() - start);
+
+        std::cout << engineName << ": " << programs.size() << " programs, first load " << loadTimes[0]
+                  << " ms, second load " << loadTimes[1] << " ms, " << executions << " executions "
+                  << executionTimes[engineName] << " ms" << std::endl;
+    }
+
+    std::cout << "Execution speedup: " << executionTimes["projectm-eval"] / executionTimes["native-jit"] << "x" << std::endl;
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/ExpressionParser.hpp>
+
+#include <string>
+
+using libprojectM::MilkdropPreset::ExpressionParser;
+using Node = ExpressionParser::Node;
+
+namespace {
+
+/**
+ * Prints a syntax tree in prefix notation to make the structure easy to compare.
+ */
+auto Print(const Node& node) -> std::string
+{
+    std::string result;
+    switch (node.type)
+    {
+        case Node::Type::Constant:
+            return std::to_string(node.value).substr(0, 4);
+        case Node::Type::Variable:
+            return node.name;
+        case Node::Type::Assign:
+        case Node::Type::Unary:
+        case Node::Type::Binary:
+            result = "(" + node.operation;
+            break;
+        case Node::Type::Condition:
+            result = "(?";
+            break;
+        case Node::Type::Call:
+            result = "(" + node.name;
+            break;
+        case Node::Type::Index:
+            result = "([]";
+            break;
+        case Node::Type::Sequence:
+            result = "(;";
+            break;
+    }
+
+    for (const auto& argument : node.arguments)
+    {
+        result += " " + Print(*argument);
+    }
+    return result + ")";
+}
+
+auto ParseAndPrint(const std::string& code) -> std::string
+{
+    auto const tree = ExpressionParser::Parse(code);
+    return tree ? Print(*tree) : "failed";
+}
+
+} // namespace
+
+TEST(ExpressionParser, Precedence)
+{
+    EXPECT_EQ(ParseAndPrint("a = b + c * d ^ 2"), "(; (= a (+ b (* c (^ d 2.00)))))");
+    // Like in ns-eel2, unary operators bind stronger than the power operator.
+    EXPECT_EQ(ParseAndPrint("-a ^ 2"), "(; (^ (- a) 2.00))");
+    EXPECT_EQ(ParseAndPrint("a || b && c == d"), "(; (|| a (&& b (== c d))))");
+    EXPECT_EQ(ParseAndPrint("a - b - c"), "(; (- (- a b) c))");
+    EXPECT_EQ(ParseAndPrint("a = b = 1"), "(; (= a (= b 1.00)))");
+}
+
+TEST(ExpressionParser, Statements)
+{
+    std::string const code = "Q1 = 1;\n// comment\nwave.x += 2; /* block */ megabuf(q1)[1] = $PI;;";
+    auto const tree = ExpressionParser::Parse(code);
+    ASSERT_TRUE(tree);
+    EXPECT_EQ(Print(*tree), "(; (= q1 1.00) (+= wave.x 2.00) (= ([] (megabuf (; q1)) (; 1.00)) 3.14))");
+
+    ASSERT_EQ(tree->arguments.size(), 3);
+    EXPECT_EQ(code.substr(tree->arguments[0]->begin, tree->arguments[0]->end - tree->arguments[0]->begin), "Q1 = 1");
+
+    EXPECT_EQ(ParseAndPrint("a > 1 ? b = 2 : c"), "(; (? (> a 1.00) (= b 2.00) c))");
+    EXPECT_EQ(ParseAndPrint("loop(3, a += 1; b = a)"), "(; (loop (; 3.00) (; (+= a 1.00) (= b a))))");
+    EXPECT_EQ(ParseAndPrint(""), "(;)");
+}
+
+TEST(ExpressionParser, RejectsUnclearCode)
+{
+    EXPECT_EQ(ParseAndPrint("a = (1 + ;"), "failed");
+    EXPECT_EQ(ParseAndPrint("a < b < c"), "failed");
+    EXPECT_EQ(ParseAndPrint("a = 1e3"), "failed");
+    EXPECT_EQ(ParseAndPrint("a = 0x10"), "failed");
+    EXPECT_EQ(ParseAndPrint("a = 1; /* open"), "failed");
+    EXPECT_EQ(ParseAndPrint("1 = a"), "failed");
+    EXPECT_EQ(ParseAndPrint(std::string(1000, '(') + "1" + std::string(1000, ')')), "failed");
+}
+
+TEST(ExpressionParser, GlobalRegisters)
+{
+    EXPECT_TRUE(ExpressionParser::IsGlobalRegister("reg00"));
+    EXPECT_TRUE(ExpressionParser::IsGlobalRegister("reg99"));
+    EXPECT_FALSE(ExpressionParser::IsGlobalRegister("reg1"));
+    EXPECT_FALSE(ExpressionParser::IsGlobalRegister("reg100"));
+    EXPECT_FALSE(ExpressionParser::IsGlobalRegister("q1"));
+}
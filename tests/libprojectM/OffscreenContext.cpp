@@ -0,0 +1,102 @@
+#include "OffscreenContext.hpp"
+
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+std::mutex displayMutex;      //!< Guards the display reference count.
+int displayReferenceCount{0}; //!< Number of contexts using the EGL display.
+
+} // namespace
+
+OffscreenContext::OffscreenContext(int width, int height)
+{
+    {
+        // The display is shared by all contexts in the process, e.g. one per test thread.
+        std::lock_guard<std::mutex> lock(displayMutex);
+        m_display = GetDisplay();
+        if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+        {
+            m_display = EGL_NO_DISPLAY;
+            return;
+        }
+        displayReferenceCount++;
+    }
+
+    EGLint const configAttributes[]{
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE};
+    EGLConfig config{};
+    EGLint configCount{};
+    if (!eglChooseConfig(m_display, configAttributes, &config, 1, &configCount) || configCount == 0 ||
+        !eglBindAPI(EGL_OPENGL_API))
+    {
+        return;
+    }
+
+    EGLint const surfaceAttributes[]{EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    m_surface = eglCreatePbufferSurface(m_display, config, surfaceAttributes);
+
+    EGLint const contextAttributes[]{
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttributes);
+
+    if (m_surface == EGL_NO_SURFACE || m_context == EGL_NO_CONTEXT)
+    {
+        return;
+    }
+
+    m_current = eglMakeCurrent(m_display, m_surface, m_surface, m_context) == EGL_TRUE;
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    if (m_display == EGL_NO_DISPLAY)
+    {
+        return;
+    }
+
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_context != EGL_NO_CONTEXT)
+    {
+        eglDestroyContext(m_display, m_context);
+    }
+    if (m_surface != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(m_display, m_surface);
+    }
+
+    std::lock_guard<std::mutex> lock(displayMutex);
+    if (--displayReferenceCount == 0)
+    {
+        eglTerminate(m_display);
+    }
+}
+
+auto OffscreenContext::Current() const -> bool
+{
+    return m_current;
+}
+
+auto OffscreenContext::GetDisplay() -> EGLDisplay
+{
+    auto const* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto const getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (extensions != nullptr && std::strstr(extensions, "EGL_MESA_platform_surfaceless") != nullptr && getPlatformDisplay != nullptr)
+    {
+        auto const display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY)
+        {
+            return display;
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+/**
+ * @brief Creates an off-screen OpenGL 3.3 core profile context using EGL.
+ *
+ * Tests which need OpenGL are only built if EGL is available, and should be skipped if
+ * Current() returns false, e.g. on build machines without any GPU driver.
+ *
+ * Contexts can be created on several threads at the same time, each one is current on the
+ * thread which created it.
+ */
+class OffscreenContext
+{
+public:
+    /**
+     * @brief Creates the context and makes it current.
+     * @param width The width of the default framebuffer.
+     * @param height The height of the default framebuffer.
+     */
+    explicit OffscreenContext(int width = 1, int height = 1);
+
+    ~OffscreenContext();
+
+    OffscreenContext(const OffscreenContext&) = delete;
+    auto operator=(const OffscreenContext&) -> OffscreenContext& = delete;
+
+    /**
+     * @brief Returns whether the context was created and is current.
+     * @return true if OpenGL functions can be used.
+     */
+    auto Current() const -> bool;
+
+private:
+    /**
+     * @brief Prefers Mesa's surfaceless platform, which works without a display server.
+     */
+    static auto GetDisplay() -> EGLDisplay;
+
+    EGLDisplay m_display{EGL_NO_DISPLAY};
+    EGLSurface m_surface{EGL_NO_SURFACE};
+    EGLContext m_context{EGL_NO_CONTEXT};
+    bool m_current{false};
+};
@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+
+#include <Lz4.hpp>
+#include <MemoryStream.hpp>
+#include <PackArchive.hpp>
+#include <PackArchiveWriter.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using libprojectM::MemoryStream;
+using libprojectM::PackArchive;
+using libprojectM::PackArchiveWriter;
+
+namespace {
+
+const std::string presetData{"[preset00]\n"
+                             "fDecay=0.980000\n"
+                             "per_frame_1=zoom = zoom + 0.01;\n"
+                             "per_frame_2=zoom = zoom + 0.01;\n"
+                             "per_frame_3=zoom = zoom + 0.01;\n"
+                             "per_frame_4=zoom = zoom + 0.01;\n"};
+
+/**
+ * Writes a pack with a few members to a temporary file and returns the file name.
+ */
+auto WriteTestPack(const std::string& name, bool compress) -> std::string
+{
+    auto const packFile = testing::TempDir() + name + PackArchive::FileExtension;
+
+    std::ofstream packStream(packFile.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    PackArchiveWriter writer(packStream, compress);
+    EXPECT_TRUE(writer.Add("Geiss/Reaction.milk", presetData));
+    EXPECT_TRUE(writer.Add("textures\\Clouds.jpg", std::string("\xFF\xD8\xFF\xE0", 4)));
+    EXPECT_TRUE(writer.Add("A.milk", std::string()));
+    EXPECT_TRUE(writer.Finish());
+
+    return packFile;
+}
+
+} // namespace
+
+TEST(PackArchive, Lz4RoundTrip)
+{
+    std::string repetitiveData;
+    for (int line = 0; line < 200; line++)
+    {
+        repetitiveData += "per_pixel_" + std::to_string(line) + "=rot = rot + 0.01 * sin(time);\n";
+    }
+
+    std::string randomData;
+    unsigned int seed{1};
+    for (int byte = 0; byte < 5000; byte++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        randomData.push_back(static_cast<char>(seed >> 16));
+    }
+
+    for (const auto& data : {repetitiveData, randomData, std::string("abc"), std::string(), std::string(1000, 'x')})
+    {
+        auto const block = libprojectM::Lz4::CompressBlock(data.data(), data.size());
+
+        std::vector<char> output(data.size() + 1);
+        ASSERT_TRUE(libprojectM::Lz4::DecompressBlock(block.data(), block.size(), output.data(), data.size()));
+        EXPECT_EQ(std::string(output.data(), data.size()), data);
+
+        // The exact size must match.
+        EXPECT_FALSE(libprojectM::Lz4::DecompressBlock(block.data(), block.size(), output.data(), data.size() + 1));
+    }
+
+    auto const block = libprojectM::Lz4::CompressBlock(repetitiveData.data(), repetitiveData.size());
+    EXPECT_LT(block.size(), repetitiveData.size() / 4);
+
+    std::vector<char> output(repetitiveData.size());
+    EXPECT_FALSE(libprojectM::Lz4::DecompressBlock(block.data(), block.size() / 2, output.data(), output.size()));
+}
+
+TEST(PackArchive, ReadMembers)
+{
+    for (bool compress : {false, true})
+    {
+        auto const packFile = WriteTestPack(compress ? "Compressed" : "Stored", compress);
+
+        PackArchive pack;
+        ASSERT_TRUE(pack.Open(packFile));
+        ASSERT_EQ(pack.MemberCount(), 3);
+
+        // Sorted by lower-case name, with backslashes converted.
+        EXPECT_EQ(pack.MemberName(0), "A.milk");
+        EXPECT_EQ(pack.MemberName(1), "Geiss/Reaction.milk");
+        EXPECT_EQ(pack.MemberName(2), "textures/Clouds.jpg");
+
+        auto const presetIndex = pack.Find("geiss\\REACTION.milk");
+        ASSERT_EQ(presetIndex, 1);
+        EXPECT_EQ(pack.MemberSize(presetIndex), presetData.size());
+        EXPECT_EQ(pack.Find("Geiss/Missing.milk"), PackArchive::InvalidIndex);
+
+        std::vector<char> buffer;
+        auto const presetView = pack.Read(presetIndex, buffer);
+        ASSERT_NE(presetView.data, nullptr);
+        EXPECT_EQ(std::string(presetView.data, presetView.size), presetData);
+
+        // Incompressible data is always stored as-is.
+        buffer.clear();
+        auto const textureView = pack.Read(pack.Find("textures/clouds.jpg"), buffer);
+        EXPECT_EQ(std::string(textureView.data, textureView.size), std::string("\xFF\xD8\xFF\xE0", 4));
+        EXPECT_TRUE(buffer.empty());
+
+        auto const emptyView = pack.Read(pack.Find("a.milk"), buffer);
+        EXPECT_NE(emptyView.data, nullptr);
+        EXPECT_EQ(emptyView.size, 0);
+
+        pack.Close();
+        std::remove(packFile.c_str());
+    }
+}
+
+TEST(PackArchive, RejectsInvalidFiles)
+{
+    auto const packFile = WriteTestPack("Damaged", false);
+
+    std::string packData;
+    {
+        std::ifstream packStream(packFile.c_str(), std::ios_base::in | std::ios_base::binary);
+        packData.assign(std::istreambuf_iterator<char>(packStream), std::istreambuf_iterator<char>());
+    }
+
+    // Truncated file.
+    {
+        std::ofstream packStream(packFile.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        packStream.write(packData.data(), static_cast<std::streamsize>(packData.size() - 1));
+    }
+
+    PackArchive pack;
+    EXPECT_FALSE(pack.Open(packFile));
+    EXPECT_FALSE(pack.Open(packFile + ".missing"));
+    EXPECT_EQ(pack.MemberCount(), 0);
+
+    // Data offset of the first index entry pointing outside the file.
+    auto const indexOffset = static_cast<unsigned char>(packData.at(16)) | (static_cast<unsigned char>(packData.at(17)) << 8);
+    packData[indexOffset + 23] = '\x7F';
+    {
+        std::ofstream packStream(packFile.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        packStream.write(packData.data(), static_cast<std::streamsize>(packData.size()));
+    }
+    EXPECT_FALSE(pack.Open(packFile));
+
+    std::remove(packFile.c_str());
+
+    // Duplicate names can't be written.
+    std::ostringstream duplicateStream;
+    PackArchiveWriter writer(duplicateStream, false);
+    EXPECT_TRUE(writer.Add("Preset.milk", presetData));
+    EXPECT_TRUE(writer.Add("PRESET.milk", presetData));
+    EXPECT_FALSE(writer.Finish());
+}
+
+TEST(PackArchive, RejectsOversizedMembers)
+{
+    auto const packFile = WriteTestPack("Oversized", true);
+
+    std::string packData;
+    {
+        std::ifstream packStream(packFile.c_str(), std::ios_base::in | std::ios_base::binary);
+        packData.assign(std::istreambuf_iterator<char>(packStream), std::istreambuf_iterator<char>());
+    }
+
+    // Find the compressed preset entry and claim a huge uncompressed size for it.
+    auto const indexOffset = static_cast<unsigned char>(packData.at(16)) | (static_cast<unsigned char>(packData.at(17)) << 8);
+    size_t entryOffset{0};
+    for (size_t entry = 0; entry < 3; entry++)
+    {
+        if (packData.at(indexOffset + entry * PackArchive::IndexEntrySize + 12) == 1)
+        {
+            entryOffset = indexOffset + entry * PackArchive::IndexEntrySize;
+        }
+    }
+    ASSERT_NE(entryOffset, 0);
+
+    for (auto const sizeByte : {4, 7})
+    {
+        auto damagedData = packData;
+        damagedData[entryOffset + 32 + sizeByte] = '\x01';
+        {
+            std::ofstream packStream(packFile.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            packStream.write(damagedData.data(), static_cast<std::streamsize>(damagedData.size()));
+        }
+
+        PackArchive pack;
+        EXPECT_FALSE(pack.Open(packFile));
+    }
+
+    std::remove(packFile.c_str());
+}
+
+TEST(PackArchive, SplitPath)
+{
+    std::string packFile;
+    std::string memberName;
+
+    EXPECT_TRUE(PackArchive::SplitPath("/usr/share/presets.milkpack/Geiss/Reaction.milk", packFile, memberName));
+    EXPECT_EQ(packFile, "/usr/share/presets.milkpack");
+    EXPECT_EQ(memberName, "Geiss/Reaction.milk");
+
+    EXPECT_TRUE(PackArchive::SplitPath("C:\\Presets.MilkPack\\Reaction.milk", packFile, memberName));
+    EXPECT_EQ(packFile, "C:\\Presets.MilkPack");
+    EXPECT_EQ(memberName, "Reaction.milk");
+
+    EXPECT_FALSE(PackArchive::SplitPath("/usr/share/presets.milkpack", packFile, memberName));
+    EXPECT_FALSE(PackArchive::SplitPath("/usr/share/presets.milkpack/", packFile, memberName));
+    EXPECT_FALSE(PackArchive::SplitPath("/usr/share/presets/Reaction.milk", packFile, memberName));
+
+    EXPECT_TRUE(PackArchive::IsPackFileName("presets.MILKPACK"));
+    EXPECT_FALSE(PackArchive::IsPackFileName("presets.milk"));
+}
+
+TEST(PackArchive, MemoryStream)
+{
+    MemoryStream stream(presetData.data(), presetData.size());
+
+    std::string line;
+    std::getline(stream, line);
+    EXPECT_EQ(line, "[preset00]");
+
+    stream.seekg(0, stream.end);
+    EXPECT_EQ(stream.tellg(), static_cast<std::streamoff>(presetData.size()));
+
+    stream.seekg(11, stream.beg);
+    std::getline(stream, line);
+    EXPECT_EQ(line, "fDecay=0.980000");
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/PerPixelCodeAnalysis.hpp>
+
+using libprojectM::MilkdropPreset::PerPixelCodeAnalysis;
+
+TEST(PerPixelCodeAnalysis, HoistsFullyInvariantCode)
+{
+    auto const analysis = PerPixelCodeAnalysis::Analyze("zoom = zoom + 0.1 * bass;\nrot = sin(time) * q1;\n");
+
+    EXPECT_TRUE(analysis.analyzed);
+    EXPECT_EQ(analysis.statementCount, 2);
+    EXPECT_EQ(analysis.hoistedStatementCount, 2);
+    EXPECT_TRUE(analysis.perVertexCode.empty());
+    EXPECT_NE(analysis.perFrameCode.find("zoom = zoom + 0.1 * bass"), std::string::npos);
+    EXPECT_NE(analysis.perFrameCode.find("rot = sin(time) * q1"), std::string::npos);
+}
+
+TEST(PerPixelCodeAnalysis, SplitsMixedCode)
+{
+    auto const analysis = PerPixelCodeAnalysis::Analyze("a = bass * 2;\nzoom = zoom + a * rad;\nb = a + 1;\n");
+
+    EXPECT_EQ(analysis.statementCount, 3);
+    EXPECT_EQ(analysis.hoistedStatementCount, 2);
+    EXPECT_NE(analysis.perFrameCode.find("a = bass * 2"), std::string::npos);
+    EXPECT_NE(analysis.perFrameCode.find("b = a + 1"), std::string::npos);
+    EXPECT_NE(analysis.perVertexCode.find("zoom = zoom + a * rad"), std::string::npos);
+}
+
+TEST(PerPixelCodeAnalysis, KeepsPositionDependentCode)
+{
+    auto const analysis = PerPixelCodeAnalysis::Analyze("d = x - 0.5; e = d * d; rot = e;");
+
+    EXPECT_TRUE(analysis.analyzed);
+    EXPECT_EQ(analysis.statementCount, 3);
+    EXPECT_EQ(analysis.hoistedStatementCount, 0);
+    EXPECT_TRUE(analysis.perFrameCode.empty());
+    EXPECT_EQ(analysis.perVertexCode, "d = x - 0.5; e = d * d; rot = e;");
+}
+
+TEST(PerPixelCodeAnalysis, KeepsValuesCarriedBetweenVertices)
+{
+    // "t" is incremented once per vertex, "b" reads the value from the previous vertex.
+    auto const analysis = PerPixelCodeAnalysis::Analyze("t = t + 1; b = c; c = 5; zoom = zoom + t * 0.001;");
+
+    EXPECT_EQ(analysis.hoistedStatementCount, 0);
+}
+
+TEST(PerPixelCodeAnalysis, KeepsSideEffects)
+{
+    EXPECT_EQ(PerPixelCodeAnalysis::Analyze("zoom = zoom + rand(10) * 0.01;").hoistedStatementCount, 0);
+    EXPECT_EQ(PerPixelCodeAnalysis::Analyze("megabuf(1) = bass;").hoistedStatementCount, 0);
+    EXPECT_EQ(PerPixelCodeAnalysis::Analyze("reg00 = bass;").hoistedStatementCount, 0);
+}
+
+TEST(PerPixelCodeAnalysis, KeepsStatementOrder)
+{
+    // "a" is read per vertex before the invariant statement assigns it.
+    auto const analysis = PerPixelCodeAnalysis::Analyze("zoom = zoom + a * x; a = bass;");
+    EXPECT_EQ(analysis.hoistedStatementCount, 0);
+
+    // The invariant assignment is overwritten per vertex.
+    auto const overwritten = PerPixelCodeAnalysis::Analyze("a = 1; a = a + x; rot = a;");
+    EXPECT_EQ(overwritten.hoistedStatementCount, 0);
+}
+
+TEST(PerPixelCodeAnalysis, HandlesComments)
+{
+    auto const analysis = PerPixelCodeAnalysis::Analyze("a = bass; // comment; with semicolon\nrot = a * ang; /* ; */\n");
+
+    EXPECT_EQ(analysis.statementCount, 2);
+    EXPECT_EQ(analysis.hoistedStatementCount, 1);
+    EXPECT_NE(analysis.perFrameCode.find("a = bass"), std::string::npos);
+    EXPECT_NE(analysis.perVertexCode.find("rot = a * ang"), std::string::npos);
+}
+
+TEST(PerPixelCodeAnalysis, InvalidCode)
+{
+    auto const analysis = PerPixelCodeAnalysis::Analyze("zoom = (zoom + 1;");
+
+    EXPECT_FALSE(analysis.analyzed);
+    EXPECT_EQ(analysis.hoistedStatementCount, 0);
+    EXPECT_EQ(analysis.perVertexCode, "zoom = (zoom + 1;");
+}
+
+TEST(PerPixelCodeAnalysis, CollectsAssignedVariables)
+{
+    std::set<std::string> variables;
+    EXPECT_TRUE(PerPixelCodeAnalysis::AssignedVariables("Q1 = bass; t2 += 1; x = (y = 2) * q3; a == b;", variables));
+    EXPECT_EQ(variables, std::set<std::string>({"q1", "t2", "x", "y"}));
+
+    variables.clear();
+    EXPECT_FALSE(PerPixelCodeAnalysis::AssignedVariables("assign(q1, 2);", variables));
+    EXPECT_FALSE(PerPixelCodeAnalysis::AssignedVariables("x = (1;", variables));
+}
+
+TEST(PerPixelCodeAnalysis, DetectsSharedState)
+{
+    EXPECT_FALSE(PerPixelCodeAnalysis::UsesSharedState(""));
+    EXPECT_FALSE(PerPixelCodeAnalysis::UsesSharedState("x = x + sin(time) * bass; megabuf(1) = q1; // reg00"));
+
+    EXPECT_TRUE(PerPixelCodeAnalysis::UsesSharedState("x = REG07;"));
+    EXPECT_TRUE(PerPixelCodeAnalysis::UsesSharedState("gmegabuf(3) = x;"));
+    EXPECT_TRUE(PerPixelCodeAnalysis::UsesSharedState("x = gmem[3];"));
+    EXPECT_TRUE(PerPixelCodeAnalysis::UsesSharedState("x = rand(10);"));
+    EXPECT_TRUE(PerPixelCodeAnalysis::UsesSharedState("x = (1;"));
+}
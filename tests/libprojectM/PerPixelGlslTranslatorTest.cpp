@@ -0,0 +1,333 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/PerPixelGlslTranslator.hpp>
+
+#include <algorithm>
+#include <string>
+
+#ifdef PROJECTM_TEST_EGL
+#include "OffscreenContext.hpp"
+
+#include <MilkdropPreset/ExpressionEngine.hpp>
+
+#include <projectM-opengl.h>
+
+#include <cmath>
+#include <map>
+#include <vector>
+#endif
+
+using libprojectM::MilkdropPreset::PerPixelGlslTranslator;
+
+namespace {
+
+auto Contains(const std::vector<std::string>& list, const std::string& value) -> bool
+{
+    return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+} // namespace
+
+TEST(PerPixelGlslTranslator, TranslatesSimpleCode)
+{
+    PerPixelGlslTranslator translator;
+    ASSERT_TRUE(translator.Translate("zoom = zoom + 0.05 * sin(rad * 10 + time);\nrot = q1 * cos(ang); // comment\n"));
+
+    auto const& source = translator.Source();
+    EXPECT_NE(source.find("#define PER_PIXEL_EQUATIONS"), std::string::npos);
+    EXPECT_NE(source.find("void PerPixelEquations(float x, float y, float rad, float ang"), std::string::npos);
+    EXPECT_NE(source.find("uniform float " + PerPixelGlslTranslator::UniformName(0) + ";"), std::string::npos);
+
+    auto const& uniforms = translator.UniformVariables();
+    ASSERT_GE(uniforms.size(), 10);
+    EXPECT_EQ(uniforms.at(0), "zoom");
+    EXPECT_EQ(uniforms.at(9), "sy");
+    EXPECT_TRUE(Contains(uniforms, "time"));
+    EXPECT_TRUE(Contains(uniforms, "q1"));
+    EXPECT_FALSE(Contains(uniforms, "rad"));
+}
+
+TEST(PerPixelGlslTranslator, AcceptsTemporaryVariables)
+{
+    PerPixelGlslTranslator translator;
+
+    EXPECT_TRUE(translator.Translate("t = x * 2; rot = t"));
+    EXPECT_FALSE(Contains(translator.UniformVariables(), "t"));
+
+    EXPECT_TRUE(translator.Translate("x = x * 2; y += 1; zoom = x + y"));
+    EXPECT_TRUE(translator.Translate("dx = if(above(x, 0.5), 0.01, -0.01); dy = exec2(a = 2, a * y)"));
+    EXPECT_TRUE(translator.Translate("(t = 1; u = 2); sx = t + u"));
+    EXPECT_TRUE(translator.Translate(""));
+}
+
+TEST(PerPixelGlslTranslator, RejectsUnsupportedCode)
+{
+    PerPixelGlslTranslator translator;
+
+    EXPECT_FALSE(translator.Translate("megabuf(0) = x; zoom = megabuf(0)"));
+    EXPECT_FALSE(translator.Translate("reg00 = x; zoom = reg00"));
+    EXPECT_FALSE(translator.Translate("rot = rand(10)"));
+    EXPECT_FALSE(translator.Translate("loop(3, zoom += 1)"));
+    EXPECT_FALSE(translator.Translate("zoom = 2 ^ 3"));
+    EXPECT_FALSE(translator.Translate("zoom = (1 + ;"));
+    EXPECT_TRUE(translator.Source().empty());
+    EXPECT_TRUE(translator.UniformVariables().empty());
+}
+
+TEST(PerPixelGlslTranslator, EmitsConstantsWithFullPrecision)
+{
+    PerPixelGlslTranslator translator;
+    ASSERT_TRUE(translator.Translate("zoom = $PI + 0.1 + 16777216 + 1.0000001"));
+
+    auto const& source = translator.Source();
+    EXPECT_NE(source.find("3.1415927"), std::string::npos);
+    EXPECT_NE(source.find("0.1"), std::string::npos);
+    EXPECT_NE(source.find("16777216"), std::string::npos);
+    EXPECT_NE(source.find("1.0000001"), std::string::npos);
+}
+
+TEST(PerPixelGlslTranslator, RejectsValuesCarriedBetweenVertices)
+{
+    PerPixelGlslTranslator translator;
+
+    EXPECT_FALSE(translator.Translate("t = t + x; rot = t"));
+    EXPECT_FALSE(translator.Translate("rot = t; t = x"));
+    EXPECT_FALSE(translator.Translate("if(above(x, 0.5), t = 1, 0); rot = t"));
+    EXPECT_FALSE(translator.Translate("x > 0.5 && (t = 1); rot = t"));
+}
+
+#ifdef PROJECTM_TEST_EGL
+
+namespace {
+
+struct TestVertex
+{
+    float x{};
+    float y{};
+    float rad{};
+    float ang{};
+};
+
+constexpr int outputCount{10}; //!< zoom, zoomexp, rot, warp, cx, cy, dx, dy, sx, sy
+
+const std::vector<std::string> outputVariables{"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+/**
+ * Returns the initial values of all variables used in the tests.
+ */
+auto InitialValue(const std::string& name) -> float
+{
+    static const std::map<std::string, float> values{
+        {"zoom", 1.01f}, {"zoomexp", 1.0f}, {"rot", 0.02f}, {"warp", 1.0f}, {"cx", 0.5f}, {"cy", 0.5f},
+        {"dx", 0.0f}, {"dy", 0.0f}, {"sx", 1.0f}, {"sy", 1.0f}, {"time", 12.5f}, {"bass", 1.3f}, {"q1", 0.7f}};
+
+    auto const value = values.find(name);
+    return value == values.end() ? 0.25f : value->second;
+}
+
+auto CompileShader(GLenum type, const std::string& source) -> GLuint
+{
+    auto const shader = glCreateShader(type);
+    auto const* sourcePointer = source.c_str();
+    glShaderSource(shader, 1, &sourcePointer, nullptr);
+    glCompileShader(shader);
+
+    GLint status{};
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[4096]{};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        ADD_FAILURE() << log << "\n"
+                      << source;
+    }
+    return shader;
+}
+
+/**
+ * Evaluates the translated code for each vertex on the GPU using transform feedback.
+ */
+auto EvaluateOnGpu(const PerPixelGlslTranslator& translator, const std::vector<TestVertex>& vertices) -> std::vector<float>
+{
+    std::string const vertexShaderSource = "#version 330\n" + translator.Source() + R"(
+layout(location = 0) in vec4 inputs;
+
+out vec4 out_transforms;
+out vec2 out_warp_center;
+out vec2 out_warp_distance;
+out vec2 out_stretch;
+
+void main()
+{
+    PerPixelEquations(inputs.x, inputs.y, inputs.z, inputs.w,
+                      out_transforms, out_warp_center, out_warp_distance, out_stretch);
+    gl_Position = vec4(0.0);
+}
+)";
+
+    auto const program = glCreateProgram();
+    auto const vertexShader = CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
+    glAttachShader(program, vertexShader);
+
+    const char* varyings[]{"out_transforms", "out_warp_center", "out_warp_distance", "out_stretch"};
+    glTransformFeedbackVaryings(program, 4, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+
+    GLint status{};
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    EXPECT_EQ(status, GL_TRUE);
+
+    glUseProgram(program);
+    auto const& uniforms = translator.UniformVariables();
+    for (size_t index = 0; index < uniforms.size(); index++)
+    {
+        glUniform1f(glGetUniformLocation(program, PerPixelGlslTranslator::UniformName(index).c_str()),
+                    InitialValue(uniforms[index]));
+    }
+
+    GLuint vertexArray{};
+    GLuint buffers[2]{};
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(2, buffers);
+
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(TestVertex) * vertices.size()), vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TestVertex), nullptr);
+
+    std::vector<float> results(vertices.size() * outputCount);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1]);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, static_cast<GLsizeiptr>(sizeof(float) * results.size()), nullptr, GL_STATIC_READ);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(vertices.size()));
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, static_cast<GLsizeiptr>(sizeof(float) * results.size()), results.data());
+
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteProgram(program);
+
+    return results;
+}
+
+/**
+ * Evaluates the code for each vertex with the default expression engine.
+ */
+auto EvaluateOnCpu(const std::string& code, const std::vector<std::string>& uniforms, const std::vector<TestVertex>& vertices) -> std::vector<float>
+{
+    using libprojectM::MilkdropPreset::ExpressionEngine;
+
+    auto& engine = ExpressionEngine::Default();
+    ExpressionEngine::GlobalRegisters globalRegisters{};
+    auto globalMemory = engine.CreateMemoryBuffer();
+    auto context = engine.CreateContext(*globalMemory, &globalRegisters);
+
+    auto* x = context->RegisterVariable("x");
+    auto* y = context->RegisterVariable("y");
+    auto* rad = context->RegisterVariable("rad");
+    auto* ang = context->RegisterVariable("ang");
+    std::vector<PRJM_EVAL_F*> outputs;
+    for (auto const& name : outputVariables)
+    {
+        outputs.push_back(context->RegisterVariable(name));
+    }
+    for (auto const& name : uniforms)
+    {
+        *context->RegisterVariable(name) = InitialValue(name);
+    }
+
+    auto program = context->Compile(code);
+    EXPECT_TRUE(program);
+
+    std::vector<float> results;
+    for (auto const& vertex : vertices)
+    {
+        *x = vertex.x;
+        *y = vertex.y;
+        *rad = vertex.rad;
+        *ang = vertex.ang;
+        for (size_t index = 0; index < outputs.size(); index++)
+        {
+            *outputs[index] = InitialValue(outputVariables[index]);
+        }
+
+        if (program)
+        {
+            program->Execute();
+        }
+
+        for (auto const* output : outputs)
+        {
+            results.push_back(static_cast<float>(*output));
+        }
+    }
+
+    return results;
+}
+
+} // namespace
+
+TEST(PerPixelGlslTranslator, MatchesCpuEvaluation)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    std::vector<TestVertex> vertices;
+    for (int gridY = 0; gridY <= 8; gridY++)
+    {
+        for (int gridX = 0; gridX <= 8; gridX++)
+        {
+            TestVertex vertex;
+            vertex.x = static_cast<float>(gridX) / 8.0f;
+            vertex.y = static_cast<float>(gridY) / 8.0f;
+            vertex.rad = std::hypot(vertex.x - 0.5f, vertex.y - 0.5f) * 2.0f;
+            vertex.ang = std::atan2(vertex.y - 0.5f, vertex.x - 0.5f);
+            vertices.push_back(vertex);
+        }
+    }
+
+    const std::vector<std::string> presetCode{
+        "zoom = zoom + 0.05 * sin(rad * 10 + time); rot = rot + q1 * cos(ang * 3) * 0.1;",
+        "dx = if(above(x, 0.5), 0.01, -0.01); dy = (y - 0.5) * 0.02 * bass; t = sqrt(x * x + y * y); sx = 1 + t * 0.1;",
+        "warp = pow(rad, 2) + min(x, y) - max(x * 0.5, 0.2); cx = x; cy = 1 - y; zoomexp = exec2(a = 2, a * 0.5 + abs(x - 0.5));",
+        "sy = 1 + band(x > 0.3, y < 0.7) * 0.1 + bor(x == 0.5, y != 0.5) * 0.01; rot = (x < 0.25 ? -0.1 : 0.1) * !(y >= 0.75);",
+        // The center vertex calls atan2(0, 0), which GLSL's atan() leaves undefined.
+        "t = atan2(y - 0.5, x - 0.5); zoom /= 1 + sqr(t) * 0.01; zoom -= floor(x * 4) * 0.01 + ceil(y * 2) * 0.01; dx = sign(x - 0.5) * 0.01 / (x - 0.5);",
+        "rot = pow(x - 0.5, 1.5); warp = pow(x - 0.5, 3) + pow(y - 0.5, 2); zoom = $pi * 0.3 + $e * 0.01 + $phi * 0.01;",
+    };
+
+    for (auto const& code : presetCode)
+    {
+        PerPixelGlslTranslator translator;
+        ASSERT_TRUE(translator.Translate(code)) << code;
+
+        auto const gpuResults = EvaluateOnGpu(translator, vertices);
+        auto const cpuResults = EvaluateOnCpu(code, translator.UniformVariables(), vertices);
+        ASSERT_EQ(gpuResults.size(), cpuResults.size());
+
+        for (size_t index = 0; index < gpuResults.size(); index++)
+        {
+            if (std::isnan(cpuResults[index]))
+            {
+                EXPECT_TRUE(std::isnan(gpuResults[index]))
+                    << code << "\nVertex " << index / outputCount << ", output " << outputVariables[index % outputCount];
+                continue;
+            }
+
+            // GPU evaluation uses single precision.
+            EXPECT_NEAR(gpuResults[index], cpuResults[index], 1e-4f * std::max(1.0f, std::abs(cpuResults[index])))
+                << code << "\nVertex " << index / outputCount << ", output " << outputVariables[index % outputCount];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/MilkdropShader.hpp>
+#include <MilkdropPreset/PresetBundle.hpp>
+#include <MilkdropPreset/PresetFileParser.hpp>
+
+#include <Utils.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+
+using libprojectM::MilkdropPreset::MilkdropShader;
+using libprojectM::MilkdropPreset::PresetBundle;
+using libprojectM::MilkdropPreset::PresetFileParser;
+
+namespace {
+
+const std::string presetSource{"[preset00]\n"
+                               "fDecay=0.980000\n"
+                               "zoom=1.010000\n"
+                               "per_frame_1=zoom = zoom + 0.01;\n"
+                               "per_frame_2=rot = 0.1;\n"
+                               "per_frame_4=cut = 1;\n"
+                               "wave_0_per_point1=x = sample;\n"
+                               "warp_1=`shader_body\n"
+                               "warp_2=`{\n"
+                               "warp_3=`ret = tex2D(sampler_main, uv).xyz * 0.5;\n"
+                               "warp_4=`}\n"
+                               "comp_1=`shader_body\n"
+                               "comp_2=`{\n"
+                               "comp_3=`ret = tex2D(sampler_main, uv).xyz + tex2D(sampler_fw_clouds, uv).xyz;\n"
+                               "comp_4=`ret += tex3D(sampler_noisevol_lq, uv.xyy).xyz * texsize_noisevol_lq.x;\n"
+                               "comp_5=`}\n"};
+
+} // namespace
+
+TEST(PresetBundle, RoundTrip)
+{
+    PresetBundle bundle;
+    ASSERT_TRUE(bundle.Build(presetSource));
+
+    auto const data = bundle.Serialize();
+    PresetBundle loadedBundle;
+    ASSERT_TRUE(loadedBundle.Read(data.data(), data.size()));
+
+    PresetFileParser sourceParser;
+    std::istringstream sourceStream(presetSource);
+    ASSERT_TRUE(sourceParser.Read(sourceStream));
+
+    PresetFileParser bundleParser;
+    loadedBundle.Apply(bundleParser);
+
+    EXPECT_EQ(bundleParser.GetFloat("fDecay", 0.0f), sourceParser.GetFloat("fDecay", 0.0f));
+    EXPECT_EQ(bundleParser.GetFloat("zoom", 0.0f), sourceParser.GetFloat("zoom", 0.0f));
+    for (const auto& prefix : {"per_frame_", "per_pixel_", "wave_0_per_point", "warp_", "comp_"})
+    {
+        EXPECT_EQ(bundleParser.GetCode(prefix), sourceParser.GetCode(prefix)) << prefix;
+    }
+
+    // The code lines are only stored as assembled blocks, except the ones after a gap.
+    EXPECT_EQ(bundleParser.PresetValues().count("per_frame_1"), 0);
+    EXPECT_EQ(bundleParser.PresetValues().count("warp_1"), 0);
+    EXPECT_EQ(bundleParser.PresetValues().count("per_frame_4"), 1);
+
+    EXPECT_EQ(loadedBundle.WarpShaderSamplers(), std::set<std::string>({"main"}));
+    EXPECT_EQ(loadedBundle.CompositeShaderSamplers(), std::set<std::string>({"fw_clouds", "main", "noisevol_lq"}));
+    EXPECT_EQ(loadedBundle.TextureNames(), std::set<std::string>({"clouds", "noisevol_lq"}));
+}
+
+TEST(PresetBundle, PrecompiledShaders)
+{
+    PresetBundle bundle;
+    ASSERT_TRUE(bundle.Build(presetSource));
+
+    // Both shaders for both GLSL versions.
+    ASSERT_EQ(bundle.Shaders().size(), 4);
+
+    // The key must match the one calculated on load with the same textures.
+    PresetFileParser parser;
+    bundle.Apply(parser);
+    auto const preprocessedCode = MilkdropShader::PreprocessPresetShader(parser.GetCode("warp_"), MilkdropShader::ShaderType::WarpShader);
+    auto const key = MilkdropShader::TranslationKey(preprocessedCode,
+                                                    {"uniform sampler2D sampler_main;\n"},
+                                                    {"uniform float4 texsize_main;\n"},
+                                                    M4::GLSLGenerator::Version_330);
+    ASSERT_EQ(bundle.Shaders().count(key), 1);
+    EXPECT_NE(bundle.Shaders().at(key).find("#version 330"), std::string::npos);
+
+    // Random textures are selected on load, so the shader can't be precompiled.
+    PresetBundle randomTextureBundle;
+    ASSERT_TRUE(randomTextureBundle.Build("warp_1=`shader_body { ret = tex2D(sampler_rand00, uv).xyz; }\n"));
+    EXPECT_TRUE(randomTextureBundle.Shaders().empty());
+}
+
+TEST(PresetBundle, RejectsInvalidData)
+{
+    PresetBundle bundle;
+    ASSERT_TRUE(bundle.Build(presetSource));
+    auto data = bundle.Serialize();
+
+    PresetBundle loadedBundle;
+    EXPECT_FALSE(loadedBundle.Read(data.data(), data.size() - 1));
+    EXPECT_FALSE(loadedBundle.Read(data.data(), PresetBundle::HeaderSize - 1));
+
+    data.back() ^= 1;
+    EXPECT_FALSE(loadedBundle.Read(data.data(), data.size()));
+
+    EXPECT_FALSE(bundle.Build(std::string()));
+}
+
+TEST(PresetBundle, DetectsBundles)
+{
+    PresetBundle bundle;
+    ASSERT_TRUE(bundle.Build(presetSource));
+
+    std::istringstream bundleStream(bundle.Serialize());
+    EXPECT_TRUE(PresetBundle::IsBundle(bundleStream));
+    EXPECT_TRUE(bundle.Read(bundleStream));
+
+    std::istringstream presetStream(presetSource);
+    EXPECT_FALSE(PresetBundle::IsBundle(presetStream));
+    EXPECT_EQ(presetStream.tellg(), 0);
+
+    EXPECT_TRUE(PresetBundle::IsBundleFileName("presets/Test.MilkB"));
+    EXPECT_FALSE(PresetBundle::IsBundleFileName("presets/Test.milk"));
+    EXPECT_EQ(PresetBundle::SourceFileName("presets/Test.milkb"), "presets/Test.milk");
+}
+
+TEST(PresetBundle, ChecksSourceFile)
+{
+    std::string const sourceFile{"PresetBundleTest.milk"};
+    {
+        std::ofstream sourceStream(sourceFile, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        sourceStream << presetSource;
+    }
+
+    uint64_t size{};
+    int64_t modificationTime{};
+    ASSERT_TRUE(libprojectM::Utils::GetFileInfo(sourceFile, size, modificationTime));
+    EXPECT_EQ(size, presetSource.size());
+
+    // Same size, but different contents.
+    std::string modifiedSource{presetSource};
+    modifiedSource.replace(modifiedSource.find("0.98"), 4, "0.97");
+
+    // Same time stamp, the contents aren't compared.
+    PresetBundle bundle;
+    ASSERT_TRUE(bundle.Build(modifiedSource, modificationTime));
+    EXPECT_TRUE(bundle.IsUpToDate(sourceFile));
+
+    // Different time stamp, the contents are compared.
+    ASSERT_TRUE(bundle.Build(presetSource, modificationTime + 1));
+    EXPECT_TRUE(bundle.IsUpToDate(sourceFile));
+    ASSERT_TRUE(bundle.Build(modifiedSource, modificationTime + 1));
+    EXPECT_FALSE(bundle.IsUpToDate(sourceFile));
+
+    // Different size.
+    ASSERT_TRUE(bundle.Build(presetSource + "\n", modificationTime));
+    EXPECT_FALSE(bundle.IsUpToDate(sourceFile));
+
+    std::remove(sourceFile.c_str());
+    EXPECT_TRUE(bundle.IsUpToDate(sourceFile));
+}
@@ -0,0 +1,436 @@
+#include <gtest/gtest.h>
+
+#include "OffscreenContext.hpp"
+
+#include <ProjectM.hpp>
+
+#include <Renderer/FileScanner.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int ImageWidth{96};  //!< Width of the rendered test images.
+constexpr int ImageHeight{63}; //!< Height of the rendered test images. Odd, so lines in the center don't fall on a pixel boundary.
+constexpr int FrameCount{12};  //!< Number of frames rendered before the image is taken.
+
+/**
+ * RGB image, bottom row first, as returned by glReadPixels().
+ */
+using Image = std::vector<uint8_t>;
+
+/**
+ * Renders a few frames of each bundled test preset in turn into an off-screen framebuffer and
+ * reads back the last one. Presets are switched with a hard cut. The frame times and random seed
+ * are fixed and no audio is added, so the result only depends on the presets.
+ */
+auto RenderPresets(const std::vector<std::string>& presetNames,
+                   const std::function<void(libprojectM::ProjectM&)>& configure = {},
+                   double secondsPerFrame = 1.0 / 30.0,
+                   int frameCount = FrameCount) -> Image
+{
+    GLuint texture{};
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ImageWidth, ImageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLuint framebuffer{};
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    Image image(ImageWidth * ImageHeight * 3);
+    {
+        libprojectM::ProjectM projectM;
+
+        // The random hue offsets and shader rand_preset values come from rand(), which projectM
+        // seeds with the current time.
+        std::srand(1);
+
+        projectM.SetWindowSize(ImageWidth, ImageHeight);
+        projectM.SetPresetLocked(true);
+        if (configure)
+        {
+            configure(projectM);
+        }
+
+        int frame{0};
+        for (const auto& presetName : presetNames)
+        {
+            projectM.LoadPresetFile(std::string(PROJECTM_TEST_PRESETS_DIR) + "/" + presetName, false);
+            projectM.SwitchToPendingPreset();
+
+            for (int presetFrame = 0; presetFrame < frameCount; presetFrame++, frame++)
+            {
+                projectM.SetFrameTime(frame * secondsPerFrame);
+                projectM.RenderFrame(framebuffer);
+            }
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, ImageWidth, ImageHeight, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &texture);
+
+    return image;
+}
+
+/**
+ * Renders a few frames of a single bundled test preset, see RenderPresets().
+ */
+auto RenderPreset(const std::string& presetName,
+                  const std::function<void(libprojectM::ProjectM&)>& configure = {},
+                  double secondsPerFrame = 1.0 / 30.0,
+                  int frameCount = FrameCount) -> Image
+{
+    return RenderPresets({presetName}, configure, secondsPerFrame, frameCount);
+}
+
+/**
+ * Returns the file names of all bundled test presets, sorted by name.
+ */
+auto TestPresetNames() -> std::vector<std::string>
+{
+    std::vector<std::string> extensions{".milk"};
+    libprojectM::Renderer::FileScanner scanner({PROJECTM_TEST_PRESETS_DIR}, extensions);
+
+    std::vector<std::string> presetNames;
+    scanner.Scan([&presetNames](const std::string& path, const std::string&) {
+        presetNames.push_back(path.substr(path.find_last_of("/\\") + 1));
+    });
+
+    std::sort(presetNames.begin(), presetNames.end());
+    return presetNames;
+}
+
+/**
+ * Returns the largest difference of any color channel between both images.
+ */
+auto MaxDifference(const Image& first, const Image& second) -> int
+{
+    int maxDifference{0};
+    for (size_t index = 0; index < first.size() && index < second.size(); index++)
+    {
+        maxDifference = std::max(maxDifference, std::abs(first[index] - second[index]));
+    }
+    return maxDifference;
+}
+
+/**
+ * Returns the number of pixels with any color channel differing by more than the threshold.
+ */
+auto DifferentPixels(const Image& first, const Image& second, int threshold) -> int
+{
+    int pixels{0};
+    for (size_t index = 0; index + 2 < first.size() && index + 2 < second.size(); index += 3)
+    {
+        if (std::abs(first[index] - second[index]) > threshold ||
+            std::abs(first[index + 1] - second[index + 1]) > threshold ||
+            std::abs(first[index + 2] - second[index + 2]) > threshold)
+        {
+            pixels++;
+        }
+    }
+    return pixels;
+}
+
+/**
+ * Returns the file name of the reference image with the given name.
+ */
+auto ReferenceImageFile(const std::string& referenceName) -> std::string
+{
+    return std::string(PROJECTM_TEST_DATA_DIR) + "/PresetRendering/" + referenceName + ".ppm";
+}
+
+/**
+ * Reads a binary PPM image written by WriteReferenceImage().
+ */
+auto ReadReferenceImage(const std::string& fileName) -> Image
+{
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
+    std::string magic;
+    int width{};
+    int height{};
+    int maxValue{};
+    file >> magic >> width >> height >> maxValue;
+    file.get();
+    if (!file || magic != "P6" || width != ImageWidth || height != ImageHeight || maxValue != 255)
+    {
+        return {};
+    }
+
+    // PPM stores the top row first.
+    Image image(ImageWidth * ImageHeight * 3);
+    for (int row = ImageHeight - 1; row >= 0; row--)
+    {
+        file.read(reinterpret_cast<char*>(&image[row * ImageWidth * 3]), ImageWidth * 3);
+    }
+    return file ? image : Image{};
+}
+
+/**
+ * Writes the image as binary PPM.
+ */
+void WriteReferenceImage(const std::string& fileName, const Image& image)
+{
+    std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    file << "P6\n"
+         << ImageWidth << " " << ImageHeight << "\n255\n";
+    for (int row = ImageHeight - 1; row >= 0; row--)
+    {
+        file.write(reinterpret_cast<const char*>(&image[row * ImageWidth * 3]), ImageWidth * 3);
+    }
+}
+
+/**
+ * Returns the image upside down.
+ */
+auto Mirrored(const Image& image) -> Image
+{
+    Image mirrored(image.size());
+    for (int row = 0; row < ImageHeight; row++)
+    {
+        std::copy_n(&image[row * ImageWidth * 3], ImageWidth * 3, &mirrored[(ImageHeight - 1 - row) * ImageWidth * 3]);
+    }
+    return mirrored;
+}
+
+/**
+ * Compares the image with the stored reference image, or replaces the reference if the
+ * environment variable PROJECTM_TEST_WRITE_REFERENCE_IMAGES is set.
+ */
+void ExpectReferenceImage(const std::string& referenceName, const Image& image)
+{
+    auto const referenceFile = ReferenceImageFile(referenceName);
+    if (std::getenv("PROJECTM_TEST_WRITE_REFERENCE_IMAGES") != nullptr)
+    {
+        WriteReferenceImage(referenceFile, image);
+        return;
+    }
+
+    auto const reference = ReadReferenceImage(referenceFile);
+    ASSERT_EQ(reference.size(), image.size()) << referenceFile;
+
+    // Allow for rounding and a few pixels on triangle edges, which the rasterizer may assign differently.
+    EXPECT_LE(DifferentPixels(image, reference, 8), ImageWidth * ImageHeight / 100) << referenceName;
+
+    // If the reference isn't vertically symmetric, a mirrored image differs by far more than that.
+    if (DifferentPixels(Mirrored(reference), reference, 8) > ImageWidth * ImageHeight / 20)
+    {
+        EXPECT_GT(DifferentPixels(Mirrored(image), reference, 8), ImageWidth * ImageHeight / 100) << referenceName;
+    }
+}
+
+} // namespace
+
+/**
+ * The preset framebuffer was once drawn upside down and flipped with extra copies each frame.
+ * The reference images of all test presets were rendered with that pipeline, so any pass
+ * sampling with the wrong orientation after the flip removal shows up as a mirrored image.
+ * Set the environment variable PROJECTM_TEST_WRITE_REFERENCE_IMAGES to write new reference
+ * images instead of comparing.
+ */
+TEST(PresetRendering, MatchesReferenceImages)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    auto const presetNames = TestPresetNames();
+    ASSERT_FALSE(presetNames.empty());
+
+    for (const auto& presetName : presetNames)
+    {
+        ExpectReferenceImage(presetName.substr(0, presetName.rfind('.')), RenderPreset(presetName));
+    }
+}
+
+/**
+ * The initial image of a new preset is copied from the previous preset's output. The second
+ * preset keeps that image unchanged, so it must match the reference rendered before the flip removal.
+ */
+TEST(PresetRendering, InitialImageMatchesReferenceImage)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    auto const image = RenderPresets({"330-textured-shape.milk", "350-initial-image.milk"});
+
+    // Make sure the first preset's image was actually carried over.
+    EXPECT_GT(DifferentPixels(image, Image(image.size()), 16), ImageWidth * ImageHeight / 20);
+
+    ExpectReferenceImage("330-textured-shape-350-initial-image", image);
+}
+
+/**
+ * The fast blur uses a smaller kernel than Milkdrop's blur, so the images differ slightly.
+ * Make sure it stays close enough to look the same, including the position of the blurred image.
+ */
+TEST(PresetRendering, FastBlurIsCloseToClassicBlur)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    auto const classicImage = RenderPreset("290-blur.milk");
+    auto const fastImage = RenderPreset("290-blur.milk", [](libprojectM::ProjectM& projectM) {
+        projectM.SetFastBlurEnabled(true);
+    });
+
+    EXPECT_LE(MaxDifference(classicImage, fastImage), 40);
+    EXPECT_LE(DifferentPixels(classicImage, fastImage, 16), ImageWidth * ImageHeight / 50);
+}
+
+/**
+ * With a pipeline depth of 2, each frame is prepared on a worker thread while the previous one
+ * is drawn. The frame times are exact binary fractions, so the predicted time of the prepared
+ * frame is exact and the images must be identical.
+ */
+TEST(PresetRendering, PipelineDepthDoesNotChangeImage)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    auto const configureDepth = [](int depth) {
+        return [depth](libprojectM::ProjectM& projectM) {
+            projectM.SetPipelineDepth(depth);
+        };
+    };
+
+    auto const singleFrameImage = RenderPreset("310-frame-pipeline.milk", configureDepth(1), 1.0 / 32.0);
+    auto const pipelinedImage = RenderPreset("310-frame-pipeline.milk", configureDepth(2), 1.0 / 32.0);
+
+    // Make sure the preset actually draws something.
+    EXPECT_GT(DifferentPixels(singleFrameImage, Image(singleFrameImage.size()), 16), ImageWidth * ImageHeight / 10);
+
+    EXPECT_EQ(MaxDifference(singleFrameImage, pipelinedImage), 0);
+}
+
+/**
+ * Several instances render the same preset on their own threads and OpenGL contexts, while
+ * their expression code uses megabuf and gmegabuf. Each image must be identical to the one
+ * rendered by a single instance. Build with -fsanitize=thread to check for data races between
+ * the instances.
+ */
+TEST(PresetRendering, ConcurrentInstances)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    static constexpr int threadCount{4};
+    static constexpr int rendersPerThread{3};
+
+    auto const referenceImage = RenderPreset("320-memory-buffers.milk");
+    EXPECT_GT(DifferentPixels(referenceImage, Image(referenceImage.size()), 16), ImageWidth * ImageHeight / 10);
+
+    std::vector<Image> images(threadCount * rendersPerThread);
+    std::atomic<int> threadContexts{};
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < threadCount; threadIndex++)
+    {
+        threads.emplace_back([threadIndex, &images, &threadContexts]() {
+            OffscreenContext threadContext;
+            if (!threadContext.Current())
+            {
+                return;
+            }
+
+            threadContexts++;
+            for (int render = 0; render < rendersPerThread; render++)
+            {
+                images[threadIndex * rendersPerThread + render] = RenderPreset("320-memory-buffers.milk");
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(threadContexts, threadCount);
+    for (const auto& image : images)
+    {
+        ASSERT_EQ(image.size(), referenceImage.size());
+        EXPECT_EQ(MaxDifference(image, referenceImage), 0);
+    }
+}
+
+/**
+ * Measures how the total frame rate scales with the number of instances rendering on their own
+ * threads. Software OpenGL drivers use several threads themselves, so the scaling of the preset
+ * code is only visible with hardware drivers. Disabled by default, run with
+ * --gtest_also_run_disabled_tests --gtest_filter=PresetRendering.DISABLED_ConcurrentInstanceThroughput
+ */
+TEST(PresetRendering, DISABLED_ConcurrentInstanceThroughput)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    static constexpr int framesPerInstance{300};
+
+    auto const maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    double singleThreadRate{};
+
+    for (unsigned int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+    {
+        std::vector<std::thread> threads;
+        auto const start = std::chrono::steady_clock::now();
+        for (unsigned int threadIndex = 0; threadIndex < threadCount; threadIndex++)
+        {
+            threads.emplace_back([]() {
+                OffscreenContext threadContext;
+                if (threadContext.Current())
+                {
+                    RenderPreset("320-memory-buffers.milk", {}, 1.0 / 30.0, framesPerInstance);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+
+        auto const rate = threadCount * framesPerInstance / elapsed.count();
+        if (threadCount == 1)
+        {
+            singleThreadRate = rate;
+        }
+
+        std::cout << threadCount << " instances: " << static_cast<int>(rate) << " frames/s, "
+                  << static_cast<int>(100.0 * rate / (threadCount * singleThreadRate)) << "% scaling efficiency" << std::endl;
+    }
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/MilkdropShader.hpp>
+
+#include <string>
+
+using libprojectM::MilkdropPreset::MilkdropShader;
+
+namespace {
+
+/**
+ * Returns the preprocessed code after the header and defines.
+ */
+auto PreprocessedBody(const std::string& code, MilkdropShader::ShaderType type) -> std::string
+{
+    auto const result = MilkdropShader::PreprocessPresetShader(code, type);
+    auto const entryPoint = result.find("void PS(");
+    EXPECT_NE(entryPoint, std::string::npos);
+    return entryPoint != std::string::npos ? result.substr(entryPoint) : std::string();
+}
+
+} // namespace
+
+TEST(PresetShaderPreprocessor, WarpShader)
+{
+    auto const body = PreprocessedBody("shader_body\n"
+                                       "{\n"
+                                       "ret = tex2D(sampler_main, uv).xyz;\n"
+                                       "}\n",
+                                       MilkdropShader::ShaderType::WarpShader);
+
+    EXPECT_EQ(body, "void PS(float4 _vDiffuse : COLOR, float4 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR0, out float4 _mv_tex_coords : COLOR1)\n"
+                    "\n"
+                    "{\n"
+                    "float3 ret = 0;\n"
+                    "_mv_tex_coords.xy = _uv.xy;\n"
+                    "\n"
+                    "ret = tex2D(sampler_main, uv).xyz;\n"
+                    "_return_value = float4(ret.xyz, 1.0);\n"
+                    "}\n");
+}
+
+TEST(PresetShaderPreprocessor, CompositeShader)
+{
+    auto const result = MilkdropShader::PreprocessPresetShader("shader_body { ret = hue_shader; }",
+                                                               MilkdropShader::ShaderType::CompositeShader);
+
+    EXPECT_NE(result.find("#define hue_shader _vDiffuse.xyz\n"), std::string::npos);
+    EXPECT_NE(result.find("out float4 _return_value : COLOR)\n {\nfloat3 ret = 0;\n ret = hue_shader; _return_value"), std::string::npos);
+    EXPECT_EQ(result.find("_mv_tex_coords"), std::string::npos);
+}
+
+TEST(PresetShaderPreprocessor, RemovesSamplerStates)
+{
+    auto const result = MilkdropShader::PreprocessPresetShader("sampler sampler_pw_noise = sampler_state { Filter = LINEAR; AddressU = WRAP; };\n"
+                                                               "sampler sampler_fc_main = sampler_state { Filter = POINT; };\n"
+                                                               "shader_body { ret = 0; }",
+                                                               MilkdropShader::ShaderType::CompositeShader);
+
+    EXPECT_EQ(result.find("sampler_state"), std::string::npos);
+    EXPECT_NE(result.find("sampler sampler_pw_noise ;\nsampler sampler_fc_main ;\nvoid PS("), std::string::npos);
+    EXPECT_NE(result.find("{\nfloat3 ret = 0;\n ret = 0; _return_value"), std::string::npos);
+}
+
+TEST(PresetShaderPreprocessor, CutsTextAfterMainFunction)
+{
+    auto const body = PreprocessedBody("float3 Helper(float3 value) { return value; }\n"
+                                       "shader_body\n"
+                                       "{\n"
+                                       "// Closing } brace in a comment\n"
+                                       "if (rad > 0.5) { ret = Helper(1); }\n"
+                                       "}\n"
+                                       "trailing text without braces",
+                                       MilkdropShader::ShaderType::CompositeShader);
+
+    EXPECT_NE(body.find("if (rad > 0.5) { ret = Helper(1); }\n_return_value = float4(ret.xyz, 1.0);\n}\n"), std::string::npos);
+    EXPECT_EQ(body.find("trailing text"), std::string::npos);
+
+    auto const result = MilkdropShader::PreprocessPresetShader("float3 Helper(float3 value) { return value; }\nshader_body { }",
+                                                               MilkdropShader::ShaderType::CompositeShader);
+    EXPECT_NE(result.find("float3 Helper(float3 value) { return value; }\nvoid PS("), std::string::npos);
+}
+
+TEST(PresetShaderPreprocessor, InvalidCode)
+{
+    EXPECT_THROW(MilkdropShader::PreprocessPresetShader("", MilkdropShader::ShaderType::WarpShader),
+                 libprojectM::Renderer::ShaderException);
+    EXPECT_THROW(MilkdropShader::PreprocessPresetShader("{ ret = 0; }", MilkdropShader::ShaderType::WarpShader),
+                 libprojectM::Renderer::ShaderException);
+    EXPECT_THROW(MilkdropShader::PreprocessPresetShader("shader_body ret = 0;", MilkdropShader::ShaderType::WarpShader),
+                 libprojectM::Renderer::ShaderException);
+    EXPECT_THROW(MilkdropShader::PreprocessPresetShader("shader_body { ret = 0;", MilkdropShader::ShaderType::WarpShader),
+                 libprojectM::Renderer::ShaderException);
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <QualityGovernor.hpp>
+
+using libprojectM::QualityGovernor;
+
+static constexpr double frameTimeBudget{1.0 / 50.0};
+
+/**
+ * Feeds one full evaluation window with the given frame time.
+ * @return true if the quality level changed at the end of the window.
+ */
+static auto RunWindow(QualityGovernor& governor, double frameTime) -> bool
+{
+    bool changed{false};
+    for (int frame = 0; frame < QualityGovernor::EvaluationFrames; frame++)
+    {
+        changed = governor.Update(frameTime);
+    }
+    return changed;
+}
+
+TEST(QualityGovernor, DisabledByDefault)
+{
+    QualityGovernor governor;
+    governor.SetFrameTimeBudget(frameTimeBudget);
+
+    EXPECT_FALSE(governor.Enabled());
+    EXPECT_FALSE(RunWindow(governor, frameTimeBudget * 4.0));
+    EXPECT_EQ(governor.QualityLevel(), 0);
+}
+
+TEST(QualityGovernor, DegradesWhenOverBudget)
+{
+    QualityGovernor governor;
+    governor.SetFrameTimeBudget(frameTimeBudget);
+    governor.SetEnabled(true);
+
+    EXPECT_TRUE(RunWindow(governor, frameTimeBudget * 2.0));
+    EXPECT_EQ(governor.QualityLevel(), 1);
+    EXPECT_LT(governor.Settings().meshScale, 1.0f);
+
+    // Degrades one step per window, until the lowest level is reached.
+    for (int level = 2; level <= QualityGovernor::MaxQualityLevel(); level++)
+    {
+        EXPECT_TRUE(RunWindow(governor, frameTimeBudget * 2.0));
+        EXPECT_EQ(governor.QualityLevel(), level);
+    }
+
+    EXPECT_FALSE(RunWindow(governor, frameTimeBudget * 2.0));
+    EXPECT_EQ(governor.QualityLevel(), QualityGovernor::MaxQualityLevel());
+}
+
+TEST(QualityGovernor, KeepsLevelWithinBudget)
+{
+    QualityGovernor governor;
+    governor.SetFrameTimeBudget(frameTimeBudget);
+    governor.SetEnabled(true);
+
+    RunWindow(governor, frameTimeBudget * 2.0);
+    ASSERT_EQ(governor.QualityLevel(), 1);
+
+    // Slightly below budget is not enough headroom to restore quality.
+    for (int window = 0; window < QualityGovernor::RestoreWindows * 2; window++)
+    {
+        EXPECT_FALSE(RunWindow(governor, frameTimeBudget * 0.9));
+    }
+    EXPECT_EQ(governor.QualityLevel(), 1);
+}
+
+TEST(QualityGovernor, RestoresWithHysteresis)
+{
+    QualityGovernor governor;
+    governor.SetFrameTimeBudget(frameTimeBudget);
+    governor.SetEnabled(true);
+
+    RunWindow(governor, frameTimeBudget * 2.0);
+    RunWindow(governor, frameTimeBudget * 2.0);
+    ASSERT_EQ(governor.QualityLevel(), 2);
+
+    // Needs several consecutive windows with headroom before restoring.
+    for (int window = 1; window < QualityGovernor::RestoreWindows; window++)
+    {
+        EXPECT_FALSE(RunWindow(governor, frameTimeBudget * 0.5));
+    }
+    EXPECT_TRUE(RunWindow(governor, frameTimeBudget * 0.5));
+    EXPECT_EQ(governor.QualityLevel(), 1);
+
+    // A window within budget resets the headroom counter.
+    for (int window = 1; window < QualityGovernor::RestoreWindows; window++)
+    {
+        RunWindow(governor, frameTimeBudget * 0.5);
+    }
+    RunWindow(governor, frameTimeBudget * 0.9);
+    EXPECT_FALSE(RunWindow(governor, frameTimeBudget * 0.5));
+    EXPECT_EQ(governor.QualityLevel(), 1);
+}
+
+TEST(QualityGovernor, IgnoresInvalidFrameTimes)
+{
+    QualityGovernor governor;
+    governor.SetFrameTimeBudget(frameTimeBudget);
+    governor.SetEnabled(true);
+
+    EXPECT_FALSE(RunWindow(governor, 0.0));
+    EXPECT_FALSE(RunWindow(governor, -1.0));
+    EXPECT_FALSE(RunWindow(governor, 5.0));
+    EXPECT_EQ(governor.QualityLevel(), 0);
+}
+
+TEST(QualityGovernor, DisableRestoresFullQuality)
+{
+    QualityGovernor governor;
+    governor.SetFrameTimeBudget(frameTimeBudget);
+    governor.SetEnabled(true);
+
+    RunWindow(governor, frameTimeBudget * 2.0);
+    ASSERT_EQ(governor.QualityLevel(), 1);
+
+    governor.SetEnabled(false);
+    EXPECT_EQ(governor.QualityLevel(), 0);
+    EXPECT_FLOAT_EQ(governor.Settings().renderScale, 1.0f);
+    EXPECT_FLOAT_EQ(governor.Settings().meshScale, 1.0f);
+}
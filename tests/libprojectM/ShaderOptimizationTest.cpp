@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <GLSLGenerator.h>
+#include <HLSLParser.h>
+
+#include <string>
+
+namespace {
+
+/**
+ * Parses the given HLSL code, runs the optimization passes and returns the generated GLSL code.
+ */
+auto OptimizeAndGenerate(const std::string& code,
+                         M4::GLSLGenerator::Version version = M4::GLSLGenerator::Version_330,
+                         unsigned int flags = 0) -> std::string
+{
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    M4::HLSLParser parser(&allocator, &tree);
+    EXPECT_TRUE(parser.Parse("", code.c_str(), code.size()));
+
+    M4::PruneTree(&tree, "PS");
+    M4::FoldConstants(&tree);
+
+    M4::GLSLGenerator generator;
+    EXPECT_TRUE(generator.Generate(&tree, M4::GLSLGenerator::Target_FragmentShader, version, "PS",
+                                   M4::GLSLGenerator::Options(flags)));
+    return generator.GetResult();
+}
+
+} // namespace
+
+TEST(ShaderOptimization, PrunesUnusedDeclarations)
+{
+    auto const glsl = OptimizeAndGenerate("uniform float4 _c0;\n"
+                                          "uniform float4 _c1, _c2;\n"
+                                          "uniform sampler2D sampler_main;\n"
+                                          "uniform sampler2D sampler_noise_lq;\n"
+                                          "float Unused(float x) { return x; }\n"
+                                          "float3 Helper(float3 x) { return x.zyx; }\n"
+                                          "void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                                          "{\n"
+                                          "    _return_value = float4(Helper(tex2D(sampler_main, _uv.xy).xyz), _c2.x);\n"
+                                          "}\n");
+
+    EXPECT_EQ(glsl.find("_c0"), std::string::npos);
+    EXPECT_EQ(glsl.find("Unused"), std::string::npos);
+    EXPECT_EQ(glsl.find("sampler_noise_lq"), std::string::npos);
+
+    // Variables declared in the same statement are kept together.
+    EXPECT_NE(glsl.find("uniform vec4 _c1, _c2;"), std::string::npos);
+    EXPECT_NE(glsl.find("uniform sampler2D sampler_main;"), std::string::npos);
+    EXPECT_NE(glsl.find("Helper("), std::string::npos);
+}
+
+TEST(ShaderOptimization, FoldsConstants)
+{
+    auto const glsl = OptimizeAndGenerate("void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                                          "{\n"
+                                          "    float a = 2.0 * 0.25 + 1;\n"
+                                          "    int b = 7 / 2 - 1;\n"
+                                          "    float c = -(0.5 * 3);\n"
+                                          "    float3 d = _uv.xyz * 1 + 0;\n"
+                                          "    float e = (1 > 0 ? _uv.x : _uv.y) / 1;\n"
+                                          "    _return_value = float4(d * a, b + c + e);\n"
+                                          "}\n");
+
+    EXPECT_NE(glsl.find("float a = float( float(1.5) );"), std::string::npos);
+    EXPECT_NE(glsl.find("int b = int( 2 );"), std::string::npos);
+    EXPECT_NE(glsl.find("float c = float( float(-1.5) );"), std::string::npos);
+    EXPECT_NE(glsl.find("vec3 d = vec3( (_uv).xyz );"), std::string::npos);
+}
+
+TEST(ShaderOptimization, KeepsUnsafeOperations)
+{
+    auto const glsl = OptimizeAndGenerate("void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                                          "{\n"
+                                          "    int a = 1 / 0;\n"
+                                          "    float b = _uv.x * 0;\n"
+                                          "    float c = a * 1.0;\n"
+                                          "    _return_value = float4(_uv.xyz, b + c);\n"
+                                          "}\n");
+
+    EXPECT_NE(glsl.find("int a = int( (1 / 0) );"), std::string::npos);
+    EXPECT_NE(glsl.find("float b = float( ((_uv).x * float (0)) );"), std::string::npos);
+
+    // The integer must still be converted to a float.
+    EXPECT_NE(glsl.find("float c = float( (float (a) * float(1)) );"), std::string::npos);
+}
+
+TEST(ShaderOptimization, FoldsWithFullPrecision)
+{
+    auto const glsl = OptimizeAndGenerate("void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                                          "{\n"
+                                          "    float a = 1024 * 1024.0;\n"
+                                          "    float b = 3.14159265 * 1;\n"
+                                          "    float c = 1.0 / 3.0;\n"
+                                          "    float d = 0.25 + 0.5;\n"
+                                          "    _return_value = float4(a, b, c, d);\n"
+                                          "}\n");
+
+    EXPECT_NE(glsl.find("float a = float( float(1048576) );"), std::string::npos);
+    EXPECT_NE(glsl.find("float b = float( float(3.1415927) );"), std::string::npos);
+    EXPECT_NE(glsl.find("float c = float( float(0.33333334) );"), std::string::npos);
+
+    // Values which are exact with fewer digits are written as short as possible.
+    EXPECT_NE(glsl.find("float d = float( float(0.75) );"), std::string::npos);
+}
+
+TEST(ShaderOptimization, KeepsNonFiniteResults)
+{
+    auto const glsl = OptimizeAndGenerate("void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                                          "{\n"
+                                          "    float a = 1.0 / 0.0;\n"
+                                          "    float b = 0.0 / 0.0;\n"
+                                          "    float c = 3e38 * 10.0;\n"
+                                          "    _return_value = float4(a, b, c, 1);\n"
+                                          "}\n");
+
+    EXPECT_NE(glsl.find("float a = float( (float(1) / float(0)) );"), std::string::npos);
+    EXPECT_NE(glsl.find("float b = float( (float(0) / float(0)) );"), std::string::npos);
+    EXPECT_NE(glsl.find("float c = float( (float(3e+38) * float(10)) );"), std::string::npos);
+    EXPECT_EQ(glsl.find("inf"), std::string::npos);
+    EXPECT_EQ(glsl.find("nan"), std::string::npos);
+}
+
+TEST(ShaderOptimization, KeepsIntegerOverflow)
+{
+    auto const glsl = OptimizeAndGenerate("void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                                          "{\n"
+                                          "    int a = 2147483647 + 1;\n"
+                                          "    int b = -2147483647 - 2;\n"
+                                          "    int c = 65536 * 65536;\n"
+                                          "    int d = (-2147483647 - 1) / -1;\n"
+                                          "    int e = 65536 * 32767;\n"
+                                          "    _return_value = float4(a, b, c, d + e);\n"
+                                          "}\n");
+
+    EXPECT_NE(glsl.find("int a = int( (2147483647 + 1) );"), std::string::npos);
+    EXPECT_NE(glsl.find("int b = int( (-2147483647 - 2) );"), std::string::npos);
+    EXPECT_NE(glsl.find("int c = int( (65536 * 65536) );"), std::string::npos);
+    EXPECT_NE(glsl.find("int d = int( (-2147483648 / -1) );"), std::string::npos);
+
+    // Results in range are still folded.
+    EXPECT_NE(glsl.find("int e = int( 2147418112 );"), std::string::npos);
+}
+
+TEST(ShaderOptimization, MediumPrecisionOutputs)
+{
+    std::string const code = "uniform sampler3D sampler_noisevol_lq;\n"
+                             "void PS(float4 _uv : TEXCOORD0, out float4 _return_value : COLOR)\n"
+                             "{\n"
+                             "    _return_value = tex3D(sampler_noisevol_lq, _uv.xyz);\n"
+                             "}\n";
+
+    auto const glslEs = OptimizeAndGenerate(code, M4::GLSLGenerator::Version_300_ES,
+                                            M4::GLSLGenerator::Flag_MediumPrecisionOutputs);
+    EXPECT_NE(glslEs.find("precision highp float;\nprecision mediump sampler3D;"), std::string::npos);
+    EXPECT_NE(glslEs.find("out mediump vec4 rast_FragData[1];"), std::string::npos);
+
+    auto const glslEsDefault = OptimizeAndGenerate(code, M4::GLSLGenerator::Version_300_ES);
+    EXPECT_NE(glslEsDefault.find("precision highp sampler3D;"), std::string::npos);
+    EXPECT_NE(glslEsDefault.find("out vec4 rast_FragData[1];"), std::string::npos);
+
+    auto const glslDesktop = OptimizeAndGenerate(code, M4::GLSLGenerator::Version_330,
+                                                 M4::GLSLGenerator::Flag_MediumPrecisionOutputs);
+    EXPECT_EQ(glslDesktop.find("mediump"), std::string::npos);
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/SharedVariableBlock.hpp>
+
+using libprojectM::MilkdropPreset::ExpressionEngine;
+using libprojectM::MilkdropPreset::SharedVariableBinding;
+using libprojectM::MilkdropPreset::SharedVariableBlock;
+
+TEST(SharedVariableBlock, VariableNames)
+{
+    EXPECT_EQ(SharedVariableBlock::Name(SharedVariableBlock::Time), "time");
+    EXPECT_EQ(SharedVariableBlock::Name(SharedVariableBlock::TrebAtt), "treb_att");
+    EXPECT_EQ(SharedVariableBlock::Name(SharedVariableBlock::Q1), "q1");
+    EXPECT_EQ(SharedVariableBlock::Name(SharedVariableBlock::Count - 1), "q32");
+}
+
+TEST(SharedVariableBlock, RestoresOnlyAssignedVariables)
+{
+    auto& engine = ExpressionEngine::Default();
+    ExpressionEngine::GlobalRegisters globalRegisters{};
+    auto globalMemory = engine.CreateMemoryBuffer();
+    auto context = engine.CreateContext(*globalMemory, &globalRegisters);
+
+    SharedVariableBlock block;
+    SharedVariableBinding binding;
+    binding.Register(*context, block);
+
+    std::string const code = "q1 = 5; bass = bass + 2;";
+    binding.AddCode(code);
+    auto program = context->Compile(code);
+    ASSERT_TRUE(program);
+
+    binding.Load();
+    program->Execute();
+    *binding.Variable(SharedVariableBlock::Treb) = 7.0;
+
+    EXPECT_DOUBLE_EQ(*context->RegisterVariable("q1"), 5.0);
+    EXPECT_DOUBLE_EQ(*context->RegisterVariable("bass"), 2.0);
+
+    binding.Restore();
+
+    EXPECT_DOUBLE_EQ(*binding.Variable(SharedVariableBlock::Q1), 0.0);
+    EXPECT_DOUBLE_EQ(*binding.Variable(SharedVariableBlock::Bass), 0.0);
+    EXPECT_DOUBLE_EQ(*binding.Variable(SharedVariableBlock::Treb), 7.0);
+
+    binding.Load();
+
+    EXPECT_DOUBLE_EQ(*binding.Variable(SharedVariableBlock::Treb), 0.0);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include "OffscreenContext.hpp"
+
+#include <Renderer/StateCache.hpp>
+
+#include <array>
+
+using libprojectM::Renderer::StateCache;
+
+namespace {
+
+/**
+ * Texture objects and a sampler created for the test and deleted afterwards.
+ */
+struct TestObjects
+{
+    TestObjects()
+    {
+        glGenTextures(static_cast<GLsizei>(textures.size()), textures.data());
+        glGenSamplers(1, &sampler);
+        for (size_t index = 0; index < textures.size(); index++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[index]);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    ~TestObjects()
+    {
+        glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+        glDeleteSamplers(1, &sampler);
+    }
+
+    std::array<GLuint, 4> textures{};
+    GLuint sampler{};
+};
+
+auto BoundTexture(GLuint unit) -> GLuint
+{
+    GLint texture{};
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+    return static_cast<GLuint>(texture);
+}
+
+auto BoundSampler(GLuint unit) -> GLuint
+{
+    GLint sampler{};
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(GL_SAMPLER_BINDING, &sampler);
+    return static_cast<GLuint>(sampler);
+}
+
+} // namespace
+
+TEST(StateCache, RestoresHostTextureUnits)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    TestObjects objects;
+
+    // Host bindings on several units, with unit 2 active.
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, objects.textures[0]);
+    glBindSampler(1, objects.sampler);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, objects.textures[1]);
+    glActiveTexture(GL_TEXTURE2);
+
+    StateCache stateCache;
+    stateCache.SetSaveHostState(true);
+    {
+        StateCache::ScopedFrame frame(stateCache);
+        stateCache.BindTexture(1, GL_TEXTURE_2D, objects.textures[2]);
+        stateCache.BindSampler(1, 0);
+        stateCache.BindTexture(5, GL_TEXTURE_2D, objects.textures[3]);
+        stateCache.BindTexture(7, GL_TEXTURE_2D, objects.textures[3]);
+        stateCache.BindSampler(7, objects.sampler);
+    }
+
+    GLint activeTexture{};
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    EXPECT_EQ(activeTexture, GL_TEXTURE2);
+
+    EXPECT_EQ(BoundTexture(1), objects.textures[0]);
+    EXPECT_EQ(BoundSampler(1), objects.sampler);
+    EXPECT_EQ(BoundTexture(5), objects.textures[1]);
+    EXPECT_EQ(BoundTexture(7), 0);
+    EXPECT_EQ(BoundSampler(7), 0);
+}
+
+TEST(StateCache, ResetsToDefaultsWithoutHostState)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    TestObjects objects;
+
+    StateCache stateCache;
+    EXPECT_FALSE(stateCache.SaveHostState());
+
+    stateCache.Begin();
+    stateCache.BindTexture(3, GL_TEXTURE_2D, objects.textures[0]);
+    stateCache.BindTexture(6, GL_TEXTURE_2D, objects.textures[1]);
+    stateCache.BindSampler(6, objects.sampler);
+    stateCache.SetBlend(true);
+    stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Binding the same texture again is filtered.
+    auto const before = stateCache.GetStatistics();
+    stateCache.BindTexture(3, GL_TEXTURE_2D, objects.textures[0]);
+    EXPECT_EQ(stateCache.GetStatistics().issuedCalls, before.issuedCalls + 1); // Only the unit switch.
+    stateCache.End();
+
+    GLint activeTexture{};
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    EXPECT_EQ(activeTexture, GL_TEXTURE0);
+    EXPECT_EQ(glIsEnabled(GL_BLEND), GL_FALSE);
+
+    GLint blendSource{};
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+    EXPECT_EQ(blendSource, GL_ONE);
+
+    EXPECT_EQ(BoundTexture(3), 0);
+    EXPECT_EQ(BoundTexture(6), 0);
+    EXPECT_EQ(BoundSampler(6), 0);
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/ThreadPool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using libprojectM::MilkdropPreset::ThreadPool;
+
+TEST(ThreadPool, RunsEachIndexOnce)
+{
+    ThreadPool pool(3);
+    EXPECT_EQ(pool.WorkerCount(), 3);
+
+    for (size_t count : {0, 1, 2, 17, 100})
+    {
+        std::vector<std::atomic<int>> calls(count);
+        pool.Run(count, [&calls](size_t index) {
+            calls[index]++;
+        });
+
+        for (size_t index = 0; index < count; index++)
+        {
+            EXPECT_EQ(calls[index], 1) << "count " << count << ", index " << index;
+        }
+    }
+}
+
+TEST(ThreadPool, RunsWithoutWorkers)
+{
+    ThreadPool pool(0);
+    EXPECT_EQ(pool.WorkerCount(), 0);
+
+    auto const caller = std::this_thread::get_id();
+    int sum{};
+    pool.Run(4, [&](size_t index) {
+        EXPECT_EQ(std::this_thread::get_id(), caller);
+        sum += static_cast<int>(index);
+    });
+
+    EXPECT_EQ(sum, 6);
+}
+
+TEST(ThreadPool, ConcurrentCallers)
+{
+    ThreadPool pool(2);
+    std::atomic<int> total{};
+
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < 4; caller++)
+    {
+        callers.emplace_back([&pool, &total]() {
+            for (int run = 0; run < 50; run++)
+            {
+                pool.Run(8, [&total](size_t) {
+                    total++;
+                });
+            }
+        });
+    }
+
+    for (auto& caller : callers)
+    {
+        caller.join();
+    }
+
+    EXPECT_EQ(total, 4 * 50 * 8);
+}
+
+TEST(ThreadPool, ConcurrentCallsOverlap)
+{
+    ThreadPool pool(1);
+    std::atomic<int> runningCallers{};
+    std::atomic<bool> overlapped{false};
+
+    // Each caller's tasks wait until a task of the other call is running. If calls waited for
+    // each other, the first call's tasks would time out.
+    auto const runCall = [&]() {
+        pool.Run(2, [&](size_t index) {
+            if (index != 0)
+            {
+                return;
+            }
+
+            runningCallers++;
+            auto const timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (runningCallers < 2 && std::chrono::steady_clock::now() < timeout)
+            {
+                std::this_thread::yield();
+            }
+            if (runningCallers == 2)
+            {
+                overlapped = true;
+            }
+        });
+    };
+
+    std::thread firstCaller(runCall);
+    std::thread secondCaller(runCall);
+    firstCaller.join();
+    secondCaller.join();
+
+    EXPECT_TRUE(overlapped);
+}
@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+
+#include "OffscreenContext.hpp"
+
+#include <Renderer/TransitionShaderManager.hpp>
+
+using libprojectM::Renderer::TransitionShaderManager;
+
+/**
+ * All transition shaders start compiling on construction. Once selected, a shader must be
+ * linked and usable without waiting for the driver again.
+ */
+TEST(TransitionShaderManager, SelectsCompiledShaders)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    TransitionShaderManager manager;
+
+    for (int selection = 0; selection < 20; selection++)
+    {
+        auto const transitionShader = manager.RandomTransition();
+        ASSERT_NE(transitionShader, nullptr);
+        EXPECT_TRUE(transitionShader->IsCompilationComplete());
+        EXPECT_NO_THROW(transitionShader->FinishCompilation());
+    }
+
+    EXPECT_TRUE(manager.IsCompilationComplete());
+}
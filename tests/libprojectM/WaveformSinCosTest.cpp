@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <MilkdropPreset/Waveforms/SinCos.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+using libprojectM::MilkdropPreset::Waveforms::SinCos;
+
+TEST(WaveformSinCos, MatchesStandardLibrary)
+{
+    std::vector<float> angles;
+    for (float angle = -20000.0f; angle < 20000.0f; angle += 0.37f)
+    {
+        angles.push_back(angle);
+    }
+
+    std::vector<float> sines(angles.size());
+    std::vector<float> cosines(angles.size());
+    SinCos(angles.data(), sines.data(), cosines.data(), angles.size());
+
+    for (size_t index = 0; index < angles.size(); index++)
+    {
+        EXPECT_NEAR(sines[index], std::sin(static_cast<double>(angles[index])), 1e-6) << "angle " << angles[index];
+        EXPECT_NEAR(cosines[index], std::cos(static_cast<double>(angles[index])), 1e-6) << "angle " << angles[index];
+    }
+}
+
+TEST(WaveformSinCos, QuadrantBoundaries)
+{
+    constexpr float pi{3.14159265358979f};
+    std::vector<float> const angles{0.0f, pi / 4.0f, pi / 2.0f, 3.0f * pi / 4.0f, pi, -pi / 2.0f, -pi, 2.0f * pi};
+
+    std::vector<float> sines(angles.size());
+    std::vector<float> cosines(angles.size());
+    SinCos(angles.data(), sines.data(), cosines.data(), angles.size());
+
+    for (size_t index = 0; index < angles.size(); index++)
+    {
+        EXPECT_NEAR(sines[index], std::sin(angles[index]), 1e-6) << "angle " << angles[index];
+        EXPECT_NEAR(cosines[index], std::cos(angles[index]), 1e-6) << "angle " << angles[index];
+    }
+}
+
+TEST(WaveformSinCos, LargeAndNonFiniteAngles)
+{
+    std::vector<float> const angles{std::nanf(""), std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                                    3.5e9f, -1.0e20f, std::numeric_limits<float>::max(), 100001.0f, 1.0f};
+
+    std::vector<float> sines(angles.size());
+    std::vector<float> cosines(angles.size());
+    SinCos(angles.data(), sines.data(), cosines.data(), angles.size());
+
+    for (size_t index = 0; index < angles.size(); index++)
+    {
+        if (std::isfinite(angles[index]))
+        {
+            EXPECT_FLOAT_EQ(sines[index], sinf(angles[index])) << "angle " << angles[index];
+            EXPECT_FLOAT_EQ(cosines[index], cosf(angles[index])) << "angle " << angles[index];
+        }
+        else
+        {
+            EXPECT_TRUE(std::isnan(sines[index])) << "angle " << angles[index];
+            EXPECT_TRUE(std::isnan(cosines[index])) << "angle " << angles[index];
+        }
+    }
+}
+
+TEST(WaveformSinCos, Throughput)
+{
+    // Not a pass/fail criterion, the timings are recorded in the test report for comparison.
+    std::vector<float> angles(576);
+    for (size_t index = 0; index < angles.size(); index++)
+    {
+        angles[index] = static_cast<float>(index) * 0.0109f + 12.5f;
+    }
+
+    std::vector<float> sines(angles.size());
+    std::vector<float> cosines(angles.size());
+    constexpr int iterations{2000};
+
+    // The checksums keep the compiler from removing the loops.
+    float batchChecksum{};
+    float libraryChecksum{};
+
+    auto const batchStart = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        angles[0] = static_cast<float>(iteration) * 0.001f;
+        SinCos(angles.data(), sines.data(), cosines.data(), angles.size());
+        batchChecksum += sines[0] + cosines[angles.size() - 1];
+    }
+    auto const batchEnd = std::chrono::steady_clock::now();
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        angles[0] = static_cast<float>(iteration) * 0.001f;
+        for (size_t index = 0; index < angles.size(); index++)
+        {
+            sines[index] = sinf(angles[index]);
+            cosines[index] = cosf(angles[index]);
+        }
+        libraryChecksum += sines[0] + cosines[angles.size() - 1];
+    }
+    auto const libraryEnd = std::chrono::steady_clock::now();
+
+    auto const batchNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(batchEnd - batchStart).count() / iterations;
+    auto const libraryNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(libraryEnd - batchEnd).count() / iterations;
+    RecordProperty("SinCosNanoseconds", std::to_string(batchNanoseconds));
+    RecordProperty("LibraryNanoseconds", std::to_string(libraryNanoseconds));
+
+    EXPECT_NEAR(batchChecksum, libraryChecksum, 1e-2f);
+}
@@ -0,0 +1,272 @@
+#include <gtest/gtest.h>
+
+#ifdef PROJECTM_TEST_EGL
+#include "OffscreenContext.hpp"
+
+#include <MilkdropPreset/PerFrameContext.hpp>
+#include <MilkdropPreset/PresetState.hpp>
+#include <MilkdropPreset/Waveforms/Circle.hpp>
+#include <MilkdropPreset/Waveforms/Milkdrop2077WaveFlower.hpp>
+#include <MilkdropPreset/Waveforms/Milkdrop2077WaveLasso.hpp>
+#include <MilkdropPreset/Waveforms/Milkdrop2077WaveSkewed.hpp>
+#include <MilkdropPreset/Waveforms/Milkdrop2077WaveStar.hpp>
+#include <MilkdropPreset/Waveforms/XYOscillationSpiral.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace libprojectM::MilkdropPreset;
+using namespace libprojectM::MilkdropPreset::Waveforms;
+
+namespace {
+
+/*
+ * The reference classes below calculate each vertex with sinf() and cosf(), like the waveforms
+ * did before the batched SinCos() approximation was introduced.
+ */
+
+class ReferenceCircle : public Circle
+{
+protected:
+    void GenerateVertices(const PresetState& presetState, const PerFrameContext&) override
+    {
+        m_samples = libprojectM::Audio::WaveformSamples / 2;
+        m_wave1Vertices.resize(m_samples);
+
+        const int sampleOffset{(libprojectM::Audio::WaveformSamples - m_samples) / 2};
+        const float inverseSamplesMinusOne{1.0f / static_cast<float>(m_samples)};
+
+        for (int i = 0; i < m_samples; i++)
+        {
+            float radius = 0.5f + 0.4f * m_pcmDataR[i + sampleOffset] + m_mysteryWaveParam;
+            float const angle = static_cast<float>(i) * inverseSamplesMinusOne * 6.28f + presetState.renderContext.time * 0.2f;
+            if (i < m_samples / 10)
+            {
+                float mix = static_cast<float>(i) / (static_cast<float>(m_samples) * 0.1f);
+                mix = 0.5f - 0.5f * cosf(mix * 3.1416f);
+                float const radius2 = 0.5f + 0.4f * m_pcmDataR[i + m_samples + sampleOffset] + m_mysteryWaveParam;
+                radius = radius2 * (1.0f - mix) + radius * (mix);
+            }
+
+            m_wave1Vertices[i].x = radius * cosf(angle) * m_aspectY + m_waveX;
+            m_wave1Vertices[i].y = radius * sinf(angle) * m_aspectX + m_waveY;
+        }
+    }
+};
+
+class ReferenceXYOscillationSpiral : public XYOscillationSpiral
+{
+protected:
+    void GenerateVertices(const PresetState& presetState, const PerFrameContext&) override
+    {
+        m_samples = libprojectM::Audio::WaveformSamples / 2;
+        m_wave1Vertices.resize(m_samples);
+
+        for (int i = 0; i < m_samples; i++)
+        {
+            float const radius = (0.53f + 0.43f * m_pcmDataR[i] + m_mysteryWaveParam);
+            float const angle = m_pcmDataL[i + 32] * 1.57f + presetState.renderContext.time * 2.3f;
+
+            m_wave1Vertices[i].x = radius * cosf(angle) * m_aspectY + m_waveX;
+            m_wave1Vertices[i].y = radius * sinf(angle) * m_aspectX + m_waveY;
+        }
+    }
+};
+
+class ReferenceMilkdrop2077WaveStar : public Milkdrop2077WaveStar
+{
+protected:
+    void GenerateVertices(const PresetState& presetState, const PerFrameContext&) override
+    {
+        m_samples = libprojectM::Audio::WaveformSamples / 2;
+        m_wave1Vertices.resize(m_samples + 1);
+
+        int const sampleOffset = (libprojectM::Audio::WaveformSamples - m_samples) / 2;
+        float const invertedSamplesMinusOne = 1.0f / static_cast<float>(m_samples - 1);
+        float const tenthSamples = static_cast<float>(m_samples) * 0.1f;
+
+        for (int sample = 0; sample < m_samples; sample++)
+        {
+            float radius = 0.7f + 0.4f * m_pcmDataR[sample + sampleOffset] + m_mysteryWaveParam;
+            float const angle = static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + presetState.renderContext.time * 0.2f;
+            if (static_cast<float>(sample) < m_samples / radius)
+            {
+                float mix = static_cast<float>(sample) / tenthSamples;
+                mix = 0.5f - 0.5f * cosf(mix * 3.1416f);
+                float const radius2 = 0.5f + 0.4f * m_pcmDataR[sample + m_samples - sampleOffset] + m_mysteryWaveParam;
+                radius = radius2 * (1.0f - mix) + radius * mix;
+            }
+            m_wave1Vertices[sample].x = radius * cosf(angle) * m_aspectY + m_waveX;
+            m_wave1Vertices[sample].y = radius * sinf(angle) * m_aspectX + m_waveY;
+        }
+    }
+};
+
+class ReferenceMilkdrop2077WaveFlower : public Milkdrop2077WaveFlower
+{
+protected:
+    void GenerateVertices(const PresetState& presetState, const PerFrameContext&) override
+    {
+        m_samples = libprojectM::Audio::WaveformSamples / 2;
+        m_wave1Vertices.resize(m_samples + 1);
+
+        int const sampleOffset = (libprojectM::Audio::WaveformSamples - m_samples) / 2;
+        float const invertedSamplesMinusOne = 1.0f / static_cast<float>(m_samples - 1);
+        float const tenthSamples = static_cast<float>(m_samples) * 0.1f;
+
+        for (int sample = 0; sample < m_samples; sample++)
+        {
+            float radius = 0.7f + 0.7f * m_pcmDataR[sample + sampleOffset] + m_mysteryWaveParam;
+            float angle = static_cast<float>(sample) * invertedSamplesMinusOne * 6.28f + presetState.renderContext.time * 0.2f;
+            if (static_cast<float>(sample) < static_cast<float>(m_samples) / radius)
+            {
+                float mix = static_cast<float>(sample) / tenthSamples;
+                mix = 0.7f - 0.7f * cosf(mix * 3.1416f);
+                float const radius2 = 0.7f + 0.7f * m_pcmDataR[sample + m_samples - sampleOffset] + m_mysteryWaveParam;
+                radius = radius2 * (1.0f - mix) + radius * mix * .25f;
+            }
+
+            m_wave1Vertices[sample].x = radius * cosf(angle * 3.1416f) * m_aspectY / 1.5f + m_waveX * cosf(3.1416f);
+            m_wave1Vertices[sample].y = radius * sinf(angle - presetState.renderContext.time / 3.0f) * m_aspectX / 1.5f + m_waveY * cosf(3.1416f);
+        }
+    }
+};
+
+class ReferenceMilkdrop2077WaveSkewed : public Milkdrop2077WaveSkewed
+{
+protected:
+    void GenerateVertices(const PresetState& presetState, const PerFrameContext& presetPerFrameContext) override
+    {
+        m_samples = libprojectM::Audio::WaveformSamples / 2;
+        m_wave1Vertices.resize(m_samples);
+
+        float alpha = static_cast<float>(*presetPerFrameContext.wave_a) * 1.25f;
+        if (presetState.modWaveAlphaByvolume)
+        {
+            alpha *= presetState.audioData.vol;
+        }
+        alpha = std::max(0.0f, std::min(1.0f, alpha));
+
+        for (size_t i = 0; i < static_cast<size_t>(m_samples); i++)
+        {
+            float rad = 0.63f + 0.23f * m_pcmDataR[i] + m_mysteryWaveParam;
+            float ang = m_pcmDataL[i + 32] * 0.9f + presetState.renderContext.time * 3.3f;
+            m_wave1Vertices[i].x = rad * cosf(ang + alpha) * m_aspectY + m_waveX;
+            m_wave1Vertices[i].y = rad * sinf(ang) * m_aspectX + m_waveY;
+        }
+    }
+};
+
+class ReferenceMilkdrop2077WaveLasso : public Milkdrop2077WaveLasso
+{
+protected:
+    void GenerateVertices(const PresetState& presetState, const PerFrameContext&) override
+    {
+        m_samples = libprojectM::Audio::WaveformSamples / 2;
+        m_wave1Vertices.resize(m_samples);
+
+        for (int sample = 0; sample < m_samples; sample++)
+        {
+            float const angle = m_pcmDataL[sample + 32] * 1.57f + presetState.renderContext.time * 2.0f;
+
+            m_wave1Vertices[sample].x = cosf(presetState.renderContext.time) / 2.0f + cosf(angle * 2.0f + tanf(presetState.renderContext.time / angle));
+            m_wave1Vertices[sample].y = sinf(presetState.renderContext.time) * 2.0f * sinf(angle * 3.14f) * m_aspectX / 2.8f + m_waveY;
+        }
+    }
+};
+
+using WaveformPair = std::pair<std::unique_ptr<WaveformMath>, std::unique_ptr<WaveformMath>>;
+
+auto CreateWaveforms() -> std::vector<std::pair<std::string, WaveformPair>>
+{
+    std::vector<std::pair<std::string, WaveformPair>> waveforms;
+    waveforms.emplace_back("Circle", WaveformPair(std::make_unique<Circle>(), std::make_unique<ReferenceCircle>()));
+    waveforms.emplace_back("XYOscillationSpiral", WaveformPair(std::make_unique<XYOscillationSpiral>(), std::make_unique<ReferenceXYOscillationSpiral>()));
+    waveforms.emplace_back("Milkdrop2077WaveStar", WaveformPair(std::make_unique<Milkdrop2077WaveStar>(), std::make_unique<ReferenceMilkdrop2077WaveStar>()));
+    waveforms.emplace_back("Milkdrop2077WaveFlower", WaveformPair(std::make_unique<Milkdrop2077WaveFlower>(), std::make_unique<ReferenceMilkdrop2077WaveFlower>()));
+    waveforms.emplace_back("Milkdrop2077WaveSkewed", WaveformPair(std::make_unique<Milkdrop2077WaveSkewed>(), std::make_unique<ReferenceMilkdrop2077WaveSkewed>()));
+    waveforms.emplace_back("Milkdrop2077WaveLasso", WaveformPair(std::make_unique<Milkdrop2077WaveLasso>(), std::make_unique<ReferenceMilkdrop2077WaveLasso>()));
+    return waveforms;
+}
+
+} // namespace
+
+TEST(WaveformVertices, MatchReferenceImplementation)
+{
+    OffscreenContext context;
+    if (!context.Current())
+    {
+        GTEST_SKIP() << "No off-screen OpenGL 3.3 context available.";
+    }
+
+    PresetState presetState;
+    PerFrameContext perFrameContext(presetState.expressionEngine, *presetState.globalMemory, &presetState.globalRegisters);
+
+    PRJM_EVAL_F waveA{0.6};
+    PRJM_EVAL_F waveX{0.45};
+    PRJM_EVAL_F waveY{0.55};
+    PRJM_EVAL_F waveMystery{0.3};
+    perFrameContext.wave_a = &waveA;
+    perFrameContext.wave_x = &waveX;
+    perFrameContext.wave_y = &waveY;
+    perFrameContext.wave_mystery = &waveMystery;
+
+    presetState.renderContext.viewportSizeX = 1280;
+    presetState.renderContext.viewportSizeY = 720;
+    presetState.audioData.vol = 0.8f;
+    presetState.waveScale = 1.3f;
+    presetState.waveSmoothing = 0.6f;
+
+    unsigned int seed{1};
+    for (size_t sample = 0; sample < presetState.audioData.waveformLeft.size(); sample++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        presetState.audioData.waveformLeft[sample] = static_cast<float>(seed >> 16 & 0xFFFF) / 32768.0f - 1.0f;
+        seed = seed * 1103515245u + 12345u;
+        presetState.audioData.waveformRight[sample] = static_cast<float>(seed >> 16 & 0xFFFF) / 32768.0f - 1.0f;
+    }
+
+    // Includes a preset running for days and times where the lasso divides by values close to 0.
+    for (float const time : {0.0f, 1.7f, 123.4f, 5000.0f, 250000.0f})
+    {
+        presetState.renderContext.time = time;
+
+        // Large angles have fewer fractional bits, so rewriting angle sums like cos(a + b) rounds differently.
+        float const tolerance = 1e-4f + time * 1e-6f;
+
+        for (auto& waveform : CreateWaveforms())
+        {
+            auto const& vertices = waveform.second.first->GetVertices(presetState, perFrameContext);
+            auto const& referenceVertices = waveform.second.second->GetVertices(presetState, perFrameContext);
+
+            for (size_t set = 0; set < vertices.size(); set++)
+            {
+                ASSERT_EQ(vertices[set].size(), referenceVertices[set].size()) << waveform.first;
+
+                for (size_t index = 0; index < vertices[set].size(); index++)
+                {
+                    auto const& vertex = vertices[set][index];
+                    auto const& referenceVertex = referenceVertices[set][index];
+
+                    // Both calculations must produce NaN for the same vertices, otherwise stay within the approximation's error.
+                    EXPECT_EQ(std::isnan(vertex.x), std::isnan(referenceVertex.x)) << waveform.first << " at time " << time << ", vertex " << index;
+                    EXPECT_EQ(std::isnan(vertex.y), std::isnan(referenceVertex.y)) << waveform.first << " at time " << time << ", vertex " << index;
+                    if (!std::isnan(referenceVertex.x))
+                    {
+                        EXPECT_NEAR(vertex.x, referenceVertex.x, tolerance) << waveform.first << " at time " << time << ", vertex " << index;
+                    }
+                    if (!std::isnan(referenceVertex.y))
+                    {
+                        EXPECT_NEAR(vertex.y, referenceVertex.y, tolerance) << waveform.first << " at time " << time << ", vertex " << index;
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -22,3 +22,12 @@ PROJECTM_EXPORT void projectm_load_preset_file(projectm_handle, const char*,
                                bool)
 {
 }
+
+PROJECTM_EXPORT char** projectm_get_pack_preset_files(const char*)
+{
+    return nullptr;
+}
+
+PROJECTM_EXPORT void projectm_free_string_array(char**)
+{
+}